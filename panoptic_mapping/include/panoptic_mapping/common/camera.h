@@ -1,6 +1,8 @@
 #ifndef PANOPTIC_MAPPING_COMMON_CAMERA_H_
 #define PANOPTIC_MAPPING_COMMON_CAMERA_H_
 
+#include <limits>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -8,6 +10,7 @@
 
 #include "panoptic_mapping/3rd_party/config_utilities.hpp"
 #include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/common/max_depth_pyramid.h"
 #include "panoptic_mapping/map/submap.h"
 #include "panoptic_mapping/map/submap_collection.h"
 
@@ -30,6 +33,19 @@ class Camera {
     float fx = 320.f;  // Focal lengths.
     float fy = 320.f;
 
+    // Lens distortion model of the input images. Supported are {pinhole (no
+    // distortion), radtan, equidistant}. Distorted images can be used directly
+    // without rectifying them first.
+    std::string distortion_model = "pinhole";
+
+    // Coefficients of the distortion model. radtan: [k1, k2, p1, p2(, k3)],
+    // equidistant: [k1, k2, k3, k4].
+    std::vector<float> distortion_coefficients;
+
+    // Number of iterations used to invert the distortion when pre-computing the
+    // back-projection rays.
+    int undistortion_iterations = 20;
+
     // Maximum range (ray-length) in meters.
     float max_range = 5.f;
 
@@ -46,8 +62,12 @@ class Camera {
   explicit Camera(const Config& config);
   virtual ~Camera() = default;
 
+  enum class DistortionModel { kPinhole = 0, kRadTan, kEquidistant };
+  static DistortionModel distortionModelFromString(const std::string& model);
+
   // Access.
   const Config& getConfig() const { return config_; }
+  DistortionModel getDistortionModel() const { return distortion_model_; }
 
   // Visibility checks.
   bool pointIsInViewFrustum(const Point& point_C,
@@ -65,6 +85,21 @@ class Camera {
                             const Transformation& T_C_S, float block_size,
                             float block_diag_half) const;
 
+  /**
+   * @brief Conservatively check whether a submap is hidden behind the observed
+   * surfaces, i.e. whether its bounding volume lies farther than the farthest
+   * depth within its screen-space bounds. Only implemented for the pinhole
+   * model, other models never report occlusions.
+   *
+   * @param max_depths Max depth pyramid of the current depth image.
+   * @param depth_margin Additional distance in meters the submap needs to lie
+   * behind the surfaces to count as occluded.
+   * @return True if the submap is fully occluded.
+   */
+  bool submapIsOccluded(const Submap& submap, const Transformation& T_M_C,
+                        const MaxDepthPyramid& max_depths,
+                        float depth_margin = 0.f) const;
+
   // Visibility search.
   std::vector<int> findVisibleSubmapIDs(const SubmapCollection& submaps,
                                         const Transformation& T_M_C,
@@ -84,15 +119,36 @@ class Camera {
 
   bool projectPointToImagePlane(const Point& p_C, int* u, int* v) const;
 
-  cv::Mat computeVertexMap(const cv::Mat& depth_image) const;
+  // Depth images can be float (CV_32FC1) in meters or 16-bit (CV_16UC1) in
+  // units of 'depth_scale' meters, which are converted on the fly.
+  cv::Mat computeVertexMap(const cv::Mat& depth_image,
+                           float depth_scale = 1.f) const;
 
-  cv::Mat computeValidityImage(const cv::Mat& depth_image) const;
+  cv::Mat computeValidityImage(const cv::Mat& depth_image,
+                               float depth_scale = 1.f) const;
 
  private:
+  // Distortion in normalized image coordinates (z = 1). Returns false for
+  // points outside the range where the distortion model is invertible.
+  bool distort(float x, float y, float* x_d, float* y_d) const;
+  void undistort(float x_d, float y_d, float* x, float* y) const;
+  void computeDistortionLimits();
+  void computeRayTable();
+  void computeViewFrustum();
+
   const Config config_;
+  DistortionModel distortion_model_;
+  float k_[5] = {0.f, 0.f, 0.f, 0.f, 0.f};  // Distortion coefficients.
+
+  // Largest undistorted radius (radtan) or incidence angle (equidistant) up
+  // to which the distortion is monotonic. Beyond, points would fold back into
+  // the image.
+  float max_radius_ = std::numeric_limits<float>::max();
+  float max_theta_ = 0.f;
 
   // Pre-computed stored values.
   std::vector<Point> view_frustum_;  // Top, right, bottom, left plane normals.
+  cv::Mat ray_table_;  // CV_32FC2, undistorted normalized x, y per pixel.
 };
 
 }  // namespace panoptic_mapping
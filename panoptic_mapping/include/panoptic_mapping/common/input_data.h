@@ -8,6 +8,7 @@
 #include <opencv2/core/mat.hpp>
 
 #include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/common/max_depth_pyramid.h"
 
 namespace panoptic_mapping {
 class InputDataUser;
@@ -26,6 +27,18 @@ struct DetectronLabel {
 };
 typedef std::unordered_map<int, DetectronLabel> DetectronLabels;  // <id-label>
 
+/**
+ * Metric depth of a pixel of a depth image that is either float (CV_32FC1) in
+ * meters or 16-bit (CV_16UC1) in units of 'depth_scale' meters.
+ */
+inline float depthAt(const cv::Mat& depth_image, float depth_scale, int v,
+                     int u) {
+  if (depth_image.type() == CV_16UC1) {
+    return depth_image.at<uint16_t>(v, u) * depth_scale;
+  }
+  return depth_image.at<float>(v, u);
+}
+
 /**
  * A class that wraps all input data to be processed into a common structure.
  * Optional fields are also included here but the data is only set if required.
@@ -40,7 +53,8 @@ class InputData {
     kDetectronLabels,
     kVertexMap,
     kValidityImage,
-    kUncertaintyImage
+    kUncertaintyImage,
+    kMaxDepthPyramid
   };
 
   static std::string inputTypeToString(InputType type) {
@@ -59,6 +73,8 @@ class InputData {
         return "Vertex Map";
       case InputType::kValidityImage:
         return "Validity Image";
+      case InputType::kMaxDepthPyramid:
+        return "Max Depth Pyramid";
       default:
         return "Unknown Input";
     }
@@ -76,16 +92,26 @@ class InputData {
   void setFrameName(const std::string& frame_name) {
     sensor_frame_name_ = frame_name;
   }
-  void setDepthImage(const cv::Mat& depth_image) {
+  // Depth images are float (CV_32FC1) in meters or 16-bit (CV_16UC1) in units
+  // of 'depth_scale' meters, e.g. 0.001 for millimeters.
+  void setDepthImage(const cv::Mat& depth_image, float depth_scale = 1.f) {
     depth_image_ = depth_image;
+    depth_scale_ = depth_scale;
     contained_inputs_.insert(InputType::kDepthImage);
   }
   void setColorImage(const cv::Mat& color_image) {
     color_image_ = color_image;
     contained_inputs_.insert(InputType::kColorImage);
   }
+  // ID images are kept as CV_32SC1 since the trackers overwrite them in place
+  // with submap IDs, which can exceed 16 bits. CV_32SC1 images are shared,
+  // 16-bit (CV_16UC1) images are widened into a new image.
   void setIdImage(const cv::Mat& id_image) {
-    id_image_ = id_image;
+    if (id_image.type() == CV_16UC1) {
+      id_image.convertTo(id_image_, CV_32SC1);
+    } else {
+      id_image_ = id_image;
+    }
     contained_inputs_.insert(InputType::kSegmentationImage);
   }
   void setDetectronLabels(const DetectronLabels& labels) {
@@ -101,6 +127,11 @@ class InputData {
     contained_inputs_.insert(InputType::kValidityImage);
   }
 
+  void setMaxDepthPyramid(const MaxDepthPyramid& max_depth_pyramid) {
+    max_depth_pyramid_ = max_depth_pyramid;
+    contained_inputs_.insert(InputType::kMaxDepthPyramid);
+  }
+
   void setUncertaintyImage(const cv::Mat& uncertainty_image) {
     uncertainty_image_ = uncertainty_image;
     contained_inputs_.insert(InputType::kUncertaintyImage);
@@ -112,12 +143,17 @@ class InputData {
   const std::string& sensorFrameName() const { return sensor_frame_name_; }
   double timestamp() const { return timestamp_; }
   const cv::Mat& depthImage() const { return depth_image_; }
+  float depthScale() const { return depth_scale_; }
+  float depth(int v, int u) const {
+    return depthAt(depth_image_, depth_scale_, v, u);
+  }
   const cv::Mat& colorImage() const { return color_image_; }
   const DetectronLabels& detectronLabels() const { return detectron_labels_; }
   const cv::Mat& vertexMap() const { return vertex_map_; }
   const cv::Mat& idImage() const { return id_image_; }
   const cv::Mat& validityImage() const { return validity_image_; }
   const cv::Mat& uncertaintyImage() const { return uncertainty_image_; }
+  const MaxDepthPyramid& maxDepthPyramid() const { return max_depth_pyramid_; }
 
   // Access to modifyable data.
   cv::Mat* idImagePtr() { return &id_image_; }
@@ -138,7 +174,8 @@ class InputData {
   double timestamp_ = 0.0;         // Timestamp of the inputs.
 
   // Common Input data.
-  cv::Mat depth_image_;  // Float depth image (CV_32FC1).
+  cv::Mat depth_image_;  // Float (CV_32FC1) or 16-bit (CV_16UC1) depth image.
+  float depth_scale_ = 1.f;  // Meters per unit of 16-bit depth images.
   cv::Mat color_image_;  // BGR (CV_8U).
   cv::Mat id_image_;     // Mutable assigned ids as ints (CV_32SC1).
   cv::Mat uncertainty_image_; // Float image containing uncertainty information (CV_32FC1)
@@ -146,6 +183,7 @@ class InputData {
   // Common derived data.
   cv::Mat vertex_map_;      // XYZ points (CV32FC3), can be compute via camera.
   cv::Mat validity_image_;  // 0-1 image for valid pixels (CV_8UC1).
+  MaxDepthPyramid max_depth_pyramid_;  // Of the depth image, for culling.
 
   // Optional Input data.
   DetectronLabels detectron_labels_;
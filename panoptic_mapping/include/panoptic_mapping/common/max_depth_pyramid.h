@@ -0,0 +1,47 @@
+#ifndef PANOPTIC_MAPPING_COMMON_MAX_DEPTH_PYRAMID_H_
+#define PANOPTIC_MAPPING_COMMON_MAX_DEPTH_PYRAMID_H_
+
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Hierarchy of a depth image where each level stores the maximum depth
+ * of 2x2 pixels of the level below. This allows conservative lookups of the
+ * farthest observed surface within arbitrary image rectangles in constant
+ * time. Invalid depth values are treated as infinitely far away.
+ */
+class MaxDepthPyramid {
+ public:
+  MaxDepthPyramid() = default;
+  virtual ~MaxDepthPyramid() = default;
+
+  /**
+   * @brief Build the pyramid from a depth image.
+   *
+   * @param depth_image Float (CV_32FC1) or 16-bit (CV_16UC1) depth image.
+   * @param depth_scale Meters per unit of 16-bit depth images.
+   */
+  void compute(const cv::Mat& depth_image, float depth_scale = 1.f);
+
+  /**
+   * @brief Get an upper bound of the depth within a rectangle of pixels.
+   *
+   * @param u_min, v_min, u_max, v_max Inclusive pixel limits of the
+   * rectangle, which are clamped to the image.
+   * @return The maximum depth or infinity if the rectangle does not overlap
+   * the image.
+   */
+  float maxDepth(int u_min, int v_min, int u_max, int v_max) const;
+
+  bool empty() const { return levels_.empty(); }
+
+ private:
+  std::vector<cv::Mat> levels_;  // Finest first, CV_32FC1.
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_COMMON_MAX_DEPTH_PYRAMID_H_
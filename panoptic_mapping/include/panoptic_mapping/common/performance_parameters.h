@@ -0,0 +1,62 @@
+#ifndef PANOPTIC_MAPPING_COMMON_PERFORMANCE_PARAMETERS_H_
+#define PANOPTIC_MAPPING_COMMON_PERFORMANCE_PARAMETERS_H_
+
+#include <sstream>
+#include <string>
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Performance relevant settings that can be changed while mapping.
+ * Negative values and empty strings leave the current setting unchanged.
+ * Components only apply the settings they use and should only be reconfigured
+ * between two frames.
+ */
+struct PerformanceParameters {
+  // Tsdf integration.
+  int integration_threads = -1;
+  std::string interpolation_method;
+
+  // ID tracking.
+  int rendering_threads = -1;
+  int rendering_subsampling = -1;
+
+  // Map management. Perform actions every n frames, 0 to turn them off.
+  int prune_active_blocks_frequency = -1;
+  int change_detection_frequency = -1;
+  int activity_management_frequency = -1;
+
+  // Input.
+  int max_input_queue_length = -1;
+
+  // Check that all set values are valid, otherwise write the reason to error.
+  bool isValid(std::string* error = nullptr) const {
+    std::stringstream ss;
+    if (integration_threads == 0) {
+      ss << "'integration_threads' must be > 0. ";
+    }
+    if (rendering_threads == 0) {
+      ss << "'rendering_threads' must be > 0. ";
+    }
+    if (rendering_subsampling == 0) {
+      ss << "'rendering_subsampling' must be > 0. ";
+    }
+    if (max_input_queue_length == 0) {
+      ss << "'max_input_queue_length' must be > 0. ";
+    }
+    if (!interpolation_method.empty() && interpolation_method != "nearest" &&
+        interpolation_method != "bilinear" &&
+        interpolation_method != "adaptive") {
+      ss << "'interpolation_method' must be one of {nearest, bilinear, "
+            "adaptive}. ";
+    }
+    if (error) {
+      *error = ss.str();
+    }
+    return ss.str().empty();
+  }
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_COMMON_PERFORMANCE_PARAMETERS_H_
@@ -0,0 +1,91 @@
+#ifndef PANOPTIC_MAPPING_COMMON_THREAD_AFFINITY_H_
+#define PANOPTIC_MAPPING_COMMON_THREAD_AFFINITY_H_
+
+#include <string>
+#include <vector>
+
+#include "panoptic_mapping/3rd_party/config_utilities.hpp"
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Process wide placement of the mapping worker threads on the CPUs and
+ * NUMA nodes of the machine. By default nothing is pinned. The placement is
+ * configured once at startup, before any workers are spawned. All queries are
+ * cheap and can be called from any worker.
+ */
+class ThreadAffinity {
+ public:
+  struct Config : public config_utilities::Config<Config> {
+    int verbosity = 1;
+
+    // How to pin worker threads. Supported are {none, node, core}. 'node' lets
+    // each worker run on all worker CPUs of its NUMA node, 'core' pins each
+    // worker to a single CPU.
+    std::string worker_pinning = "none";
+
+    // If true and the workers are pinned on a machine with multiple NUMA
+    // nodes, the blocks of each submap are allocated and integrated by
+    // workers of a consistent node.
+    bool numa_aware_submaps = true;
+
+    // CPUs that are not used by the workers, e.g. to keep them free for the
+    // ROS callback and visualization threads. See pinToReservedCores().
+    std::vector<int> reserved_cores;
+
+    Config() { setConfigName("ThreadAffinity"); }
+
+   protected:
+    void setupParamsAndPrinting() override;
+    void checkParams() const override;
+  };
+
+  /**
+   * @brief Detect the CPU topology and set up the placement.
+   */
+  static void configure(const Config& config);
+
+  /**
+   * @brief Restrict the calling thread and all threads it spawns afterwards to
+   * the reserved cores. Does nothing if no cores are reserved.
+   */
+  static void pinToReservedCores();
+
+  /**
+   * @brief Pin the calling worker thread according to the configuration.
+   *
+   * @param worker_index Index of the worker within its thread pool.
+   */
+  static void pinWorkerThread(int worker_index);
+
+  // Number of NUMA nodes workers are distributed over, 1 if not NUMA-aware.
+  static int numNodes();
+
+  // Whether submaps are assigned to NUMA nodes.
+  static bool isNumaAware() { return numNodes() > 1; }
+
+  // Home node of the given worker or submap, always 0 if not NUMA-aware.
+  static int workerNode(int worker_index);
+  static int submapNode(int submap_id);
+
+ private:
+  enum class Pinning { kNone = 0, kNode, kCore };
+  struct State {
+    Pinning pinning = Pinning::kNone;
+    bool numa_aware = false;
+    std::vector<std::vector<int>> node_cpus;  // Worker CPUs of each node.
+    std::vector<int> reserved_cpus;
+  };
+  static State& state() {
+    static State state;
+    return state;
+  }
+
+  static std::vector<std::vector<int>> readNodeCpus();
+  static std::vector<int> parseCpuList(const std::string& cpu_list);
+  static bool setAffinity(const std::vector<int>& cpus);
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_COMMON_THREAD_AFFINITY_H_
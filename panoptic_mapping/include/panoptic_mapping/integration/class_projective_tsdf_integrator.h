@@ -13,6 +13,7 @@
 #include "panoptic_mapping/integration/projection_interpolators.h"
 #include "panoptic_mapping/integration/projective_tsdf_integrator.h"
 #include "panoptic_mapping/integration/tsdf_integrator_base.h"
+#include "panoptic_mapping/map/classification/class_layer.h"
 
 namespace panoptic_mapping {
 
@@ -49,18 +50,30 @@ class ClassProjectiveIntegrator : public ProjectiveIntegrator {
  protected:
   void updateBlock(Submap* submap, InterpolatorBase* interpolator,
                    const voxblox::BlockIndex& block_index,
-                   const Transformation& T_C_S,
+                   const Transformation& T_C_S, float max_carving_distance,
                    const InputData& input) const override;
 
   bool updateVoxel(InterpolatorBase* interpolator, TsdfVoxel* voxel,
                    const Point& p_C, const InputData& input,
                    const int submap_id, const bool is_free_space_submap,
-                   const float truncation_distance, const float voxel_size,
+                   const float truncation_distance,
+                   const float max_carving_distance, const float voxel_size,
                    ClassVoxel* class_voxel = nullptr,
                    ScoreVoxel* score_voxel = nullptr) const override;
 
-  void updateClassVoxel(InterpolatorBase* interpolator, ClassVoxel* voxel,
-                        const InputData& input, const int submap_id) const;
+  // Update the TSDF voxel and record the class update near the surface if
+  // 'class_updates' is set.
+  bool integrateVoxel(InterpolatorBase* interpolator, TsdfVoxel* voxel,
+                      const Point& p_C, const InputData& input,
+                      const int submap_id, const bool is_free_space_submap,
+                      const float truncation_distance,
+                      const float max_carving_distance, const float voxel_size,
+                      ClassCountUpdates* class_updates,
+                      const size_t voxel_index) const;
+
+  // Compute the ID whose count is incremented for the current measurement.
+  int computeClassID(InterpolatorBase* interpolator, const InputData& input,
+                     const int submap_id) const;
 
  private:
   const Config config_;
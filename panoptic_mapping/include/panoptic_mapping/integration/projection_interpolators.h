@@ -11,6 +11,37 @@
 
 namespace panoptic_mapping {
 
+/**
+ * @brief Flags all pixel quads (u, v) - (u + 1, v + 1) of a range image whose
+ * range values differ by more than a threshold. This is computed once per frame
+ * so interpolators only need to look up whether a quad spans a surface
+ * discontinuity.
+ */
+class DepthDiscontinuityMask {
+ public:
+  /**
+   * @brief Recompute the mask for a new range image.
+   *
+   * @param range_image Range image of the current frame.
+   * @param max_depth_difference Quads whose max - min range exceeds this value
+   * in meters are marked as discontinuous.
+   * @param num_threads Number of threads to compute the mask with.
+   */
+  void compute(const Eigen::MatrixXf& range_image, float max_depth_difference,
+               int num_threads = 1);
+
+  /**
+   * @brief Whether the quad with top left corner (u, v) spans a discontinuity.
+   * Assumes (u, v) lies within the image, which is not re-checked.
+   */
+  bool isDiscontinuous(int u, int v) const { return mask_(v, u) != 0; }
+
+ private:
+  // Same (column major) layout as the range image. The last row and column are
+  // not part of any full quad and are always false.
+  Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic> mask_;
+};
+
 /**
  * @brief Interface for different ways to interpolate the necessary values.
  * Use computeWeights() first to setup the interpolator, then use the
@@ -18,6 +49,15 @@ namespace panoptic_mapping {
  */
 class InterpolatorBase {
  public:
+  virtual ~InterpolatorBase() = default;
+
+  /**
+   * @brief Optionally provide a precomputed discontinuity mask of the range
+   * image used in subsequent lookups. Interpolators that do not use it ignore
+   * it. The mask is not owned and needs to outlive all lookups.
+   */
+  virtual void setDiscontinuityMask(const DepthDiscontinuityMask* mask) {}
+
   /**
    * @brief Sets up the interpolator for a specific lookup and stores all
    * relevant information in the internal state. This method assumes that u and
@@ -131,6 +171,9 @@ class InterpolatorBilinear : public InterpolatorBase {
  */
 class InterpolatorAdaptive : public InterpolatorBilinear {
  public:
+  void setDiscontinuityMask(const DepthDiscontinuityMask* mask) override {
+    discontinuity_mask_ = mask;
+  }
   void computeWeights(float u, float v,
                       const Eigen::MatrixXf& range_image) override;
   float interpolateRange(const Eigen::MatrixXf& range_image) override;
@@ -147,6 +190,10 @@ class InterpolatorAdaptive : public InterpolatorBilinear {
   float weight_[4];
   bool use_bilinear_;
 
+  // If no mask is provided the discontinuity is checked for every lookup.
+  const DepthDiscontinuityMask* discontinuity_mask_ = nullptr;
+  static constexpr float kDefaultMaxDepthDifference_ = 0.2f;  // m
+
  private:
   static config_utilities::Factory::Registration<InterpolatorBase,
                                                  InterpolatorAdaptive>
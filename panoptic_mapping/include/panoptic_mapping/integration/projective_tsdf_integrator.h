@@ -1,9 +1,13 @@
 #ifndef PANOPTIC_MAPPING_INTEGRATION_PROJECTIVE_TSDF_INTEGRATOR_H_
 #define PANOPTIC_MAPPING_INTEGRATION_PROJECTIVE_TSDF_INTEGRATOR_H_
 
+#include <atomic>
+#include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "panoptic_mapping/3rd_party/config_utilities.hpp"
@@ -44,6 +48,11 @@ class ProjectiveIntegrator : public TsdfIntegratorBase {
     // Supported are {nearest, bilinear, adaptive}.
     std::string interpolation_method = "adaptive";
 
+    // Maximum range difference in meters within a pixel quad for the 'adaptive'
+    // interpolation to use bilinear interpolation. Larger differences are
+    // treated as surface discontinuities and use nearest neighbor lookup.
+    float interpolation_max_depth_difference = 0.2f;
+
     // If true, rays that don't belong to the submap ID are treated as clearing
     // rays.
     bool foreign_rays_clear = true;
@@ -60,6 +69,20 @@ class ProjectiveIntegrator : public TsdfIntegratorBase {
     // submap-parallel.
     int integration_threads = std::thread::hardware_concurrency();
 
+    // If true, skip submaps that are fully hidden behind the observed surfaces
+    // by more than their truncation distance, since none of their voxels
+    // would be updated.
+    bool use_occlusion_culling = true;
+
+    // Maximum number of voxels in front of the surface that are updated along
+    // a ray, limiting free space carving. Values <= 0 carve up to the maximum
+    // range.
+    int max_carving_voxels = 0;
+
+    // Per-class carving budgets in voxels, overwriting 'max_carving_voxels'
+    // for submaps whose class name or class ID is given as key.
+    std::map<std::string, int> class_max_carving_voxels;
+
     Config() { setConfigName("ProjectiveTsdfIntegrator"); }
 
    protected:
@@ -73,7 +96,16 @@ class ProjectiveIntegrator : public TsdfIntegratorBase {
 
   void processInput(SubmapCollection* submaps, InputData* input) override;
 
+  // Changes the number of integration threads and the interpolation method.
+  void reconfigure(const PerformanceParameters& parameters) override;
+
  protected:
+  /**
+   * @brief Create one interpolator of the current interpolation method for
+   * each integration thread.
+   */
+  void setupInterpolators();
+
   /**
    * @brief Allocate all new blocks in all submaps.
    *
@@ -83,6 +115,38 @@ class ProjectiveIntegrator : public TsdfIntegratorBase {
   virtual void allocateNewBlocks(SubmapCollection* submaps,
                                  const InputData& input);
 
+  /**
+   * @brief Precompute the depth discontinuity mask of the current range image
+   * if the interpolation method uses it. Call after the range image was set.
+   */
+  void computeDiscontinuityMask();
+
+  /**
+   * @brief Run a function on all given submaps using the integration threads.
+   * With NUMA-aware thread placement each submap is preferably processed by a
+   * worker of its home node.
+   *
+   * @param function Function taking the submap ID and the thread index.
+   */
+  void processSubmapsInParallel(
+      const std::vector<int>& submap_ids,
+      const std::function<void(int, int)>& function) const;
+
+  /**
+   * @brief Remove all submaps that are fully occluded in the current depth
+   * image from the blocks to be integrated.
+   */
+  void cullOccludedSubmaps(
+      const SubmapCollection& submaps, const InputData& input,
+      std::unordered_map<int, voxblox::BlockIndexList>* block_lists) const;
+
+  /**
+   * @brief Compute the distance in meters in front of the surface up to which
+   * voxels of the submap are updated, based on the carving budget of its
+   * class.
+   */
+  float computeMaxCarvingDistance(const Submap& submap) const;
+
   virtual void updateSubmap(Submap* submap, InterpolatorBase* interpolator,
                             const voxblox::BlockIndexList& block_indices,
                             const InputData& input) const;
@@ -90,6 +154,7 @@ class ProjectiveIntegrator : public TsdfIntegratorBase {
   virtual void updateBlock(Submap* submap, InterpolatorBase* interpolator,
                            const voxblox::BlockIndex& block_index,
                            const Transformation& T_C_S,
+                           float max_carving_distance,
                            const InputData& input) const;
 
   /**
@@ -103,6 +168,8 @@ class ProjectiveIntegrator : public TsdfIntegratorBase {
    * @param submap_id SubmapID of the owning submap.
    * @param is_free_space_submap Whether the voxel belongs to a freespace map.
    * @param truncation_distance Truncation distance to be used.
+   * @param max_carving_distance Voxels farther in front of the surface are
+   * not updated.
    * @param voxel_size Voxel size of the TSDF layer.
    * @param class_voxel Optional: class voxel to be updated.
    * @param score_voxel Optional: score voxel to be updated.
@@ -113,6 +180,7 @@ class ProjectiveIntegrator : public TsdfIntegratorBase {
                            const Point& p_C, const InputData& input,
                            const int submap_id, const bool is_free_space_submap,
                            const float truncation_distance,
+                           const float max_carving_distance,
                            const float voxel_size,
                            ClassVoxel* class_voxel = nullptr,
                            ScoreVoxel* score_voxel = nullptr) const;
@@ -162,6 +230,13 @@ class ProjectiveIntegrator : public TsdfIntegratorBase {
   const Camera::Config* cam_config_;
   std::vector<std::unique_ptr<InterpolatorBase>>
       interpolators_;  // one for each thread.
+  DepthDiscontinuityMask discontinuity_mask_;
+  bool use_discontinuity_mask_ = false;
+  mutable std::atomic<uint64_t> num_updated_voxels_{0};  // Current frame.
+
+  // Settings that can be reconfigured at runtime, initialized from the config.
+  int num_threads_;
+  std::string interpolation_method_;
 
  private:
   const Config config_;
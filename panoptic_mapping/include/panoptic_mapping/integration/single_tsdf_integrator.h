@@ -10,6 +10,7 @@
 #include "panoptic_mapping/common/camera.h"
 #include "panoptic_mapping/common/common.h"
 #include "panoptic_mapping/integration/projective_tsdf_integrator.h"
+#include "panoptic_mapping/map/classification/class_layer.h"
 #include "panoptic_mapping/map/classification/uncertainty.h"
 
 namespace panoptic_mapping {
@@ -61,13 +62,14 @@ class SingleTsdfIntegrator : public ProjectiveIntegrator {
 
   void updateBlock(Submap* submap, InterpolatorBase* interpolator,
                    const voxblox::BlockIndex& block_index,
-                   const Transformation& T_C_S,
+                   const Transformation& T_C_S, float max_carving_distance,
                    const InputData& input) const override;
 
   bool updateVoxel(InterpolatorBase* interpolator, TsdfVoxel* voxel,
                    const Point& p_C, const InputData& input,
                    const int submap_id, const bool is_free_space_submap,
-                   const float truncation_distance, const float voxel_size,
+                   const float truncation_distance,
+                   const float max_carving_distance, const float voxel_size,
                    ClassVoxel* class_voxel = nullptr,
                    ScoreVoxel* score_voxel = nullptr) const override;
 
@@ -77,6 +79,15 @@ class SingleTsdfIntegrator : public ProjectiveIntegrator {
       TsdfIntegratorBase, SingleTsdfIntegrator, std::shared_ptr<Globals>>
       registration_;
 
+  // Update the voxel. If 'class_updates' is set the class count is recorded
+  // there instead of being applied to the class voxel.
+  bool integrateVoxel(InterpolatorBase* interpolator, TsdfVoxel* voxel,
+                      const Point& p_C, const InputData& input,
+                      const float truncation_distance,
+                      const float max_carving_distance, const float voxel_size,
+                      ClassVoxel* class_voxel, ScoreVoxel* score_voxel,
+                      ClassCountUpdates* class_updates,
+                      const size_t voxel_index) const;
   void updateClassVoxel(InterpolatorBase* interpolator, const InputData& input,
                         ClassVoxel* class_voxel) const;
   void updateScoreVoxel(InterpolatorBase* interpolator, const InputData& input,
@@ -10,6 +10,7 @@
 #include "panoptic_mapping/common/common.h"
 #include "panoptic_mapping/common/globals.h"
 #include "panoptic_mapping/common/input_data_user.h"
+#include "panoptic_mapping/common/performance_parameters.h"
 #include "panoptic_mapping/map/submap_collection.h"
 
 namespace panoptic_mapping {
@@ -25,6 +26,10 @@ class TsdfIntegratorBase : public InputDataUser {
 
   virtual void processInput(SubmapCollection* submaps, InputData* input) = 0;
 
+  // Apply the performance parameters used by this integrator. Must not be
+  // called while processing input.
+  virtual void reconfigure(const PerformanceParameters& parameters) {}
+
  protected:
   std::shared_ptr<Globals> globals_;
 };
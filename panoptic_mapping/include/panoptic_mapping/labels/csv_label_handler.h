@@ -20,6 +20,11 @@ class CsvLabelHandler : public LabelHandlerBase {
 
     // File name to read the labels from.
     std::string file_name;
+
+    // If true, the labels of each file are read once per process and shared
+    // with all handlers reading the same file, e.g. of multiple mappers.
+    bool share_labels = true;
+
     Config() { setConfigName("CsvLabelHandler"); }
 
    protected:
@@ -35,7 +40,7 @@ class CsvLabelHandler : public LabelHandlerBase {
   static config_utilities::Factory::RegistrationRos<LabelHandlerBase,
                                                     CsvLabelHandler>
       registration_;
-  void readLabelsFromFile();
+  LabelTable::Labels readLabelsFromFile() const;
 };
 
 }  // namespace panoptic_mapping
@@ -4,35 +4,60 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
 
 #include "panoptic_mapping/common/common.h"
 #include "panoptic_mapping/labels/label_entry.h"
+#include "panoptic_mapping/labels/label_table.h"
 
 namespace panoptic_mapping {
 
 /**
  * @brief Class that enables look-ups on labels via the segmentation ID. Exposes
  * the minimum required fields explicitly, however returning the LabelEntry
- * directly is more efficient for multiple lookups.
+ * directly is more efficient for multiple lookups. The labels are stored in an
+ * immutable LabelTable that can be shared between handlers.
  */
 class LabelHandlerBase {
  public:
-  LabelHandlerBase() = default;
+  LabelHandlerBase() : label_table_(std::make_shared<const LabelTable>()) {}
   virtual ~LabelHandlerBase() = default;
 
   // This returns true if the id was found.
-  bool segmentationIdExists(int segmentation_id) const;
+  bool segmentationIdExists(int segmentation_id) const {
+    return findLabel(segmentation_id) != nullptr;
+  }
 
   // These acessors assume that the segmentation_id exists.
-  int getClassID(int segmentation_id) const;
-  bool isBackgroundClass(int segmentation_id) const;
-  bool isInstanceClass(int segmentation_id) const;
-  bool isUnknownClass(int segmentation_id) const;
-  bool isSpaceClass(int segmentation_id) const;
-  PanopticLabel getPanopticLabel(int segmentation_id) const;
-  const voxblox::Color& getColor(int segmentation_id) const;
-  const std::string& getName(int segmentation_id) const;
-  const LabelEntry& getLabelEntry(int segmentation_id) const;
+  int getClassID(int segmentation_id) const {
+    return getLabel(segmentation_id).class_id;
+  }
+  bool isBackgroundClass(int segmentation_id) const {
+    return getLabel(segmentation_id).label == PanopticLabel::kBackground;
+  }
+  bool isInstanceClass(int segmentation_id) const {
+    return getLabel(segmentation_id).label == PanopticLabel::kInstance;
+  }
+  bool isUnknownClass(int segmentation_id) const {
+    return getLabel(segmentation_id).label == PanopticLabel::kUnknown;
+  }
+  bool isSpaceClass(int segmentation_id) const {
+    return getLabel(segmentation_id).label == PanopticLabel::kFreeSpace;
+  }
+  PanopticLabel getPanopticLabel(int segmentation_id) const {
+    return getLabel(segmentation_id).label;
+  }
+  const voxblox::Color& getColor(int segmentation_id) const {
+    return getLabel(segmentation_id).color;
+  }
+  const std::string& getName(int segmentation_id) const {
+    return getLabel(segmentation_id).entry->name;
+  }
+  const LabelEntry& getLabelEntry(int segmentation_id) const {
+    return *getLabel(segmentation_id).entry;
+  }
 
   /**
    * @brief Get the LabelEntry if it exists in a combined lookup.
@@ -44,13 +69,50 @@ class LabelHandlerBase {
   bool getLabelEntryIfExists(int segmentation_id,
                              LabelEntry* label_entry) const;
 
+  /**
+   * @brief Look up the labels of a whole segmentation image at once.
+   *
+   * @param id_image Segmentation IDs (CV_32SC1).
+   * @param class_image Optional: resulting class IDs (CV_32SC1), -1 for
+   * unknown segmentation IDs.
+   * @param label_image Optional: resulting panoptic labels (CV_8UC1), kUnknown
+   * for unknown segmentation IDs.
+   * @param color_image Optional: resulting label colors (CV_8UC3, BGR), black
+   * for unknown segmentation IDs.
+   */
+  void classifyIDImage(const cv::Mat& id_image, cv::Mat* class_image,
+                       cv::Mat* label_image = nullptr,
+                       cv::Mat* color_image = nullptr) const;
+
   // Get the number of stored labels.
   size_t numberOfLabels() const;
 
+  // Access to the underlying, possibly shared, label table.
+  const std::shared_ptr<const LabelTable>& getLabelTable() const {
+    return label_table_;
+  }
+
  protected:
-  // List of the labels associated with each segmentation ID. Labels are stored
-  // by pointer such that derived label types can also be stored here.
-  std::unordered_map<int, std::unique_ptr<LabelEntry>> labels_;
+  // Set the labels of this handler. Needs to be called by derived handlers
+  // whenever the labels were changed.
+  void setLabels(LabelTable::Labels labels);
+  void setLabelTable(std::shared_ptr<const LabelTable> label_table);
+
+ private:
+  using CompactLabel = LabelTable::CompactLabel;
+
+  const CompactLabel* findLabel(int segmentation_id) const {
+    return label_table_->findLabel(segmentation_id);
+  }
+
+  const CompactLabel& getLabel(int segmentation_id) const {
+    const CompactLabel* label = findLabel(segmentation_id);
+    CHECK(label) << "Segmentation ID '" << segmentation_id
+                 << "' does not exist.";
+    return *label;
+  }
+
+  std::shared_ptr<const LabelTable> label_table_;
 };
 
 }  // namespace panoptic_mapping
@@ -0,0 +1,84 @@
+#ifndef PANOPTIC_MAPPING_LABELS_LABEL_TABLE_H_
+#define PANOPTIC_MAPPING_LABELS_LABEL_TABLE_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/labels/label_entry.h"
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Immutable set of labels with compiled lookup tables. Tables are
+ * read-only after construction and can thus be shared by the label handlers of
+ * multiple mappers. Shared tables are loaded once per process and identified
+ * by a key, e.g. the source file.
+ */
+class LabelTable {
+ public:
+  // Labels associated with each segmentation ID. Labels are stored by pointer
+  // such that derived label types can also be stored here.
+  using Labels = std::unordered_map<int, std::unique_ptr<LabelEntry>>;
+
+  // Compact copy of the frequently accessed label fields.
+  struct CompactLabel {
+    int class_id = -1;
+    PanopticLabel label = PanopticLabel::kUnknown;
+    Color color;
+    const LabelEntry* entry = nullptr;  // Nullptr if the ID does not exist.
+  };
+
+  explicit LabelTable(Labels labels = Labels());
+  virtual ~LabelTable() = default;
+
+  // The table owns the entries its lookups point to.
+  LabelTable(const LabelTable&) = delete;
+  LabelTable& operator=(const LabelTable&) = delete;
+
+  /**
+   * @brief Get the table with the given key if it is already loaded in this
+   * process, otherwise load and register it. Tables are released once no
+   * handler references them anymore.
+   *
+   * @param key Unique identifier of the labels, e.g. the source file.
+   * @param load Function to read the labels if the table is not loaded yet.
+   */
+  static std::shared_ptr<const LabelTable> getShared(
+      const std::string& key, const std::function<Labels()>& load);
+
+  // Lookup.
+  const CompactLabel* findLabel(int segmentation_id) const {
+    const int64_t index =
+        static_cast<int64_t>(segmentation_id) - dense_table_offset_;
+    if (index >= 0 && index < static_cast<int64_t>(dense_table_.size())) {
+      const CompactLabel& label = dense_table_[index];
+      return label.entry ? &label : nullptr;
+    }
+    auto it = sparse_table_.find(segmentation_id);
+    return it == sparse_table_.end() ? nullptr : &it->second;
+  }
+  size_t numberOfLabels() const { return labels_.size(); }
+  const Labels& labels() const { return labels_; }
+
+ private:
+  const Labels labels_;
+
+  // Labels of the segmentation IDs [offset, offset + size) are stored in the
+  // dense table, outliers in the sparse table.
+  std::vector<CompactLabel> dense_table_;
+  int dense_table_offset_ = 0;
+  std::unordered_map<int, CompactLabel> sparse_table_;
+
+  // Minimum size and maximum size as a multiple of the number of labels of
+  // the dense table.
+  static constexpr int kMinDenseTableSize = 1024;
+  static constexpr int kDenseTableSizeFactor = 4;
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_LABELS_LABEL_TABLE_H_
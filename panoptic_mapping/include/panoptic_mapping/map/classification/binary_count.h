@@ -48,6 +48,10 @@ class BinaryCountLayer : public ClassLayerImpl<BinaryCountVoxel> {
   BinaryCountLayer(const Config& config, const float voxel_size,
                    const int voxels_per_side);
 
+  // Branch-free batched count updates.
+  void incrementCounts(ClassBlock* block,
+                       const ClassCountUpdates& updates) override;
+
   ClassVoxelType getVoxelType() const override;
   std::unique_ptr<ClassLayer> clone() const override;
   static std::unique_ptr<ClassLayer> loadFromStream(
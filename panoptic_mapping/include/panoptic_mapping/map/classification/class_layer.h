@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <voxblox/core/layer.h>
 
@@ -12,6 +13,31 @@
 
 namespace panoptic_mapping {
 
+/**
+ * @brief Batch of count increments for the voxels of a single block, stored as
+ * pairs of linear voxel index and ID to increment. Each voxel may appear at
+ * most once per batch.
+ */
+struct ClassCountUpdates {
+  std::vector<size_t> voxel_indices;
+  std::vector<int> ids;
+
+  void add(size_t voxel_index, int id) {
+    voxel_indices.push_back(voxel_index);
+    ids.push_back(id);
+  }
+  void reserve(size_t size) {
+    voxel_indices.reserve(size);
+    ids.reserve(size);
+  }
+  void clear() {
+    voxel_indices.clear();
+    ids.clear();
+  }
+  size_t size() const { return ids.size(); }
+  bool empty() const { return ids.empty(); }
+};
+
 /**
  * @brief General interface to classification voxel layers. Wraps the voxblox
  * layer to allow substituting different classification layer types.
@@ -51,6 +77,23 @@ class ClassLayer {
   virtual FloatingPoint block_size() const = 0;
   virtual std::unique_ptr<ClassLayer> clone() const = 0;
 
+  /**
+   * @brief Replace the block at the given index by a copy of the block of
+   * another layer of the same voxel type, or remove it if the other layer does
+   * not contain the block.
+   *
+   * @return False if the voxel types of the layers differ.
+   */
+  virtual bool copyBlockFrom(const ClassLayer& other,
+                             const BlockIndex& block_index) = 0;
+
+  /**
+   * @brief Apply a batch of count increments to the voxels of a block of this
+   * layer. The result is identical to calling incrementCount() on each voxel.
+   */
+  virtual void incrementCounts(ClassBlock* block,
+                               const ClassCountUpdates& updates) = 0;
+
   // Serialization
   virtual bool saveBlockToStream(BlockIndex block_index,
                                  std::fstream* outfile_ptr) const = 0;
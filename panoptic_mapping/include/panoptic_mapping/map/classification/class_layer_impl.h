@@ -82,6 +82,35 @@ class ClassLayerImpl : public ClassLayer {
   FloatingPoint voxel_size() const override { return layer_.voxel_size(); }
   FloatingPoint block_size() const override { return layer_.block_size(); }
 
+  bool copyBlockFrom(const ClassLayer& other,
+                     const BlockIndex& block_index) override {
+    const auto* other_impl =
+        dynamic_cast<const ClassLayerImpl<VoxelT>*>(&other);
+    if (!other_impl) {
+      return false;
+    }
+    auto other_block = other_impl->layer_.getBlockPtrByIndex(block_index);
+    if (!other_block) {
+      layer_.removeBlock(block_index);
+      return true;
+    }
+    auto block = layer_.allocateBlockPtrByIndex(block_index);
+    for (size_t i = 0; i < block->num_voxels(); ++i) {
+      block->getVoxelByLinearIndex(i) = other_block->getVoxelByLinearIndex(i);
+    }
+    block->set_has_data(other_block->has_data());
+    return true;
+  }
+
+  // Default batch update, increments each voxel individually.
+  void incrementCounts(ClassBlock* block,
+                       const ClassCountUpdates& updates) override {
+    for (size_t i = 0; i < updates.size(); ++i) {
+      block->getVoxelByLinearIndex(updates.voxel_indices[i])
+          .incrementCount(updates.ids[i]);
+    }
+  }
+
   // Serialization.
   bool saveBlockToStream(BlockIndex block_index,
                          std::fstream* outfile_ptr) const override {
@@ -181,6 +210,35 @@ class ClassLayerImpl : public ClassLayer {
  protected:
   voxblox::Layer<VoxelT> layer_;
 
+  // Batches updating fewer than 1/kSparseUpdateRatio of the voxels of a block
+  // are applied voxel by voxel, denser ones by the dense kernels.
+  static constexpr size_t kSparseUpdateRatio = 8;
+  static bool isSparseUpdate(const ClassCountUpdates& updates,
+                             size_t num_voxels) {
+    return updates.size() * kSparseUpdateRatio < num_voxels;
+  }
+
+  // Access the wrapped block of a class block of this layer.
+  static voxblox::Block<VoxelT>& getWrappedBlock(ClassBlock* block) {
+    DCHECK(dynamic_cast<ClassBlockImpl<VoxelT>*>(block) != nullptr);
+    return static_cast<ClassBlockImpl<VoxelT>*>(block)->getBlock();
+  }
+
+  // Split a batch of binary updates into dense per-voxel increments of the
+  // belonging (ID 0) and foreign counts, used by the batched binary kernels.
+  static void computeBinaryIncrements(const ClassCountUpdates& updates,
+                                      size_t num_voxels,
+                                      std::vector<uint8_t>* belongs,
+                                      std::vector<uint8_t>* foreign) {
+    belongs->assign(num_voxels, 0u);
+    foreign->assign(num_voxels, 0u);
+    for (size_t i = 0; i < updates.size(); ++i) {
+      const uint8_t is_belonging = updates.ids[i] == 0;
+      (*belongs)[updates.voxel_indices[i]] = is_belonging;
+      (*foreign)[updates.voxel_indices[i]] = 1u - is_belonging;
+    }
+  }
+
   // Common conversion functions for the class block wrapper.
   ClassBlock::Ptr getClassBlockPtr(
       const typename voxblox::Block<VoxelT>::Ptr& block_ptr) {
@@ -53,6 +53,10 @@ class MovingBinaryCountLayer : public ClassLayerImpl<MovingBinaryCountVoxel> {
                          std::fstream* outfile_ptr) const override;
   bool addBlockFromProto(const voxblox::BlockProto& block_proto) override;
 
+  // Branch-free batched count updates.
+  void incrementCounts(ClassBlock* block,
+                       const ClassCountUpdates& updates) override;
+
   ClassVoxelType getVoxelType() const override;
   std::unique_ptr<ClassLayer> clone() const override;
   static std::unique_ptr<ClassLayer> loadFromStream(
@@ -0,0 +1,31 @@
+#ifndef PANOPTIC_MAPPING_MAP_MAP_VERSION_H_
+#define PANOPTIC_MAPPING_MAP_MAP_VERSION_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Global monotonically increasing counter used to stamp changes of the
+ * map. All submaps and submap collections draw their versions from it, so as
+ * long as current() does not change nothing in the map changed.
+ */
+class MapVersion {
+ public:
+  // Get a new version stamp.
+  static uint64_t next() { return ++counter(); }
+
+  // Get the most recently issued version stamp.
+  static uint64_t current() { return counter().load(); }
+
+ private:
+  static std::atomic<uint64_t>& counter() {
+    static std::atomic<uint64_t> counter(0);
+    return counter;
+  }
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_MAP_MAP_VERSION_H_
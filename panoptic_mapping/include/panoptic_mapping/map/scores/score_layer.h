@@ -51,6 +51,16 @@ class ScoreLayer {
   virtual FloatingPoint block_size() const = 0;
   virtual std::unique_ptr<ScoreLayer> clone() const = 0;
 
+  /**
+   * @brief Replace the block at the given index by a copy of the block of
+   * another layer of the same voxel type, or remove it if the other layer does
+   * not contain the block.
+   *
+   * @return False if the voxel types of the layers differ.
+   */
+  virtual bool copyBlockFrom(const ScoreLayer& other,
+                             const BlockIndex& block_index) = 0;
+
   // Serialization
   virtual bool saveBlockToStream(BlockIndex block_index,
                                  std::fstream* outfile_ptr) const = 0;
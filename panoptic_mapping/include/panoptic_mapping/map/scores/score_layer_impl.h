@@ -82,6 +82,26 @@ class ScoreLayerImpl : public ScoreLayer {
   FloatingPoint voxel_size() const override { return layer_.voxel_size(); }
   FloatingPoint block_size() const override { return layer_.block_size(); }
 
+  bool copyBlockFrom(const ScoreLayer& other,
+                     const BlockIndex& block_index) override {
+    const auto* other_impl =
+        dynamic_cast<const ScoreLayerImpl<VoxelT>*>(&other);
+    if (!other_impl) {
+      return false;
+    }
+    auto other_block = other_impl->layer_.getBlockPtrByIndex(block_index);
+    if (!other_block) {
+      layer_.removeBlock(block_index);
+      return true;
+    }
+    auto block = layer_.allocateBlockPtrByIndex(block_index);
+    for (size_t i = 0; i < block->num_voxels(); ++i) {
+      block->getVoxelByLinearIndex(i) = other_block->getVoxelByLinearIndex(i);
+    }
+    block->set_has_data(other_block->has_data());
+    return true;
+  }
+
   // Serialization.
   bool saveBlockToStream(BlockIndex block_index,
                          std::fstream* outfile_ptr) const override {
@@ -1,13 +1,17 @@
 #ifndef PANOPTIC_MAPPING_MAP_SUBMAP_H_
 #define PANOPTIC_MAPPING_MAP_SUBMAP_H_
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include <voxblox/core/block_hash.h>
 #include <voxblox/core/layer.h>
 #include <voxblox/mesh/mesh_layer.h>
 
@@ -22,6 +26,7 @@
 #include "panoptic_mapping/map/scores/score_layer.h"
 #include "panoptic_mapping/map/scores/score_voxel.h"
 #include "panoptic_mapping/map/instance_id.h"
+#include "panoptic_mapping/map/map_version.h"
 #include "panoptic_mapping/map/submap_bounding_volume.h"
 #include "panoptic_mapping/map/submap_id.h"
 
@@ -31,6 +36,16 @@ class LayerManipulator;
 
 class Submap {
  public:
+  // All blocks of the submap at a single block index. The class and score
+  // blocks are only set if the submap has the corresponding layer.
+  struct BlockRecord {
+    TsdfBlock::Ptr tsdf;
+    ClassBlock::Ptr classification;
+    ScoreBlock::Ptr score;
+
+    explicit operator bool() const { return tsdf != nullptr; }
+  };
+
   struct Config : public config_utilities::Config<Config> {
     int verbosity = 1;
     // Size of one voxel in meters.
@@ -56,6 +71,12 @@ class Submap {
     // Config of the mesh integrator.
     MeshIntegrator::Config mesh;
 
+    // If true, the TSDF, class and score blocks of each block index are also
+    // kept in a single record, so the integrators look up all blocks of an
+    // index with a single hash probe. Blocks then need to be allocated and
+    // removed via the submap, see allocateBlocks() and removeBlocks().
+    bool fused_block_storage = false;
+
     Config() { setConfigName("Submap"); }
 
     // Utility tool that checks whether a classification layer was specified.
@@ -113,15 +134,125 @@ class Submap {
   }
   SubmapBoundingVolume* getBoundingVolumePtr() { return &bounding_volume_; }
 
+  // Blocks.
+  /**
+   * @brief Allocate the TSDF block and, if the layers exist, the class and
+   * score blocks at the given index.
+   *
+   * @param block_index Index of the blocks to allocate.
+   * @param tsdf_only If true, only the TSDF block is allocated.
+   * @return All blocks at the index.
+   */
+  BlockRecord allocateBlocks(const BlockIndex& block_index,
+                             bool tsdf_only = false);
+
+  /**
+   * @brief Get all blocks at the given index. The record evaluates to false if
+   * no TSDF block is allocated. Does not modify the submap, so it can be used
+   * concurrently by the integration threads.
+   */
+  BlockRecord getBlocks(const BlockIndex& block_index) const;
+
+  /**
+   * @brief Remove the TSDF, class, score and mesh blocks at the given index.
+   */
+  void removeBlocks(const BlockIndex& block_index);
+
+  /**
+   * @brief Rebuild the fused block records from the layers. Needs to be called
+   * if blocks were allocated or removed directly via the layers while
+   * fused_block_storage is enabled. Does nothing otherwise.
+   */
+  void updateBlockRecords();
+
+  // Versioning.
+  /**
+   * @brief Version of the submap state, i.e. its IDs, transform, label,
+   * activity and change state. Only changes if any of these actually change,
+   * or when the layers are modified as a whole.
+   */
+  uint64_t getVersion() const { return version_; }
+
+  /**
+   * @brief Version at which the layers of the submap were created or last
+   * replaced as a whole, e.g. when loading or copying the submap. Block
+   * versions only track the changes after this version.
+   */
+  uint64_t getLayersVersion() const { return layers_version_; }
+
+  /**
+   * @brief Most recent version of the submap state or any of its blocks. If
+   * this did not change nothing in the submap changed.
+   */
+  uint64_t getLatestVersion() const {
+    return std::max<uint64_t>(version_, latest_block_version_);
+  }
+
+  /**
+   * @brief Version of the data in the block at the given index, 0 if the block
+   * was never modified.
+   */
+  uint64_t getBlockVersion(const BlockIndex& block_index) const;
+
+  /**
+   * @brief Get the indices of all blocks that were modified or removed after
+   * the given version.
+   */
+  void getUpdatedBlocks(uint64_t version,
+                        voxblox::BlockIndexList* block_indices) const;
+
+  /**
+   * @brief Whether any block within the index range (inclusive) was modified
+   * or removed after the given version.
+   */
+  bool hasUpdatedBlocks(uint64_t version, const BlockIndex& min_index,
+                        const BlockIndex& max_index) const;
+
+  /**
+   * @brief Stamp a new version for a block whose data was modified. Thread
+   * safe, so this can be called from integration threads.
+   */
+  void markBlockUpdated(const BlockIndex& block_index);
+
+  /**
+   * @brief Stamp a new submap version, invalidating all of its blocks.
+   */
+  void markStateUpdated() { version_ = MapVersion::next(); }
+
   // Setters.
   void setT_M_S(const Transformation& T_M_S);
-  void setInstanceID(int id) { instance_id_ = id; }
-  void setClassID(int id) { class_id_ = id; }
-  void setLabel(PanopticLabel label) { label_ = label; }
+  void setInstanceID(int id) {
+    if (id != instance_id_) {
+      instance_id_ = id;
+      markStateUpdated();
+    }
+  }
+  void setClassID(int id) {
+    if (id != class_id_) {
+      class_id_ = id;
+      markStateUpdated();
+    }
+  }
+  void setLabel(PanopticLabel label) {
+    if (label != label_) {
+      label_ = label;
+      markStateUpdated();
+    }
+  }
   void setName(const std::string& name) { name_ = name; }
   void setFrameName(const std::string& name) { frame_name_ = name; }
-  void setChangeState(ChangeState state) { change_state_ = state; }
-  void setIsActive(bool is_active) { is_active_ = is_active; }
+  void setChangeState(ChangeState state) {
+    if (state != change_state_) {
+      change_state_ = state;
+      markStateUpdated();
+    }
+  }
+  void setIsActive(bool is_active) {
+    if (is_active != is_active_) {
+      is_active_ = is_active;
+      markStateUpdated();
+    }
+  }
   void setWasTracked(bool was_tracked) { was_tracked_ = was_tracked; }
 
   // Processing.
@@ -178,6 +309,19 @@ class Submap {
   bool applyClassLayer(const LayerManipulator& manipulator,
                        bool clear_class_layer = true);
 
+  /**
+   * @brief Update a copy of another submap with everything that changed in
+   * the other submap after the given version, i.e. its state and all modified
+   * or removed blocks. If the layers of the other submap were replaced after
+   * the version, all layers are copied. The IDs, frame name, transformation
+   * and activity are kept. The other submap is expected to have an identical
+   * layer layout.
+   *
+   * @param other Submap to copy the updates from.
+   * @param version Version of the other submap that this copy reflects.
+   */
+  void copyUpdatesFrom(const Submap& other, uint64_t version);
+
   /**
    * @brief Create a deep copy of the submap. Notice that new submapID and
    * instanceID managers need to be provided to not corrupt the ID counts. ID
@@ -201,9 +345,26 @@ class Submap {
   Submap(const Config& config, SubmapIDManager* submap_id_manager,
          InstanceIDManager* instance_id_manager, int submap_id);
 
+  // This constructor creates a submap with a new ID that joins an existing
+  // instance.
+  Submap(const Config& config, int instance_id,
+         SubmapIDManager* submap_id_manager,
+         InstanceIDManager* instance_id_manager);
+
   // Setup.
   void initialize();
 
+  // Deep copy the layers and derived data of the other submap.
+  void copyLayersFrom(const Submap& other);
+
+  // Fused block storage.
+  void updateBlockRecord(const BlockIndex& block_index);
+  BlockRecord lookUpBlocks(const BlockIndex& block_index) const;
+
+  // Deep copy all data of the other submap, except for its IDs and frame name.
+  // The other submap is expected to have an identical layer layout.
+  void copyDataFrom(const Submap& other);
+
   // IO.
   /**
    * @brief Serialize the submap to protobuf.
@@ -266,8 +427,19 @@ class Submap {
   std::vector<IsoSurfacePoint> iso_surface_points_;
   SubmapBoundingVolume bounding_volume_;
 
+  // Fused block storage, only used if config_.fused_block_storage is set. The
+  // records share their blocks with the layers.
+  voxblox::AnyIndexHashMapType<BlockRecord>::type block_records_;
+
   // Processing.
   std::unique_ptr<MeshIntegrator> mesh_integrator_;
+
+  // Versioning.
+  std::atomic<uint64_t> version_;
+  std::atomic<uint64_t> latest_block_version_{0};
+  uint64_t layers_version_ = 0;
+  mutable std::mutex block_versions_mutex_;
+  voxblox::AnyIndexHashMapType<uint64_t>::type block_versions_;
 };
 
 }  // namespace panoptic_mapping
@@ -54,6 +54,26 @@ class SubmapCollection {
    */
   Submap* createSubmap(const Submap::Config& config);
 
+  /**
+   * @brief Add a deep copy of a submap, e.g. from another collection, to the
+   * collection. The copy receives a new SubmapID and InstanceID of this
+   * collection, all other data is copied.
+   *
+   * @param submap Submap to copy.
+   * @return Pointer to the newly created copy.
+   */
+  Submap* addSubmapCopy(const Submap& submap);
+
+  /**
+   * @brief Add a deep copy of a submap that joins an existing instance of
+   * this collection. The copy receives a new SubmapID.
+   *
+   * @param submap Submap to copy.
+   * @param instance_id InstanceID of this collection the copy belongs to.
+   * @return Pointer to the newly created copy.
+   */
+  Submap* addSubmapCopy(const Submap& submap, int instance_id);
+
   /**
    * @brief Remove a submap from the collection.
    *
@@ -95,6 +115,10 @@ class SubmapCollection {
   Submap* getSubmapPtr(int id);
 
   int getActiveFreeSpaceSubmapID() const { return active_freespace_submap_id_; }
+
+  // Version of the collection layout. Changes whenever submaps are added or
+  // removed, changes within submaps are versioned by the submaps themselves.
+  uint64_t getVersion() const { return version_; }
   const std::unordered_map<int, std::unordered_set<int>>&
   getInstanceToSubmapIDTable() const {
     return instance_to_submap_ids_;
@@ -110,7 +134,9 @@ class SubmapCollection {
   void updateIDList(const std::vector<int>& id_list, std::vector<int>* new_ids,
                     std::vector<int>* deleted_ids) const;
 
-  // Update the list of contained submaps for each instance.
+  // Update the list of contained submaps for each instance. Only submaps that
+  // were added, removed, or changed their instance since the last update are
+  // re-indexed.
   void updateInstanceToSubmapIDTable();
 
   // Creates a deep copy of all submaps, with new submap and instance id
@@ -139,7 +165,9 @@ class SubmapCollection {
   // Bookkeeping.
   std::unordered_map<int, size_t> id_to_index_;
   std::unordered_map<int, std::unordered_set<int>> instance_to_submap_ids_;
+  std::unordered_map<int, int> submap_to_instance_id_;  // As last indexed.
   int active_freespace_submap_id_ = -1;
+  uint64_t version_ = MapVersion::next();
 
  public:
   // Iterators over submaps.
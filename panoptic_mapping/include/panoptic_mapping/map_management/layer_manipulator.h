@@ -1,6 +1,10 @@
 #ifndef PANOPTIC_MAPPING_MAP_MANAGEMENT_LAYER_MANIPULATOR_H_
 #define PANOPTIC_MAPPING_MAP_MANAGEMENT_LAYER_MANIPULATOR_H_
 
+#include <functional>
+#include <thread>
+#include <vector>
+
 #include "panoptic_mapping/3rd_party/config_utilities.hpp"
 #include "panoptic_mapping/common/common.h"
 #include "panoptic_mapping/map/submap.h"
@@ -21,6 +25,15 @@ class LayerManipulator {
     bool use_instance_classification =
         false;  // How to interpret the class layer data.
 
+    // Radius in voxels searched for the remaining surface when applying a
+    // class layer. Voxels that do not belong to the submap get the distance to
+    // the closest surface of the belonging voxels within this radius. 0 sets
+    // them to the truncation distance.
+    int redistancing_radius = 2;
+
+    // Number of threads used to apply class layers and re-distance layers.
+    int num_threads = std::thread::hardware_concurrency();
+
     Config() { setConfigName("LayerManipulator"); }
 
    protected:
@@ -34,6 +47,7 @@ class LayerManipulator {
   /* Tools */
   // Trim the TSDF layer according to the provided class layer. Tsdf and class
   // layer are expected to have identical layout, extent and transformation.
+  // All blocks whose mesh may have changed are flagged for a mesh update.
   void applyClassificationLayer(TsdfLayer* tsdf_layer,
                                 const ClassLayer& class_layer,
                                 float truncation_distance) const;
@@ -41,12 +55,47 @@ class LayerManipulator {
   void mergeSubmapAintoB(const Submap& A, Submap* B) const;
 
   /**
-   * @brief Convert a TSDF into an ESDF layer, propagating shortest distances
-   * through the projective TSDF.
+   * @brief Replace the projective distances of a TSDF layer by distances to
+   * the closest surface, computed in place within the truncation band.
+   * Surface points are found at the zero crossings and distances are
+   * propagated from there by a brushfire limited to the truncation distance.
+   * Observed voxels further away are clamped to the truncation distance.
    *
-   * @param layer Layer to ESDFify.
+   * @param layer Layer to re-distance.
+   * @param truncation_distance Width of the band in meters.
    */
-  void unprojectTsdfLayer(TsdfLayer* layer) const;
+  void unprojectTsdfLayer(TsdfLayer* layer, float truncation_distance) const;
+
+ private:
+  // Offset of a neighboring voxel and its distance in meters.
+  struct NeighborOffset {
+    VoxelIndex offset;
+    float distance;
+  };
+
+  enum class BlockResult { kUnchanged, kUpdated, kRemoved };
+
+  // Voxel next to a zero crossing and its distance to the surface.
+  struct SurfaceSeed {
+    VoxelIndex voxel_index;
+    float distance;
+  };
+
+  void processInParallel(size_t num_items,
+                         const std::function<void(size_t)>& process) const;
+
+  BlockResult applyClassificationToBlock(
+      TsdfLayer* tsdf_layer, const ClassLayer& class_layer,
+      const BlockIndex& block_index, float truncation_distance,
+      const std::vector<NeighborOffset>& offsets) const;
+  std::vector<NeighborOffset> computeNeighborOffsets(
+      float voxel_size, int voxels_per_side) const;
+  static std::vector<SurfaceSeed> computeSurfaceSeeds(
+      const TsdfLayer& layer, const BlockIndex& block_index);
+  static void redistanceBlock(
+      TsdfLayer* layer, const BlockIndex& block_index,
+      const std::vector<const std::vector<SurfaceSeed>*>& neighbor_seeds,
+      float truncation_distance);
 
  private:
   const Config config_;
@@ -1,6 +1,7 @@
 #ifndef PANOPTIC_MAPPING_MAP_MANAGEMENT_MAP_MANAGER_H_
 #define PANOPTIC_MAPPING_MAP_MANAGEMENT_MAP_MANAGER_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -58,6 +59,9 @@ class MapManager : public MapManagerBase {
   void tick(SubmapCollection* submaps) override;
   void finishMapping(SubmapCollection* submaps) override;
 
+  // Changes the frequencies of the map management actions.
+  void reconfigure(const PerformanceParameters& parameters) override;
+
   // Perform specific tasks.
   void pruneActiveBlocks(SubmapCollection* submaps);
   void manageSubmapActivity(SubmapCollection* submaps);
@@ -80,20 +84,33 @@ class MapManager : public MapManagerBase {
   std::shared_ptr<TsdfRegistrator> tsdf_registrator_;
   std::shared_ptr<LayerManipulator> layer_manipulator_;
 
-  // Action tick counters.
+  // Action tick counters. Actions with 0 max ticks are disabled.
   class Ticker {
    public:
-    Ticker(unsigned int max_ticks,
-           std::function<void(SubmapCollection* submaps)> action)
-        : max_ticks_(max_ticks), action_(std::move(action)) {}
+    explicit Ticker(std::function<void(SubmapCollection* submaps)> action)
+        : action_(std::move(action)) {}
     void tick(SubmapCollection* submaps);
 
+    // Changing the frequency restarts the tick count.
+    void setMaxTicks(int max_ticks);
+
    private:
     unsigned int current_tick_ = 0;
-    const unsigned int max_ticks_;
+    unsigned int max_ticks_ = 0;
     const std::function<void(SubmapCollection* submaps)> action_;
   };
-  std::vector<Ticker> tickers_;
+  Ticker prune_active_blocks_ticker_;
+  Ticker activity_management_ticker_;
+  Ticker change_detection_ticker_;
+
+  // Action frequencies, initialized from the config.
+  int prune_active_blocks_frequency_;
+  int activity_management_frequency_;
+  int change_detection_frequency_;
+
+  // Set the frequency of an action if it changed.
+  static void setFrequency(int frequency, int* current_frequency,
+                           Ticker* ticker);
 };
 
 }  // namespace panoptic_mapping
@@ -1,6 +1,7 @@
 #ifndef PANOPTIC_MAPPING_MAP_MANAGEMENT_MAP_MANAGER_BASE_H_
 #define PANOPTIC_MAPPING_MAP_MANAGEMENT_MAP_MANAGER_BASE_H_
 
+#include "panoptic_mapping/common/performance_parameters.h"
 #include "panoptic_mapping/map/submap_collection.h"
 
 namespace panoptic_mapping {
@@ -17,6 +18,9 @@ class MapManagerBase {
   // Perform all actions when with specified timings.
   virtual void tick(SubmapCollection* submaps) = 0;
   virtual void finishMapping(SubmapCollection* submaps) = 0;
+
+  // Apply the performance parameters used by this manager between two ticks.
+  virtual void reconfigure(const PerformanceParameters& parameters) {}
 };
 
 }  // namespace panoptic_mapping
@@ -0,0 +1,177 @@
+#ifndef PANOPTIC_MAPPING_MAP_MANAGEMENT_SUBMAP_COLLECTION_FUSION_H_
+#define PANOPTIC_MAPPING_MAP_MANAGEMENT_SUBMAP_COLLECTION_FUSION_H_
+
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "panoptic_mapping/3rd_party/config_utilities.hpp"
+#include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/map/submap.h"
+#include "panoptic_mapping/map/submap_collection.h"
+#include "panoptic_mapping/map_management/layer_manipulator.h"
+#include "panoptic_mapping/map_management/tsdf_registrator.h"
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Fuses the submap collections of multiple robots (peers) into a single
+ * target collection. Peer submaps are copied into the target with remapped
+ * submap and instance IDs, and finished peer submaps that geometrically and
+ * semantically match a submap of the target are merged into it. Peers can
+ * provide their full collection or stream deltas of updated and removed
+ * submaps, the ID mapping of every peer is kept between calls. Copies are
+ * updated in place with the blocks that changed since the last fusion. Target
+ * submaps that received merged data are owned by the fusion and no longer
+ * updated from the peer they were copied from.
+ */
+class SubmapCollectionFusion {
+ public:
+  struct Config : public config_utilities::Config<Config> {
+    int verbosity = 2;
+
+    // If true merge finished peer submaps into matching target submaps of the
+    // same class. Otherwise all peer submaps are only copied.
+    bool merge_matching_submaps = true;
+
+    // Maximum translation in meters and rotation in radians between two
+    // submap frames to merge them directly. Submaps whose frames differ more
+    // are resampled into the frame of the submap they are merged into.
+    float max_alignment_translation = 1e-4;
+    float max_alignment_rotation = 1e-4;
+
+    // Number of threads used for matching and merging submaps.
+    int integration_threads = std::thread::hardware_concurrency();
+
+    // Tools used to detect matches and merge submaps.
+    TsdfRegistrator::Config tsdf_registrator_config;
+    LayerManipulator::Config layer_manipulator_config;
+
+    Config() { setConfigName("SubmapCollectionFusion"); }
+
+   protected:
+    void setupParamsAndPrinting() override;
+    void checkParams() const override;
+  };
+
+  explicit SubmapCollectionFusion(const Config& config);
+  virtual ~SubmapCollectionFusion() = default;
+
+  /**
+   * @brief Fuse the complete collection of a peer into the target. Peer
+   * submaps that changed since they were last fused are updated and submaps
+   * that no longer exist in the peer collection are removed from the target.
+   *
+   * @param peer_id Unique identifier of the peer, e.g. the robot ID.
+   * @param peer_submaps Collection of the peer.
+   * @param T_M_P Transformation from the peer mission frame to the mission
+   * frame of the target.
+   * @param target Collection to fuse the peer submaps into.
+   */
+  void fuseCollection(int peer_id, const SubmapCollection& peer_submaps,
+                      const Transformation& T_M_P, SubmapCollection* target);
+
+  /**
+   * @brief Incrementally fuse a delta of a peer collection into the target.
+   *
+   * @param peer_id Unique identifier of the peer, e.g. the robot ID.
+   * @param peer_submaps Collection of the peer, needs to contain all submaps
+   * listed in updated_ids.
+   * @param updated_ids Peer submap IDs that were added or changed since the
+   * last call.
+   * @param removed_ids Peer submap IDs that were removed since the last call.
+   * @param T_M_P Transformation from the peer mission frame to the mission
+   * frame of the target.
+   * @param target Collection to fuse the peer submaps into.
+   */
+  void fuseDelta(int peer_id, const SubmapCollection& peer_submaps,
+                 const std::vector<int>& updated_ids,
+                 const std::vector<int>& removed_ids,
+                 const Transformation& T_M_P, SubmapCollection* target);
+
+  /**
+   * @brief Forget the ID mapping of a peer. Submaps already fused into a
+   * target collection are not affected.
+   */
+  void resetPeer(int peer_id);
+
+  /**
+   * @brief Look up the target submap ID of a peer submap.
+   *
+   * @return The target submap ID, -1 if the peer submap was not fused.
+   */
+  int getTargetSubmapID(int peer_id, int peer_submap_id) const;
+
+ private:
+  // A peer submap fused into the target.
+  struct FusedSubmap {
+    // Target submap containing the data of the peer submap.
+    int target_id = -1;
+
+    // Merged peer submaps are part of a target submap owned by the fusion and
+    // are no longer updated. Otherwise the target submap is a copy.
+    bool merged = false;
+
+    // Whether the peer is still integrating into the submap.
+    bool peer_is_active = false;
+
+    // Most recent map version of the peer submap contained in the target.
+    uint64_t imported_version = 0;
+  };
+
+  // ID mapping of a single peer.
+  struct PeerState {
+    // Peer submap ID to fused submap.
+    std::unordered_map<int, FusedSubmap> submaps;
+
+    // Peer instance ID to target instance ID.
+    std::unordered_map<int, int> instance_ids;
+  };
+
+  // Copy a peer submap into the target or update its previous copy with what
+  // changed since.
+  void importSubmap(int peer_id, const Submap& peer_submap,
+                    const Transformation& T_M_P, PeerState* peer,
+                    SubmapCollection* target);
+
+  // Take ownership of a target submap that is a copy of a peer submap, so it
+  // can no longer be modified by updates of that peer.
+  void takeOwnership(int target_id);
+
+  // Find the first target submap that the candidate can be merged into, -1
+  // if there is none.
+  int findMatchingSubmap(const SubmapCollection& target,
+                         const Submap& candidate,
+                         const std::unordered_set<int>& excluded_ids) const;
+
+  // Merge all candidates into the target submap with the given ID.
+  void mergeIntoSubmap(const std::vector<int>& candidate_ids,
+                       SubmapCollection* target, int target_id) const;
+
+  // Resample the TSDF and class layer of A into the frame and layout of the
+  // reference submap. The result needs to have the config of the reference.
+  static void resampleSubmap(const Submap& A, const Submap& reference,
+                             Submap* result);
+
+  bool framesAreAligned(const Transformation& T_B_A) const;
+
+ private:
+  const Config config_;
+
+  // Tools.
+  TsdfRegistrator tsdf_registrator_;
+  LayerManipulator layer_manipulator_;
+
+  // Data.
+  std::unordered_map<int, PeerState> peers_;
+
+  // Target submap ID to <peer ID, peer submap ID> of all copies.
+  std::unordered_map<int, std::pair<int, int>> copy_owners_;
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_MAP_MANAGEMENT_SUBMAP_COLLECTION_FUSION_H_
@@ -1,6 +1,9 @@
 #ifndef PANOPTIC_MAPPING_SUBMAP_ALLOCATION_SEMANTIC_SUBMAP_ALLOCATOR_H_
 #define PANOPTIC_MAPPING_SUBMAP_ALLOCATION_SEMANTIC_SUBMAP_ALLOCATOR_H_
 
+#include <map>
+#include <string>
+
 #include "panoptic_mapping/3rd_party/config_utilities.hpp"
 #include "panoptic_mapping/labels/label_entry.h"
 #include "panoptic_mapping/submap_allocation/submap_allocator_base.h"
@@ -9,7 +12,8 @@ namespace panoptic_mapping {
 
 /**
  * @brief This submap allocator chooses a voxel size based on the semantic label
- * of submaps.
+ * of submaps. Optionally, the voxel size of instances is derived from their
+ * metric extent observed in the input at allocation time.
  */
 class SemanticSubmapAllocator : public SubmapAllocatorBase {
  public:
@@ -32,6 +36,31 @@ class SemanticSubmapAllocator : public SubmapAllocatorBase {
     // submap. Negative values are multiples of the voxel size.
     float truncation_distance = -2.f;
 
+    // Per-class truncation distances, overwriting 'truncation_distance' for
+    // labels whose class name or class ID is given as key, e.g. a thin band
+    // for walls and a wider one for clutter. Negative values are multiples of
+    // the voxel size.
+    std::map<std::string, float> class_truncation_distances;
+
+    // If true, the voxel size of new instance submaps is chosen such that
+    // their extent estimated from the vertex map spans the target number of
+    // voxels. Falls back to the label size if the estimate is unavailable.
+    bool use_extent_voxel_size = false;
+
+    // Target number of voxels along the largest extent of an instance.
+    float target_voxels_per_extent = 40.f;
+
+    // Bounds of the extent-driven voxel size in meters.
+    float min_instance_voxel_size = 0.02f;
+    float max_instance_voxel_size = 0.1f;
+
+    // Minimum number of valid segment pixels to estimate the extent.
+    int min_extent_pixels = 100;
+
+    // Fraction of points ignored at each end of every axis when computing the
+    // extent, making it robust to mixed pixels at the segment boundary.
+    float extent_outlier_fraction = 0.05f;
+
     Config() { setConfigName("SemanticSubmapAllocator"); }
 
    protected:
@@ -44,10 +73,20 @@ class SemanticSubmapAllocator : public SubmapAllocatorBase {
                                    bool print_config = true);
   ~SemanticSubmapAllocator() override = default;
 
-  Submap* allocateSubmap(SubmapCollection* submaps, InputData* /* input */,
-                         int /* input_id */, const LabelEntry& label) override;
+  Submap* allocateSubmap(SubmapCollection* submaps, InputData* input,
+                         int input_id, const LabelEntry& label) override;
 
  private:
+  /**
+   * @brief Estimate the largest axis aligned extent in camera frame of the
+   * segment with the given ID in the input.
+   *
+   * @param extent Output extent in meters.
+   * @return True if enough valid points of the segment were found.
+   */
+  bool estimateExtent(const InputData& input, int input_id,
+                      float* extent) const;
+
   static config_utilities::Factory::RegistrationRos<SubmapAllocatorBase,
                                                     SemanticSubmapAllocator>
       registration_;
@@ -18,13 +18,14 @@ namespace test {
  */
 class TempFile {
  public:
-  explicit TempFile(const std::string& name = "") {
+  explicit TempFile(const std::string& name = "",
+                    const std::string& extension = ".tmp") {
     // For Ubuntu /tmp/ should always exist and no subdirectories are used.
     auto t = std::time(nullptr);
     auto tm = *std::localtime(&t);
     std::stringstream ss;
     ss << std::put_time(&tm, "%d-%m-%Y_%H-%M-%S");
-    file_name_ = "/tmp/" + name + ss.str() + ".tmp";
+    file_name_ = "/tmp/" + name + ss.str() + extension;
     stream_.open(file_name_, std::fstream::in | std::fstream::out |
                                  std::fstream::trunc | std::fstream::binary);
   }
@@ -40,6 +41,7 @@ class TempFile {
   operator bool() const { return stream_.is_open(); }
   std::fstream& stream() { return stream_; }
   const std::fstream& stream() const { return stream_; }
+  const std::string& fileName() const { return file_name_; }
 
  private:
   std::fstream stream_;
@@ -0,0 +1,93 @@
+#ifndef PANOPTIC_MAPPING_TOOLS_FRAME_DEDUPLICATOR_H_
+#define PANOPTIC_MAPPING_TOOLS_FRAME_DEDUPLICATOR_H_
+
+#include <opencv2/core/mat.hpp>
+
+#include "panoptic_mapping/3rd_party/config_utilities.hpp"
+#include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/common/input_data.h"
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Detects frames that are nearly identical to the last integrated frame,
+ * e.g. while the sensor is stationary. A frame is redundant if the sensor pose
+ * changed little and only few pixels of the depth and segmentation images
+ * differ. The image comparison is subsampled to be cheap.
+ */
+class FrameDeduplicator {
+ public:
+  struct Config : public config_utilities::Config<Config> {
+    int verbosity = 1;
+
+    // Maximum sensor motion for a frame to be redundant.
+    float max_translation = 0.01f;  // m
+    float max_rotation = 0.01f;     // rad
+
+    // Pixels whose depth differs by more than this are considered changed.
+    float depth_tolerance = 0.05f;  // m
+
+    // Maximum fraction of changed depth and segmentation pixels for a frame to
+    // be redundant.
+    float max_changed_depth_ratio = 0.02f;
+    float max_changed_id_ratio = 0.02f;
+
+    // Only every n-th pixel in each direction is compared.
+    int pixel_stride = 4;
+
+    // Integrate a frame after at most this many consecutive redundant frames
+    // to keep accumulating measurements. 0 to skip indefinitely.
+    int max_skipped_frames = 10;
+
+    Config() { setConfigName("FrameDeduplicator"); }
+
+   protected:
+    void setupParamsAndPrinting() override;
+    void checkParams() const override;
+  };
+
+  explicit FrameDeduplicator(const Config& config);
+  virtual ~FrameDeduplicator() = default;
+
+  /**
+   * @brief Check whether the input is redundant w.r.t. the last frame that was
+   * not. Frames that are not redundant become the new reference. Needs to be
+   * called before the ID image is modified by tracking.
+   *
+   * @param input Input data containing at least pose and depth image.
+   * @return True if the frame can be skipped.
+   */
+  bool isRedundant(const InputData& input);
+
+  /**
+   * @brief Forget the reference frame, the next frame is never redundant.
+   */
+  void reset();
+
+  // Access.
+  int getNumSkippedFrames() const { return num_skipped_frames_; }
+
+ private:
+  // Fraction of the compared pixels that changed.
+  float depthChangeRatio(const cv::Mat& depth_image, float depth_scale) const;
+  float idChangeRatio(const cv::Mat& id_image) const;
+  void setReference(const InputData& input);
+
+ private:
+  const Config config_;
+
+  // Reference frame.
+  bool has_reference_ = false;
+  Transformation T_M_C_;
+  cv::Mat depth_image_;
+  float depth_scale_ = 1.f;
+  cv::Mat id_image_;
+
+  // Tracking.
+  int num_consecutive_skipped_ = 0;
+  int num_skipped_frames_ = 0;
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_TOOLS_FRAME_DEDUPLICATOR_H_
@@ -1,6 +1,10 @@
 #ifndef PANOPTIC_MAPPING_TOOLS_MAP_RENDERER_H_
 #define PANOPTIC_MAPPING_TOOLS_MAP_RENDERER_H_
 
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <opencv2/core/mat.hpp>
 #include <voxblox/utils/color_maps.h>
 
@@ -13,16 +17,27 @@
 namespace panoptic_mapping {
 
 /**
- * Preliminary tool to visualize the map for debugging. Not very efficient or
- * sophisticated.
+ * Tool to render submap IDs or classes of the map for debugging and tracking.
+ * Submaps are either approximated by splatting their mesh vertices or rendered
+ * by z-buffered rasterization of their mesh triangles.
  */
 class MapRenderer {
  public:
   struct Config : public config_utilities::Config<Config> {
     int verbosity = 4;
 
+    // How to render the submap meshes. Supported are {vertices, triangles}.
+    // 'vertices' splats every mesh vertex, 'triangles' rasterizes the mesh
+    // triangles of all mesh blocks in the view frustum. Triangles are only
+    // supported for pinhole cameras and fall back to vertices otherwise.
+    std::string rendering_mode = "vertices";
+
+    // Vertices: Paint a window of the projected voxel size around each vertex.
     bool impaint_voxel_size = false;
 
+    // Triangles: Number of threads used to collect and rasterize triangles.
+    int num_threads = std::thread::hardware_concurrency();
+
     Config() { setConfigName("MapRenderer"); }
 
    protected:
@@ -46,13 +61,36 @@ class MapRenderer {
   const Config config_;
   Camera camera_;
 
-  //
+  // Range image of the vertex rendering and depth buffer of the triangle
+  // rasterization.
   Eigen::MatrixXf range_image_;
   voxblox::ExponentialOffsetIdColorMap id_color_map_;
 
+  // Triangle projected to the image plane.
+  struct ScreenTriangle {
+    float u[3];
+    float v[3];
+    float inverse_depth[3];
+    int value;
+  };
+
   // Methods.
   cv::Mat render(const SubmapCollection& submaps, const Transformation& T_M_C,
                  bool only_active_submaps, int (*paint)(const Submap&));
+  cv::Mat renderVertices(const SubmapCollection& submaps,
+                         const Transformation& T_M_C, bool only_active_submaps,
+                         int (*paint)(const Submap&));
+  cv::Mat renderTriangles(const SubmapCollection& submaps,
+                          const Transformation& T_M_C, bool only_active_submaps,
+                          int (*paint)(const Submap&));
+  bool isRendered(const Submap& submap, const Transformation& T_M_C,
+                  bool only_active_submaps) const;
+  void projectTriangles(const Submap& submap, const Transformation& T_M_C,
+                        int value,
+                        std::vector<ScreenTriangle>* triangles) const;
+  void rasterizeTriangles(const std::vector<ScreenTriangle>& triangles,
+                          const std::vector<size_t>& indices, int v_begin,
+                          int v_end, cv::Mat* result);
   static int paintSubmapID(const Submap& submap);
   static int paintClass(const Submap& submap);
 };
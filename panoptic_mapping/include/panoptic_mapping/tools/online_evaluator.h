@@ -0,0 +1,153 @@
+#ifndef PANOPTIC_MAPPING_TOOLS_ONLINE_EVALUATOR_H_
+#define PANOPTIC_MAPPING_TOOLS_ONLINE_EVALUATOR_H_
+
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <voxblox/core/block_hash.h>
+
+#include "panoptic_mapping/3rd_party/config_utilities.hpp"
+#include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/map/submap_collection.h"
+#include "panoptic_mapping/tools/planning_interface.h"
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Evaluates the reconstruction error and coverage of a map against a
+ * ground truth point cloud while mapping. The ground truth points are stored
+ * in a grid of cells and the statistics of each cell are kept, such that each
+ * update only re-evaluates the cells overlapped by submap blocks that changed
+ * since the previous update. The metrics match the reconstruction error
+ * computed by the offline MapEvaluator.
+ */
+class OnlineEvaluator {
+ public:
+  struct Config : public config_utilities::Config<Config> {
+    int verbosity = 2;
+
+    // Errors are truncated to this distance in meters.
+    float maximum_distance = 0.2f;
+
+    // Points with errors up to this distance in meters count as inliers.
+    float inlier_distance = 0.1f;
+
+    // If true, points whose error exceeds the maximum distance do not
+    // contribute to the error statistics.
+    bool ignore_truncated_points = false;
+
+    // If true evaluate a single TSDF map, i.e. including free space and
+    // ignoring change states.
+    bool is_single_tsdf = false;
+
+    // Side length in meters of the cells in which the ground truth points are
+    // grouped. Changes are tracked per cell.
+    float cell_size = 1.f;
+
+    // Number of threads used to evaluate the changed cells.
+    int num_threads = std::thread::hardware_concurrency();
+
+    Config() { setConfigName("OnlineEvaluator"); }
+
+   protected:
+    void setupParamsAndPrinting() override;
+    void checkParams() const override;
+  };
+
+  // Aggregated metrics over all ground truth points.
+  struct Metrics {
+    uint64_t total_points = 0;
+    uint64_t unknown_points = 0;
+    uint64_t truncated_points = 0;
+    uint64_t inliers = 0;
+    float mean_error = 0.f;    // m
+    float stddev_error = 0.f;  // m
+    float rmse = 0.f;          // m
+    float coverage = 0.f;      // Fraction of observed ground truth points.
+    size_t updated_cells = 0;  // Cells re-evaluated by the last update.
+  };
+
+  explicit OnlineEvaluator(const Config& config);
+  virtual ~OnlineEvaluator() = default;
+
+  /**
+   * @brief Set the ground truth points in mission frame. This resets all
+   * statistics.
+   */
+  void setGroundTruth(const std::vector<Point>& points);
+
+  /**
+   * @brief Re-evaluate all ground truth points that might be affected by
+   * changes of the map since the last update.
+   *
+   * @param submaps The map to evaluate.
+   * @return The metrics after the update.
+   */
+  const Metrics& update(const SubmapCollection& submaps);
+
+  // Access.
+  const Metrics& getMetrics() const { return metrics_; }
+
+  // Mark all cells for re-evaluation in the next update.
+  void reset();
+
+ private:
+  // Error statistics of a set of points.
+  struct Statistics {
+    uint64_t observed_points = 0;
+    uint64_t unknown_points = 0;
+    uint64_t truncated_points = 0;
+    uint64_t inliers = 0;
+    uint64_t num_errors = 0;
+    double error_sum = 0.0;
+    double squared_error_sum = 0.0;
+
+    void add(const Statistics& other);
+    void subtract(const Statistics& other);
+  };
+
+  struct Cell {
+    std::vector<Point> points;
+    Statistics statistics;
+  };
+
+  // Extent of a submap in cells at the time of the last update.
+  struct SubmapRecord {
+    uint64_t version = 0;
+    bool has_blocks = false;
+    voxblox::BlockIndex min_cell;
+    voxblox::BlockIndex max_cell;
+  };
+
+  // Mark all cells overlapped by a submap block, padded by one voxel for
+  // interpolation, and extend the record of the submap.
+  void markBlock(const Submap& submap, const voxblox::BlockIndex& block_index,
+                 SubmapRecord* record);
+  void markRecord(const SubmapRecord& record);
+  Statistics evaluateCell(const Cell& cell,
+                          const PlanningInterface& planning) const;
+  void computeMetrics();
+
+ private:
+  const Config config_;
+
+  // Ground truth points grouped in cells.
+  voxblox::AnyIndexHashMapType<Cell>::type cells_;
+  voxblox::IndexSet dirty_cells_;
+
+  // Tracking of the map changes.
+  const SubmapCollection* previous_submaps_ = nullptr;
+  uint64_t evaluated_version_ = 0;
+  std::unordered_map<int, SubmapRecord> submap_records_;
+
+  // Results.
+  Statistics total_;
+  uint64_t total_points_ = 0;
+  Metrics metrics_;
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_TOOLS_ONLINE_EVALUATOR_H_
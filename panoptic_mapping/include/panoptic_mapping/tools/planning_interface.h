@@ -1,8 +1,15 @@
 #ifndef PANOPTIC_MAPPING_TOOLS_PLANNING_INTERFACE_H_
 #define PANOPTIC_MAPPING_TOOLS_PLANNING_INTERFACE_H_
 
+#include <list>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
+#include <voxblox/core/block_hash.h>
+
+#include "panoptic_mapping/3rd_party/config_utilities.hpp"
 #include "panoptic_mapping/map/submap.h"
 #include "panoptic_mapping/map/submap_collection.h"
 
@@ -14,7 +21,32 @@ namespace panoptic_mapping {
  */
 class PlanningInterface {
  public:
-  explicit PlanningInterface(std::shared_ptr<const SubmapCollection> submaps);
+  struct Config : public config_utilities::Config<Config> {
+    int verbosity = 1;
+
+    // If true cache the results of getVoxelState() and getDistance(). Cached
+    // results are invalidated whenever a submap block they depend on changes.
+    bool use_cache = false;
+
+    // Resolution of the cache in meters. Cached queries are answered for the
+    // center of the cache voxel containing the query point.
+    float cache_voxel_size = 0.05f;
+
+    // Number of cache voxels per side of a cache block.
+    int cache_voxels_per_side = 16;
+
+    // Maximum number of cached blocks, the least recently used are evicted.
+    int cache_max_blocks = 2000;
+
+    Config() { setConfigName("PlanningInterface"); }
+
+   protected:
+    void setupParamsAndPrinting() override;
+    void checkParams() const override;
+  };
+
+  explicit PlanningInterface(std::shared_ptr<const SubmapCollection> submaps,
+                             const Config& config = Config());
 
   enum class VoxelState {
     kUnknown = 0,
@@ -65,9 +97,54 @@ class PlanningInterface {
                    bool consider_change_state = true,
                    bool include_free_space = true) const;
 
+  /**
+   * @brief Remove all cached results.
+   */
+  void clearCache() const;
+
  private:
+  // Uncached lookups.
+  VoxelState computeVoxelState(const Point& position) const;
+  bool computeDistance(const Point& position, float* distance,
+                       bool consider_change_state,
+                       bool include_free_space) const;
+
+  // Cache. Results are stored in blocks of the mission frame. Each block
+  // records for every submap the range of submap blocks it depends on and is
+  // only used while none of these changed.
+  struct CacheDependency {
+    int submap_id;
+    uint64_t version;  // Latest submap version the cache block is valid for.
+    BlockIndex min_index;
+    BlockIndex max_index;
+  };
+  struct CacheBlock {
+    uint64_t validated_version = 0;
+    uint64_t collection_version = 0;
+    std::vector<CacheDependency> dependencies;
+    std::vector<int8_t> voxel_states;  // -1 if not computed.
+    std::vector<float> distances[4];   // Per query flags, NaN if not computed.
+    std::list<BlockIndex>::iterator lru_position;
+  };
+
+  // Get the valid cache block containing the cache voxel, set up a new block
+  // if necessary. Requires the cache mutex to be locked.
+  CacheBlock* getCacheBlock(const voxblox::GlobalIndex& voxel_index) const;
+  bool cacheBlockIsValid(CacheBlock* block) const;
+  bool cacheDependencyIsValid(CacheDependency* dependency) const;
+  void computeCacheDependencies(const BlockIndex& block_index,
+                                CacheBlock* block) const;
+  size_t cacheLinearIndex(const voxblox::GlobalIndex& voxel_index) const;
+
+ private:
+  const Config config_;
   std::shared_ptr<const SubmapCollection> submaps_;
   static constexpr float kObservedMinWeight_ = 1e-6;
+
+  // Cache data.
+  mutable std::mutex cache_mutex_;
+  mutable voxblox::AnyIndexHashMapType<CacheBlock>::type cache_;
+  mutable std::list<BlockIndex> cache_lru_;  // Most recently used first.
 };
 
 }  // namespace panoptic_mapping
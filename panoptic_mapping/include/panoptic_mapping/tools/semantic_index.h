@@ -0,0 +1,181 @@
+#ifndef PANOPTIC_MAPPING_TOOLS_SEMANTIC_INDEX_H_
+#define PANOPTIC_MAPPING_TOOLS_SEMANTIC_INDEX_H_
+
+#include <functional>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <voxblox/core/block_hash.h>
+
+#include "panoptic_mapping/3rd_party/config_utilities.hpp"
+#include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/map/submap_collection.h"
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Incrementally maintained index over the submaps of a collection,
+ * keyed by class ID, instance ID, panoptic label and change state, and
+ * spatially by the submap bounding volumes. Use update() after the collection
+ * changed, then query the index without scanning all submaps. Spatially, each
+ * submap is stored in a single cell of a hierarchy of grids, at the finest
+ * level whose cells are at least as large as its bounding volume. Updating and
+ * querying is thread safe.
+ */
+class SemanticIndex {
+ public:
+  struct Config : public config_utilities::Config<Config> {
+    int verbosity = 1;
+
+    // Edge length of the cells of the finest spatial grid in meters. Each
+    // coarser level doubles the cell size.
+    float grid_cell_size = 2.f;
+
+    Config() { setConfigName("SemanticIndex"); }
+
+   protected:
+    void setupParamsAndPrinting() override;
+    void checkParams() const override;
+  };
+
+  // Indexed data of a single submap.
+  struct Entry {
+    int submap_id = -1;
+    int instance_id = -1;
+    int class_id = -1;
+    PanopticLabel label = PanopticLabel::kUnknown;
+    ChangeState change_state = ChangeState::kNew;
+    bool is_active = true;
+    Point center_M;  // Bounding volume center in mission frame.
+    float radius = 0.f;
+  };
+
+  // Query filter. Unset fields match all submaps.
+  struct Query {
+    std::optional<int> class_id;
+    std::optional<int> instance_id;
+    std::optional<PanopticLabel> label;
+    std::optional<ChangeState> change_state;
+    bool only_active = false;
+  };
+
+  explicit SemanticIndex(const Config& config);
+  virtual ~SemanticIndex() = default;
+
+  /**
+   * @brief Update all entries whose submap changed or was removed since the
+   * last update. Uses the map versions to only re-index what changed, and
+   * returns immediately if nothing in the map changed.
+   *
+   * @param submaps The submap collection to index.
+   */
+  void update(const SubmapCollection& submaps);
+
+  /**
+   * @brief Remove all entries.
+   */
+  void clear();
+
+  // Queries. All queries return submap IDs.
+  /**
+   * @brief Find all submaps that match the query.
+   */
+  std::vector<int> find(const Query& query) const;
+
+  /**
+   * @brief Find all submaps that match the query and whose bounding volume
+   * lies at least partially within the given radius of a point.
+   *
+   * @param query Semantic filter to apply.
+   * @param position_M Query point in mission frame.
+   * @param radius Search radius in meters.
+   */
+  std::vector<int> findWithinRadius(const Query& query, const Point& position_M,
+                                    float radius) const;
+
+  /**
+   * @brief Find the submap matching the query whose bounding volume is closest
+   * to a point. Searches the grid in growing radii around the point.
+   *
+   * @param query Semantic filter to apply.
+   * @param position_M Query point in mission frame.
+   * @param submap_id Output ID of the nearest submap.
+   * @param distance Optional output distance to its bounding volume in meters,
+   * 0 if the point lies inside the bounding volume.
+   * @return True if any submap matched the query.
+   */
+  bool findNearest(const Query& query, const Point& position_M, int* submap_id,
+                   float* distance = nullptr) const;
+
+  // Access.
+  size_t size() const;
+
+  /**
+   * @brief Get a copy of the indexed data of a submap.
+   *
+   * @return True if the submap is indexed.
+   */
+  bool getEntry(int submap_id, Entry* entry) const;
+
+ private:
+  using GridIndex = voxblox::AnyIndex;
+  using IDSet = std::unordered_set<int>;
+  using Grid = voxblox::AnyIndexHashMapType<IDSet>::type;
+
+  // Cap on the grid hierarchy, beyond this submaps share the coarsest level.
+  static constexpr int kMaxGridLevel = 24;
+
+  void insert(const Entry& entry);
+  void remove(const Entry& entry);
+  bool matches(const Entry& entry, const Query& query) const;
+  static bool needsUpdate(const Entry& old_entry, const Entry& new_entry);
+
+  // Spatial indexing. The level and cell of an entry only depend on its
+  // bounding volume.
+  int gridLevel(float radius) const;
+  float gridCellSize(int level) const;
+  GridIndex gridIndexFromPoint(const Point& point, int level) const;
+
+  // Calls the visitor for all entries that can lie within the radius of a
+  // point. Returns false without visiting anything if more than max_cells grid
+  // cells would have to be checked. Optionally reports whether all entries
+  // were visited.
+  bool visitNeighborhood(const Point& position_M, float radius,
+                         size_t max_cells,
+                         const std::function<void(const Entry&)>& visitor,
+                         bool* visited_all = nullptr) const;
+
+  // Returns the smallest ID set of the specified semantic keys, nullptr if no
+  // semantic key is specified. Points to an empty set if nothing matches.
+  const IDSet* semanticCandidates(const Query& query) const;
+
+ private:
+  const Config config_;
+  const IDSet empty_set_;
+
+  // Data.
+  std::unordered_map<int, Entry> entries_;
+
+  // Semantic indices.
+  std::unordered_map<int, IDSet> class_index_;
+  std::unordered_map<int, IDSet> instance_index_;
+  std::unordered_map<int, IDSet> label_index_;
+  std::unordered_map<int, IDSet> change_state_index_;
+
+  // Spatial index. One grid per level, each submap is stored in the cell
+  // containing its bounding volume center.
+  std::vector<Grid> grid_levels_;
+
+  // Most recent map version that is reflected in the index.
+  uint64_t indexed_version_ = 0;
+
+  // Queries may run concurrently, updates are exclusive.
+  mutable std::shared_mutex mutex_;
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_TOOLS_SEMANTIC_INDEX_H_
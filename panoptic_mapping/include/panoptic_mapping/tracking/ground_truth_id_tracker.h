@@ -2,7 +2,9 @@
 #define PANOPTIC_MAPPING_TRACKING_GROUND_TRUTH_ID_TRACKER_H_
 
 #include <memory>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "panoptic_mapping/3rd_party/config_utilities.hpp"
@@ -20,10 +22,14 @@ class GroundTruthIDTracker : public IDTrackerBase {
   struct Config : public config_utilities::Config<Config> {
     int verbosity = 4;
 
+    // Number of threads used to scan and remap the ID image.
+    int num_threads = std::thread::hardware_concurrency();
+
     Config() { setConfigName("GroundTruthIDTracker"); }
 
    protected:
     void setupParamsAndPrinting() override;
+    void checkParams() const override;
   };
 
   GroundTruthIDTracker(const Config& config, std::shared_ptr<Globals> globals,
@@ -51,6 +57,19 @@ class GroundTruthIDTracker : public IDTrackerBase {
    */
   void printAndResetWarnings();
 
+  /**
+   * @brief Collect all distinct instance IDs of valid pixels in the ID image
+   * and the range of all IDs in the image.
+   */
+  std::unordered_set<int> collectInstances(const InputData& input, int* min_id,
+                                           int* max_id) const;
+
+  /**
+   * @brief Replace the instance IDs in the ID image by their submap IDs, -1
+   * for unknown instances.
+   */
+  void remapIDImage(int min_id, int max_id, InputData* input) const;
+
  private:
   static config_utilities::Factory::RegistrationRos<
       IDTrackerBase, GroundTruthIDTracker, std::shared_ptr<Globals>>
@@ -58,6 +77,10 @@ class GroundTruthIDTracker : public IDTrackerBase {
   const Config config_;
   std::unordered_map<int, int> instance_to_id_;  // Track active maps.
   std::unordered_map<int, int> unknown_ids;      // For error handling.
+
+  // Maximum number of entries of the flat instance to submap ID lookup table.
+  // Images spanning a larger range of IDs are remapped via the hash map.
+  static constexpr int kMaxLookupTableSize = 1 << 20;
 };
 
 }  // namespace panoptic_mapping
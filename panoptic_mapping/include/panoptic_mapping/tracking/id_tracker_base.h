@@ -12,6 +12,7 @@
 #include "panoptic_mapping/common/common.h"
 #include "panoptic_mapping/common/globals.h"
 #include "panoptic_mapping/common/input_data_user.h"
+#include "panoptic_mapping/common/performance_parameters.h"
 #include "panoptic_mapping/map/submap_collection.h"
 #include "panoptic_mapping/submap_allocation/freespace_allocator_base.h"
 #include "panoptic_mapping/submap_allocation/submap_allocator_base.h"
@@ -38,6 +39,14 @@ class IDTrackerBase : public InputDataUser {
    */
   virtual void processInput(SubmapCollection* submaps, InputData* input) = 0;
 
+  /**
+   * @brief Apply the performance parameters used by this tracker. Must not be
+   * called while processing input.
+   *
+   * @param parameters The parameters to apply.
+   */
+  virtual void reconfigure(const PerformanceParameters& parameters) {}
+
   // Setters for external setup.
   /**
    * @brief Sets a callback that is called whenever an image needs to be
@@ -51,6 +60,20 @@ class IDTrackerBase : public InputDataUser {
     visualize_ = true;
   }
 
+  /**
+   * @brief Sets a callback that is queried before an image is computed for
+   * visualization. Images are only computed if it returns true for their name,
+   * e.g. because someone is listening. Without this callback all images are
+   * computed.
+   *
+   * @param callback The function that returns whether the named image is
+   * requested.
+   */
+  void setVisualizationRequestCallback(
+      std::function<bool(const std::string&)> callback) {
+    visualization_request_callback_ = std::move(callback);
+  }
+
   /**
    * @brief Set the submap allocator that is used to allocate non-freespace
    * maps.
@@ -80,6 +103,10 @@ class IDTrackerBase : public InputDataUser {
 
   // Visualization
   bool visualizationIsOn() const { return visualize_; }
+  bool visualizationIsRequested(const std::string& name) const {
+    return visualize_ && (!visualization_request_callback_ ||
+                          visualization_request_callback_(name));
+  }
   void visualize(const cv::Mat& image, const std::string& name) {
     if (visualize_) {
       visualization_callback_(image, name);
@@ -90,6 +117,7 @@ class IDTrackerBase : public InputDataUser {
   bool visualize_ = false;
   std::function<void(const cv::Mat&, const std::string&)>
       visualization_callback_;
+  std::function<bool(const std::string&)> visualization_request_callback_;
 };
 
 }  // namespace panoptic_mapping
@@ -59,6 +59,10 @@ class ProjectiveIDTracker : public IDTrackerBase {
     // Number of threads to use to track submaps in parallel.
     int rendering_threads = std::thread::hardware_concurrency();
 
+    // If true, skip rendering submaps that are fully hidden behind the
+    // observed surfaces by more than the depth tolerance.
+    bool use_occlusion_culling = true;
+
     // Renderer settings. The renderer is only used for visualization purposes.
     MapRenderer::Config renderer;
 
@@ -75,6 +79,9 @@ class ProjectiveIDTracker : public IDTrackerBase {
 
   void processInput(SubmapCollection* submaps, InputData* input) override;
 
+  // Changes the number of rendering threads and the rendering subsampling.
+  void reconfigure(const PerformanceParameters& parameters) override;
+
  protected:
   // Internal methods.
   virtual bool classesMatch(int input_id, int submap_class_id);
@@ -82,6 +89,9 @@ class ProjectiveIDTracker : public IDTrackerBase {
                                  InputData* input);
   TrackingInfoAggregator computeTrackingData(SubmapCollection* submaps,
                                              InputData* input);
+  void cullOccludedSubmaps(const SubmapCollection& submaps,
+                           const InputData& input,
+                           std::vector<int>* submap_ids) const;
   TrackingInfo renderTrackingInfo(const Submap& submap,
                                   const InputData& input) const;
 
@@ -102,6 +112,11 @@ class ProjectiveIDTracker : public IDTrackerBase {
  protected:
   MapRenderer renderer_;  // The renderer is only used if visualization is on.
   cv::Mat rendered_vis_;  // Store visualization data.
+  bool visualize_rendered_ = false;
+
+  // Settings that can be reconfigured at runtime, initialized from the config.
+  int rendering_threads_;
+  int rendering_subsampling_;
 };
 
 }  // namespace panoptic_mapping
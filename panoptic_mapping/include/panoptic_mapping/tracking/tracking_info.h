@@ -12,6 +12,7 @@
 #include <opencv2/core/mat.hpp>
 
 #include "panoptic_mapping/common/camera.h"
+#include "panoptic_mapping/common/input_data.h"
 
 namespace panoptic_mapping {
 
@@ -32,7 +33,8 @@ class TrackingInfo {
 
   // Approximate rendering.
   void insertRenderedPoint(int u, int v, int size_x, int size_y);
-  void evaluate(const cv::Mat& id_image, const cv::Mat& depth_image);
+  void evaluate(const cv::Mat& id_image, const cv::Mat& depth_image,
+                float depth_scale = 1.f);
 
   // Vertex rendering.
   void insertVertexPoint(int input_id);
@@ -66,8 +68,8 @@ class TrackingInfoAggregator {
   void insertTrackingInfos(const std::vector<TrackingInfo>& infos);
   void insertTrackingInfo(const TrackingInfo& info);
   void insertInputImage(const cv::Mat& id_image, const cv::Mat& depth_image,
-                        const Camera::Config& camera,
-                        int rendering_subsampling);
+                        const Camera::Config& camera, int rendering_subsampling,
+                        float depth_scale = 1.f);
 
   // Get results. Requires that all input data is already set.
   std::vector<int> getInputIDs() const;
@@ -1,9 +1,55 @@
 #include "panoptic_mapping/common/camera.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace panoptic_mapping {
+namespace {
+
+// Metric depth of float and 16-bit depth pixels.
+inline float toMeters(float depth, float /* depth_scale */) { return depth; }
+inline float toMeters(uint16_t depth, float depth_scale) {
+  return depth * depth_scale;
+}
+
+template <typename DepthT>
+void computeVertexMapImpl(const cv::Mat& depth_image, float depth_scale,
+                          const cv::Mat& ray_table, cv::Mat* vertices) {
+  for (int v = 0; v < depth_image.rows; v++) {
+    const DepthT* depth_row = depth_image.ptr<DepthT>(v);
+    const cv::Vec2f* ray_row = ray_table.ptr<cv::Vec2f>(v);
+    cv::Vec3f* vertex_row = vertices->ptr<cv::Vec3f>(v);
+    for (int u = 0; u < depth_image.cols; u++) {
+      cv::Vec3f& vertex = vertex_row[u];  // x, y, z
+      vertex[2] = toMeters(depth_row[u], depth_scale);
+      if (!std::isfinite(vertex[2])) vertex[2] = 0.0; // this will be filtered via min_range constraint
+      vertex[0] = ray_row[u][0] * vertex[2];
+      vertex[1] = ray_row[u][1] * vertex[2];
+    }
+  }
+}
+
+template <typename DepthT>
+void computeValidityImageImpl(const cv::Mat& depth_image, float depth_scale,
+                              float min_range, float max_range,
+                              cv::Mat* validity_image) {
+  for (int v = 0; v < depth_image.rows; v++) {
+    const DepthT* depth_row = depth_image.ptr<DepthT>(v);
+    uchar* validity_row = validity_image->ptr<uchar>(v);
+    for (int u = 0; u < depth_image.cols; u++) {
+      const float depth = toMeters(depth_row[u], depth_scale);
+      validity_row[u] =
+          static_cast<uchar>(depth >= min_range && depth <= max_range);
+    }
+  }
+}
+
+}  // namespace
 
 void Camera::Config::checkParams() const {
   checkParamGT(width, 0, "width");
@@ -17,6 +63,21 @@ void Camera::Config::checkParams() const {
                  "'max_range' is expected > 'min_range'.");
   checkParamCond(vx <= width, "'vx' is expected <= 'width'.");
   checkParamCond(vy <= height, "'vy' is expected <= 'height'.");
+  checkParamGT(undistortion_iterations, 0, "undistortion_iterations");
+  if (distortion_model == "radtan") {
+    checkParamCond(distortion_coefficients.size() == 4 ||
+                       distortion_coefficients.size() == 5,
+                   "The 'radtan' model expects 4 or 5 "
+                   "'distortion_coefficients' [k1, k2, p1, p2(, k3)].");
+  } else if (distortion_model == "equidistant") {
+    checkParamCond(distortion_coefficients.size() == 4,
+                   "The 'equidistant' model expects 4 "
+                   "'distortion_coefficients' [k1, k2, k3, k4].");
+  } else {
+    checkParamCond(distortion_model == "pinhole",
+                   "Unknown distortion_model '" + distortion_model +
+                       "', supported are {pinhole, radtan, equidistant}.");
+  }
 }
 
 void Camera::Config::setupParamsAndPrinting() {
@@ -27,32 +88,223 @@ void Camera::Config::setupParamsAndPrinting() {
   setupParam("vy", &vy, "px");
   setupParam("fx", &fx, "px");
   setupParam("fy", &fy, "px");
+  setupParam("distortion_model", &distortion_model);
+  setupParam("distortion_coefficients", &distortion_coefficients);
+  setupParam("undistortion_iterations", &undistortion_iterations);
   setupParam("max_range", &max_range, "m");
   setupParam("min_range", &min_range, "m");
 }
 
-Camera::Camera(const Config& config) : config_(config.checkValid()) {
+Camera::Camera(const Config& config)
+    : config_(config.checkValid()),
+      distortion_model_(distortionModelFromString(config_.distortion_model)) {
   LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
 
+  // Setup the distortion parameters.
+  for (size_t i = 0; i < config_.distortion_coefficients.size() && i < 5;
+       ++i) {
+    k_[i] = config_.distortion_coefficients[i];
+  }
+
+  // Pre-compute the back-projection rays and view frustum.
+  computeDistortionLimits();
+  computeRayTable();
+  computeViewFrustum();
+}
+
+Camera::DistortionModel Camera::distortionModelFromString(
+    const std::string& model) {
+  if (model == "radtan") {
+    return DistortionModel::kRadTan;
+  } else if (model == "equidistant") {
+    return DistortionModel::kEquidistant;
+  }
+  return DistortionModel::kPinhole;
+}
+
+bool Camera::distort(float x, float y, float* x_d, float* y_d) const {
+  switch (distortion_model_) {
+    case DistortionModel::kRadTan: {
+      // k_ = [k1, k2, p1, p2, k3].
+      const float r2 = x * x + y * y;
+      if (r2 > max_radius_ * max_radius_) {
+        return false;
+      }
+      const float radial = 1.f + r2 * (k_[0] + r2 * (k_[1] + r2 * k_[4]));
+      *x_d = x * radial + 2.f * k_[2] * x * y + k_[3] * (r2 + 2.f * x * x);
+      *y_d = y * radial + k_[2] * (r2 + 2.f * y * y) + 2.f * k_[3] * x * y;
+      return true;
+    }
+    case DistortionModel::kEquidistant: {
+      // k_ = [k1, k2, k3, k4].
+      const float r = std::sqrt(x * x + y * y);
+      if (r < 1e-8f) {
+        break;
+      }
+      const float theta = std::atan(r);
+      if (theta > max_theta_) {
+        return false;
+      }
+      const float theta2 = theta * theta;
+      const float theta4 = theta2 * theta2;
+      const float theta_d =
+          theta * (1.f + k_[0] * theta2 + k_[1] * theta4 +
+                   k_[2] * theta4 * theta2 + k_[3] * theta4 * theta4);
+      const float scale = theta_d / r;
+      *x_d = x * scale;
+      *y_d = y * scale;
+      return true;
+    }
+    default:
+      break;
+  }
+  *x_d = x;
+  *y_d = y;
+  return true;
+}
+
+void Camera::undistort(float x_d, float y_d, float* x, float* y) const {
+  switch (distortion_model_) {
+    case DistortionModel::kRadTan: {
+      // Fixed point iteration on the undistorted coordinates.
+      float x_u = x_d;
+      float y_u = y_d;
+      for (int i = 0; i < config_.undistortion_iterations; ++i) {
+        const float r2 = x_u * x_u + y_u * y_u;
+        const float radial = 1.f + r2 * (k_[0] + r2 * (k_[1] + r2 * k_[4]));
+        const float dx =
+            2.f * k_[2] * x_u * y_u + k_[3] * (r2 + 2.f * x_u * x_u);
+        const float dy =
+            k_[2] * (r2 + 2.f * y_u * y_u) + 2.f * k_[3] * x_u * y_u;
+        x_u = (x_d - dx) / radial;
+        y_u = (y_d - dy) / radial;
+      }
+      // Pixels beyond the valid radius are mapped onto its border.
+      const float r = std::sqrt(x_u * x_u + y_u * y_u);
+      if (r > max_radius_) {
+        x_u *= max_radius_ / r;
+        y_u *= max_radius_ / r;
+      }
+      *x = x_u;
+      *y = y_u;
+      return;
+    }
+    case DistortionModel::kEquidistant: {
+      // Newton iteration on the incidence angle.
+      const float theta_d = std::sqrt(x_d * x_d + y_d * y_d);
+      if (theta_d < 1e-8f) {
+        break;
+      }
+      float theta = theta_d;
+      for (int i = 0; i < config_.undistortion_iterations; ++i) {
+        const float theta2 = theta * theta;
+        const float theta4 = theta2 * theta2;
+        const float theta6 = theta4 * theta2;
+        const float theta8 = theta4 * theta4;
+        const float f = theta * (1.f + k_[0] * theta2 + k_[1] * theta4 +
+                                 k_[2] * theta6 + k_[3] * theta8) -
+                        theta_d;
+        const float df = 1.f + 3.f * k_[0] * theta2 + 5.f * k_[1] * theta4 +
+                         7.f * k_[2] * theta6 + 9.f * k_[3] * theta8;
+        // Keep theta in the valid range, tan(theta) diverges at pi / 2.
+        theta = std::min(std::max(theta - f / df, 0.f), max_theta_);
+      }
+      const float scale = std::tan(theta) / theta_d;
+      *x = x_d * scale;
+      *y = y_d * scale;
+      return;
+    }
+    default:
+      break;
+  }
+  *x = x_d;
+  *y = y_d;
+}
+
+void Camera::computeDistortionLimits() {
+  // Scan for the first radius or angle where the derivative of the radial
+  // distortion is no longer positive.
+  constexpr float kStep = 1e-3f;
+  constexpr float kMaxTheta = M_PI / 2.f - 1e-3f;
+  max_radius_ = std::numeric_limits<float>::max();
+  max_theta_ = kMaxTheta;
+  if (distortion_model_ == DistortionModel::kRadTan) {
+    // d/dr r * (1 + k1 r^2 + k2 r^4 + k3 r^6), scanned up to 89 degrees.
+    const float max_radius = std::tan(kMaxTheta);
+    for (float r = 0.f; r < max_radius; r += kStep) {
+      const float r2 = r * r;
+      if (1.f + r2 * (3.f * k_[0] + r2 * (5.f * k_[1] + r2 * 7.f * k_[4])) <=
+          0.f) {
+        max_radius_ = r;
+        break;
+      }
+    }
+  } else if (distortion_model_ == DistortionModel::kEquidistant) {
+    // d/dtheta theta * (1 + k1 theta^2 + k2 theta^4 + k3 theta^6 + ...).
+    for (float theta = 0.f; theta < kMaxTheta; theta += kStep) {
+      const float theta2 = theta * theta;
+      if (1.f + theta2 * (3.f * k_[0] +
+                          theta2 * (5.f * k_[1] +
+                                    theta2 * (7.f * k_[2] +
+                                              theta2 * 9.f * k_[3]))) <=
+          0.f) {
+        max_theta_ = theta;
+        break;
+      }
+    }
+  }
+}
+
+void Camera::computeRayTable() {
+  ray_table_ = cv::Mat(config_.height, config_.width, CV_32FC2);
+  const float fx_inv = 1.f / config_.fx;
+  const float fy_inv = 1.f / config_.fy;
+  for (int v = 0; v < config_.height; ++v) {
+    cv::Vec2f* row = ray_table_.ptr<cv::Vec2f>(v);
+    for (int u = 0; u < config_.width; ++u) {
+      undistort((static_cast<float>(u) - config_.vx) * fx_inv,
+                (static_cast<float>(v) - config_.vy) * fy_inv, &row[u][0],
+                &row[u][1]);
+    }
+  }
+}
+
+void Camera::computeViewFrustum() {
+  // Find the extent of the undistorted image borders in normalized
+  // coordinates. For distorted images the borders are curved so the resulting
+  // frustum is a conservative bound.
+  float x_min = std::numeric_limits<float>::max();
+  float x_max = std::numeric_limits<float>::lowest();
+  float y_min = std::numeric_limits<float>::max();
+  float y_max = std::numeric_limits<float>::lowest();
+  const auto add_border_point = [&](float u, float v) {
+    float x, y;
+    undistort((u - config_.vx) / config_.fx, (v - config_.vy) / config_.fy, &x,
+              &y);
+    x_min = std::min(x_min, x);
+    x_max = std::max(x_max, x);
+    y_min = std::min(y_min, y);
+    y_max = std::max(y_max, y);
+  };
+  for (int u = 0; u <= config_.width; ++u) {
+    add_border_point(u, 0.f);
+    add_border_point(u, config_.height);
+  }
+  for (int v = 0; v <= config_.height; ++v) {
+    add_border_point(0.f, v);
+    add_border_point(config_.width, v);
+  }
+
   // Pre-compute the view frustum (top, right, bottom, left, plane normals).
-  const float scale_factor = config_.fy / config_.fx;
-  Eigen::Vector3f p1(-config_.vx, -config_.vy * scale_factor, config_.fx);
-  Eigen::Vector3f p2(config_.width - config_.vx, -config_.vy * scale_factor,
-                     config_.fx);
-  Eigen::Vector3f normal = p1.cross(p2);
-  view_frustum_.push_back(normal.normalized());
-  p1 =
-      Eigen::Vector3f(config_.width - config_.vx,
-                      (config_.height - config_.vy) * scale_factor, config_.fx);
-  normal = p2.cross(p1);
-  view_frustum_.push_back(normal.normalized());
-  p2 = Eigen::Vector3f(
-      -config_.vx, (config_.height - config_.vy) * scale_factor, config_.fx);
-  normal = p1.cross(p2);
-  view_frustum_.push_back(normal.normalized());
-  p1 = Eigen::Vector3f(-config_.vx, -config_.vy * scale_factor, config_.fx);
-  normal = p2.cross(p1);
-  view_frustum_.push_back(normal.normalized());
+  const Eigen::Vector3f top_left(x_min, y_min, 1.f);
+  const Eigen::Vector3f top_right(x_max, y_min, 1.f);
+  const Eigen::Vector3f bottom_right(x_max, y_max, 1.f);
+  const Eigen::Vector3f bottom_left(x_min, y_max, 1.f);
+  view_frustum_.clear();
+  view_frustum_.push_back(top_left.cross(top_right).normalized());
+  view_frustum_.push_back(top_right.cross(bottom_right).normalized());
+  view_frustum_.push_back(bottom_right.cross(bottom_left).normalized());
+  view_frustum_.push_back(bottom_left.cross(top_left).normalized());
 }
 
 bool Camera::pointIsInViewFrustum(const Point& point_C,
@@ -79,6 +331,48 @@ bool Camera::submapIsInViewFrustum(const Submap& submap,
   return pointIsInViewFrustum(center_C, radius);
 }
 
+bool Camera::submapIsOccluded(const Submap& submap,
+                              const Transformation& T_M_C,
+                              const MaxDepthPyramid& max_depths,
+                              float depth_margin) const {
+  // The corners of a box only bound its projection without distortion.
+  if (distortion_model_ != DistortionModel::kPinhole) {
+    return false;
+  }
+  const float radius = submap.getBoundingVolume().getRadius();
+  const Point center_C = T_M_C.inverse() * submap.getT_M_S() *
+                         submap.getBoundingVolume().getCenter();
+  const float min_depth = center_C.z() - radius;
+  if (min_depth <= 0.f) {
+    return false;
+  }
+
+  // Screen-space bounds of the box around the bounding sphere.
+  float u_min = std::numeric_limits<float>::max();
+  float v_min = std::numeric_limits<float>::max();
+  float u_max = std::numeric_limits<float>::lowest();
+  float v_max = std::numeric_limits<float>::lowest();
+  for (int corner = 0; corner < 8; ++corner) {
+    const float x = center_C.x() + (corner & 1 ? radius : -radius);
+    const float y = center_C.y() + (corner & 2 ? radius : -radius);
+    const float z = center_C.z() + (corner & 4 ? radius : -radius);
+    const float u = x * config_.fx / z + config_.vx;
+    const float v = y * config_.fy / z + config_.vy;
+    u_min = std::min(u_min, u);
+    v_min = std::min(v_min, v);
+    u_max = std::max(u_max, u);
+    v_max = std::max(v_max, v);
+  }
+
+  // Interpolation can read one pixel beyond the projection.
+  const float max_depth = max_depths.maxDepth(
+      static_cast<int>(std::floor(std::max(u_min, -1.f))) - 1,
+      static_cast<int>(std::floor(std::max(v_min, -1.f))) - 1,
+      static_cast<int>(std::ceil(std::min(u_max, config_.width + 1.f))) + 1,
+      static_cast<int>(std::ceil(std::min(v_max, config_.height + 1.f))) + 1);
+  return min_depth > max_depth + depth_margin;
+}
+
 bool Camera::blockIsInViewFrustum(const Submap& submap,
                                   const voxblox::BlockIndex& block_index,
                                   const Transformation& T_M_C) const {
@@ -106,12 +400,22 @@ bool Camera::projectPointToImagePlane(const Point& p_C, float* u,
   // All values are ceiled and floored to guarantee that the resulting points
   // will be valid for any integer conversion.
   CHECK_NOTNULL(u);
-  *u = p_C.x() * config_.fx / p_C.z() + config_.vx;
+  CHECK_NOTNULL(v);
+  if (distortion_model_ == DistortionModel::kPinhole) {
+    *u = p_C.x() * config_.fx / p_C.z() + config_.vx;
+    *v = p_C.y() * config_.fy / p_C.z() + config_.vy;
+  } else {
+    float x_d, y_d;
+    if (p_C.z() <= 0.f ||
+        !distort(p_C.x() / p_C.z(), p_C.y() / p_C.z(), &x_d, &y_d)) {
+      return false;
+    }
+    *u = x_d * config_.fx + config_.vx;
+    *v = y_d * config_.fy + config_.vy;
+  }
   if (std::ceil(*u) >= config_.width || std::floor(*u) < 0) {
     return false;
   }
-  CHECK_NOTNULL(v);
-  *v = p_C.y() * config_.fy / p_C.z() + config_.vy;
   if (std::ceil(*v) >= config_.height || std::floor(*v) < 0) {
     return false;
   }
@@ -120,12 +424,22 @@ bool Camera::projectPointToImagePlane(const Point& p_C, float* u,
 
 bool Camera::projectPointToImagePlane(const Point& p_C, int* u, int* v) const {
   CHECK_NOTNULL(u);
-  *u = std::round(p_C.x() * config_.fx / p_C.z() + config_.vx);
+  CHECK_NOTNULL(v);
+  if (distortion_model_ == DistortionModel::kPinhole) {
+    *u = std::round(p_C.x() * config_.fx / p_C.z() + config_.vx);
+    *v = std::round(p_C.y() * config_.fy / p_C.z() + config_.vy);
+  } else {
+    float x_d, y_d;
+    if (p_C.z() <= 0.f ||
+        !distort(p_C.x() / p_C.z(), p_C.y() / p_C.z(), &x_d, &y_d)) {
+      return false;
+    }
+    *u = std::round(x_d * config_.fx + config_.vx);
+    *v = std::round(y_d * config_.fy + config_.vy);
+  }
   if (*u >= config_.width || *u < 0) {
     return false;
   }
-  CHECK_NOTNULL(v);
-  *v = std::round(p_C.y() * config_.fy / p_C.z() + config_.vy);
   if (*v >= config_.height || *v < 0) {
     return false;
   }
@@ -200,33 +514,38 @@ std::unordered_map<int, voxblox::BlockIndexList> Camera::findVisibleBlocks(
   return result;
 }
 
-cv::Mat Camera::computeVertexMap(const cv::Mat& depth_image) const {
-  // Compute the 3D pointcloud from a depth image.
+cv::Mat Camera::computeVertexMap(const cv::Mat& depth_image,
+                                 float depth_scale) const {
+  // Compute the 3D pointcloud from a depth image using the pre-computed
+  // (undistorted) pixel rays.
+  CHECK_EQ(depth_image.rows, ray_table_.rows);
+  CHECK_EQ(depth_image.cols, ray_table_.cols);
   cv::Mat vertices(depth_image.size(), CV_32FC3);
-  const float fx_inv = 1.f / config_.fx;
-  const float fy_inv = 1.f / config_.fy;
-  for (int v = 0; v < depth_image.rows; v++) {
-    for (int u = 0; u < depth_image.cols; u++) {
-      cv::Vec3f& vertex = vertices.at<cv::Vec3f>(v, u);  // x, y, z
-      vertex[2] = depth_image.at<float>(v, u);
-      if (!std::isfinite(vertex[2])) vertex[2] = 0.0; // this will be filtered via min_range constraint
-      vertex[0] = (static_cast<float>(u) - config_.vx) * vertex[2] * fx_inv;
-      vertex[1] = (static_cast<float>(v) - config_.vy) * vertex[2] * fy_inv;
-    }
+  if (depth_image.type() == CV_16UC1) {
+    computeVertexMapImpl<uint16_t>(depth_image, depth_scale, ray_table_,
+                                   &vertices);
+  } else {
+    CHECK_EQ(depth_image.type(), CV_32FC1);
+    computeVertexMapImpl<float>(depth_image, depth_scale, ray_table_,
+                                &vertices);
   }
   return vertices;
 }
 
-cv::Mat Camera::computeValidityImage(const cv::Mat& depth_image) const {
+cv::Mat Camera::computeValidityImage(const cv::Mat& depth_image,
+                                     float depth_scale) const {
   // Check whether the depth image is valid. Currently just checks for min and
   // max range.
   cv::Mat validity_image(depth_image.size(), CV_8UC1);
-  for (int v = 0; v < depth_image.rows; v++) {
-    for (int u = 0; u < depth_image.cols; u++) {
-      float depth = depth_image.at<float>(v, u);
-      validity_image.at<uchar>(v, u) = static_cast<uchar>(
-          depth >= config_.min_range && depth <= config_.max_range);
-    }
+  if (depth_image.type() == CV_16UC1) {
+    computeValidityImageImpl<uint16_t>(depth_image, depth_scale,
+                                       config_.min_range, config_.max_range,
+                                       &validity_image);
+  } else {
+    CHECK_EQ(depth_image.type(), CV_32FC1);
+    computeValidityImageImpl<float>(depth_image, depth_scale,
+                                    config_.min_range, config_.max_range,
+                                    &validity_image);
   }
   return validity_image;
 }
@@ -0,0 +1,89 @@
+#include "panoptic_mapping/common/max_depth_pyramid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace panoptic_mapping {
+
+void MaxDepthPyramid::compute(const cv::Mat& depth_image, float depth_scale) {
+  CHECK(depth_image.type() == CV_32FC1 || depth_image.type() == CV_16UC1)
+      << "Depth images are expected to be CV_32FC1 or CV_16UC1.";
+  levels_.clear();
+  if (depth_image.empty()) {
+    return;
+  }
+
+  // Finest level. Missing measurements could hide anything.
+  constexpr float kInfinity = std::numeric_limits<float>::infinity();
+  // 16-bit depth is converted to meters here.
+  levels_.emplace_back(depth_image.rows, depth_image.cols, CV_32FC1);
+  for (int v = 0; v < depth_image.rows; ++v) {
+    float* target = levels_.back().ptr<float>(v);
+    if (depth_image.type() == CV_16UC1) {
+      const uint16_t* source = depth_image.ptr<uint16_t>(v);
+      for (int u = 0; u < depth_image.cols; ++u) {
+        target[u] = source[u] > 0 ? source[u] * depth_scale : kInfinity;
+      }
+      continue;
+    }
+    const float* source = depth_image.ptr<float>(v);
+    for (int u = 0; u < depth_image.cols; ++u) {
+      target[u] = std::isfinite(source[u]) && source[u] > 0.f ? source[u]
+                                                               : kInfinity;
+    }
+  }
+
+  // Coarser levels, odd sizes are rounded up.
+  while (levels_.back().rows > 1 || levels_.back().cols > 1) {
+    const cv::Mat& fine = levels_.back();
+    cv::Mat coarse((fine.rows + 1) / 2, (fine.cols + 1) / 2, CV_32FC1);
+    for (int v = 0; v < coarse.rows; ++v) {
+      const float* row_0 = fine.ptr<float>(2 * v);
+      const float* row_1 = fine.ptr<float>(std::min(2 * v + 1, fine.rows - 1));
+      float* target = coarse.ptr<float>(v);
+      for (int u = 0; u < coarse.cols; ++u) {
+        const int u_1 = std::min(2 * u + 1, fine.cols - 1);
+        target[u] = std::max(std::max(row_0[2 * u], row_0[u_1]),
+                             std::max(row_1[2 * u], row_1[u_1]));
+      }
+    }
+    levels_.emplace_back(std::move(coarse));
+  }
+}
+
+float MaxDepthPyramid::maxDepth(int u_min, int v_min, int u_max,
+                                int v_max) const {
+  if (levels_.empty()) {
+    return std::numeric_limits<float>::infinity();
+  }
+  u_min = std::max(u_min, 0);
+  v_min = std::max(v_min, 0);
+  u_max = std::min(u_max, levels_.front().cols - 1);
+  v_max = std::min(v_max, levels_.front().rows - 1);
+  if (u_min > u_max || v_min > v_max) {
+    return std::numeric_limits<float>::infinity();
+  }
+
+  // Find the finest level where the rectangle covers at most 2x2 pixels.
+  size_t level = 0;
+  while (level + 1 < levels_.size() &&
+         ((u_max >> level) - (u_min >> level) > 1 ||
+          (v_max >> level) - (v_min >> level) > 1)) {
+    ++level;
+  }
+  const cv::Mat& image = levels_[level];
+  float result = 0.f;
+  for (int v = v_min >> level; v <= (v_max >> level); ++v) {
+    for (int u = u_min >> level; u <= (u_max >> level); ++u) {
+      result = std::max(result, image.at<float>(v, u));
+    }
+  }
+  return result;
+}
+
+}  // namespace panoptic_mapping
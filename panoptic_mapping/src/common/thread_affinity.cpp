@@ -0,0 +1,199 @@
+#include "panoptic_mapping/common/thread_affinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace panoptic_mapping {
+
+void ThreadAffinity::Config::checkParams() const {
+  checkParamCond(worker_pinning == "none" || worker_pinning == "node" ||
+                     worker_pinning == "core",
+                 "'worker_pinning' must be one of {none, node, core}.");
+  for (int core : reserved_cores) {
+    checkParamGE(core, 0, "reserved_cores");
+  }
+}
+
+void ThreadAffinity::Config::setupParamsAndPrinting() {
+  setupParam("verbosity", &verbosity);
+  setupParam("worker_pinning", &worker_pinning);
+  setupParam("numa_aware_submaps", &numa_aware_submaps);
+  setupParam("reserved_cores", &reserved_cores);
+}
+
+void ThreadAffinity::configure(const Config& config) {
+  const Config checked_config = config.checkValid();
+  LOG_IF(INFO, checked_config.verbosity >= 1) << "\n"
+                                              << checked_config.toString();
+  State& placement = state();
+  placement = State();
+  if (checked_config.worker_pinning == "node") {
+    placement.pinning = Pinning::kNode;
+  } else if (checked_config.worker_pinning == "core") {
+    placement.pinning = Pinning::kCore;
+  } else if (!checked_config.reserved_cores.empty()) {
+    // Workers still need to leave the reserved cores.
+    placement.pinning = Pinning::kNode;
+  }
+
+  // Find the CPUs of each node that can run workers.
+  const std::unordered_set<int> reserved(checked_config.reserved_cores.begin(),
+                                         checked_config.reserved_cores.end());
+  for (std::vector<int>& cpus : readNodeCpus()) {
+    cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                              [&reserved](int cpu) {
+                                return reserved.find(cpu) != reserved.end();
+                              }),
+               cpus.end());
+    if (!cpus.empty()) {
+      placement.node_cpus.emplace_back(std::move(cpus));
+    }
+  }
+  if (placement.node_cpus.empty()) {
+    LOG(WARNING) << "No CPUs are left for the workers, threads are not pinned.";
+    placement.pinning = Pinning::kNone;
+    return;
+  }
+  placement.numa_aware = checked_config.worker_pinning != "none" &&
+                         checked_config.numa_aware_submaps &&
+                         placement.node_cpus.size() > 1;
+  if (!placement.numa_aware) {
+    // Treat all CPUs as a single node.
+    std::vector<int> all_cpus;
+    for (const std::vector<int>& cpus : placement.node_cpus) {
+      all_cpus.insert(all_cpus.end(), cpus.begin(), cpus.end());
+    }
+    std::sort(all_cpus.begin(), all_cpus.end());
+    placement.node_cpus = {all_cpus};
+  }
+
+  placement.reserved_cpus = checked_config.reserved_cores;
+  LOG_IF(INFO, checked_config.verbosity >= 1 &&
+                   placement.pinning != Pinning::kNone)
+      << "Pinning workers to " << placement.node_cpus.size() << " node(s)"
+      << (placement.numa_aware ? " with NUMA-aware submap placement." : ".");
+}
+
+void ThreadAffinity::pinToReservedCores() {
+  const State& placement = state();
+  if (placement.reserved_cpus.empty()) {
+    return;
+  }
+  if (!setAffinity(placement.reserved_cpus)) {
+    LOG(WARNING) << "Could not pin the calling thread to the reserved cores.";
+  }
+}
+
+void ThreadAffinity::pinWorkerThread(int worker_index) {
+  const State& placement = state();
+  if (placement.pinning == Pinning::kNone) {
+    return;
+  }
+  const std::vector<int>& cpus = placement.node_cpus[workerNode(worker_index)];
+  if (placement.pinning == Pinning::kNode) {
+    setAffinity(cpus);
+  } else {
+    const int index_in_node = worker_index / placement.node_cpus.size();
+    setAffinity({cpus[index_in_node % cpus.size()]});
+  }
+}
+
+int ThreadAffinity::numNodes() {
+  const State& placement = state();
+  return placement.numa_aware ? placement.node_cpus.size() : 1;
+}
+
+int ThreadAffinity::workerNode(int worker_index) {
+  return worker_index % numNodes();
+}
+
+int ThreadAffinity::submapNode(int submap_id) {
+  const int num_nodes = numNodes();
+  return (submap_id % num_nodes + num_nodes) % num_nodes;
+}
+
+std::vector<std::vector<int>> ThreadAffinity::readNodeCpus() {
+  // Only consider the CPUs this process may run on.
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return {};
+  }
+  const auto filter_allowed = [&allowed](std::vector<int> cpus) {
+    cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                              [&allowed](int cpu) {
+                                return cpu >= CPU_SETSIZE ||
+                                       !CPU_ISSET(cpu, &allowed);
+                              }),
+               cpus.end());
+    return cpus;
+  };
+
+  // Node IDs can be sparse.
+  std::vector<std::vector<int>> result;
+  constexpr int kMaxNodes = 256;
+  for (int node = 0; node < kMaxNodes; ++node) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) +
+                       "/cpulist");
+    std::string cpu_list;
+    if (!file.is_open() || !std::getline(file, cpu_list)) {
+      continue;
+    }
+    std::vector<int> cpus = filter_allowed(parseCpuList(cpu_list));
+    if (!cpus.empty()) {
+      result.emplace_back(std::move(cpus));
+    }
+  }
+
+  // Machines without NUMA information are a single node.
+  if (result.empty()) {
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      cpus.push_back(cpu);
+    }
+    result.emplace_back(filter_allowed(cpus));
+  }
+  return result;
+}
+
+std::vector<int> ThreadAffinity::parseCpuList(const std::string& cpu_list) {
+  // Format: comma separated CPUs or inclusive ranges, e.g. "0-3,8,10-11".
+  std::vector<int> result;
+  std::stringstream stream(cpu_list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    const size_t dash = range.find('-');
+    const int first = std::stoi(range.substr(0, dash));
+    const int last =
+        dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu) {
+      result.push_back(cpu);
+    }
+  }
+  return result;
+}
+
+bool ThreadAffinity::setAffinity(const std::vector<int>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) ==
+         0;
+}
+
+}  // namespace panoptic_mapping
@@ -67,50 +67,58 @@ void ClassProjectiveIntegrator::processInput(SubmapCollection* submaps,
 void ClassProjectiveIntegrator::updateBlock(
     Submap* submap, InterpolatorBase* interpolator,
     const voxblox::BlockIndex& block_index, const Transformation& T_C_S,
-    const InputData& input) const {
+    float max_carving_distance, const InputData& input) const {
   CHECK_NOTNULL(submap);
   // Set up preliminaries.
-  if (!submap->getTsdfLayer().hasBlock(block_index)) {
+  const Submap::BlockRecord blocks = submap->getBlocks(block_index);
+  if (!blocks) {
     LOG_IF(WARNING, config_.verbosity >= 1)
         << "Tried to access inexistent block '" << block_index.transpose()
         << "' in submap " << submap->getID() << ".";
     return;
   }
-  TsdfBlock& block = submap->getTsdfLayerPtr()->getBlockByIndex(block_index);
+  TsdfBlock& block = *blocks.tsdf;
   const float voxel_size = block.voxel_size();
   const float truncation_distance = submap->getConfig().truncation_distance;
   const int submap_id = submap->getID();
   const bool is_free_space_submap =
       submap->getLabel() == PanopticLabel::kFreeSpace;
-  bool was_updated = false;
+  size_t num_updated = 0;
 
-  // Allocate the class block if not yet existent and get it.
+  // Allocate the class block if not yet existent. The class updates are
+  // collected and applied to the block in a single batch.
+  ClassLayer* class_layer = nullptr;
   ClassBlock::Ptr class_block;
   if (submap->hasClassLayer() &&
       (!config_.update_only_tracked_submaps || submap->wasTracked())) {
-    class_block =
-        submap->getClassLayerPtr()->allocateBlockPtrByIndex(block_index);
+    class_layer = submap->getClassLayerPtr().get();
+    class_block = blocks.classification;
+    if (!class_block) {
+      class_block = class_layer->allocateBlockPtrByIndex(block_index);
+    }
   }
+  thread_local ClassCountUpdates class_updates;
+  class_updates.clear();
 
   // Update all voxels.
   for (size_t i = 0; i < block.num_voxels(); ++i) {
     TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
     const Point p_C = T_C_S * block.computeCoordinatesFromLinearIndex(
                                   i);  // Voxel center in camera frame.
-    ClassVoxel* class_voxel = nullptr;
-
-    if (class_block) {
-      class_voxel = &class_block->getVoxelByLinearIndex(i);
-    }
-
-    if (updateVoxel(interpolator, &voxel, p_C, input, submap_id,
-                    is_free_space_submap, truncation_distance, voxel_size,
-                    class_voxel)) {
-      was_updated = true;
+    if (integrateVoxel(interpolator, &voxel, p_C, input, submap_id,
+                       is_free_space_submap, truncation_distance,
+                       max_carving_distance, voxel_size,
+                       class_layer ? &class_updates : nullptr, i)) {
+      num_updated++;
     }
   }
-  if (was_updated) {
+  if (!class_updates.empty()) {
+    class_layer->incrementCounts(class_block.get(), class_updates);
+  }
+  num_updated_voxels_ += num_updated;
+  if (num_updated > 0) {
     block.setUpdatedAll();
+    submap->markBlockUpdated(block_index);
   }
 }
 
@@ -118,14 +126,32 @@ bool ClassProjectiveIntegrator::updateVoxel(
     InterpolatorBase* interpolator, TsdfVoxel* voxel, const Point& p_C,
     const InputData& input, const int submap_id,
     const bool is_free_space_submap, const float truncation_distance,
-    const float voxel_size, ClassVoxel* class_voxel,
-    ScoreVoxel* score_voxel) const {
+    const float max_carving_distance, const float voxel_size,
+    ClassVoxel* class_voxel, ScoreVoxel* score_voxel) const {
+  // Single voxel update, the class count is applied directly.
+  ClassCountUpdates class_update;
+  const bool was_updated = integrateVoxel(
+      interpolator, voxel, p_C, input, submap_id, is_free_space_submap,
+      truncation_distance, max_carving_distance, voxel_size,
+      class_voxel ? &class_update : nullptr, 0);
+  if (!class_update.empty()) {
+    class_voxel->incrementCount(class_update.ids[0]);
+  }
+  return was_updated;
+}
+
+bool ClassProjectiveIntegrator::integrateVoxel(
+    InterpolatorBase* interpolator, TsdfVoxel* voxel, const Point& p_C,
+    const InputData& input, const int submap_id,
+    const bool is_free_space_submap, const float truncation_distance,
+    const float max_carving_distance, const float voxel_size,
+    ClassCountUpdates* class_updates, const size_t voxel_index) const {
   // Compute the signed distance. This also sets up the interpolator.
   float sdf;
   if (!computeSignedDistance(p_C, interpolator, &sdf)) {
     return false;
   }
-  if (sdf < -truncation_distance) {
+  if (sdf < -truncation_distance || sdf > max_carving_distance) {
     return false;
   }
 
@@ -142,46 +168,39 @@ bool ClassProjectiveIntegrator::updateVoxel(
     const Color color = interpolator->interpolateColor(input.colorImage());
     updateVoxelValues(voxel, sdf, weight, &color);
 
-    // Update the class voxel.
-    if (class_voxel) {
-      updateClassVoxel(interpolator, class_voxel, input, submap_id);
+    // Record the class update.
+    if (class_updates) {
+      class_updates->add(voxel_index,
+                         computeClassID(interpolator, input, submap_id));
     }
   }
   return true;
 }
 
-void ClassProjectiveIntegrator::updateClassVoxel(InterpolatorBase* interpolator,
-                                                 ClassVoxel* voxel,
-                                                 const InputData& input,
-                                                 const int submap_id) const {
+int ClassProjectiveIntegrator::computeClassID(InterpolatorBase* interpolator,
+                                              const InputData& input,
+                                              const int submap_id) const {
   if (config_.use_binary_classification) {
     // Use ID 0 for belongs, 1 for does not belong.
     if (config_.use_instance_classification) {
       // Just count how often the assignments were right.
-      voxel->incrementCount(
-          1 - static_cast<int>(interpolator->interpolateID(input.idImage()) ==
-                               submap_id));
-    } else {
-      // Only the class needs to match.
-      auto it = id_to_class_.find(submap_id);
-      auto it2 =
-          id_to_class_.find(interpolator->interpolateID(input.idImage()));
-      if (it != id_to_class_.end() && it2 != id_to_class_.end()) {
-        voxel->incrementCount(1 - static_cast<int>(it->second == it2->second));
-      } else {
-        voxel->incrementCount(1);
-      }
+      return 1 - static_cast<int>(
+                     interpolator->interpolateID(input.idImage()) == submap_id);
     }
-  } else {
-    if (config_.use_instance_classification) {
-      voxel->incrementCount(interpolator->interpolateID(input.idImage()));
-    } else {
-      // NOTE(schmluk): id_to_class should always exist since it's created based
-      // on the input.
-      voxel->incrementCount(
-          id_to_class_.at(interpolator->interpolateID(input.idImage())));
+    // Only the class needs to match.
+    auto it = id_to_class_.find(submap_id);
+    auto it2 = id_to_class_.find(interpolator->interpolateID(input.idImage()));
+    if (it != id_to_class_.end() && it2 != id_to_class_.end()) {
+      return 1 - static_cast<int>(it->second == it2->second);
     }
+    return 1;
+  }
+  if (config_.use_instance_classification) {
+    return interpolator->interpolateID(input.idImage());
   }
+  // NOTE(schmluk): id_to_class should always exist since it's created based
+  // on the input.
+  return id_to_class_.at(interpolator->interpolateID(input.idImage()));
 }
 
 }  // namespace panoptic_mapping
@@ -1,8 +1,11 @@
 #include "panoptic_mapping/integration/projection_interpolators.h"
 
+#include <algorithm>
 #include <cmath>
+#include <future>
 #include <limits>
 #include <unordered_map>
+#include <vector>
 
 namespace panoptic_mapping {
 
@@ -13,6 +16,62 @@ config_utilities::Factory::Registration<InterpolatorBase, InterpolatorBilinear>
 config_utilities::Factory::Registration<InterpolatorBase, InterpolatorAdaptive>
     InterpolatorAdaptive::registration_("adaptive");
 
+void DepthDiscontinuityMask::compute(const Eigen::MatrixXf& range_image,
+                                     float max_depth_difference,
+                                     int num_threads) {
+  const int rows = range_image.rows();
+  const int cols = range_image.cols();
+  mask_.setZero(rows, cols);
+  if (rows < 2 || cols < 2) {
+    return;
+  }
+
+  // Each thread processes a contiguous range of columns. Since the images are
+  // column major, the min / max of vertically adjacent pixels is computed on
+  // contiguous memory and can be vectorized by Eigen.
+  const auto compute_columns = [&](int col_start, int col_end) {
+    Eigen::ArrayXf min_left =
+        range_image.col(col_start).head(rows - 1).array().min(
+            range_image.col(col_start).tail(rows - 1).array());
+    Eigen::ArrayXf max_left =
+        range_image.col(col_start).head(rows - 1).array().max(
+            range_image.col(col_start).tail(rows - 1).array());
+    Eigen::ArrayXf min_right(rows - 1);
+    Eigen::ArrayXf max_right(rows - 1);
+    for (int u = col_start; u < col_end; ++u) {
+      min_right = range_image.col(u + 1).head(rows - 1).array().min(
+          range_image.col(u + 1).tail(rows - 1).array());
+      max_right = range_image.col(u + 1).head(rows - 1).array().max(
+          range_image.col(u + 1).tail(rows - 1).array());
+      mask_.col(u).head(rows - 1) =
+          (max_left.max(max_right) - min_left.min(min_right) >
+           max_depth_difference)
+              .cast<uint8_t>()
+              .matrix();
+      min_left.swap(min_right);
+      max_left.swap(max_right);
+    }
+  };
+
+  const int num_quad_cols = cols - 1;
+  num_threads = std::max(1, std::min(num_threads, num_quad_cols));
+  const int cols_per_thread =
+      (num_quad_cols + num_threads - 1) / num_threads;
+  std::vector<std::future<void>> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    const int col_start = i * cols_per_thread;
+    const int col_end = std::min(col_start + cols_per_thread, num_quad_cols);
+    if (col_start >= col_end) {
+      break;
+    }
+    threads.emplace_back(std::async(std::launch::async, compute_columns,
+                                    col_start, col_end));
+  }
+  for (auto& thread : threads) {
+    thread.get();
+  }
+}
+
 void InterpolatorNearest::computeWeights(float u, float v,
                                          const Eigen::MatrixXf& range_image) {
   u_ = std::round(u);
@@ -107,29 +166,28 @@ int InterpolatorBilinear::interpolateID(const cv::Mat& id_image) {
 
 void InterpolatorAdaptive::computeWeights(float u, float v,
                                           const Eigen::MatrixXf& range_image) {
-  // NOTE(schmluk): This is currently a compile-time value. Could make this a
-  // param or similar.
-  constexpr float max_depth_difference = 0.2;  // m
   u_ = std::floor(u);
   v_ = std::floor(v);
 
-  // Check max depth difference.
-  float min = std::numeric_limits<float>::max();
-  float max = std::numeric_limits<float>::lowest();
-  for (size_t i = 0; i < 4; ++i) {
-    const float depth = range_image(v_ + v_offset_[i], u_ + u_offset_[i]);
-    if (depth > max) {
-      max = depth;
-    }
-    if (depth < min) {
-      min = depth;
-    }
-    if (max - min > max_depth_difference) {
-      use_bilinear_ = false;
-      u_ = std::round(u);
-      v_ = std::round(v);
-      return;
+  // Check max depth difference, preferably from the precomputed mask.
+  bool is_discontinuous = false;
+  if (discontinuity_mask_) {
+    is_discontinuous = discontinuity_mask_->isDiscontinuous(u_, v_);
+  } else {
+    float min = std::numeric_limits<float>::max();
+    float max = std::numeric_limits<float>::lowest();
+    for (size_t i = 0; i < 4; ++i) {
+      const float depth = range_image(v_ + v_offset_[i], u_ + u_offset_[i]);
+      min = std::min(min, depth);
+      max = std::max(max, depth);
     }
+    is_discontinuous = max - min > kDefaultMaxDepthDifference_;
+  }
+  if (is_discontinuous) {
+    use_bilinear_ = false;
+    u_ = std::round(u);
+    v_ = std::round(v);
+    return;
   }
   use_bilinear_ = true;
   InterpolatorBilinear::computeWeights(u, v, range_image);
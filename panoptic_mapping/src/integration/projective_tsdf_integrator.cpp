@@ -2,8 +2,11 @@
 
 #include <algorithm>
 #include <chrono>
+#include <functional>
 #include <future>
+#include <limits>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -12,6 +15,7 @@
 #include <voxblox/integrator/merge_integration.h>
 
 #include "panoptic_mapping/common/index_getter.h"
+#include "panoptic_mapping/common/thread_affinity.h"
 
 namespace panoptic_mapping {
 
@@ -22,6 +26,8 @@ config_utilities::Factory::RegistrationRos<
 void ProjectiveIntegrator::Config::checkParams() const {
   checkParamGT(integration_threads, 0, "integration_threads");
   checkParamGT(max_weight, 0.f, "max_weight");
+  checkParamGT(interpolation_max_depth_difference, 0.f,
+               "interpolation_max_depth_difference");
   if (use_weight_dropoff) {
     checkParamNE(weight_dropoff_epsilon, 0.f, "weight_dropoff_epsilon");
   }
@@ -35,9 +41,14 @@ void ProjectiveIntegrator::Config::setupParamsAndPrinting() {
   setupParam("foreign_rays_clear", &foreign_rays_clear);
   setupParam("max_weight", &max_weight);
   setupParam("interpolation_method", &interpolation_method);
+  setupParam("interpolation_max_depth_difference",
+             &interpolation_max_depth_difference, "m");
   setupParam("allocate_neighboring_blocks", &allocate_neighboring_blocks);
   setupParam("use_longterm_fusion", &use_longterm_fusion);
   setupParam("integration_threads", &integration_threads);
+  setupParam("use_occlusion_culling", &use_occlusion_culling);
+  setupParam("max_carving_voxels", &max_carving_voxels);
+  setupParam("class_max_carving_voxels", &class_max_carving_voxels);
 }
 
 ProjectiveIntegrator::ProjectiveIntegrator(const Config& config,
@@ -51,19 +62,57 @@ ProjectiveIntegrator::ProjectiveIntegrator(const Config& config,
       {InputData::InputType::kColorImage, InputData::InputType::kDepthImage,
        InputData::InputType::kSegmentationImage,
        InputData::InputType::kVertexMap, InputData::InputType::kValidityImage});
+  if (config_.use_occlusion_culling) {
+    addRequiredInput(InputData::InputType::kMaxDepthPyramid);
+  }
 
   // Setup the interpolators (one for each thread).
-  for (int i = 0; i < config_.integration_threads; ++i) {
-    interpolators_.emplace_back(
-        config_utilities::Factory::create<InterpolatorBase>(
-            config_.interpolation_method));
-  }
+  num_threads_ = config_.integration_threads;
+  interpolation_method_ = config_.interpolation_method;
+  setupInterpolators();
 
   // Allocate range image.
   range_image_ = Eigen::MatrixXf(globals_->camera()->getConfig().height,
                                  globals_->camera()->getConfig().width);
 }
 
+void ProjectiveIntegrator::setupInterpolators() {
+  // The adaptive interpolator reads the discontinuity mask that is computed
+  // once per frame.
+  use_discontinuity_mask_ = interpolation_method_ == "adaptive";
+  interpolators_.clear();
+  for (int i = 0; i < num_threads_; ++i) {
+    interpolators_.emplace_back(
+        config_utilities::Factory::create<InterpolatorBase>(
+            interpolation_method_));
+    if (use_discontinuity_mask_) {
+      interpolators_.back()->setDiscontinuityMask(&discontinuity_mask_);
+    }
+  }
+}
+
+void ProjectiveIntegrator::reconfigure(
+    const PerformanceParameters& parameters) {
+  bool changed = false;
+  if (parameters.integration_threads > 0 &&
+      parameters.integration_threads != num_threads_) {
+    num_threads_ = parameters.integration_threads;
+    changed = true;
+  }
+  if (!parameters.interpolation_method.empty() &&
+      parameters.interpolation_method != interpolation_method_) {
+    interpolation_method_ = parameters.interpolation_method;
+    changed = true;
+  }
+  if (!changed) {
+    return;
+  }
+  setupInterpolators();
+  LOG_IF(INFO, config_.verbosity >= 2)
+      << "Reconfigured integration to use " << num_threads_
+      << " threads and '" << interpolation_method_ << "' interpolation.";
+}
+
 void ProjectiveIntegrator::processInput(SubmapCollection* submaps,
                                         InputData* input) {
   CHECK_NOTNULL(submaps);
@@ -76,6 +125,7 @@ void ProjectiveIntegrator::processInput(SubmapCollection* submaps,
   cam_config_ = &(globals_->camera()->getConfig());
   allocateNewBlocks(submaps, *input);
   alloc_timer.Stop();
+  computeDiscontinuityMask();
 
   // Find all active blocks that are in the field of view.
   // Note(schmluk): This could potentially also be included in the parallel part
@@ -84,6 +134,9 @@ void ProjectiveIntegrator::processInput(SubmapCollection* submaps,
   std::unordered_map<int, voxblox::BlockIndexList> block_lists =
       globals_->camera()->findVisibleBlocks(*submaps, input->T_M_C(),
                                             max_range_in_image_, true);
+  if (config_.use_occlusion_culling) {
+    cullOccludedSubmaps(*submaps, *input, &block_lists);
+  }
   std::vector<int> id_list;
   id_list.reserve(block_lists.size());
   for (const auto& id_blocklist_pair : block_lists) {
@@ -93,26 +146,102 @@ void ProjectiveIntegrator::processInput(SubmapCollection* submaps,
 
   // Integrate in parallel.
   Timer int_timer("tsdf_integration/integration");
-  SubmapIndexGetter index_getter(id_list);
+  num_updated_voxels_ = 0;
+  processSubmapsInParallel(
+      id_list, [this, &block_lists, submaps, input](int submap_id, int thread) {
+        this->updateSubmap(submaps->getSubmapPtr(submap_id),
+                           interpolators_[thread].get(),
+                           block_lists.at(submap_id), *input);
+      });
+  int_timer.Stop();
+  LOG_IF(INFO, config_.verbosity >= 3)
+      << "Updated " << num_updated_voxels_ << " voxels in " << id_list.size()
+      << " submaps.";
+}
+
+void ProjectiveIntegrator::processSubmapsInParallel(
+    const std::vector<int>& submap_ids,
+    const std::function<void(int, int)>& function) const {
+  // Each worker first processes the submaps of its own NUMA node, then helps
+  // with the other nodes. Without NUMA-awareness there is a single queue.
+  const int num_nodes = ThreadAffinity::numNodes();
+  std::vector<std::vector<int>> node_submap_ids(num_nodes);
+  for (int submap_id : submap_ids) {
+    node_submap_ids[ThreadAffinity::submapNode(submap_id)].push_back(submap_id);
+  }
+  std::vector<std::unique_ptr<SubmapIndexGetter>> index_getters;
+  for (std::vector<int>& ids : node_submap_ids) {
+    index_getters.emplace_back(
+        std::make_unique<SubmapIndexGetter>(std::move(ids)));
+  }
   std::vector<std::future<void>> threads;
-  for (int i = 0; i < config_.integration_threads; ++i) {
-    threads.emplace_back(
-        std::async(std::launch::async,
-                   [this, &index_getter, &block_lists, submaps, input, i]() {
-                     int index;
-                     while (index_getter.getNextIndex(&index)) {
-                       this->updateSubmap(submaps->getSubmapPtr(index),
-                                          interpolators_[i].get(),
-                                          block_lists.at(index), *input);
-                     }
-                   }));
+  for (int i = 0; i < num_threads_; ++i) {
+    threads.emplace_back(std::async(
+        std::launch::async, [&index_getters, &function, num_nodes, i]() {
+          ThreadAffinity::pinWorkerThread(i);
+          const int node = ThreadAffinity::workerNode(i);
+          int index;
+          for (int n = 0; n < num_nodes; ++n) {
+            SubmapIndexGetter& getter = *index_getters[(node + n) % num_nodes];
+            while (getter.getNextIndex(&index)) {
+              function(index, i);
+            }
+          }
+        }));
   }
 
   // Join all threads.
   for (auto& thread : threads) {
     thread.get();
   }
-  int_timer.Stop();
+}
+
+void ProjectiveIntegrator::computeDiscontinuityMask() {
+  if (!use_discontinuity_mask_) {
+    return;
+  }
+  Timer timer("tsdf_integration/discontinuity_mask");
+  discontinuity_mask_.compute(range_image_,
+                              config_.interpolation_max_depth_difference,
+                              num_threads_);
+}
+
+void ProjectiveIntegrator::cullOccludedSubmaps(
+    const SubmapCollection& submaps, const InputData& input,
+    std::unordered_map<int, voxblox::BlockIndexList>* block_lists) const {
+  const size_t num_visible = block_lists->size();
+  for (auto it = block_lists->begin(); it != block_lists->end();) {
+    // Voxels farther than the truncation distance behind the surface are
+    // never updated.
+    const Submap& submap = submaps.getSubmap(it->first);
+    if (globals_->camera()->submapIsOccluded(
+            submap, input.T_M_C(), input.maxDepthPyramid(),
+            submap.getConfig().truncation_distance)) {
+      it = block_lists->erase(it);
+    } else {
+      ++it;
+    }
+  }
+  LOG_IF(INFO, config_.verbosity >= 3)
+      << "Culled " << num_visible - block_lists->size() << " of "
+      << num_visible << " visible submaps as occluded.";
+}
+
+float ProjectiveIntegrator::computeMaxCarvingDistance(
+    const Submap& submap) const {
+  int max_voxels = config_.max_carving_voxels;
+  auto it = config_.class_max_carving_voxels.find(submap.getName());
+  if (it == config_.class_max_carving_voxels.end()) {
+    it = config_.class_max_carving_voxels.find(
+        std::to_string(submap.getClassID()));
+  }
+  if (it != config_.class_max_carving_voxels.end()) {
+    max_voxels = it->second;
+  }
+  if (max_voxels <= 0) {
+    return std::numeric_limits<float>::max();
+  }
+  return max_voxels * submap.getConfig().voxel_size;
 }
 
 void ProjectiveIntegrator::updateSubmap(
@@ -120,8 +249,10 @@ void ProjectiveIntegrator::updateSubmap(
     const voxblox::BlockIndexList& block_indices,
     const InputData& input) const {
   Transformation T_C_S = input.T_M_C().inverse() * submap->getT_M_S();
+  const float max_carving_distance = computeMaxCarvingDistance(*submap);
   for (const auto& block_index : block_indices) {
-    updateBlock(submap, interpolator, block_index, T_C_S, input);
+    updateBlock(submap, interpolator, block_index, T_C_S, max_carving_distance,
+                input);
   }
 }
 
@@ -129,22 +260,24 @@ void ProjectiveIntegrator::updateBlock(Submap* submap,
                                        InterpolatorBase* interpolator,
                                        const voxblox::BlockIndex& block_index,
                                        const Transformation& T_C_S,
+                                       float max_carving_distance,
                                        const InputData& input) const {
   CHECK_NOTNULL(submap);
   // Set up preliminaries.
-  if (!submap->getTsdfLayer().hasBlock(block_index)) {
+  const Submap::BlockRecord blocks = submap->getBlocks(block_index);
+  if (!blocks) {
     LOG_IF(WARNING, config_.verbosity >= 1)
         << "Tried to access inexistent block '" << block_index.transpose()
         << "' in submap " << submap->getID() << ".";
     return;
   }
-  TsdfBlock& block = submap->getTsdfLayerPtr()->getBlockByIndex(block_index);
+  TsdfBlock& block = *blocks.tsdf;
   const float voxel_size = block.voxel_size();
   const float truncation_distance = submap->getConfig().truncation_distance;
   const int submap_id = submap->getID();
   const bool is_free_space_submap =
       submap->getLabel() == PanopticLabel::kFreeSpace;
-  bool was_updated = false;
+  size_t num_updated = 0;
 
   // Update all voxels.
   for (size_t i = 0; i < block.num_voxels(); ++i) {
@@ -152,12 +285,15 @@ void ProjectiveIntegrator::updateBlock(Submap* submap,
     const Point p_C = T_C_S * block.computeCoordinatesFromLinearIndex(
                                   i);  // Voxel center in camera frame.
     if (updateVoxel(interpolator, &voxel, p_C, input, submap_id,
-                    is_free_space_submap, truncation_distance, voxel_size)) {
-      was_updated = true;
+                    is_free_space_submap, truncation_distance,
+                    max_carving_distance, voxel_size)) {
+      num_updated++;
     }
   }
-  if (was_updated) {
+  num_updated_voxels_ += num_updated;
+  if (num_updated > 0) {
     block.setUpdatedAll();
+    submap->markBlockUpdated(block_index);
   }
 }
 
@@ -165,13 +301,14 @@ bool ProjectiveIntegrator::updateVoxel(
     InterpolatorBase* interpolator, TsdfVoxel* voxel, const Point& p_C,
     const InputData& input, const int submap_id,
     const bool is_free_space_submap, const float truncation_distance,
-    const float voxel_size, ClassVoxel* class_voxel, ScoreVoxel* score_voxel) const {
+    const float max_carving_distance, const float voxel_size,
+    ClassVoxel* class_voxel, ScoreVoxel* score_voxel) const {
   // Compute the signed distance. This also sets up the interpolator.
   float sdf;
   if (!computeSignedDistance(p_C, interpolator, &sdf)) {
     return false;
   }
-  if (sdf < -truncation_distance) {
+  if (sdf < -truncation_distance || sdf > max_carving_distance) {
     return false;
   }
 
@@ -285,8 +422,8 @@ void ProjectiveIntegrator::allocateNewBlocks(SubmapCollection* submaps,
   range_image_.setZero();
   max_range_in_image_ = 0.f;
 
-  // Parse through each point to allocate instance + background blocks.
-  std::unordered_set<Submap*> touched_submaps;
+  // Parse through each point to find the instance + background blocks.
+  std::unordered_map<int, voxblox::IndexSet> new_block_indices;
   for (int v = 0; v < input.depthImage().rows; v++) {
     for (int u = 0; u < input.depthImage().cols; u++) {
       const cv::Vec3f& vertex = input.vertexMap().at<cv::Vec3f>(v, u);
@@ -305,16 +442,8 @@ void ProjectiveIntegrator::allocateNewBlocks(SubmapCollection* submaps,
         const Point p_S = submap->getT_S_M() * input.T_M_C() * p_C;
         const voxblox::BlockIndex block_index =
             submap->getTsdfLayer().computeBlockIndexFromCoordinates(p_S);
-        const auto block =
-            submap->getTsdfLayerPtr()->allocateBlockPtrByIndex(block_index);
-        if (submap->hasClassLayer()) {
-          // NOTE(schmluk): The projective integrator does not use the class
-          // layer but was added here for simplicity.
-          submap->getClassLayerPtr()->allocateBlockPtrByIndex(block_index);
-        }
-        if (submap->hasScoreLayer()) {
-          submap->getScoreLayerPtr()->allocateBlockPtrByIndex(block_index);
-        }
+        voxblox::IndexSet& new_blocks = new_block_indices[id];
+        new_blocks.insert(block_index);
 
         // If required, check whether the point is on the boudnary of a block
         // and allocate the neighboring blocks.
@@ -327,22 +456,9 @@ void ProjectiveIntegrator::allocateNewBlocks(SubmapCollection* submaps,
             const voxblox::BlockIndex neighbor_index =
                 submap->getTsdfLayer().computeBlockIndexFromCoordinates(
                     p_neighbor_S);
-            if (neighbor_index != block_index) {
-              const auto block =
-                  submap->getTsdfLayerPtr()->allocateBlockPtrByIndex(
-                      neighbor_index);
-              if (submap->hasClassLayer()) {
-                submap->getClassLayerPtr()->allocateBlockPtrByIndex(
-                    neighbor_index);
-              }
-              if (submap->hasScoreLayer()) {
-                submap->getScoreLayerPtr()->allocateBlockPtrByIndex(
-                    neighbor_index);
-              }
-            }
+            new_blocks.insert(neighbor_index);
           }
         }
-        touched_submaps.insert(submap);
       }
     }
   }
@@ -365,8 +481,10 @@ void ProjectiveIntegrator::allocateNewBlocks(SubmapCollection* submaps,
           const Point candidate_S = camera_S + offset * block_size;
           if (globals_->camera()->pointIsInViewFrustum(T_C_S * candidate_S,
                                                        block_diag_half)) {
-            space->getTsdfLayerPtr()->allocateBlockPtrByCoordinates(
-                candidate_S);
+            space->allocateBlocks(
+                space->getTsdfLayer().computeBlockIndexFromCoordinates(
+                    candidate_S),
+                true);
           }
         }
       }
@@ -374,12 +492,27 @@ void ProjectiveIntegrator::allocateNewBlocks(SubmapCollection* submaps,
     space->getBoundingVolumePtr()->update();
   }
 
-  // Update all bounding volumes. This is currently done in every integration
-  // step since it's not too expensive and won't do anything if no new block
-  // was allocated.
-  for (auto& submap : touched_submaps) {
-    submap->updateBoundingVolume();
+  // Allocate the blocks in parallel. Blocks are first touched by a worker of
+  // the NUMA node the submap will also be integrated on.
+  // NOTE(schmluk): The projective integrator does not use the class layer but
+  // it is allocated here for simplicity.
+  std::vector<int> id_list;
+  id_list.reserve(new_block_indices.size());
+  for (const auto& id_blocks_pair : new_block_indices) {
+    id_list.emplace_back(id_blocks_pair.first);
   }
+  processSubmapsInParallel(
+      id_list, [submaps, &new_block_indices](int submap_id, int /* thread */) {
+        Submap* submap = submaps->getSubmapPtr(submap_id);
+        for (const voxblox::BlockIndex& index :
+             new_block_indices.at(submap_id)) {
+          submap->allocateBlocks(index);
+        }
+        // Update all bounding volumes. This is currently done in every
+        // integration step since it's not too expensive and won't do anything
+        // if no new block was allocated.
+        submap->updateBoundingVolume();
+      });
 }
 
 }  // namespace panoptic_mapping
@@ -11,6 +11,7 @@
 #include <voxblox/integrator/merge_integration.h>
 
 #include "panoptic_mapping/common/index_getter.h"
+#include "panoptic_mapping/common/thread_affinity.h"
 
 namespace panoptic_mapping {
 
@@ -86,6 +87,7 @@ void SingleTsdfIntegrator::processInput(SubmapCollection* submaps,
   // Allocate all blocks in the map.
   auto t1 = std::chrono::high_resolution_clock::now();
   allocateNewBlocks(map, input);
+  computeDiscontinuityMask();
   auto t2 = std::chrono::high_resolution_clock::now();
 
   // Find all active blocks that are in the field of view.
@@ -98,16 +100,20 @@ void SingleTsdfIntegrator::processInput(SubmapCollection* submaps,
   }
   IndexGetter<voxblox::BlockIndex> index_getter(indices);
   const Transformation T_C_S = input->T_M_C().inverse() * map->getT_M_S();
+  const float max_carving_distance = computeMaxCarvingDistance(*map);
 
   // Integrate in parallel.
+  num_updated_voxels_ = 0;
   std::vector<std::future<void>> threads;
-  for (int i = 0; i < config_.projective_integrator.integration_threads; ++i) {
+  for (int i = 0; i < num_threads_; ++i) {
     threads.emplace_back(std::async(
-        std::launch::async, [this, &index_getter, map, input, i, T_C_S]() {
+        std::launch::async,
+        [this, &index_getter, map, input, i, T_C_S, max_carving_distance]() {
+          ThreadAffinity::pinWorkerThread(i);
           voxblox::BlockIndex index;
           while (index_getter.getNextIndex(&index)) {
             this->updateBlock(map, interpolators_[i].get(), index, T_C_S,
-                              *input);
+                              max_carving_distance, *input);
           }
         }));
   }
@@ -123,23 +129,25 @@ void SingleTsdfIntegrator::processInput(SubmapCollection* submaps,
       << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count()
       << "ms, Integrate: "
       << std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count()
-      << "ms.";
+      << "ms, updated " << num_updated_voxels_ << " voxels.";
 }
 
 void SingleTsdfIntegrator::updateBlock(Submap* submap,
                                        InterpolatorBase* interpolator,
                                        const voxblox::BlockIndex& block_index,
                                        const Transformation& T_C_S,
+                                       float max_carving_distance,
                                        const InputData& input) const {
   // Set up preliminaries.
-  if (!submap->getTsdfLayer().hasBlock(block_index)) {
+  const Submap::BlockRecord blocks = submap->getBlocks(block_index);
+  if (!blocks) {
     LOG_IF(WARNING, config_.verbosity >= 1)
         << "Tried to access inexistent block '" << block_index.transpose()
         << "' in submap " << submap->getID() << ".";
     return;
   }
-  TsdfBlock& block = submap->getTsdfLayerPtr()->getBlockByIndex(block_index);
-  bool was_updated = false;
+  TsdfBlock& block = *blocks.tsdf;
+  size_t num_updated = 0;
   const float voxel_size = block.voxel_size();
   const float truncation_distance = submap->getConfig().truncation_distance;
   const int submap_id = submap->getID();
@@ -151,31 +159,40 @@ void SingleTsdfIntegrator::updateBlock(Submap* submap,
       submap->hasScoreLayer() && config_.use_score;
 
   if (use_class_layer) {
-    if (!submap->getClassLayer().hasBlock(block_index)) {
+    class_block = blocks.classification;
+    if (!class_block) {
       LOG_IF(WARNING, config_.verbosity >= 1)
           << "Tried to access inexistent class block '"
           << block_index.transpose() << "' in submap " << submap->getID()
           << ".";
       return;
     }
-    class_block = submap->getClassLayerPtr()->getBlockPtrByIndex(block_index);
   }
   if (use_score_layer) {
-    if (!submap->getScoreLayer().hasBlock(block_index)) {
+    score_block = blocks.score;
+    if (!score_block) {
       LOG_IF(WARNING, config_.verbosity >= 1)
           << "Tried to access inexistent score block '"
           << block_index.transpose() << "' in submap " << submap->getID()
           << ".";
       return;
     }
-    score_block = submap->getScoreLayerPtr()->getBlockPtrByIndex(block_index);
   }
 
+  // Class counts are collected and applied to the block in a single batch.
+  // Uncertainty voxels are updated individually.
+  const bool batch_class_updates =
+      use_class_layer &&
+      !(config_.use_uncertainty &&
+        class_block->getVoxelType() == ClassVoxelType::kUncertainty);
+  thread_local ClassCountUpdates class_updates;
+  class_updates.clear();
+
   // Update all voxels.
   for (size_t i = 0; i < block.num_voxels(); ++i) {
     TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
     ClassVoxel* class_voxel = nullptr;
-    if (use_class_layer) {
+    if (use_class_layer && !batch_class_updates) {
       class_voxel = &class_block->getVoxelByLinearIndex(i);
     }
     ScoreVoxel* score_voxel = nullptr;
@@ -184,14 +201,22 @@ void SingleTsdfIntegrator::updateBlock(Submap* submap,
     }
     const Point p_C = T_C_S * block.computeCoordinatesFromLinearIndex(
                                   i);  // Voxel center in camera frame.
-    if (updateVoxel(interpolator, &voxel, p_C, input, submap_id, true,
-                    truncation_distance, voxel_size, class_voxel, score_voxel)) {
-      was_updated = true;
+    if (integrateVoxel(interpolator, &voxel, p_C, input, truncation_distance,
+                       max_carving_distance, voxel_size, class_voxel,
+                       score_voxel,
+                       batch_class_updates ? &class_updates : nullptr, i)) {
+      num_updated++;
     }
   }
+  if (!class_updates.empty()) {
+    submap->getClassLayerPtr()->incrementCounts(class_block.get(),
+                                                class_updates);
+  }
 
-  if (was_updated) {
+  num_updated_voxels_ += num_updated;
+  if (num_updated > 0) {
     block.setUpdatedAll();
+    submap->markBlockUpdated(block_index);
   }
 }
 
@@ -199,13 +224,25 @@ bool SingleTsdfIntegrator::updateVoxel(
     InterpolatorBase* interpolator, TsdfVoxel* voxel, const Point& p_C,
     const InputData& input, const int submap_id,
     const bool is_free_space_submap, const float truncation_distance,
-    const float voxel_size, ClassVoxel* class_voxel, ScoreVoxel* score_voxel) const {
+    const float max_carving_distance, const float voxel_size,
+    ClassVoxel* class_voxel, ScoreVoxel* score_voxel) const {
+  return integrateVoxel(interpolator, voxel, p_C, input, truncation_distance,
+                        max_carving_distance, voxel_size, class_voxel,
+                        score_voxel, nullptr, 0);
+}
+
+bool SingleTsdfIntegrator::integrateVoxel(
+    InterpolatorBase* interpolator, TsdfVoxel* voxel, const Point& p_C,
+    const InputData& input, const float truncation_distance,
+    const float max_carving_distance, const float voxel_size,
+    ClassVoxel* class_voxel, ScoreVoxel* score_voxel,
+    ClassCountUpdates* class_updates, const size_t voxel_index) const {
   // Compute the signed distance. This also sets up the interpolator.
   float sdf;
   if (!computeSignedDistance(p_C, interpolator, &sdf)) {
     return false;
   }
-  if (sdf < -truncation_distance) {
+  if (sdf < -truncation_distance || sdf > max_carving_distance) {
     return false;
   }
 
@@ -221,7 +258,12 @@ bool SingleTsdfIntegrator::updateVoxel(
     updateVoxelValues(voxel, sdf, weight, &color);
 
     // Update the semantic information if requested.
-    if (class_voxel) {
+    if (class_updates) {
+      // For the single TSDF case there is no belonging submap, just use the ID
+      // directly.
+      class_updates->add(voxel_index,
+                         interpolator->interpolateID(input.idImage()));
+    } else if (class_voxel) {
       // Uncertainty voxels are handled differently.
       if (config_.use_uncertainty &&
           class_voxel->getVoxelType() == ClassVoxelType::kUncertainty) {
@@ -320,13 +362,9 @@ void SingleTsdfIntegrator::allocateNewBlocks(Submap* map, InputData* input) {
         const Point candidate_S = camera_S + offset * block_size;
         if (globals_->camera()->pointIsInViewFrustum(T_C_S * candidate_S,
                                                      block_diag_half)) {
-          map->getTsdfLayerPtr()->allocateBlockPtrByCoordinates(candidate_S);
-          if (map->hasClassLayer()) {
-            map->getClassLayerPtr()->allocateBlockPtrByCoordinates(candidate_S);
-          }
-          if (map->hasScoreLayer()) {
-            map->getScoreLayerPtr()->allocateBlockPtrByCoordinates(candidate_S);
-          }
+          map->allocateBlocks(
+              map->getTsdfLayer().computeBlockIndexFromCoordinates(
+                  candidate_S));
         }
       }
     }
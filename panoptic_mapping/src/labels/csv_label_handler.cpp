@@ -6,8 +6,11 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <experimental/filesystem>
+
 #include "panoptic_mapping/3rd_party/csv.h"
 
 namespace panoptic_mapping {
@@ -18,6 +21,7 @@ config_utilities::Factory::RegistrationRos<LabelHandlerBase, CsvLabelHandler>
 void CsvLabelHandler::Config::setupParamsAndPrinting() {
   setupParam("verbosity", &verbosity);
   setupParam("file_name", &file_name);
+  setupParam("share_labels", &share_labels);
 }
 
 void CsvLabelHandler::Config::checkParams() const {
@@ -32,10 +36,24 @@ CsvLabelHandler::CsvLabelHandler(const Config& config, bool print_config)
   LOG_IF(INFO, config_.verbosity >= 1 && print_config) << "\n"
                                                        << config_.toString();
   // Setup the labels from csv file.
-  readLabelsFromFile();
+  if (!config_.share_labels) {
+    setLabels(readLabelsFromFile());
+    return;
+  }
+  bool was_loaded = true;
+  setLabelTable(LabelTable::getShared(
+      "csv:" +
+          std::experimental::filesystem::canonical(config_.file_name).string(),
+      [this, &was_loaded]() {
+        was_loaded = false;
+        return readLabelsFromFile();
+      }));
+  LOG_IF(INFO, was_loaded && config_.verbosity >= 2)
+      << "Using the " << numberOfLabels() << " shared labels of '"
+      << config_.file_name << "'.";
 }
 
-void CsvLabelHandler::readLabelsFromFile() {
+LabelTable::Labels CsvLabelHandler::readLabelsFromFile() const {
   // NOTE(schmluk): Assumes fixed header names in the target file. Reading
   // exceptions should be handled by the CSVReader. Read all optional columns
   // and write the present ones. All header columns need to be present at the
@@ -44,6 +62,7 @@ void CsvLabelHandler::readLabelsFromFile() {
   in.read_header(io::ignore_extra_column, "InstanceID", "ClassID", "PanopticID",
                  "R", "G", "B", "Name", "Size");
 
+  LabelTable::Labels labels;
   bool read_row = true;
   std::vector<float> field_count(6, 0.f);
   int missed_count = -1;  // The header is also counter.
@@ -81,7 +100,7 @@ void CsvLabelHandler::readLabelsFromFile() {
       label.color = voxblox::Color(r, g, b);
       field_count[5] += 1.f;
     }
-    labels_[inst] = std::make_unique<LabelEntry>(label);
+    labels[inst] = std::make_unique<LabelEntry>(label);
   }
 
   // Cehck all labels valid.
@@ -92,7 +111,7 @@ void CsvLabelHandler::readLabelsFromFile() {
   }
 
   // Required fields.
-  const size_t num_labels = labels_.size();
+  const size_t num_labels = labels.size();
   const std::vector<std::string> field_names = {
       "InstanceID", "ClassID", "PanopticID", "RGB", "Name", "Size"};
   for (size_t i = 1; i < 3; ++i) {
@@ -117,6 +136,7 @@ void CsvLabelHandler::readLabelsFromFile() {
     }
   }
   LOG_IF(INFO, config_.verbosity >= 1) << info.str();
+  return labels;
 }
 
 }  // namespace panoptic_mapping
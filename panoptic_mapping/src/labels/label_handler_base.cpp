@@ -1,60 +1,83 @@
 #include "panoptic_mapping/labels/label_handler_base.h"
 
-#include <string>
+#include <memory>
+#include <utility>
 
-namespace panoptic_mapping {
-
-bool LabelHandlerBase::segmentationIdExists(int segmentation_id) const {
-  return labels_.find(segmentation_id) != labels_.end();
-}
-
-int LabelHandlerBase::getClassID(int segmentation_id) const {
-  return labels_.at(segmentation_id)->class_id;
-}
-
-bool LabelHandlerBase::isBackgroundClass(int segmentation_id) const {
-  return labels_.at(segmentation_id)->label == PanopticLabel::kBackground;
-}
+#include <opencv2/core.hpp>
 
-bool LabelHandlerBase::isInstanceClass(int segmentation_id) const {
-  return labels_.at(segmentation_id)->label == PanopticLabel::kInstance;
-}
-
-bool LabelHandlerBase::isUnknownClass(int segmentation_id) const {
-  return labels_.at(segmentation_id)->label == PanopticLabel::kUnknown;
-}
+namespace panoptic_mapping {
 
-bool LabelHandlerBase::isSpaceClass(int segmentation_id) const {
-  return labels_.at(segmentation_id)->label == PanopticLabel::kFreeSpace;
+bool LabelHandlerBase::getLabelEntryIfExists(int segmentation_id,
+                                             LabelEntry* label_entry) const {
+  const CompactLabel* label = findLabel(segmentation_id);
+  if (label) {
+    CHECK_NOTNULL(label_entry);
+    *label_entry = *label->entry;
+    return true;
+  }
+  return false;
 }
 
-PanopticLabel LabelHandlerBase::getPanopticLabel(int segmentation_id) const {
-  return labels_.at(segmentation_id)->label;
-}
+void LabelHandlerBase::classifyIDImage(const cv::Mat& id_image,
+                                       cv::Mat* class_image,
+                                       cv::Mat* label_image,
+                                       cv::Mat* color_image) const {
+  CHECK_EQ(id_image.type(), CV_32SC1);
+  if (class_image) {
+    class_image->create(id_image.size(), CV_32SC1);
+  }
+  if (label_image) {
+    label_image->create(id_image.size(), CV_8UC1);
+  }
+  if (color_image) {
+    color_image->create(id_image.size(), CV_8UC3);
+  }
 
-const voxblox::Color& LabelHandlerBase::getColor(int segmentation_id) const {
-  return labels_.at(segmentation_id)->color;
+  // Consecutive pixels mostly share the same ID so cache the last lookup.
+  const CompactLabel unknown_label;
+  for (int v = 0; v < id_image.rows; ++v) {
+    const int* ids = id_image.ptr<int>(v);
+    int* classes = class_image ? class_image->ptr<int>(v) : nullptr;
+    uchar* labels = label_image ? label_image->ptr<uchar>(v) : nullptr;
+    cv::Vec3b* colors = color_image ? color_image->ptr<cv::Vec3b>(v) : nullptr;
+    int previous_id = 0;
+    const CompactLabel* label = nullptr;
+    for (int u = 0; u < id_image.cols; ++u) {
+      if (!label || ids[u] != previous_id) {
+        previous_id = ids[u];
+        label = findLabel(previous_id);
+        if (!label) {
+          label = &unknown_label;
+        }
+      }
+      const bool exists = label->entry != nullptr;
+      if (classes) {
+        classes[u] = label->class_id;
+      }
+      if (labels) {
+        labels[u] = static_cast<uchar>(label->label);
+      }
+      if (colors) {
+        colors[u] = exists ? cv::Vec3b(label->color.b, label->color.g,
+                                       label->color.r)
+                           : cv::Vec3b(0, 0, 0);
+      }
+    }
+  }
 }
 
-const std::string& LabelHandlerBase::getName(int segmentation_id) const {
-  return labels_.at(segmentation_id)->name;
+size_t LabelHandlerBase::numberOfLabels() const {
+  return label_table_->numberOfLabels();
 }
 
-const LabelEntry& LabelHandlerBase::getLabelEntry(int segmentation_id) const {
-  return *labels_.at(segmentation_id);
+void LabelHandlerBase::setLabels(LabelTable::Labels labels) {
+  label_table_ = std::make_shared<const LabelTable>(std::move(labels));
 }
 
-bool LabelHandlerBase::getLabelEntryIfExists(int segmentation_id,
-                                             LabelEntry* label_entry) const {
-  auto it = labels_.find(segmentation_id);
-  if (it != labels_.end()) {
-    CHECK_NOTNULL(label_entry);
-    *label_entry = *it->second;
-    return true;
-  }
-  return false;
+void LabelHandlerBase::setLabelTable(
+    std::shared_ptr<const LabelTable> label_table) {
+  CHECK_NOTNULL(label_table.get());
+  label_table_ = std::move(label_table);
 }
 
-size_t LabelHandlerBase::numberOfLabels() const { return labels_.size(); }
-
 }  // namespace panoptic_mapping
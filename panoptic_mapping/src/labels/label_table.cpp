@@ -0,0 +1,68 @@
+#include "panoptic_mapping/labels/label_table.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace panoptic_mapping {
+
+LabelTable::LabelTable(Labels labels) : labels_(std::move(labels)) {
+  if (labels_.empty()) {
+    return;
+  }
+
+  // The dense table starts at the smallest ID and is limited in size, IDs
+  // beyond its end are outliers.
+  int min_id = std::numeric_limits<int>::max();
+  int max_id = std::numeric_limits<int>::lowest();
+  for (const auto& id_label_pair : labels_) {
+    min_id = std::min(min_id, id_label_pair.first);
+    max_id = std::max(max_id, id_label_pair.first);
+  }
+  const int64_t max_size =
+      std::max<int64_t>(kMinDenseTableSize,
+                        kDenseTableSizeFactor * labels_.size());
+  const int64_t size =
+      std::min<int64_t>(static_cast<int64_t>(max_id) - min_id + 1, max_size);
+  dense_table_.resize(size);
+  dense_table_offset_ = min_id;
+
+  for (const auto& id_label_pair : labels_) {
+    const LabelEntry& entry = *id_label_pair.second;
+    CompactLabel label;
+    label.class_id = entry.class_id;
+    label.label = entry.label;
+    label.color = entry.color;
+    label.entry = &entry;
+    const int64_t index =
+        static_cast<int64_t>(id_label_pair.first) - dense_table_offset_;
+    if (index < size) {
+      dense_table_[index] = label;
+    } else {
+      sparse_table_[id_label_pair.first] = label;
+    }
+  }
+}
+
+std::shared_ptr<const LabelTable> LabelTable::getShared(
+    const std::string& key, const std::function<Labels()>& load) {
+  // NOTE: The lock is held while loading so concurrently starting mappers
+  // wait for the first one instead of reading the same labels again.
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::weak_ptr<const LabelTable>>
+      tables;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::weak_ptr<const LabelTable>& cached = tables[key];
+  std::shared_ptr<const LabelTable> table = cached.lock();
+  if (!table) {
+    table = std::make_shared<const LabelTable>(load());
+    cached = table;
+  }
+  return table;
+}
+
+}  // namespace panoptic_mapping
@@ -4,6 +4,7 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace panoptic_mapping {
@@ -29,14 +30,16 @@ RangeLabelHandler::RangeLabelHandler(const Config& config, bool print_config)
 }
 
 void RangeLabelHandler::initialiseLabels() {
-  for (int i; i < config_.num_labels; i++) {
+  LabelTable::Labels labels;
+  for (int i = 0; i < config_.num_labels; i++) {
     LabelEntry label;
     label.segmentation_id = i;
     label.class_id = i;
     label.label = PanopticLabel::kBackground;
     label.color = voxblox::rainbowColorMap(((float)i) / config_.num_labels);
-    labels_[i] = std::make_unique<LabelEntry>(label);
+    labels[i] = std::make_unique<LabelEntry>(label);
   }
+  setLabels(std::move(labels));
 }
 
 }  // namespace panoptic_mapping
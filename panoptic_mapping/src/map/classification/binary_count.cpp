@@ -92,6 +92,35 @@ BinaryCountLayer::BinaryCountLayer(const Config& config, const float voxel_size,
     : config_(config.checkValid()),
       ClassLayerImpl(voxel_size, voxels_per_side) {}
 
+void BinaryCountLayer::incrementCounts(ClassBlock* block,
+                                       const ClassCountUpdates& updates) {
+  if (updates.empty()) {
+    return;
+  }
+  voxblox::Block<BinaryCountVoxel>& voxels = getWrappedBlock(block);
+  if (isSparseUpdate(updates, voxels.num_voxels())) {
+    for (size_t i = 0; i < updates.size(); ++i) {
+      BinaryCountVoxel& voxel =
+          voxels.getVoxelByLinearIndex(updates.voxel_indices[i]);
+      const ClassificationCount belongs = updates.ids[i] == 0;
+      voxel.belongs_count += belongs;
+      voxel.foreign_count += 1u - belongs;
+    }
+    return;
+  }
+
+  // Expand the updates to dense increments and apply them to the whole block
+  // in a single loop without branches.
+  thread_local std::vector<uint8_t> belongs;
+  thread_local std::vector<uint8_t> foreign;
+  computeBinaryIncrements(updates, voxels.num_voxels(), &belongs, &foreign);
+  for (size_t i = 0; i < voxels.num_voxels(); ++i) {
+    BinaryCountVoxel& voxel = voxels.getVoxelByLinearIndex(i);
+    voxel.belongs_count += belongs[i];
+    voxel.foreign_count += foreign[i];
+  }
+}
+
 ClassVoxelType BinaryCountLayer::getVoxelType() const {
   return ClassVoxelType::kBinaryCount;
 }
@@ -6,6 +6,21 @@
 
 namespace panoptic_mapping {
 
+namespace {
+
+// Increment the counts by 0 or 1 each. If the incremented count is saturated
+// both counts are halved first to de-weight older measurements.
+inline void applyIncrements(const uint8_t belongs, const uint8_t foreign,
+                            MovingBinaryCountVoxel* voxel) {
+  constexpr uint8_t kMax = std::numeric_limits<uint8_t>::max();
+  const uint8_t shift = (belongs & (voxel->belongs_count == kMax)) |
+                        (foreign & (voxel->foreign_count == kMax));
+  voxel->belongs_count = (voxel->belongs_count >> shift) + belongs;
+  voxel->foreign_count = (voxel->foreign_count >> shift) + foreign;
+}
+
+}  // namespace
+
 ClassVoxelType MovingBinaryCountVoxel::getVoxelType() const {
   return ClassVoxelType::kMovingBinaryCount;
 }
@@ -39,19 +54,8 @@ float MovingBinaryCountVoxel::getProbability(const int id) const {
 
 void MovingBinaryCountVoxel::incrementCount(const int id, const float weight) {
   // ID 0 is used for belonging voxels.
-  if (id == 0u) {
-    if (belongs_count == std::numeric_limits<uint8_t>::max()) {
-      belongs_count /= 2u;
-      foreign_count /= 2u;
-    }
-    belongs_count++;
-  } else {
-    if (foreign_count == std::numeric_limits<uint8_t>::max()) {
-      belongs_count /= 2u;
-      foreign_count /= 2u;
-    }
-    foreign_count++;
-  }
+  const uint8_t belongs = id == 0;
+  applyIncrements(belongs, 1u - belongs, this);
 }
 
 bool MovingBinaryCountVoxel::mergeVoxel(const ClassVoxel& other) {
@@ -185,6 +189,32 @@ bool MovingBinaryCountLayer::addBlockFromProto(
   return true;
 }
 
+void MovingBinaryCountLayer::incrementCounts(
+    ClassBlock* block, const ClassCountUpdates& updates) {
+  if (updates.empty()) {
+    return;
+  }
+  voxblox::Block<MovingBinaryCountVoxel>& voxels = getWrappedBlock(block);
+  if (isSparseUpdate(updates, voxels.num_voxels())) {
+    for (size_t i = 0; i < updates.size(); ++i) {
+      const uint8_t belongs = updates.ids[i] == 0;
+      applyIncrements(
+          belongs, 1u - belongs,
+          &voxels.getVoxelByLinearIndex(updates.voxel_indices[i]));
+    }
+    return;
+  }
+
+  // Expand the updates to dense increments and apply them to the whole block
+  // in a single loop without branches.
+  thread_local std::vector<uint8_t> belongs;
+  thread_local std::vector<uint8_t> foreign;
+  computeBinaryIncrements(updates, voxels.num_voxels(), &belongs, &foreign);
+  for (size_t i = 0; i < voxels.num_voxels(); ++i) {
+    applyIncrements(belongs[i], foreign[i], &voxels.getVoxelByLinearIndex(i));
+  }
+}
+
 ClassVoxelType MovingBinaryCountLayer::getVoxelType() const {
   return ClassVoxelType::kMovingBinaryCount;
 }
@@ -9,7 +9,7 @@ InstanceID::InstanceID(InstanceIDManager* manager)
 InstanceID::~InstanceID() { manager_->releaseID(id_); }
 
 InstanceID::InstanceID(int id, InstanceIDManager* manager)
-    : manager_(manager_), id_(id) {
+    : manager_(manager), id_(id) {
   manager_->registerID(id);
 }
 
@@ -42,6 +42,7 @@ void Submap::Config::setupParamsAndPrinting() {
   setupParam("classification", &classification, "classification");
   setupParam("scores", &scores, "scores");
   setupParam("mesh", &mesh, "mesh");
+  setupParam("fused_block_storage", &fused_block_storage);
 }
 
 bool Submap::Config::useClassLayer() const {
@@ -57,7 +58,8 @@ Submap::Submap(const Config& config, SubmapIDManager* submap_id_manager,
     : config_(config.checkValid()),
       bounding_volume_(*this),
       id_(submap_id_manager),
-      instance_id_(instance_id_manager) {
+      instance_id_(instance_id_manager),
+      version_(MapVersion::next()) {
   initialize();
 }
 
@@ -66,11 +68,25 @@ Submap::Submap(const Config& config, SubmapIDManager* submap_id_manager,
     : config_(config.checkValid()),
       bounding_volume_(*this),
       id_(submap_id, submap_id_manager),
-      instance_id_(instance_id_manager) {
+      instance_id_(instance_id_manager),
+      version_(MapVersion::next()) {
+  initialize();
+}
+
+Submap::Submap(const Config& config, int instance_id,
+               SubmapIDManager* submap_id_manager,
+               InstanceIDManager* instance_id_manager)
+    : config_(config.checkValid()),
+      bounding_volume_(*this),
+      id_(submap_id_manager),
+      instance_id_(instance_id, instance_id_manager),
+      version_(MapVersion::next()) {
   initialize();
 }
 
 void Submap::initialize() {
+  layers_version_ = version_;
+
   // Default values.
   std::stringstream ss;
   ss << "submap_" << static_cast<int>(id_);
@@ -103,8 +119,169 @@ void Submap::initialize() {
 }
 
 void Submap::setT_M_S(const Transformation& T_M_S) {
+  if (T_M_S.getTransformationMatrix() == T_M_S_.getTransformationMatrix()) {
+    return;
+  }
   T_M_S_ = T_M_S;
   T_M_S_inv_ = T_M_S_.inverse();
+  markStateUpdated();
+}
+
+Submap::BlockRecord Submap::allocateBlocks(const BlockIndex& block_index,
+                                           bool tsdf_only) {
+  if (config_.fused_block_storage) {
+    auto it = block_records_.find(block_index);
+    if (it != block_records_.end()) {
+      const BlockRecord& record = it->second;
+      if (tsdf_only || ((!has_class_layer_ || record.classification) &&
+                        (!has_score_layer_ || record.score))) {
+        return record;
+      }
+    }
+  }
+  BlockRecord record;
+  record.tsdf = tsdf_layer_->allocateBlockPtrByIndex(block_index);
+  if (has_class_layer_) {
+    record.classification =
+        tsdf_only ? class_layer_->getBlockPtrByIndex(block_index)
+                  : class_layer_->allocateBlockPtrByIndex(block_index);
+  }
+  if (has_score_layer_) {
+    record.score = tsdf_only
+                       ? score_layer_->getBlockPtrByIndex(block_index)
+                       : score_layer_->allocateBlockPtrByIndex(block_index);
+  }
+  if (config_.fused_block_storage) {
+    block_records_[block_index] = record;
+  }
+  return record;
+}
+
+Submap::BlockRecord Submap::getBlocks(const BlockIndex& block_index) const {
+  if (config_.fused_block_storage) {
+    auto it = block_records_.find(block_index);
+    if (it == block_records_.end()) {
+      return BlockRecord();
+    }
+    return it->second;
+  }
+  return lookUpBlocks(block_index);
+}
+
+void Submap::removeBlocks(const BlockIndex& block_index) {
+  tsdf_layer_->removeBlock(block_index);
+  if (has_class_layer_) {
+    class_layer_->removeBlock(block_index);
+  }
+  if (has_score_layer_) {
+    score_layer_->removeBlock(block_index);
+  }
+  mesh_layer_->removeMesh(block_index);
+  block_records_.erase(block_index);
+}
+
+void Submap::updateBlockRecords() {
+  block_records_.clear();
+  if (!config_.fused_block_storage) {
+    return;
+  }
+  voxblox::BlockIndexList block_indices;
+  tsdf_layer_->getAllAllocatedBlocks(&block_indices);
+  block_records_.reserve(block_indices.size());
+  for (const BlockIndex& block_index : block_indices) {
+    block_records_[block_index] = lookUpBlocks(block_index);
+  }
+}
+
+void Submap::updateBlockRecord(const BlockIndex& block_index) {
+  if (!config_.fused_block_storage) {
+    return;
+  }
+  BlockRecord record = lookUpBlocks(block_index);
+  if (record) {
+    block_records_[block_index] = std::move(record);
+  } else {
+    block_records_.erase(block_index);
+  }
+}
+
+Submap::BlockRecord Submap::lookUpBlocks(const BlockIndex& block_index) const {
+  BlockRecord record;
+  record.tsdf = tsdf_layer_->getBlockPtrByIndex(block_index);
+  if (!record.tsdf) {
+    return record;
+  }
+  if (has_class_layer_) {
+    record.classification = class_layer_->getBlockPtrByIndex(block_index);
+  }
+  if (has_score_layer_) {
+    record.score = score_layer_->getBlockPtrByIndex(block_index);
+  }
+  return record;
+}
+
+uint64_t Submap::getBlockVersion(const BlockIndex& block_index) const {
+  std::lock_guard<std::mutex> lock(block_versions_mutex_);
+  auto it = block_versions_.find(block_index);
+  if (it == block_versions_.end()) {
+    return 0u;
+  }
+  return it->second;
+}
+
+void Submap::getUpdatedBlocks(uint64_t version,
+                              voxblox::BlockIndexList* block_indices) const {
+  CHECK_NOTNULL(block_indices);
+  std::lock_guard<std::mutex> lock(block_versions_mutex_);
+  for (const auto& index_version_pair : block_versions_) {
+    if (index_version_pair.second > version) {
+      block_indices->push_back(index_version_pair.first);
+    }
+  }
+}
+
+bool Submap::hasUpdatedBlocks(uint64_t version, const BlockIndex& min_index,
+                              const BlockIndex& max_index) const {
+  if (latest_block_version_ <= version) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(block_versions_mutex_);
+  const BlockIndex extent = max_index - min_index + BlockIndex::Ones();
+  const size_t range_size = static_cast<size_t>(std::max(extent.x(), 0)) *
+                            std::max(extent.y(), 0) * std::max(extent.z(), 0);
+
+  // Look up the range or scan the versions, whichever is smaller.
+  if (range_size <= block_versions_.size()) {
+    for (int x = min_index.x(); x <= max_index.x(); ++x) {
+      for (int y = min_index.y(); y <= max_index.y(); ++y) {
+        for (int z = min_index.z(); z <= max_index.z(); ++z) {
+          auto it = block_versions_.find(BlockIndex(x, y, z));
+          if (it != block_versions_.end() && it->second > version) {
+            return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+  for (const auto& index_version_pair : block_versions_) {
+    const BlockIndex& index = index_version_pair.first;
+    if (index_version_pair.second > version &&
+        (index.array() >= min_index.array()).all() &&
+        (index.array() <= max_index.array()).all()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Submap::markBlockUpdated(const BlockIndex& block_index) {
+  const uint64_t version = MapVersion::next();
+  std::lock_guard<std::mutex> lock(block_versions_mutex_);
+  block_versions_[block_index] = version;
+  if (version > latest_block_version_) {
+    latest_block_version_ = version;
+  }
 }
 
 void Submap::getProto(SubmapProto* proto) const {
@@ -253,6 +430,7 @@ std::unique_ptr<Submap> Submap::loadFromStream(
   cblox::conversions::transformProtoToKindr(transformation_proto, &T_M_S);
   submap->setT_M_S(T_M_S);
   submap->setFrameName(submap_proto.frame_name());
+  submap->updateBlockRecords();
 
   return submap;
 }
@@ -264,6 +442,7 @@ void Submap::finishActivePeriod() {
   is_active_ = false;
   // Since the submap was active just before we assume it still exists.
   change_state_ = ChangeState::kPersistent;
+  markStateUpdated();
   updateEverything();
 }
 
@@ -325,7 +504,25 @@ bool Submap::applyClassLayer(const LayerManipulator& manipulator,
     class_layer_.reset();
     has_class_layer_ = false;
   }
-  updateEverything();
+  updateBlockRecords();
+  markStateUpdated();
+
+  // Only the blocks flagged by the manipulator need to be re-meshed, meshes of
+  // removed blocks are dropped.
+  voxblox::BlockIndexList block_indices;
+  tsdf_layer_->getAllUpdatedBlocks(voxblox::Update::Status::kMesh,
+                                   &block_indices);
+  for (const BlockIndex& block_index : block_indices) {
+    markBlockUpdated(block_index);
+  }
+  block_indices.clear();
+  mesh_layer_->getAllAllocatedMeshes(&block_indices);
+  for (const BlockIndex& block_index : block_indices) {
+    if (!tsdf_layer_->hasBlock(block_index)) {
+      mesh_layer_->removeMesh(block_index);
+    }
+  }
+  updateEverything(true);
   return tsdf_layer_->getNumberOfAllocatedBlocks() != 0;
 }
 
@@ -337,37 +534,118 @@ std::unique_ptr<Submap> Submap::clone(
 
   // Copy all members.
   result->instance_id_ = static_cast<int>(instance_id_);
-  result->class_id_ = class_id_;
-  result->label_ = label_;
-  result->name_ = name_;
-  result->is_active_ = is_active_;
-  result->was_tracked_ = was_tracked_;
-  result->has_class_layer_ = has_class_layer_;
-  result->has_score_layer_ = has_score_layer_;
-  result->change_state_ = change_state_;
   result->frame_name_ = frame_name_;
-  result->T_M_S_ = T_M_S_;
-  result->T_M_S_inv_ = T_M_S_inv_;
-  result->iso_surface_points_ = iso_surface_points_;
+  result->copyDataFrom(*this);
+  return result;
+}
+
+void Submap::copyDataFrom(const Submap& other) {
+  // Copy all members except for the IDs and frame name.
+  class_id_ = other.class_id_;
+  label_ = other.label_;
+  name_ = other.name_;
+  is_active_ = other.is_active_;
+  was_tracked_ = other.was_tracked_;
+  change_state_ = other.change_state_;
+  T_M_S_ = other.T_M_S_;
+  T_M_S_inv_ = other.T_M_S_inv_;
+  copyLayersFrom(other);
+  markStateUpdated();
+}
+
+void Submap::copyLayersFrom(const Submap& other) {
+  has_class_layer_ = other.has_class_layer_;
+  has_score_layer_ = other.has_score_layer_;
+  iso_surface_points_ = other.iso_surface_points_;
 
   // Deep copy all pointers.
-  result->tsdf_layer_ = std::make_shared<TsdfLayer>(*tsdf_layer_);
-  result->mesh_layer_ = std::make_shared<MeshLayer>(*mesh_layer_);
-  if (class_layer_) {
-    result->class_layer_ = class_layer_->clone();
+  tsdf_layer_ = std::make_shared<TsdfLayer>(*other.tsdf_layer_);
+  mesh_layer_ = std::make_shared<MeshLayer>(*other.mesh_layer_);
+  class_layer_.reset();
+  if (other.class_layer_) {
+    class_layer_ = other.class_layer_->clone();
   }
-  if (score_layer_) {
-    result->score_layer_ = score_layer_->clone();
+  score_layer_.reset();
+  if (other.score_layer_) {
+    score_layer_ = other.score_layer_->clone();
   }
-  result->mesh_integrator_ = std::make_unique<MeshIntegrator>(
-      result->config_.mesh, result->tsdf_layer_, result->mesh_layer_,
-      result->class_layer_, result->config_.truncation_distance);
+  mesh_integrator_ = std::make_unique<MeshIntegrator>(
+      config_.mesh, tsdf_layer_, mesh_layer_, class_layer_,
+      config_.truncation_distance);
+  updateBlockRecords();
 
   // The bounding volume can not completely be copied so it's just updated,
   // which should be identical.
-  result->bounding_volume_.update();
+  bounding_volume_.update();
+  layers_version_ = MapVersion::next();
+}
 
-  return result;
+void Submap::copyUpdatesFrom(const Submap& other, uint64_t version) {
+  // If the layers of the other submap were replaced as a whole after the
+  // version, e.g. because it was reloaded, its block versions do not cover
+  // all changes and everything is copied.
+  const bool layers_replaced = other.getLayersVersion() > version;
+  voxblox::BlockIndexList block_indices;
+  if (!layers_replaced) {
+    other.getUpdatedBlocks(version, &block_indices);
+  }
+  const bool state_changed = other.getVersion() > version;
+  if (!state_changed && block_indices.empty()) {
+    return;
+  }
+
+  // State. The activity is not copied, copies are never integrated into.
+  if (state_changed) {
+    setClassID(other.class_id_);
+    name_ = other.name_;
+    was_tracked_ = other.was_tracked_;
+    setLabel(other.label_);
+    setChangeState(other.change_state_);
+  }
+  if (layers_replaced) {
+    copyLayersFrom(other);
+    markStateUpdated();
+    return;
+  }
+  if (has_class_layer_ && !other.has_class_layer_) {
+    class_layer_.reset();
+    has_class_layer_ = false;
+    mesh_integrator_ = std::make_unique<MeshIntegrator>(
+        config_.mesh, tsdf_layer_, mesh_layer_, class_layer_,
+        config_.truncation_distance);
+    updateBlockRecords();
+  }
+  iso_surface_points_ = other.iso_surface_points_;
+
+  // Blocks.
+  for (const BlockIndex& block_index : block_indices) {
+    auto other_tsdf_block = other.tsdf_layer_->getBlockPtrByIndex(block_index);
+    if (other_tsdf_block) {
+      auto tsdf_block = tsdf_layer_->allocateBlockPtrByIndex(block_index);
+      for (size_t i = 0; i < tsdf_block->num_voxels(); ++i) {
+        tsdf_block->getVoxelByLinearIndex(i) =
+            other_tsdf_block->getVoxelByLinearIndex(i);
+      }
+      tsdf_block->set_has_data(other_tsdf_block->has_data());
+    } else {
+      tsdf_layer_->removeBlock(block_index);
+    }
+    if (has_class_layer_ && other.has_class_layer_) {
+      class_layer_->copyBlockFrom(*other.class_layer_, block_index);
+    }
+    if (has_score_layer_ && other.has_score_layer_) {
+      score_layer_->copyBlockFrom(*other.score_layer_, block_index);
+    }
+    if (other.mesh_layer_->hasMesh(block_index)) {
+      *mesh_layer_->allocateMeshPtrByIndex(block_index) =
+          other.mesh_layer_->getMeshByIndex(block_index);
+    } else {
+      mesh_layer_->removeMesh(block_index);
+    }
+    updateBlockRecord(block_index);
+    markBlockUpdated(block_index);
+  }
+  bounding_volume_.update();
 }
 
 }  // namespace panoptic_mapping
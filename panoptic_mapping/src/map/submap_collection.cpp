@@ -18,6 +18,25 @@ Submap* SubmapCollection::createSubmap(const Submap::Config& config) {
                                                  &instance_id_manager_));
   Submap* new_submap = submaps_.back().get();
   id_to_index_[new_submap->getID()] = submaps_.size() - 1;
+  version_ = MapVersion::next();
+  return new_submap;
+}
+
+Submap* SubmapCollection::addSubmapCopy(const Submap& submap) {
+  Submap* new_submap = createSubmap(submap.getConfig());
+  new_submap->copyDataFrom(submap);
+  return new_submap;
+}
+
+Submap* SubmapCollection::addSubmapCopy(const Submap& submap,
+                                        int instance_id) {
+  submaps_.emplace_back(std::unique_ptr<Submap>(
+      new Submap(submap.getConfig(), instance_id, &submap_id_manager_,
+                 &instance_id_manager_)));
+  Submap* new_submap = submaps_.back().get();
+  id_to_index_[new_submap->getID()] = submaps_.size() - 1;
+  version_ = MapVersion::next();
+  new_submap->copyDataFrom(submap);
   return new_submap;
 }
 
@@ -36,6 +55,7 @@ bool SubmapCollection::removeSubmap(int id) {
       id_index_pair.second -= 1;
     }
   }
+  version_ = MapVersion::next();
   return true;
 }
 
@@ -63,7 +83,9 @@ void SubmapCollection::clear() {
   instance_id_manager_ = InstanceIDManager();
   submap_id_manager_ = SubmapIDManager();
   instance_to_submap_ids_.clear();
+  submap_to_instance_id_.clear();
   active_freespace_submap_id_ = -1;
+  version_ = MapVersion::next();
 }
 
 void SubmapCollection::updateIDList(const std::vector<int>& id_list,
@@ -87,10 +109,38 @@ void SubmapCollection::updateIDList(const std::vector<int>& id_list,
 }
 
 void SubmapCollection::updateInstanceToSubmapIDTable() {
-  // Clear the table and add all new elements.
-  instance_to_submap_ids_ = std::unordered_map<int, std::unordered_set<int>>();
+  const auto remove_from_table = [this](int instance_id, int submap_id) {
+    auto it = instance_to_submap_ids_.find(instance_id);
+    if (it != instance_to_submap_ids_.end()) {
+      it->second.erase(submap_id);
+      if (it->second.empty()) {
+        instance_to_submap_ids_.erase(it);
+      }
+    }
+  };
+
+  // Remove all submaps that were deleted.
+  for (auto it = submap_to_instance_id_.begin();
+       it != submap_to_instance_id_.end();) {
+    if (submapIdExists(it->first)) {
+      ++it;
+      continue;
+    }
+    remove_from_table(it->second, it->first);
+    it = submap_to_instance_id_.erase(it);
+  }
+
+  // Add new submaps and move submaps whose instance changed.
   for (const Submap& submap : *this) {
+    auto it = submap_to_instance_id_.find(submap.getID());
+    if (it != submap_to_instance_id_.end()) {
+      if (it->second == submap.getInstanceID()) {
+        continue;
+      }
+      remove_from_table(it->second, submap.getID());
+    }
     instance_to_submap_ids_[submap.getInstanceID()].emplace(submap.getID());
+    submap_to_instance_id_[submap.getID()] = submap.getInstanceID();
   }
 }
 
@@ -149,6 +199,8 @@ bool SubmapCollection::loadFromFile(const std::string& file_path,
 
   // Clear the current maps.
   submaps_.clear();
+  instance_to_submap_ids_.clear();
+  submap_to_instance_id_.clear();
 
   // Open and check the file.
   std::ifstream proto_file;
@@ -186,6 +238,7 @@ bool SubmapCollection::loadFromFile(const std::string& file_path,
   }
   active_freespace_submap_id_ =
       submap_collection_proto.active_freespace_submap_id();
+  version_ = MapVersion::next();
   proto_file.close();
 
   // Recompute data that is not stored with the submap.
@@ -216,7 +269,9 @@ std::unique_ptr<SubmapCollection> SubmapCollection::clone() const {
   result->instance_id_manager_ = instance_id_manager_;
   result->id_to_index_ = id_to_index_;
   result->instance_to_submap_ids_ = instance_to_submap_ids_;
+  result->submap_to_instance_id_ = submap_to_instance_id_;
   result->active_freespace_submap_id_ = active_freespace_submap_id_;
+  result->version_ = version_;
 
   // Deep copy all the submaps to the new managers.
   for (const Submap& submap : *this) {
@@ -1,19 +1,33 @@
 #include "panoptic_mapping/map_management/layer_manipulator.h"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <utility>
+#include <vector>
 
-#include <voxblox/integrator/esdf_integrator.h>
 #include <voxblox/integrator/merge_integration.h>
 
+#include "panoptic_mapping/common/index_getter.h"
+#include "panoptic_mapping/common/thread_affinity.h"
+
 namespace panoptic_mapping {
 
 void LayerManipulator::Config::checkParams() const {
-  //  checkParamNE(error_threshold, 0.f, "error_threshold");
+  checkParamGE(redistancing_radius, 0, "redistancing_radius");
+  checkParamGT(num_threads, 0, "num_threads");
 }
 
 void LayerManipulator::Config::setupParamsAndPrinting() {
   setupParam("verbosity", &verbosity);
   setupParam("use_instance_classification", &use_instance_classification);
+  setupParam("redistancing_radius", &redistancing_radius);
+  setupParam("num_threads", &num_threads);
 }
 
 LayerManipulator::LayerManipulator(const Config& config)
@@ -33,41 +47,169 @@ void LayerManipulator::applyClassificationLayer(
     return;
   }
 
-  // Parse the tsdf layer.
+  // Process all blocks in parallel. Only voxels that do not belong to the
+  // submap are written and only belonging voxels are read as surface, so
+  // blocks can be processed independently.
   voxblox::BlockIndexList block_indices;
   tsdf_layer->getAllAllocatedBlocks(&block_indices);
-  for (auto& block_index : block_indices) {
-    TsdfBlock& tsdf_block = tsdf_layer->getBlockByIndex(block_index);
-    const ClassBlock::ConstPtr class_block =
-        class_layer.getBlockConstPtrByIndex(block_index);
-    if (!class_block) {
+  const std::vector<NeighborOffset> offsets = computeNeighborOffsets(
+      tsdf_layer->voxel_size(), tsdf_layer->voxels_per_side());
+  std::vector<BlockResult> results(block_indices.size(),
+                                   BlockResult::kUnchanged);
+  processInParallel(block_indices.size(), [&](size_t index) {
+    results[index] =
+        applyClassificationToBlock(tsdf_layer, class_layer,
+                                   block_indices[index], truncation_distance,
+                                   offsets);
+  });
+
+  // Remove blocks without useful data and flag the changed blocks for
+  // re-meshing. Meshes also span the border to the blocks in positive
+  // direction, so the neighbors in negative direction are flagged as well.
+  std::vector<BlockIndex> touched_blocks;
+  for (size_t i = 0; i < block_indices.size(); ++i) {
+    if (results[i] == BlockResult::kRemoved) {
+      tsdf_layer->removeBlock(block_indices[i]);
+      touched_blocks.push_back(block_indices[i]);
+    } else if (results[i] == BlockResult::kUpdated) {
+      tsdf_layer->getBlockByIndex(block_indices[i]).setUpdatedAll();
+      touched_blocks.push_back(block_indices[i]);
+    }
+  }
+  for (const BlockIndex& block_index : touched_blocks) {
+    for (int neighbor = 1; neighbor < 8; ++neighbor) {
+      const BlockIndex neighbor_index =
+          block_index - BlockIndex(neighbor & 1, (neighbor >> 1) & 1,
+                                   (neighbor >> 2) & 1);
+      TsdfBlock::Ptr block = tsdf_layer->getBlockPtrByIndex(neighbor_index);
+      if (block) {
+        block->setUpdated(voxblox::Update::Status::kMesh, true);
+      }
+    }
+  }
+  LOG_IF(INFO, config_.verbosity >= 3)
+      << "Applied class layer to " << block_indices.size() << " blocks, "
+      << touched_blocks.size() << " were changed or removed.";
+}
+
+LayerManipulator::BlockResult LayerManipulator::applyClassificationToBlock(
+    TsdfLayer* tsdf_layer, const ClassLayer& class_layer,
+    const BlockIndex& block_index, float truncation_distance,
+    const std::vector<NeighborOffset>& offsets) const {
+  TsdfBlock& tsdf_block = tsdf_layer->getBlockByIndex(block_index);
+  const ClassBlock::ConstPtr class_block =
+      class_layer.getBlockConstPtrByIndex(block_index);
+  if (!class_block) {
+    return BlockResult::kUnchanged;
+  }
+
+  // Neighboring blocks, indexed by (x + 1) + 3 * (y + 1) + 9 * (z + 1) for
+  // block offsets in {-1, 0, 1}. Fetched on first access.
+  std::array<const TsdfBlock*, 27> tsdf_neighbors;
+  std::array<ClassBlock::ConstPtr, 27> class_neighbors;
+  std::array<bool, 27> is_fetched;
+  is_fetched.fill(false);
+  const int voxels_per_side = tsdf_block.voxels_per_side();
+
+  // Apply the voxel data.
+  float min_distance = truncation_distance;
+  bool was_updated = false;
+  for (size_t i = 0; i < tsdf_block.num_voxels(); ++i) {
+    TsdfVoxel& tsdf_voxel = tsdf_block.getVoxelByLinearIndex(i);
+    if (tsdf_voxel.weight <= 1.0e-6) {
+      continue;
+    }
+    if (class_block->getVoxelByLinearIndex(i).belongsToSubmap()) {
+      min_distance = std::min(tsdf_voxel.distance, min_distance);
       continue;
     }
 
-    // Apply the voxel data.
-    float min_distance = truncation_distance;
-    bool was_updated = false;
-    for (size_t i = 0; i < tsdf_block.num_voxels(); ++i) {
-      TsdfVoxel& tsdf_voxel = tsdf_block.getVoxelByLinearIndex(i);
-      if (tsdf_voxel.weight <= 1.0e-6) {
+    // The voxel is now free space, its distance is bounded by the distance
+    // to the surface of the closest belonging voxel plus the distance to
+    // that voxel. Offsets are sorted by distance so the search can stop early.
+    // TODO(schmluk): Could use probability to change the weights?
+    const VoxelIndex voxel_index =
+        tsdf_block.computeVoxelIndexFromLinearIndex(i);
+    float distance = truncation_distance;
+    for (const NeighborOffset& offset : offsets) {
+      if (offset.distance >= distance) {
+        break;
+      }
+      VoxelIndex neighbor_index = voxel_index + offset.offset;
+      int neighbor = 0;
+      int stride = 1;
+      for (int axis = 0; axis < 3; ++axis, stride *= 3) {
+        int block_offset = 0;
+        if (neighbor_index[axis] < 0) {
+          block_offset = -1;
+        } else if (neighbor_index[axis] >= voxels_per_side) {
+          block_offset = 1;
+        }
+        neighbor_index[axis] -= block_offset * voxels_per_side;
+        neighbor += (block_offset + 1) * stride;
+      }
+      if (!is_fetched[neighbor]) {
+        const BlockIndex index =
+            block_index + BlockIndex(neighbor % 3 - 1, (neighbor / 3) % 3 - 1,
+                                     neighbor / 9 - 1);
+        tsdf_neighbors[neighbor] =
+            tsdf_layer->hasBlock(index) ? &tsdf_layer->getBlockByIndex(index)
+                                        : nullptr;
+        class_neighbors[neighbor] = class_layer.getBlockConstPtrByIndex(index);
+        is_fetched[neighbor] = true;
+      }
+      if (!tsdf_neighbors[neighbor] || !class_neighbors[neighbor]) {
         continue;
       }
-      if (!class_block->getVoxelByLinearIndex(i).belongsToSubmap()) {
-        // TODO(schmluk): Could get proper distance by looking up the surface.
-        // TODO(schmluk): Could use probability to change the weights?
-        tsdf_voxel.distance = truncation_distance;
-        was_updated = true;
-      } else {
-        min_distance = std::min(tsdf_voxel.distance, min_distance);
+      const size_t linear_index =
+          tsdf_neighbors[neighbor]->computeLinearIndexFromVoxelIndex(
+              neighbor_index);
+      const TsdfVoxel& neighbor_voxel =
+          tsdf_neighbors[neighbor]->getVoxelByLinearIndex(linear_index);
+      if (neighbor_voxel.weight <= 1.0e-6 ||
+          !class_neighbors[neighbor]
+               ->getVoxelByLinearIndex(linear_index)
+               .belongsToSubmap()) {
+        continue;
       }
+      distance = std::min(distance,
+                          std::abs(neighbor_voxel.distance) + offset.distance);
     }
-    if (min_distance == truncation_distance) {
-      // This block does not contain useful data anymore.
-      tsdf_layer->removeBlock(block_index);
-    } else if (was_updated) {
-      tsdf_block.setUpdatedAll();
+    tsdf_voxel.distance = distance;
+    was_updated = true;
+  }
+  if (min_distance == truncation_distance) {
+    // This block does not contain useful data anymore.
+    return BlockResult::kRemoved;
+  }
+  return was_updated ? BlockResult::kUpdated : BlockResult::kUnchanged;
+}
+
+std::vector<LayerManipulator::NeighborOffset>
+LayerManipulator::computeNeighborOffsets(float voxel_size,
+                                         int voxels_per_side) const {
+  // Offsets within a sphere of the redistancing radius, which is limited to
+  // the directly neighboring blocks.
+  const int radius = std::min(config_.redistancing_radius, voxels_per_side);
+  std::vector<NeighborOffset> offsets;
+  for (int x = -radius; x <= radius; ++x) {
+    for (int y = -radius; y <= radius; ++y) {
+      for (int z = -radius; z <= radius; ++z) {
+        const VoxelIndex offset(x, y, z);
+        if (offset.squaredNorm() == 0 ||
+            offset.squaredNorm() > radius * radius) {
+          continue;
+        }
+        offsets.push_back(
+            {offset, offset.cast<float>().norm() * voxel_size});
+      }
     }
   }
+  std::sort(offsets.begin(), offsets.end(),
+            [](const NeighborOffset& a, const NeighborOffset& b) {
+              return a.distance < b.distance;
+            });
+  return offsets;
 }
 
 void LayerManipulator::mergeSubmapAintoB(const Submap& A, Submap* B) const {
@@ -85,17 +227,17 @@ void LayerManipulator::mergeSubmapAintoB(const Submap& A, Submap* B) const {
   voxblox::BlockIndexList block_indices;
   A.getTsdfLayer().getAllAllocatedBlocks(&block_indices);
   for (const auto& block_index : block_indices) {
-    TsdfBlock::Ptr tsdf_block_B =
-        B->getTsdfLayerPtr()->allocateBlockPtrByIndex(block_index);
+    const Submap::BlockRecord blocks_B = B->allocateBlocks(block_index);
+    const TsdfBlock::Ptr& tsdf_block_B = blocks_B.tsdf;
     tsdf_block_B->setUpdatedAll();
+    B->markBlockUpdated(block_index);
     const TsdfBlock::ConstPtr tsdf_block_A =
         A.getTsdfLayer().getBlockPtrByIndex(block_index);
     ClassBlock::ConstPtr class_block_A;
     ClassBlock::Ptr class_block_B;
     if (use_class_layer) {
       class_block_A = A.getClassLayer().getBlockConstPtrByIndex(block_index);
-      class_block_B =
-          B->getClassLayerPtr()->allocateBlockPtrByIndex(block_index);
+      class_block_B = blocks_B.classification;
     }
 
     for (size_t i = 0; i < tsdf_block_B->num_voxels(); ++i) {
@@ -134,24 +276,221 @@ void LayerManipulator::mergeSubmapAintoB(const Submap& A, Submap* B) const {
   }
 }
 
-void LayerManipulator::unprojectTsdfLayer(TsdfLayer* tsdf_layer) const {
+void LayerManipulator::unprojectTsdfLayer(TsdfLayer* tsdf_layer,
+                                          float truncation_distance) const {
   CHECK_NOTNULL(tsdf_layer);
-  voxblox::EsdfIntegrator::Config config;
-  voxblox::Layer<voxblox::EsdfVoxel> esdf_layer(tsdf_layer->voxel_size(),
-                                                tsdf_layer->voxels_per_side());
-  voxblox::EsdfIntegrator integrator(config, tsdf_layer, &esdf_layer);
-  integrator.updateFromTsdfLayerBatch();
+  Timer timer("layer_manipulator/unproject_tsdf_layer");
   voxblox::BlockIndexList block_indices;
   tsdf_layer->getAllAllocatedBlocks(&block_indices);
-  for (const auto& block_index : block_indices) {
-    TsdfBlock& tsdf_block = tsdf_layer->getBlockByIndex(block_index);
-    const voxblox::Block<voxblox::EsdfVoxel>& esdf_block =
-        esdf_layer.getBlockByIndex(block_index);
-    for (size_t i = 0; i < tsdf_block.num_voxels(); ++i) {
-      tsdf_block.getVoxelByLinearIndex(i).distance =
-          esdf_block.getVoxelByLinearIndex(i).distance;
+
+  // Find all surface voxels first, since the distances are then overwritten
+  // in place.
+  std::vector<std::vector<SurfaceSeed>> seeds(block_indices.size());
+  processInParallel(block_indices.size(), [&](size_t index) {
+    seeds[index] = computeSurfaceSeeds(*tsdf_layer, block_indices[index]);
+  });
+  voxblox::AnyIndexHashMapType<size_t>::type seed_indices;
+  for (size_t i = 0; i < block_indices.size(); ++i) {
+    if (!seeds[i].empty()) {
+      seed_indices[block_indices[i]] = i;
+    }
+  }
+
+  // Propagate the distances of each block from the seeds in its neighborhood.
+  processInParallel(block_indices.size(), [&](size_t index) {
+    std::vector<const std::vector<SurfaceSeed>*> neighbor_seeds(27, nullptr);
+    for (int neighbor = 0; neighbor < 27; ++neighbor) {
+      const BlockIndex neighbor_index =
+          block_indices[index] + BlockIndex(neighbor % 3 - 1,
+                                            (neighbor / 3) % 3 - 1,
+                                            neighbor / 9 - 1);
+      auto it = seed_indices.find(neighbor_index);
+      if (it != seed_indices.end()) {
+        neighbor_seeds[neighbor] = &seeds[it->second];
+      }
+    }
+    redistanceBlock(tsdf_layer, block_indices[index], neighbor_seeds,
+                    truncation_distance);
+  });
+}
+
+void LayerManipulator::processInParallel(
+    size_t num_items, const std::function<void(size_t)>& process) const {
+  std::vector<size_t> indices(num_items);
+  std::iota(indices.begin(), indices.end(), 0);
+  IndexGetter<size_t> index_getter(indices);
+  std::vector<std::future<void>> threads;
+  for (int i = 0; i < config_.num_threads; ++i) {
+    threads.emplace_back(
+        std::async(std::launch::async, [&index_getter, &process, i]() {
+          ThreadAffinity::pinWorkerThread(i);
+          size_t index;
+          while (index_getter.getNextIndex(&index)) {
+            process(index);
+          }
+        }));
+  }
+  for (auto& thread : threads) {
+    thread.get();
+  }
+}
+
+std::vector<LayerManipulator::SurfaceSeed>
+LayerManipulator::computeSurfaceSeeds(const TsdfLayer& layer,
+                                      const BlockIndex& block_index) {
+  // A voxel is a seed if the sign changes towards any observed axis-aligned
+  // neighbor. Its distance is interpolated linearly along that axis.
+  const TsdfBlock& block = layer.getBlockByIndex(block_index);
+  const int voxels_per_side = block.voxels_per_side();
+  const float voxel_size = block.voxel_size();
+  std::vector<SurfaceSeed> seeds;
+  for (size_t i = 0; i < block.num_voxels(); ++i) {
+    const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+    if (voxel.weight <= 1.0e-6) {
+      continue;
+    }
+    const VoxelIndex voxel_index = block.computeVoxelIndexFromLinearIndex(i);
+    const float abs_distance = std::abs(voxel.distance);
+    float distance = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; ++axis) {
+      for (int direction : {-1, 1}) {
+        VoxelIndex neighbor_index = voxel_index;
+        neighbor_index[axis] += direction;
+        const TsdfVoxel* neighbor = nullptr;
+        if (neighbor_index[axis] >= 0 &&
+            neighbor_index[axis] < voxels_per_side) {
+          neighbor = &block.getVoxelByVoxelIndex(neighbor_index);
+        } else {
+          BlockIndex neighbor_block_index = block_index;
+          neighbor_block_index[axis] += direction;
+          neighbor_index[axis] -= direction * voxels_per_side;
+          const TsdfBlock::ConstPtr neighbor_block =
+              layer.getBlockPtrByIndex(neighbor_block_index);
+          if (neighbor_block) {
+            neighbor = &neighbor_block->getVoxelByVoxelIndex(neighbor_index);
+          }
+        }
+        if (!neighbor || neighbor->weight <= 1.0e-6 ||
+            (voxel.distance >= 0.f) == (neighbor->distance >= 0.f)) {
+          continue;
+        }
+        const float fraction =
+            abs_distance / (abs_distance + std::abs(neighbor->distance));
+        distance = std::min(distance, fraction * voxel_size);
+      }
+    }
+    if (distance != std::numeric_limits<float>::max()) {
+      // Projective distances are upper bounds as well.
+      seeds.push_back({voxel_index, std::min(distance, abs_distance)});
+    }
+  }
+  return seeds;
+}
+
+void LayerManipulator::redistanceBlock(
+    TsdfLayer* layer, const BlockIndex& block_index,
+    const std::vector<const std::vector<SurfaceSeed>*>& neighbor_seeds,
+    float truncation_distance) {
+  TsdfBlock& block = layer->getBlockByIndex(block_index);
+  const int voxels_per_side = block.voxels_per_side();
+  const float voxel_size = block.voxel_size();
+
+  // The block is padded by the band width such that all seeds within the
+  // band are contained, limited to the directly neighboring blocks.
+  const int padding = std::min(
+      static_cast<int>(std::ceil(truncation_distance / voxel_size)),
+      voxels_per_side);
+  const int size = voxels_per_side + 2 * padding;
+  auto cell = [size, padding](const VoxelIndex& index) {
+    return (index.x() + padding) + size * ((index.y() + padding) +
+                                           size * (index.z() + padding));
+  };
+
+  // Insert all seeds into the padded grid.
+  using QueueEntry = std::pair<float, int>;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry>>
+      queue;
+  // The padded distance grid is only initialized if there are seeds, and its
+  // memory is reused by each thread.
+  thread_local std::vector<float> distances;
+  bool has_seeds = false;
+  for (int neighbor = 0; neighbor < 27; ++neighbor) {
+    if (!neighbor_seeds[neighbor]) {
+      continue;
+    }
+    const VoxelIndex offset =
+        VoxelIndex(neighbor % 3 - 1, (neighbor / 3) % 3 - 1, neighbor / 9 - 1) *
+        voxels_per_side;
+    for (const SurfaceSeed& seed : *neighbor_seeds[neighbor]) {
+      const VoxelIndex index = seed.voxel_index + offset;
+      if ((index.array() < -padding).any() ||
+          (index.array() >= voxels_per_side + padding).any()) {
+        continue;
+      }
+      if (!has_seeds) {
+        distances.assign(size * size * size,
+                         std::numeric_limits<float>::max());
+        has_seeds = true;
+      }
+      float& distance = distances[cell(index)];
+      if (seed.distance < distance) {
+        distance = seed.distance;
+        queue.emplace(distance, cell(index));
+      }
+    }
+  }
+
+  // Brushfire through the 26-neighborhood, up to the truncation distance.
+  while (!queue.empty()) {
+    const QueueEntry entry = queue.top();
+    queue.pop();
+    if (entry.first > distances[entry.second]) {
+      continue;  // Outdated entry.
+    }
+    const int x = entry.second % size;
+    const int y = (entry.second / size) % size;
+    const int z = entry.second / (size * size);
+    for (int dx = -1; dx <= 1; ++dx) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dz = -1; dz <= 1; ++dz) {
+          const int nx = x + dx;
+          const int ny = y + dy;
+          const int nz = z + dz;
+          if (nx < 0 || ny < 0 || nz < 0 || nx >= size || ny >= size ||
+              nz >= size || (dx == 0 && dy == 0 && dz == 0)) {
+            continue;
+          }
+          const float distance =
+              entry.first +
+              voxel_size * std::sqrt(static_cast<float>(dx * dx + dy * dy +
+                                                        dz * dz));
+          const int neighbor = nx + size * (ny + size * nz);
+          if (distance < distances[neighbor] &&
+              distance < truncation_distance) {
+            distances[neighbor] = distance;
+            queue.emplace(distance, neighbor);
+          }
+        }
+      }
+    }
+  }
+
+  // Write the distances of the observed voxels, keeping their sign.
+  for (size_t i = 0; i < block.num_voxels(); ++i) {
+    TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+    if (voxel.weight <= 1.0e-6) {
+      continue;
+    }
+    float distance = truncation_distance;
+    if (has_seeds) {
+      distance = std::min(
+          distance,
+          distances[cell(block.computeVoxelIndexFromLinearIndex(i))]);
     }
+    voxel.distance = voxel.distance >= 0.f ? distance : -distance;
   }
+  block.setUpdatedAll();
 }
 
 }  // namespace panoptic_mapping
@@ -35,7 +35,15 @@ void MapManager::Config::setupParamsAndPrinting() {
              "layer_manipulator");
 }
 
-MapManager::MapManager(const Config& config) : config_(config.checkValid()) {
+MapManager::MapManager(const Config& config)
+    : config_(config.checkValid()),
+      prune_active_blocks_ticker_(
+          [this](SubmapCollection* submaps) { pruneActiveBlocks(submaps); }),
+      activity_management_ticker_(
+          [this](SubmapCollection* submaps) { manageSubmapActivity(submaps); }),
+      change_detection_ticker_([this](SubmapCollection* submaps) {
+        performChangeDetection(submaps);
+      }) {
   LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
 
   // Setup members.
@@ -47,28 +55,44 @@ MapManager::MapManager(const Config& config) : config_(config.checkValid()) {
       std::make_shared<LayerManipulator>(config_.layer_manipulator_config);
 
   // Add all requested tasks.
-  if (config_.prune_active_blocks_frequency > 0) {
-    tickers_.emplace_back(
-        config_.prune_active_blocks_frequency,
-        [this](SubmapCollection* submaps) { pruneActiveBlocks(submaps); });
-  }
-  if (config_.activity_management_frequency > 0) {
-    tickers_.emplace_back(
-        config_.activity_management_frequency,
-        [this](SubmapCollection* submaps) { manageSubmapActivity(submaps); });
-  }
-  if (config_.change_detection_frequency > 0) {
-    tickers_.emplace_back(
-        config_.change_detection_frequency,
-        [this](SubmapCollection* submaps) { performChangeDetection(submaps); });
-  }
+  prune_active_blocks_frequency_ = config_.prune_active_blocks_frequency;
+  activity_management_frequency_ = config_.activity_management_frequency;
+  change_detection_frequency_ = config_.change_detection_frequency;
+  prune_active_blocks_ticker_.setMaxTicks(prune_active_blocks_frequency_);
+  activity_management_ticker_.setMaxTicks(activity_management_frequency_);
+  change_detection_ticker_.setMaxTicks(change_detection_frequency_);
+}
+
+void MapManager::reconfigure(const PerformanceParameters& parameters) {
+  // Only actions whose frequency changed restart their tick count.
+  setFrequency(parameters.prune_active_blocks_frequency,
+               &prune_active_blocks_frequency_, &prune_active_blocks_ticker_);
+  setFrequency(parameters.activity_management_frequency,
+               &activity_management_frequency_, &activity_management_ticker_);
+  setFrequency(parameters.change_detection_frequency,
+               &change_detection_frequency_, &change_detection_ticker_);
+  LOG_IF(INFO, config_.verbosity >= 2)
+      << "Reconfigured map management frequencies (prune active blocks: "
+      << prune_active_blocks_frequency_
+      << ", activity management: " << activity_management_frequency_
+      << ", change detection: " << change_detection_frequency_ << ").";
 }
 
 void MapManager::tick(SubmapCollection* submaps) {
   // Increment counts for all tickers, which execute the requested actions.
-  for (Ticker& ticker : tickers_) {
-    ticker.tick(submaps);
+  prune_active_blocks_ticker_.tick(submaps);
+  activity_management_ticker_.tick(submaps);
+  change_detection_ticker_.tick(submaps);
+}
+
+void MapManager::setFrequency(int frequency, int* current_frequency,
+                              Ticker* ticker) {
+  // Negative frequencies leave the action unchanged.
+  if (frequency < 0 || frequency == *current_frequency) {
+    return;
   }
+  *current_frequency = frequency;
+  ticker->setMaxTicks(frequency);
 }
 
 void MapManager::pruneActiveBlocks(SubmapCollection* submaps) {
@@ -263,30 +287,20 @@ bool MapManager::mergeSubmapIfPossible(SubmapCollection* submaps, int submap_id,
 std::string MapManager::pruneBlocks(Submap* submap) const {
   auto t1 = std::chrono::high_resolution_clock::now();
   // Setup.
-  ClassLayer* class_layer = nullptr;
-  if (submap->hasClassLayer()) {
-    class_layer = submap->getClassLayerPtr().get();
-  }
-  ScoreLayer* score_layer = nullptr;
-  if (submap->hasScoreLayer()) {
-    score_layer = submap->getScoreLayerPtr().get();
-  }
-  TsdfLayer* tsdf_layer = submap->getTsdfLayerPtr().get();
-  MeshLayer* mesh_layer = submap->getMeshLayerPtr().get();
+  const TsdfLayer& tsdf_layer = submap->getTsdfLayer();
   const int voxel_indices = std::pow(submap->getConfig().voxels_per_side, 3);
   int count = 0;
 
   // Remove all blocks that don't have any belonging voxels.
   voxblox::BlockIndexList block_indices;
-  tsdf_layer->getAllAllocatedBlocks(&block_indices);
+  tsdf_layer.getAllAllocatedBlocks(&block_indices);
   for (const auto& block_index : block_indices) {
-    ClassBlock::Ptr class_block;
-    if (class_layer) {
-      if (class_layer->hasBlock(block_index)) {
-        class_block = class_layer->getBlockPtrByIndex(block_index);
-      }
+    const Submap::BlockRecord blocks = submap->getBlocks(block_index);
+    if (!blocks) {
+      continue;
     }
-    const TsdfBlock& tsdf_block = tsdf_layer->getBlockByIndex(block_index);
+    const TsdfBlock& tsdf_block = *blocks.tsdf;
+    const ClassBlock::Ptr& class_block = blocks.classification;
     bool has_beloning_voxels = false;
 
     // Check all voxels.
@@ -307,14 +321,8 @@ std::string MapManager::pruneBlocks(Submap* submap) const {
 
     // Prune blocks.
     if (!has_beloning_voxels) {
-      if (class_layer) {
-        class_layer->removeBlock(block_index);
-      }
-      if (score_layer) {
-        score_layer->removeBlock(block_index);
-      }
-      tsdf_layer->removeBlock(block_index);
-      mesh_layer->removeMesh(block_index);
+      submap->removeBlocks(block_index);
+      submap->markBlockUpdated(block_index);
       count++;
     }
   }
@@ -331,6 +339,9 @@ std::string MapManager::pruneBlocks(Submap* submap) const {
 
 void MapManager::Ticker::tick(SubmapCollection* submaps) {
   // Perform 'action' every 'max_ticks' ticks.
+  if (max_ticks_ == 0) {
+    return;
+  }
   current_tick_++;
   if (current_tick_ >= max_ticks_) {
     action_(submaps);
@@ -338,4 +349,9 @@ void MapManager::Ticker::tick(SubmapCollection* submaps) {
   }
 }
 
+void MapManager::Ticker::setMaxTicks(int max_ticks) {
+  max_ticks_ = std::max(max_ticks, 0);
+  current_tick_ = 0;
+}
+
 }  // namespace panoptic_mapping
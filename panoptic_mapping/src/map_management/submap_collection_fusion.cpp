@@ -0,0 +1,403 @@
+#include "panoptic_mapping/map_management/submap_collection_fusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <voxblox/integrator/merge_integration.h>
+
+#include "panoptic_mapping/common/index_getter.h"
+
+namespace panoptic_mapping {
+
+void SubmapCollectionFusion::Config::checkParams() const {
+  checkParamGE(max_alignment_translation, 0.f, "max_alignment_translation");
+  checkParamGE(max_alignment_rotation, 0.f, "max_alignment_rotation");
+  checkParamGT(integration_threads, 0, "integration_threads");
+  checkParamConfig(tsdf_registrator_config);
+  checkParamConfig(layer_manipulator_config);
+}
+
+void SubmapCollectionFusion::Config::setupParamsAndPrinting() {
+  setupParam("verbosity", &verbosity);
+  setupParam("merge_matching_submaps", &merge_matching_submaps);
+  setupParam("max_alignment_translation", &max_alignment_translation, "m");
+  setupParam("max_alignment_rotation", &max_alignment_rotation, "rad");
+  setupParam("integration_threads", &integration_threads);
+  setupParam("tsdf_registrator_config", &tsdf_registrator_config,
+             "tsdf_registrator");
+  setupParam("layer_manipulator_config", &layer_manipulator_config,
+             "layer_manipulator");
+}
+
+SubmapCollectionFusion::SubmapCollectionFusion(const Config& config)
+    : config_(config.checkValid()),
+      tsdf_registrator_(config_.tsdf_registrator_config),
+      layer_manipulator_(config_.layer_manipulator_config) {
+  LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
+}
+
+void SubmapCollectionFusion::fuseCollection(
+    int peer_id, const SubmapCollection& peer_submaps,
+    const Transformation& T_M_P, SubmapCollection* target) {
+  CHECK_NOTNULL(target);
+  const PeerState& peer = peers_[peer_id];
+
+  // Only submaps that changed since they were last fused are updated.
+  std::vector<int> updated_ids;
+  for (const Submap& submap : peer_submaps) {
+    auto it = peer.submaps.find(submap.getID());
+    if (it == peer.submaps.end() ||
+        (!it->second.merged &&
+         submap.getLatestVersion() > it->second.imported_version)) {
+      updated_ids.emplace_back(submap.getID());
+    }
+  }
+
+  // Everything that was fused before but no longer exists was removed.
+  std::vector<int> removed_ids;
+  for (const auto& id_fused_pair : peer.submaps) {
+    if (!peer_submaps.submapIdExists(id_fused_pair.first)) {
+      removed_ids.emplace_back(id_fused_pair.first);
+    }
+  }
+  fuseDelta(peer_id, peer_submaps, updated_ids, removed_ids, T_M_P, target);
+}
+
+void SubmapCollectionFusion::fuseDelta(int peer_id,
+                                       const SubmapCollection& peer_submaps,
+                                       const std::vector<int>& updated_ids,
+                                       const std::vector<int>& removed_ids,
+                                       const Transformation& T_M_P,
+                                       SubmapCollection* target) {
+  CHECK_NOTNULL(target);
+  Timer timer("map_management/collection_fusion");
+  PeerState& peer = peers_[peer_id];
+
+  // Remove all copies of removed peer submaps. Submaps that were merged are
+  // part of a target submap owned by the fusion and remain.
+  int num_removed = 0;
+  for (const int id : removed_ids) {
+    auto it = peer.submaps.find(id);
+    if (it == peer.submaps.end()) {
+      continue;
+    }
+    if (!it->second.merged) {
+      target->removeSubmap(it->second.target_id);
+      copy_owners_.erase(it->second.target_id);
+      num_removed++;
+    }
+    peer.submaps.erase(it);
+  }
+
+  // Import all updated peer submaps. Finished submaps become merge candidates.
+  int num_imported = 0;
+  std::vector<int> candidate_ids;
+  std::unordered_map<int, int> candidate_to_peer_id;
+  for (const int id : updated_ids) {
+    auto it = peer.submaps.find(id);
+    if (it != peer.submaps.end() && it->second.merged) {
+      continue;
+    }
+    if (!peer_submaps.submapIdExists(id)) {
+      LOG_IF(WARNING, config_.verbosity >= 1)
+          << "Peer " << peer_id << " has no submap " << id << " to fuse.";
+      continue;
+    }
+    const Submap& peer_submap = peer_submaps.getSubmap(id);
+    importSubmap(peer_id, peer_submap, T_M_P, &peer, target);
+    num_imported++;
+    if (!peer_submap.isActive() &&
+        peer_submap.getLabel() != PanopticLabel::kFreeSpace) {
+      const int target_id = peer.submaps.at(id).target_id;
+      candidate_ids.emplace_back(target_id);
+      candidate_to_peer_id[target_id] = id;
+    }
+  }
+
+  // Find matching target submaps in parallel. Submaps of the same peer are
+  // never merged since they were already separated by its own mapper, and
+  // copies of submaps other peers still integrate into are not merged into.
+  std::vector<std::pair<int, int>> matches;  // <candidate, target>
+  if (config_.merge_matching_submaps && !candidate_ids.empty()) {
+    std::unordered_set<int> excluded_ids;
+    for (const auto& target_owner_pair : copy_owners_) {
+      const int owner_id = target_owner_pair.second.first;
+      if (owner_id == peer_id ||
+          peers_.at(owner_id)
+              .submaps.at(target_owner_pair.second.second)
+              .peer_is_active) {
+        excluded_ids.insert(target_owner_pair.first);
+      }
+    }
+
+    SubmapIndexGetter index_getter(candidate_ids);
+    std::vector<std::future<std::vector<std::pair<int, int>>>> threads;
+    for (int i = 0; i < config_.integration_threads; ++i) {
+      threads.emplace_back(std::async(
+          std::launch::async,
+          [this, &index_getter, &excluded_ids, target]() {
+            std::vector<std::pair<int, int>> result;
+            int index;
+            while (index_getter.getNextIndex(&index)) {
+              const int match = findMatchingSubmap(
+                  *target, target->getSubmap(index), excluded_ids);
+              if (match >= 0) {
+                result.emplace_back(index, match);
+              }
+            }
+            return result;
+          }));
+    }
+    for (auto& thread : threads) {
+      const std::vector<std::pair<int, int>> result = thread.get();
+      matches.insert(matches.end(), result.begin(), result.end());
+    }
+  }
+
+  if (!matches.empty()) {
+    // Merged data must not be overwritten by updates of another peer, so the
+    // fusion takes ownership of all target submaps that are merged into.
+    std::unordered_map<int, std::vector<int>> target_to_candidates;
+    for (const auto& match : matches) {
+      target_to_candidates[match.second].emplace_back(match.first);
+    }
+    std::vector<int> target_ids;
+    target_ids.reserve(target_to_candidates.size());
+    for (const auto& target_candidates_pair : target_to_candidates) {
+      target_ids.emplace_back(target_candidates_pair.first);
+      takeOwnership(target_candidates_pair.first);
+    }
+
+    // Merge all candidates of a target submap in parallel, target submaps are
+    // only modified by a single thread.
+    SubmapIndexGetter index_getter(target_ids);
+    std::vector<std::future<void>> threads;
+    for (int i = 0; i < config_.integration_threads; ++i) {
+      threads.emplace_back(std::async(
+          std::launch::async,
+          [this, &index_getter, &target_to_candidates, target]() {
+            int index;
+            while (index_getter.getNextIndex(&index)) {
+              mergeIntoSubmap(target_to_candidates.at(index), target, index);
+            }
+          }));
+    }
+    for (auto& thread : threads) {
+      thread.get();
+    }
+
+    // Update the bookkeeping and remove the merged copies.
+    for (const auto& match : matches) {
+      const int peer_submap_id = candidate_to_peer_id.at(match.first);
+      const int old_instance = target->getSubmap(match.first).getInstanceID();
+      const int new_instance = target->getSubmap(match.second).getInstanceID();
+      FusedSubmap& fused = peer.submaps.at(peer_submap_id);
+      fused.target_id = match.second;
+      fused.merged = true;
+      copy_owners_.erase(match.first);
+      target->removeSubmap(match.first);
+
+      // All other submaps of the peer instance now belong to the merged
+      // instance.
+      if (old_instance == new_instance) {
+        continue;
+      }
+      for (auto& peer_instance_pair : peer.instance_ids) {
+        if (peer_instance_pair.second == old_instance) {
+          peer_instance_pair.second = new_instance;
+        }
+      }
+      for (const auto& id_fused_pair : peer.submaps) {
+        if (id_fused_pair.second.merged) {
+          continue;
+        }
+        Submap* submap = target->getSubmapPtr(id_fused_pair.second.target_id);
+        if (submap->getInstanceID() == old_instance) {
+          submap->setInstanceID(new_instance);
+        }
+      }
+    }
+  }
+  target->updateInstanceToSubmapIDTable();
+
+  LOG_IF(INFO, config_.verbosity >= 2)
+      << "Fused peer " << peer_id << ": imported " << num_imported
+      << " submaps, merged " << matches.size() << " of them, removed "
+      << num_removed << ".";
+}
+
+void SubmapCollectionFusion::importSubmap(int peer_id,
+                                          const Submap& peer_submap,
+                                          const Transformation& T_M_P,
+                                          PeerState* peer,
+                                          SubmapCollection* target) {
+  // Changes of the peer made while copying get newer versions and are
+  // imported in the next call.
+  const uint64_t version = MapVersion::current();
+  const int peer_instance = peer_submap.getInstanceID();
+  auto instance_it = peer->instance_ids.find(peer_instance);
+  auto it = peer->submaps.find(peer_submap.getID());
+  Submap* submap;
+  if (it == peer->submaps.end()) {
+    // Submaps of the same peer instance share an instance in the target.
+    if (instance_it == peer->instance_ids.end()) {
+      submap = target->addSubmapCopy(peer_submap);
+      peer->instance_ids[peer_instance] = submap->getInstanceID();
+    } else {
+      submap = target->addSubmapCopy(peer_submap, instance_it->second);
+    }
+    it = peer->submaps.emplace(peer_submap.getID(), FusedSubmap()).first;
+    it->second.target_id = submap->getID();
+    copy_owners_[submap->getID()] = {peer_id, peer_submap.getID()};
+  } else {
+    // Only copy what changed since the last import.
+    submap = target->getSubmapPtr(it->second.target_id);
+    submap->copyUpdatesFrom(peer_submap, it->second.imported_version);
+    if (instance_it != peer->instance_ids.end() &&
+        submap->getInstanceID() != instance_it->second) {
+      submap->setInstanceID(instance_it->second);
+    }
+  }
+  const Transformation T_M_S = T_M_P * peer_submap.getT_M_S();
+  if (T_M_S.getTransformationMatrix() !=
+      submap->getT_M_S().getTransformationMatrix()) {
+    submap->setT_M_S(T_M_S);
+  }
+
+  // Peer submaps are never integrated into by the local mapper. The copy
+  // keeps the change state of the peer.
+  it->second.peer_is_active = peer_submap.isActive();
+  if (submap->isActive()) {
+    submap->setIsActive(false);
+  }
+  it->second.imported_version = version;
+}
+
+void SubmapCollectionFusion::takeOwnership(int target_id) {
+  auto it = copy_owners_.find(target_id);
+  if (it == copy_owners_.end()) {
+    return;
+  }
+  peers_.at(it->second.first).submaps.at(it->second.second).merged = true;
+  copy_owners_.erase(it);
+}
+
+void SubmapCollectionFusion::resetPeer(int peer_id) {
+  peers_.erase(peer_id);
+  for (auto it = copy_owners_.begin(); it != copy_owners_.end();) {
+    if (it->second.first == peer_id) {
+      it = copy_owners_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+int SubmapCollectionFusion::findMatchingSubmap(
+    const SubmapCollection& target, const Submap& candidate,
+    const std::unordered_set<int>& excluded_ids) const {
+  if (candidate.getIsoSurfacePoints().empty()) {
+    return -1;
+  }
+  for (const Submap& other : target) {
+    if (other.getClassID() != candidate.getClassID() ||
+        other.getLabel() == PanopticLabel::kFreeSpace ||
+        other.hasClassLayer() != candidate.hasClassLayer() ||
+        other.getConfig().voxel_size != candidate.getConfig().voxel_size ||
+        other.getConfig().voxels_per_side !=
+            candidate.getConfig().voxels_per_side ||
+        excluded_ids.find(other.getID()) != excluded_ids.end() ||
+        !candidate.getBoundingVolume().intersects(other.getBoundingVolume())) {
+      continue;
+    }
+    bool submaps_match;
+    if (!tsdf_registrator_.submapsConflict(candidate, other, &submaps_match) &&
+        submaps_match) {
+      return other.getID();
+    }
+  }
+  return -1;
+}
+
+void SubmapCollectionFusion::mergeIntoSubmap(
+    const std::vector<int>& candidate_ids, SubmapCollection* target,
+    int target_id) const {
+  Submap* submap = target->getSubmapPtr(target_id);
+  for (const int id : candidate_ids) {
+    const Submap& candidate = target->getSubmap(id);
+    if (framesAreAligned(submap->getT_S_M() * candidate.getT_M_S())) {
+      layer_manipulator_.mergeSubmapAintoB(candidate, submap);
+      continue;
+    }
+
+    // Bring the candidate to the frame of the target submap first. The local
+    // ID managers keep the temporary submap out of the target collection.
+    SubmapIDManager submap_id_manager;
+    InstanceIDManager instance_id_manager;
+    Submap resampled(submap->getConfig(), &submap_id_manager,
+                     &instance_id_manager);
+    resampleSubmap(candidate, *submap, &resampled);
+    layer_manipulator_.mergeSubmapAintoB(resampled, submap);
+  }
+  submap->updateEverything();
+}
+
+void SubmapCollectionFusion::resampleSubmap(const Submap& A,
+                                            const Submap& reference,
+                                            Submap* result) {
+  const Transformation T_R_A = reference.getT_S_M() * A.getT_M_S();
+  voxblox::transformLayer(A.getTsdfLayer(), T_R_A,
+                          result->getTsdfLayerPtr().get());
+  result->updateBlockRecords();
+  if (!A.hasClassLayer() || !result->hasClassLayer()) {
+    return;
+  }
+
+  // Class voxels can not be interpolated, use the nearest voxel instead.
+  const Transformation T_A_R = T_R_A.inverse();
+  voxblox::BlockIndexList block_indices;
+  result->getTsdfLayer().getAllAllocatedBlocks(&block_indices);
+  for (const BlockIndex& block_index : block_indices) {
+    const TsdfBlock& tsdf_block =
+        result->getTsdfLayer().getBlockByIndex(block_index);
+    ClassBlock::Ptr class_block =
+        result->allocateBlocks(block_index).classification;
+    for (size_t i = 0; i < tsdf_block.num_voxels(); ++i) {
+      const Point position_A =
+          T_A_R * tsdf_block.computeCoordinatesFromLinearIndex(i);
+      const ClassVoxel* class_voxel_A =
+          A.getClassLayer().getVoxelPtrByCoordinates(position_A);
+      if (class_voxel_A) {
+        class_block->getVoxelByLinearIndex(i).mergeVoxel(*class_voxel_A);
+      }
+    }
+  }
+}
+
+bool SubmapCollectionFusion::framesAreAligned(
+    const Transformation& T_B_A) const {
+  const float angle =
+      2.f * std::acos(std::min(std::abs(T_B_A.getRotation().w()), 1.f));
+  return T_B_A.getPosition().norm() <= config_.max_alignment_translation &&
+         angle <= config_.max_alignment_rotation;
+}
+
+int SubmapCollectionFusion::getTargetSubmapID(int peer_id,
+                                              int peer_submap_id) const {
+  auto peer_it = peers_.find(peer_id);
+  if (peer_it == peers_.end()) {
+    return -1;
+  }
+  auto it = peer_it->second.submaps.find(peer_submap_id);
+  if (it == peer_it->second.submaps.end()) {
+    return -1;
+  }
+  return it->second.target_id;
+}
+
+}  // namespace panoptic_mapping
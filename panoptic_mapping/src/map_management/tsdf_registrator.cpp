@@ -11,6 +11,7 @@
 #include <voxblox/mesh/mesh_integrator.h>
 
 #include "panoptic_mapping/common/index_getter.h"
+#include "panoptic_mapping/common/thread_affinity.h"
 #include "panoptic_mapping/map/submap.h"
 #include "panoptic_mapping/map/submap_collection.h"
 
@@ -68,7 +69,8 @@ void TsdfRegistrator::checkSubmapCollectionForChange(
   std::vector<std::future<std::string>> threads;
   for (int i = 0; i < config_.integration_threads; ++i) {
     threads.emplace_back(
-        std::async(std::launch::async, [this, &index_getter, submaps]() {
+        std::async(std::launch::async, [this, &index_getter, submaps, i]() {
+          ThreadAffinity::pinWorkerThread(i);
           int index;
           std::string info;
           while (index_getter.getNextIndex(&index)) {
@@ -288,11 +290,13 @@ void TsdfRegistrator::mergeMatchingSubmaps(SubmapCollection* submaps) {
                                      target->getTsdfLayerPtr().get());
       submaps->removeSubmap(*it);
     }
+    target->updateBlockRecords();
     // Set the updated flags of the changed layer.
     voxblox::BlockIndexList block_list;
     target->getTsdfLayer().getAllAllocatedBlocks(&block_list);
     for (auto& index : block_list) {
       target->getTsdfLayerPtr()->getBlockByIndex(index).setUpdatedAll();
+      target->markBlockUpdated(index);
     }
   }
   LOG_IF(INFO, config_.verbosity >= 2)
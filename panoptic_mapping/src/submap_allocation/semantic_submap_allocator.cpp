@@ -1,5 +1,9 @@
 #include "panoptic_mapping/submap_allocation/semantic_submap_allocator.h"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 namespace panoptic_mapping {
 
 config_utilities::Factory::RegistrationRos<SubmapAllocatorBase,
@@ -14,6 +18,19 @@ void SemanticSubmapAllocator::Config::checkParams() const {
   checkParamGT(background_voxel_size, 0.f, "background_voxel_size");
   checkParamGT(unknown_voxel_size, 0.f, "unknown_voxel_size");
   checkParamNE(truncation_distance, 0.f, "truncation_distance");
+  for (const auto& key_value_pair : class_truncation_distances) {
+    checkParamNE(key_value_pair.second, 0.f,
+                 "class_truncation_distances/" + key_value_pair.first);
+  }
+  if (use_extent_voxel_size) {
+    checkParamGT(target_voxels_per_extent, 0.f, "target_voxels_per_extent");
+    checkParamGT(min_instance_voxel_size, 0.f, "min_instance_voxel_size");
+    checkParamGE(max_instance_voxel_size, min_instance_voxel_size,
+                 "max_instance_voxel_size");
+    checkParamGT(min_extent_pixels, 0, "min_extent_pixels");
+    checkParamGE(extent_outlier_fraction, 0.f, "extent_outlier_fraction");
+    checkParamLT(extent_outlier_fraction, 0.5f, "extent_outlier_fraction");
+  }
 }
 
 void SemanticSubmapAllocator::Config::setupParamsAndPrinting() {
@@ -25,6 +42,13 @@ void SemanticSubmapAllocator::Config::setupParamsAndPrinting() {
   setupParam("background_voxel_size", &background_voxel_size);
   setupParam("unknown_voxel_size", &unknown_voxel_size);
   setupParam("truncation_distance", &truncation_distance);
+  setupParam("class_truncation_distances", &class_truncation_distances);
+  setupParam("use_extent_voxel_size", &use_extent_voxel_size);
+  setupParam("target_voxels_per_extent", &target_voxels_per_extent);
+  setupParam("min_instance_voxel_size", &min_instance_voxel_size);
+  setupParam("max_instance_voxel_size", &max_instance_voxel_size);
+  setupParam("min_extent_pixels", &min_extent_pixels);
+  setupParam("extent_outlier_fraction", &extent_outlier_fraction);
 }
 
 SemanticSubmapAllocator::SemanticSubmapAllocator(const Config& config,
@@ -35,7 +59,7 @@ SemanticSubmapAllocator::SemanticSubmapAllocator(const Config& config,
 }
 
 Submap* SemanticSubmapAllocator::allocateSubmap(SubmapCollection* submaps,
-                                                InputData* /* input */,
+                                                InputData* input,
                                                 int input_id,
                                                 const LabelEntry& label) {
   Submap::Config config = config_.submap;
@@ -50,6 +74,18 @@ Submap* SemanticSubmapAllocator::allocateSubmap(SubmapCollection* submaps,
       } else {
         config.voxel_size = config_.medium_instance_voxel_size;
       }
+      float extent;
+      if (config_.use_extent_voxel_size && input &&
+          estimateExtent(*input, input_id, &extent)) {
+        config.voxel_size = std::min(
+            std::max(extent / config_.target_voxels_per_extent,
+                     config_.min_instance_voxel_size),
+            config_.max_instance_voxel_size);
+        LOG_IF(INFO, config_.verbosity >= 3)
+            << "Instance '" << label.name << "' (input ID " << input_id
+            << ") has an extent of " << extent << "m, using voxel size "
+            << config.voxel_size << "m.";
+      }
       break;
     }
     case PanopticLabel::kBackground: {
@@ -64,6 +100,14 @@ Submap* SemanticSubmapAllocator::allocateSubmap(SubmapCollection* submaps,
 
   // Set the truncation distance.
   config.truncation_distance = config_.truncation_distance;
+  auto it = config_.class_truncation_distances.find(label.name);
+  if (it == config_.class_truncation_distances.end()) {
+    it = config_.class_truncation_distances.find(
+        std::to_string(label.class_id));
+  }
+  if (it != config_.class_truncation_distances.end()) {
+    config.truncation_distance = it->second;
+  }
   if (config.truncation_distance < 0.f) {
     config.truncation_distance *= -config.voxel_size;
   }
@@ -76,4 +120,49 @@ Submap* SemanticSubmapAllocator::allocateSubmap(SubmapCollection* submaps,
   return new_submap;
 }
 
+bool SemanticSubmapAllocator::estimateExtent(const InputData& input,
+                                             int input_id,
+                                             float* extent) const {
+  if (!input.has(InputData::InputType::kSegmentationImage) ||
+      !input.has(InputData::InputType::kVertexMap)) {
+    return false;
+  }
+  const bool use_validity = input.has(InputData::InputType::kValidityImage);
+  const cv::Mat& id_image = input.idImage();
+  const cv::Mat& vertex_map = input.vertexMap();
+
+  // Collect the points of the segment in camera frame.
+  std::vector<float> coordinates[3];
+  for (int v = 0; v < id_image.rows; ++v) {
+    const int* ids = id_image.ptr<int>(v);
+    const cv::Vec3f* vertices = vertex_map.ptr<cv::Vec3f>(v);
+    const uchar* valid =
+        use_validity ? input.validityImage().ptr<uchar>(v) : nullptr;
+    for (int u = 0; u < id_image.cols; ++u) {
+      if (ids[u] != input_id || (valid && !valid[u])) {
+        continue;
+      }
+      for (int axis = 0; axis < 3; ++axis) {
+        coordinates[axis].push_back(vertices[u][axis]);
+      }
+    }
+  }
+  const size_t num_points = coordinates[0].size();
+  if (num_points < static_cast<size_t>(config_.min_extent_pixels)) {
+    return false;
+  }
+
+  // The extent is the largest side of the robust bounding box.
+  const size_t lower = num_points * config_.extent_outlier_fraction;
+  const size_t upper = num_points - 1 - lower;
+  *extent = 0.f;
+  for (std::vector<float>& values : coordinates) {
+    std::nth_element(values.begin(), values.begin() + lower, values.end());
+    const float min = values[lower];
+    std::nth_element(values.begin(), values.begin() + upper, values.end());
+    *extent = std::max(*extent, values[upper] - min);
+  }
+  return *extent > 0.f;
+}
+
 }  // namespace panoptic_mapping
@@ -0,0 +1,140 @@
+#include "panoptic_mapping/tools/frame_deduplicator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace panoptic_mapping {
+
+void FrameDeduplicator::Config::checkParams() const {
+  checkParamGE(max_translation, 0.f, "max_translation");
+  checkParamGE(max_rotation, 0.f, "max_rotation");
+  checkParamGE(depth_tolerance, 0.f, "depth_tolerance");
+  checkParamGE(max_changed_depth_ratio, 0.f, "max_changed_depth_ratio");
+  checkParamLE(max_changed_depth_ratio, 1.f, "max_changed_depth_ratio");
+  checkParamGE(max_changed_id_ratio, 0.f, "max_changed_id_ratio");
+  checkParamLE(max_changed_id_ratio, 1.f, "max_changed_id_ratio");
+  checkParamGT(pixel_stride, 0, "pixel_stride");
+  checkParamGE(max_skipped_frames, 0, "max_skipped_frames");
+}
+
+void FrameDeduplicator::Config::setupParamsAndPrinting() {
+  setupParam("verbosity", &verbosity);
+  setupParam("max_translation", &max_translation, "m");
+  setupParam("max_rotation", &max_rotation, "rad");
+  setupParam("depth_tolerance", &depth_tolerance, "m");
+  setupParam("max_changed_depth_ratio", &max_changed_depth_ratio);
+  setupParam("max_changed_id_ratio", &max_changed_id_ratio);
+  setupParam("pixel_stride", &pixel_stride);
+  setupParam("max_skipped_frames", &max_skipped_frames);
+}
+
+FrameDeduplicator::FrameDeduplicator(const Config& config)
+    : config_(config.checkValid()) {
+  LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
+}
+
+bool FrameDeduplicator::isRedundant(const InputData& input) {
+  if (!has_reference_ ||
+      (config_.max_skipped_frames > 0 &&
+       num_consecutive_skipped_ >= config_.max_skipped_frames)) {
+    setReference(input);
+    return false;
+  }
+
+  // Check the sensor motion first since it is cheapest.
+  const Transformation T_ref_C = T_M_C_.inverse() * input.T_M_C();
+  const float angle =
+      2.f * std::acos(std::min(std::abs(T_ref_C.getRotation().w()), 1.f));
+  bool is_redundant = T_ref_C.getPosition().norm() <= config_.max_translation &&
+                      angle <= config_.max_rotation;
+
+  // Compare the images.
+  if (is_redundant) {
+    is_redundant =
+        depthChangeRatio(input.depthImage(), input.depthScale()) <=
+        config_.max_changed_depth_ratio;
+  }
+  if (is_redundant && input.has(InputData::InputType::kSegmentationImage)) {
+    is_redundant =
+        idChangeRatio(input.idImage()) <= config_.max_changed_id_ratio;
+  }
+
+  if (!is_redundant) {
+    setReference(input);
+    return false;
+  }
+  num_consecutive_skipped_++;
+  num_skipped_frames_++;
+  LOG_IF(INFO, config_.verbosity >= 3)
+      << "Skipping redundant frame (" << num_consecutive_skipped_
+      << " consecutive, " << num_skipped_frames_ << " total).";
+  return true;
+}
+
+void FrameDeduplicator::reset() {
+  has_reference_ = false;
+  num_consecutive_skipped_ = 0;
+}
+
+void FrameDeduplicator::setReference(const InputData& input) {
+  has_reference_ = true;
+  num_consecutive_skipped_ = 0;
+  T_M_C_ = input.T_M_C();
+  depth_image_ = input.depthImage().clone();
+  depth_scale_ = input.depthScale();
+  if (input.has(InputData::InputType::kSegmentationImage)) {
+    id_image_ = input.idImage().clone();
+  } else {
+    id_image_ = cv::Mat();
+  }
+}
+
+float FrameDeduplicator::depthChangeRatio(const cv::Mat& depth_image,
+                                          float depth_scale) const {
+  if (depth_image.size() != depth_image_.size()) {
+    return 1.f;
+  }
+  int num_compared = 0;
+  int num_changed = 0;
+  for (int v = 0; v < depth_image.rows; v += config_.pixel_stride) {
+    for (int u = 0; u < depth_image.cols; u += config_.pixel_stride) {
+      const float depth = depthAt(depth_image, depth_scale, v, u);
+      const float reference = depthAt(depth_image_, depth_scale_, v, u);
+      const bool is_valid = std::isfinite(depth) && depth > 0.f;
+      const bool reference_is_valid =
+          std::isfinite(reference) && reference > 0.f;
+      if (!is_valid && !reference_is_valid) {
+        continue;
+      }
+      num_compared++;
+      if (is_valid != reference_is_valid ||
+          std::abs(depth - reference) > config_.depth_tolerance) {
+        num_changed++;
+      }
+    }
+  }
+  return num_compared == 0 ? 0.f
+                           : static_cast<float>(num_changed) / num_compared;
+}
+
+float FrameDeduplicator::idChangeRatio(const cv::Mat& id_image) const {
+  if (id_image.size() != id_image_.size()) {
+    return 1.f;
+  }
+  int num_compared = 0;
+  int num_changed = 0;
+  for (int v = 0; v < id_image.rows; v += config_.pixel_stride) {
+    const int* row = id_image.ptr<int>(v);
+    const int* reference_row = id_image_.ptr<int>(v);
+    for (int u = 0; u < id_image.cols; u += config_.pixel_stride) {
+      num_compared++;
+      if (row[u] != reference_row[u]) {
+        num_changed++;
+      }
+    }
+  }
+  return num_compared == 0 ? 0.f
+                           : static_cast<float>(num_changed) / num_compared;
+}
+
+}  // namespace panoptic_mapping
@@ -1,15 +1,30 @@
 #include "panoptic_mapping/tools/map_renderer.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <future>
+#include <limits>
 #include <string>
+#include <vector>
+
+#include "panoptic_mapping/common/index_getter.h"
+#include "panoptic_mapping/common/thread_affinity.h"
 
 namespace panoptic_mapping {
 
-void MapRenderer::Config::checkParams() const {}
+void MapRenderer::Config::checkParams() const {
+  checkParamCond(rendering_mode == "vertices" || rendering_mode == "triangles",
+                 "Unknown rendering_mode '" + rendering_mode +
+                     "', supported are {vertices, triangles}.");
+  checkParamGT(num_threads, 0, "num_threads");
+}
 
 void MapRenderer::Config::setupParamsAndPrinting() {
   setupParam("verbosity", &verbosity);
+  setupParam("rendering_mode", &rendering_mode);
   setupParam("impaint_voxel_size", &impaint_voxel_size);
+  setupParam("num_threads", &num_threads);
 }
 
 MapRenderer::MapRenderer(const Config& config, const Camera::Config& camera,
@@ -20,12 +35,40 @@ MapRenderer::MapRenderer(const Config& config, const Camera::Config& camera,
 
   // Allocate range image.
   range_image_ = Eigen::MatrixXf(camera.height, camera.width);
+
+  if (config_.rendering_mode == "triangles" &&
+      camera_.getDistortionModel() != Camera::DistortionModel::kPinhole) {
+    LOG(WARNING) << "Triangle rasterization requires a pinhole camera, "
+                    "rendering mesh vertices instead.";
+  }
 }
 
 cv::Mat MapRenderer::render(const SubmapCollection& submaps,
                             const Transformation& T_M_C,
                             bool only_active_submaps,
                             int (*paint)(const Submap&)) {
+  if (config_.rendering_mode == "triangles" &&
+      camera_.getDistortionModel() == Camera::DistortionModel::kPinhole) {
+    return renderTriangles(submaps, T_M_C, only_active_submaps, paint);
+  }
+  return renderVertices(submaps, T_M_C, only_active_submaps, paint);
+}
+
+bool MapRenderer::isRendered(const Submap& submap, const Transformation& T_M_C,
+                             bool only_active_submaps) const {
+  if (!submap.isActive() && only_active_submaps) {
+    return false;
+  }
+  if (submap.getLabel() == PanopticLabel::kFreeSpace) {
+    return false;
+  }
+  return camera_.submapIsInViewFrustum(submap, T_M_C);
+}
+
+cv::Mat MapRenderer::renderVertices(const SubmapCollection& submaps,
+                                    const Transformation& T_M_C,
+                                    bool only_active_submaps,
+                                    int (*paint)(const Submap&)) {
   // Use the mesh vertices as an approximation to render active submaps.
   // Assumes that all active submap meshes are up to date and does not perform
   // a meshing step of its own. Very inefficient due to pixel duplicates.
@@ -38,13 +81,7 @@ cv::Mat MapRenderer::render(const SubmapCollection& submaps,
   // Parse all submaps.
   for (const Submap& submap : submaps) {
     // Filter out submaps.
-    if (!submap.isActive() && only_active_submaps) {
-      continue;
-    }
-    if (submap.getLabel() == PanopticLabel::kFreeSpace) {
-      continue;
-    }
-    if (!camera_.submapIsInViewFrustum(submap, T_M_C)) {
+    if (!isRendered(submap, T_M_C, only_active_submaps)) {
       continue;
     }
 
@@ -98,6 +135,209 @@ cv::Mat MapRenderer::render(const SubmapCollection& submaps,
   return result;
 }
 
+cv::Mat MapRenderer::renderTriangles(const SubmapCollection& submaps,
+                                     const Transformation& T_M_C,
+                                     bool only_active_submaps,
+                                     int (*paint)(const Submap&)) {
+  // Rasterize the mesh triangles with a depth buffer. Assumes that all
+  // rendered submap meshes are up to date. The cost is bounded by the number
+  // of triangles in the view frustum and the covered image area.
+  const int width = camera_.getConfig().width;
+  const int height = camera_.getConfig().height;
+  range_image_.setConstant(std::numeric_limits<float>::max());
+  cv::Mat result = cv::Mat::ones(height, width, CV_32SC1) * -1;
+
+  // Collect the submaps to render.
+  std::vector<int> submap_ids;
+  for (const Submap& submap : submaps) {
+    if (isRendered(submap, T_M_C, only_active_submaps)) {
+      submap_ids.push_back(submap.getID());
+    }
+  }
+
+  // Project the triangles of all visible mesh blocks in parallel.
+  std::vector<ScreenTriangle> triangles;
+  {
+    Timer timer("map_renderer/project_triangles");
+    SubmapIndexGetter index_getter(submap_ids);
+    std::vector<std::future<std::vector<ScreenTriangle>>> threads;
+    for (int i = 0; i < config_.num_threads; ++i) {
+      threads.emplace_back(std::async(
+          std::launch::async,
+          [this, i, &index_getter, &submaps, &T_M_C,
+           paint]() -> std::vector<ScreenTriangle> {
+            ThreadAffinity::pinWorkerThread(i);
+            std::vector<ScreenTriangle> result;
+            int id;
+            while (index_getter.getNextIndex(&id)) {
+              const Submap& submap = submaps.getSubmap(id);
+              projectTriangles(submap, T_M_C, (*paint)(submap), &result);
+            }
+            return result;
+          }));
+    }
+    for (auto& thread : threads) {
+      std::vector<ScreenTriangle> thread_triangles = thread.get();
+      triangles.insert(triangles.end(), thread_triangles.begin(),
+                       thread_triangles.end());
+    }
+  }
+
+  // Sort the triangles into bands of image rows, such that each band can be
+  // rasterized independently.
+  Timer timer("map_renderer/rasterize_triangles");
+  const int num_bands = std::min(height, config_.num_threads * 4);
+  const int band_height = (height + num_bands - 1) / num_bands;
+  std::vector<std::vector<size_t>> bands(num_bands);
+  for (size_t i = 0; i < triangles.size(); ++i) {
+    const ScreenTriangle& triangle = triangles[i];
+    const auto u_range =
+        std::minmax({triangle.u[0], triangle.u[1], triangle.u[2]});
+    const auto v_range =
+        std::minmax({triangle.v[0], triangle.v[1], triangle.v[2]});
+    if (u_range.second < 0.f || u_range.first > width - 1 ||
+        v_range.second < 0.f || v_range.first > height - 1) {
+      continue;
+    }
+    const int v_min = std::max(0, static_cast<int>(std::ceil(v_range.first)));
+    const int v_max =
+        std::min(height - 1, static_cast<int>(std::floor(v_range.second)));
+    for (int band = v_min / band_height; band <= v_max / band_height; ++band) {
+      bands[band].push_back(i);
+    }
+  }
+
+  // Rasterize all bands in parallel. Each band only writes its own rows.
+  std::vector<int> band_indices(num_bands);
+  for (int i = 0; i < num_bands; ++i) {
+    band_indices[i] = i;
+  }
+  IndexGetter<int> band_getter(band_indices);
+  std::vector<std::future<void>> threads;
+  for (int i = 0; i < config_.num_threads; ++i) {
+    threads.emplace_back(std::async(
+        std::launch::async,
+        [this, i, &band_getter, &bands, &triangles, &result, band_height,
+         height]() {
+          ThreadAffinity::pinWorkerThread(i);
+          int band;
+          while (band_getter.getNextIndex(&band)) {
+            rasterizeTriangles(triangles, bands[band], band * band_height,
+                               std::min(height, (band + 1) * band_height),
+                               &result);
+          }
+        }));
+  }
+  for (auto& thread : threads) {
+    thread.get();
+  }
+  LOG_IF(INFO, config_.verbosity >= 4)
+      << "Rasterized " << triangles.size() << " triangles of "
+      << submap_ids.size() << " submaps.";
+  return result;
+}
+
+void MapRenderer::projectTriangles(
+    const Submap& submap, const Transformation& T_M_C, int value,
+    std::vector<ScreenTriangle>* triangles) const {
+  const Transformation T_C_S = T_M_C.inverse() * submap.getT_M_S();
+  const float block_size = submap.getTsdfLayer().block_size();
+  const float block_diag_half = std::sqrt(3.0f) * block_size / 2.0f;
+  const float min_depth = std::max(camera_.getConfig().min_range, 1e-3f);
+
+  voxblox::BlockIndexList index_list;
+  submap.getMeshLayer().getAllAllocatedMeshes(&index_list);
+  for (const voxblox::BlockIndex& index : index_list) {
+    // Mesh blocks share the indices of the TSDF blocks they were created from.
+    if (!submap.getTsdfLayer().hasBlock(index) ||
+        !camera_.blockIsInViewFrustum(submap, index, T_C_S, block_size,
+                                      block_diag_half)) {
+      continue;
+    }
+    const voxblox::Mesh& mesh = submap.getMeshLayer().getMeshByIndex(index);
+    const bool is_indexed = !mesh.indices.empty();
+    const size_t num_corners =
+        is_indexed ? mesh.indices.size() : mesh.vertices.size();
+    for (size_t i = 0; i + 2 < num_corners; i += 3) {
+      ScreenTriangle triangle;
+      triangle.value = value;
+      bool is_valid = true;
+      for (int corner = 0; corner < 3; ++corner) {
+        const Point p_C =
+            T_C_S * mesh.vertices[is_indexed ? mesh.indices[i + corner]
+                                             : i + corner];
+        // Triangles reaching behind the near plane are not clipped but
+        // skipped.
+        if (p_C.z() < min_depth) {
+          is_valid = false;
+          break;
+        }
+        triangle.u[corner] =
+            p_C.x() * camera_.getConfig().fx / p_C.z() + camera_.getConfig().vx;
+        triangle.v[corner] =
+            p_C.y() * camera_.getConfig().fy / p_C.z() + camera_.getConfig().vy;
+        triangle.inverse_depth[corner] = 1.f / p_C.z();
+      }
+      if (is_valid) {
+        triangles->push_back(triangle);
+      }
+    }
+  }
+}
+
+void MapRenderer::rasterizeTriangles(
+    const std::vector<ScreenTriangle>& triangles,
+    const std::vector<size_t>& indices, int v_begin, int v_end,
+    cv::Mat* result) {
+  const int width = camera_.getConfig().width;
+  for (const size_t index : indices) {
+    const ScreenTriangle& t = triangles[index];
+    const float area = (t.u[1] - t.u[0]) * (t.v[2] - t.v[0]) -
+                       (t.u[2] - t.u[0]) * (t.v[1] - t.v[0]);
+    if (std::abs(area) < 1e-6f) {
+      continue;
+    }
+    const float inv_area = 1.f / area;
+
+    // Pixel centers within the bounding box and the band.
+    const auto u_range = std::minmax({t.u[0], t.u[1], t.u[2]});
+    const auto v_range = std::minmax({t.v[0], t.v[1], t.v[2]});
+    const int u_min = std::max(0, static_cast<int>(std::ceil(u_range.first)));
+    const int u_max =
+        std::min(width - 1, static_cast<int>(std::floor(u_range.second)));
+    const int v_min =
+        std::max(v_begin, static_cast<int>(std::ceil(v_range.first)));
+    const int v_max =
+        std::min(v_end - 1, static_cast<int>(std::floor(v_range.second)));
+
+    for (int v = v_min; v <= v_max; ++v) {
+      int* row = result->ptr<int>(v);
+      for (int u = u_min; u <= u_max; ++u) {
+        // Barycentric coordinates, both windings are rendered.
+        const float w0 = ((t.u[1] - u) * (t.v[2] - v) -
+                          (t.u[2] - u) * (t.v[1] - v)) *
+                         inv_area;
+        const float w1 = ((t.u[2] - u) * (t.v[0] - v) -
+                          (t.u[0] - u) * (t.v[2] - v)) *
+                         inv_area;
+        const float w2 = 1.f - w0 - w1;
+        if (w0 < 0.f || w1 < 0.f || w2 < 0.f) {
+          continue;
+        }
+
+        // Perspective correct depth interpolation.
+        const float depth =
+            1.f / (w0 * t.inverse_depth[0] + w1 * t.inverse_depth[1] +
+                   w2 * t.inverse_depth[2]);
+        if (depth < range_image_(v, u)) {
+          range_image_(v, u) = depth;
+          row[u] = t.value;
+        }
+      }
+    }
+  }
+}
+
 int MapRenderer::paintSubmapID(const Submap& submap) { return submap.getID(); }
 
 int MapRenderer::paintClass(const Submap& submap) {
@@ -0,0 +1,328 @@
+#include "panoptic_mapping/tools/online_evaluator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "panoptic_mapping/common/index_getter.h"
+
+namespace panoptic_mapping {
+
+void OnlineEvaluator::Config::checkParams() const {
+  checkParamGT(maximum_distance, 0.f, "maximum_distance");
+  checkParamGE(inlier_distance, 0.f, "inlier_distance");
+  checkParamGT(cell_size, 0.f, "cell_size");
+  checkParamGT(num_threads, 0, "num_threads");
+}
+
+void OnlineEvaluator::Config::setupParamsAndPrinting() {
+  setupParam("verbosity", &verbosity);
+  setupParam("maximum_distance", &maximum_distance, "m");
+  setupParam("inlier_distance", &inlier_distance, "m");
+  setupParam("ignore_truncated_points", &ignore_truncated_points);
+  setupParam("is_single_tsdf", &is_single_tsdf);
+  setupParam("cell_size", &cell_size, "m");
+  setupParam("num_threads", &num_threads);
+}
+
+void OnlineEvaluator::Statistics::add(const Statistics& other) {
+  observed_points += other.observed_points;
+  unknown_points += other.unknown_points;
+  truncated_points += other.truncated_points;
+  inliers += other.inliers;
+  num_errors += other.num_errors;
+  error_sum += other.error_sum;
+  squared_error_sum += other.squared_error_sum;
+}
+
+void OnlineEvaluator::Statistics::subtract(const Statistics& other) {
+  observed_points -= other.observed_points;
+  unknown_points -= other.unknown_points;
+  truncated_points -= other.truncated_points;
+  inliers -= other.inliers;
+  num_errors -= other.num_errors;
+  error_sum -= other.error_sum;
+  squared_error_sum -= other.squared_error_sum;
+}
+
+OnlineEvaluator::OnlineEvaluator(const Config& config)
+    : config_(config.checkValid()) {
+  LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
+}
+
+void OnlineEvaluator::setGroundTruth(const std::vector<Point>& points) {
+  cells_.clear();
+  const float cell_size_inv = 1.f / config_.cell_size;
+  for (const Point& point : points) {
+    cells_[voxblox::getGridIndexFromPoint<voxblox::BlockIndex>(point,
+                                                                cell_size_inv)]
+        .points.push_back(point);
+  }
+  total_points_ = points.size();
+  reset();
+  LOG_IF(INFO, config_.verbosity >= 2)
+      << "Set " << total_points_ << " ground truth points in " << cells_.size()
+      << " cells.";
+}
+
+void OnlineEvaluator::reset() {
+  // All points are considered unknown until the next update evaluates them.
+  dirty_cells_.clear();
+  for (auto& index_cell_pair : cells_) {
+    Cell& cell = index_cell_pair.second;
+    cell.statistics = Statistics();
+    cell.statistics.unknown_points = cell.points.size();
+    dirty_cells_.insert(index_cell_pair.first);
+  }
+  total_ = Statistics();
+  total_.unknown_points = total_points_;
+  submap_records_.clear();
+  previous_submaps_ = nullptr;
+  evaluated_version_ = 0;
+  computeMetrics();
+}
+
+const OnlineEvaluator::Metrics& OnlineEvaluator::update(
+    const SubmapCollection& submaps) {
+  Timer timer("online_evaluation/update");
+
+  // Lookups are only valid for the collection the records were built from.
+  if (&submaps != previous_submaps_) {
+    reset();
+    previous_submaps_ = &submaps;
+  }
+
+  // Read the version first so changes during the update are caught next time.
+  const uint64_t version = MapVersion::current();
+
+  // Find all cells that can be affected by changes of the map.
+  std::unordered_set<int> existing_submaps;
+  for (const Submap& submap : submaps) {
+    existing_submaps.insert(submap.getID());
+    const bool is_new =
+        submap_records_.find(submap.getID()) == submap_records_.end();
+    SubmapRecord& record = submap_records_[submap.getID()];
+    voxblox::BlockIndexList block_indices;
+    if (is_new || record.version != submap.getVersion()) {
+      // New submaps or changes of the submap state affect the previous and the
+      // current extent of the submap.
+      markRecord(record);
+      record = SubmapRecord();
+      record.version = submap.getVersion();
+      submap.getTsdfLayer().getAllAllocatedBlocks(&block_indices);
+    } else {
+      // Otherwise only the blocks that were updated or removed.
+      submap.getUpdatedBlocks(evaluated_version_, &block_indices);
+    }
+    for (const voxblox::BlockIndex& block_index : block_indices) {
+      markBlock(submap, block_index, &record);
+    }
+  }
+
+  // Deleted submaps.
+  for (auto it = submap_records_.begin(); it != submap_records_.end();) {
+    if (existing_submaps.find(it->first) == existing_submaps.end()) {
+      markRecord(it->second);
+      it = submap_records_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  evaluated_version_ = version;
+
+  // Re-evaluate the affected cells in parallel.
+  std::vector<Cell*> cells;
+  cells.reserve(dirty_cells_.size());
+  for (const voxblox::BlockIndex& index : dirty_cells_) {
+    cells.push_back(&cells_.at(index));
+  }
+  dirty_cells_.clear();
+  std::vector<Statistics> statistics(cells.size());
+  std::vector<int> indices(cells.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    indices[i] = i;
+  }
+  IndexGetter<int> index_getter(indices);
+
+  // NOTE: The planning interface only borrows the submaps for this update.
+  const PlanningInterface planning(
+      std::shared_ptr<const SubmapCollection>(std::shared_ptr<void>(),
+                                              &submaps));
+  std::vector<std::future<void>> threads;
+  for (int i = 0; i < config_.num_threads; ++i) {
+    threads.emplace_back(std::async(
+        std::launch::async,
+        [this, &index_getter, &cells, &statistics, &planning]() {
+          int index;
+          while (index_getter.getNextIndex(&index)) {
+            statistics[index] = this->evaluateCell(*cells[index], planning);
+          }
+        }));
+  }
+  for (auto& thread : threads) {
+    thread.get();
+  }
+
+  // Replace the previous statistics of the cells.
+  for (size_t i = 0; i < cells.size(); ++i) {
+    total_.subtract(cells[i]->statistics);
+    total_.add(statistics[i]);
+    cells[i]->statistics = statistics[i];
+  }
+  metrics_.updated_cells = cells.size();
+  computeMetrics();
+  LOG_IF(INFO, config_.verbosity >= 3)
+      << "Re-evaluated " << cells.size() << " of " << cells_.size()
+      << " cells, RMSE: " << metrics_.rmse
+      << "m, coverage: " << metrics_.coverage << ".";
+  return metrics_;
+}
+
+void OnlineEvaluator::markBlock(const Submap& submap,
+                                const voxblox::BlockIndex& block_index,
+                                SubmapRecord* record) {
+  // Bounding box of the block in mission frame. Interpolation can reach one
+  // voxel into neighboring blocks.
+  const float block_size = submap.getTsdfLayer().block_size();
+  const float voxel_size = submap.getTsdfLayer().voxel_size();
+  const Point origin =
+      voxblox::getOriginPointFromGridIndex(block_index, block_size) -
+      Point::Constant(voxel_size);
+  const float extent = block_size + 2.f * voxel_size;
+  Point min_point = Point::Constant(std::numeric_limits<float>::max());
+  Point max_point = Point::Constant(std::numeric_limits<float>::lowest());
+  for (int corner = 0; corner < 8; ++corner) {
+    const Point corner_S =
+        origin + extent * Point(corner & 1, (corner >> 1) & 1, corner >> 2);
+    const Point corner_M = submap.getT_M_S() * corner_S;
+    min_point = min_point.cwiseMin(corner_M);
+    max_point = max_point.cwiseMax(corner_M);
+  }
+  const float cell_size_inv = 1.f / config_.cell_size;
+  const voxblox::BlockIndex min_cell =
+      voxblox::getGridIndexFromPoint<voxblox::BlockIndex>(min_point,
+                                                          cell_size_inv);
+  const voxblox::BlockIndex max_cell =
+      voxblox::getGridIndexFromPoint<voxblox::BlockIndex>(max_point,
+                                                          cell_size_inv);
+
+  // Extend the extent of the submap.
+  if (record->has_blocks) {
+    record->min_cell = record->min_cell.cwiseMin(min_cell);
+    record->max_cell = record->max_cell.cwiseMax(max_cell);
+  } else {
+    record->min_cell = min_cell;
+    record->max_cell = max_cell;
+    record->has_blocks = true;
+  }
+
+  // Mark all cells containing ground truth points.
+  voxblox::BlockIndex index;
+  for (index.x() = min_cell.x(); index.x() <= max_cell.x(); ++index.x()) {
+    for (index.y() = min_cell.y(); index.y() <= max_cell.y(); ++index.y()) {
+      for (index.z() = min_cell.z(); index.z() <= max_cell.z(); ++index.z()) {
+        if (cells_.find(index) != cells_.end()) {
+          dirty_cells_.insert(index);
+        }
+      }
+    }
+  }
+}
+
+void OnlineEvaluator::markRecord(const SubmapRecord& record) {
+  if (!record.has_blocks) {
+    return;
+  }
+  const Eigen::Vector3i extent = record.max_cell - record.min_cell;
+  if ((extent.cast<int64_t>().array() + 1).prod() >
+      static_cast<int64_t>(cells_.size())) {
+    // Large extents are cheaper to check by iterating over the cells.
+    for (const auto& index_cell_pair : cells_) {
+      const voxblox::BlockIndex& index = index_cell_pair.first;
+      if ((index.array() >= record.min_cell.array()).all() &&
+          (index.array() <= record.max_cell.array()).all()) {
+        dirty_cells_.insert(index);
+      }
+    }
+    return;
+  }
+  voxblox::BlockIndex index;
+  for (index.x() = record.min_cell.x(); index.x() <= record.max_cell.x();
+       ++index.x()) {
+    for (index.y() = record.min_cell.y(); index.y() <= record.max_cell.y();
+         ++index.y()) {
+      for (index.z() = record.min_cell.z(); index.z() <= record.max_cell.z();
+           ++index.z()) {
+        if (cells_.find(index) != cells_.end()) {
+          dirty_cells_.insert(index);
+        }
+      }
+    }
+  }
+}
+
+OnlineEvaluator::Statistics OnlineEvaluator::evaluateCell(
+    const Cell& cell, const PlanningInterface& planning) const {
+  // Same metrics as MapEvaluator::computeReconstructionError().
+  Statistics result;
+  for (const Point& point : cell.points) {
+    float distance;
+    bool observed;
+    if (config_.is_single_tsdf) {
+      observed = planning.getDistance(point, &distance, false, true);
+    } else {
+      observed = planning.getDistance(point, &distance, true, false);
+    }
+    if (!observed) {
+      result.unknown_points++;
+      continue;
+    }
+    result.observed_points++;
+    float error = std::abs(distance);
+    if (error <= config_.inlier_distance) {
+      result.inliers++;
+    }
+    if (error > config_.maximum_distance) {
+      result.truncated_points++;
+      if (config_.ignore_truncated_points) {
+        continue;
+      }
+      error = config_.maximum_distance;
+    }
+    result.num_errors++;
+    result.error_sum += error;
+    result.squared_error_sum += error * error;
+  }
+  return result;
+}
+
+void OnlineEvaluator::computeMetrics() {
+  metrics_.total_points = total_points_;
+  metrics_.unknown_points = total_.unknown_points;
+  metrics_.truncated_points = total_.truncated_points;
+  metrics_.inliers = total_.inliers;
+  metrics_.coverage =
+      total_points_ == 0
+          ? 0.f
+          : static_cast<float>(total_.observed_points) / total_points_;
+  const double n = total_.num_errors;
+  if (n == 0) {
+    metrics_.mean_error = 0.f;
+    metrics_.rmse = 0.f;
+    metrics_.stddev_error = 0.f;
+    return;
+  }
+  const double mean = total_.error_sum / n;
+  metrics_.mean_error = mean;
+  metrics_.rmse = std::sqrt(total_.squared_error_sum / n);
+  metrics_.stddev_error =
+      n > 2 ? std::sqrt(std::max(
+                  0.0, (total_.squared_error_sum - n * mean * mean) / (n - 1)))
+            : 0.f;
+}
+
+}  // namespace panoptic_mapping
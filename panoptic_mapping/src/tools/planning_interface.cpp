@@ -1,6 +1,7 @@
 #include "panoptic_mapping/tools/planning_interface.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <memory>
 #include <utility>
@@ -10,9 +11,25 @@
 
 namespace panoptic_mapping {
 
+void PlanningInterface::Config::checkParams() const {
+  checkParamGT(cache_voxel_size, 0.f, "cache_voxel_size");
+  checkParamGT(cache_voxels_per_side, 0, "cache_voxels_per_side");
+  checkParamGT(cache_max_blocks, 0, "cache_max_blocks");
+}
+
+void PlanningInterface::Config::setupParamsAndPrinting() {
+  setupParam("verbosity", &verbosity);
+  setupParam("use_cache", &use_cache);
+  setupParam("cache_voxel_size", &cache_voxel_size, "m");
+  setupParam("cache_voxels_per_side", &cache_voxels_per_side);
+  setupParam("cache_max_blocks", &cache_max_blocks);
+}
+
 PlanningInterface::PlanningInterface(
-    std::shared_ptr<const SubmapCollection> submaps)
-    : submaps_(std::move(submaps)) {}
+    std::shared_ptr<const SubmapCollection> submaps, const Config& config)
+    : config_(config.checkValid()), submaps_(std::move(submaps)) {
+  LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
+}
 
 bool PlanningInterface::isObserved(const Point& position,
                                    bool consider_change_state,
@@ -39,6 +56,29 @@ bool PlanningInterface::isObserved(const Point& position,
 PlanningInterface::VoxelState PlanningInterface::getVoxelState(
     const Point& position) const {
   Timer timer("planning_interface/get_voxel_state");
+  if (!config_.use_cache) {
+    return computeVoxelState(position);
+  }
+  const voxblox::GlobalIndex voxel_index =
+      voxblox::getGridIndexFromPoint<voxblox::GlobalIndex>(
+          position, 1.f / config_.cache_voxel_size);
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  CacheBlock* block = getCacheBlock(voxel_index);
+  if (block->voxel_states.empty()) {
+    block->voxel_states.resize(std::pow(config_.cache_voxels_per_side, 3),
+                               -1);
+  }
+  int8_t& state = block->voxel_states[cacheLinearIndex(voxel_index)];
+  if (state < 0) {
+    state = static_cast<int8_t>(
+        computeVoxelState(voxblox::getCenterPointFromGridIndex(
+            voxel_index, config_.cache_voxel_size)));
+  }
+  return static_cast<VoxelState>(state);
+}
+
+PlanningInterface::VoxelState PlanningInterface::computeVoxelState(
+    const Point& position) const {
   bool is_known_free = false;
   bool is_expected_free = false;
   bool is_expected_occupied = false;
@@ -120,8 +160,44 @@ bool PlanningInterface::getDistance(const Point& position, float* distance,
                                     bool consider_change_state,
                                     bool include_free_space) const {
   Timer timer("planning_interface/get_distance");
-  // Get the Tsdf distance. Return whether the point was observed.
   CHECK_NOTNULL(distance);
+  if (!config_.use_cache) {
+    return computeDistance(position, distance, consider_change_state,
+                           include_free_space);
+  }
+  const voxblox::GlobalIndex voxel_index =
+      voxblox::getGridIndexFromPoint<voxblox::GlobalIndex>(
+          position, 1.f / config_.cache_voxel_size);
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  CacheBlock* block = getCacheBlock(voxel_index);
+  std::vector<float>& distances =
+      block->distances[2 * consider_change_state + include_free_space];
+  if (distances.empty()) {
+    distances.resize(std::pow(config_.cache_voxels_per_side, 3),
+                     std::numeric_limits<float>::quiet_NaN());
+  }
+
+  // Unobserved points are stored as infinite distance.
+  float& cached_distance = distances[cacheLinearIndex(voxel_index)];
+  if (std::isnan(cached_distance)) {
+    if (!computeDistance(voxblox::getCenterPointFromGridIndex(
+                             voxel_index, config_.cache_voxel_size),
+                         &cached_distance, consider_change_state,
+                         include_free_space)) {
+      cached_distance = std::numeric_limits<float>::infinity();
+    }
+  }
+  if (std::isinf(cached_distance)) {
+    return false;
+  }
+  *distance = cached_distance;
+  return true;
+}
+
+bool PlanningInterface::computeDistance(const Point& position, float* distance,
+                                        bool consider_change_state,
+                                        bool include_free_space) const {
+  // Get the Tsdf distance. Return whether the point was observed.
   constexpr float max = std::numeric_limits<float>::max();
   // Distances and observedness in order of priority: [active obj (max res),
   // persistent obj (min sdf), free space (fallback)]
@@ -208,4 +284,123 @@ bool PlanningInterface::getDistance(const Point& position, float* distance,
   return false;
 }
 
+void PlanningInterface::clearCache() const {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  cache_.clear();
+  cache_lru_.clear();
+}
+
+PlanningInterface::CacheBlock* PlanningInterface::getCacheBlock(
+    const voxblox::GlobalIndex& voxel_index) const {
+  const BlockIndex block_index = voxblox::getBlockIndexFromGlobalVoxelIndex(
+      voxel_index, 1.f / config_.cache_voxels_per_side);
+  auto it = cache_.find(block_index);
+  if (it != cache_.end()) {
+    // Mark as most recently used.
+    CacheBlock* block = &it->second;
+    cache_lru_.splice(cache_lru_.begin(), cache_lru_, block->lru_position);
+    if (!cacheBlockIsValid(block)) {
+      block->voxel_states.clear();
+      for (std::vector<float>& distances : block->distances) {
+        distances.clear();
+      }
+      computeCacheDependencies(block_index, block);
+    }
+    return block;
+  }
+
+  // Evict the least recently used block if the cache is full.
+  if (cache_.size() >= static_cast<size_t>(config_.cache_max_blocks)) {
+    cache_.erase(cache_lru_.back());
+    cache_lru_.pop_back();
+  }
+  CacheBlock* block = &cache_[block_index];
+  cache_lru_.push_front(block_index);
+  block->lru_position = cache_lru_.begin();
+  computeCacheDependencies(block_index, block);
+  return block;
+}
+
+bool PlanningInterface::cacheBlockIsValid(CacheBlock* block) const {
+  // If nothing in the map changed since the last validation the block is
+  // still valid.
+  const uint64_t current_version = MapVersion::current();
+  if (block->validated_version == current_version) {
+    return true;
+  }
+  if (block->collection_version != submaps_->getVersion()) {
+    return false;
+  }
+  for (CacheDependency& dependency : block->dependencies) {
+    if (!cacheDependencyIsValid(&dependency)) {
+      return false;
+    }
+  }
+  block->validated_version = current_version;
+  return true;
+}
+
+bool PlanningInterface::cacheDependencyIsValid(
+    CacheDependency* dependency) const {
+  const Submap& submap = submaps_->getSubmap(dependency->submap_id);
+  const uint64_t latest_version = submap.getLatestVersion();
+  if (latest_version == dependency->version) {
+    return true;
+  }
+  if (submap.getVersion() > dependency->version ||
+      submap.hasUpdatedBlocks(dependency->version, dependency->min_index,
+                              dependency->max_index)) {
+    return false;
+  }
+
+  // Only blocks the cache block does not depend on changed.
+  dependency->version = latest_version;
+  return true;
+}
+
+void PlanningInterface::computeCacheDependencies(const BlockIndex& block_index,
+                                                 CacheBlock* block) const {
+  block->validated_version = MapVersion::current();
+  block->collection_version = submaps_->getVersion();
+  block->dependencies.clear();
+  const float cache_block_size =
+      config_.cache_voxel_size * config_.cache_voxels_per_side;
+  const Point origin_M = voxblox::getOriginPointFromGridIndex(
+      block_index, cache_block_size);
+
+  // A submap block is a dependency if any voxel used to interpolate a point in
+  // the cache block lies in it. Only the block range is stored, the versions
+  // are checked against it when validating.
+  for (const Submap& submap : *submaps_) {
+    const float margin = submap.getConfig().voxel_size;
+    const float block_size_inv = 1.f / submap.getTsdfLayer().block_size();
+    Point min_S = Point::Constant(std::numeric_limits<float>::max());
+    Point max_S = Point::Constant(std::numeric_limits<float>::lowest());
+    for (int corner = 0; corner < 8; ++corner) {
+      const Point corner_M =
+          origin_M +
+          Point(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) *
+              cache_block_size;
+      const Point corner_S = submap.getT_S_M() * corner_M;
+      min_S = min_S.cwiseMin(corner_S);
+      max_S = max_S.cwiseMax(corner_S);
+    }
+    CacheDependency& dependency = block->dependencies.emplace_back();
+    dependency.submap_id = submap.getID();
+    dependency.version = submap.getLatestVersion();
+    dependency.min_index = voxblox::getGridIndexFromPoint<BlockIndex>(
+        min_S - Point::Constant(margin), block_size_inv);
+    dependency.max_index = voxblox::getGridIndexFromPoint<BlockIndex>(
+        max_S + Point::Constant(margin), block_size_inv);
+  }
+}
+
+size_t PlanningInterface::cacheLinearIndex(
+    const voxblox::GlobalIndex& voxel_index) const {
+  const VoxelIndex local_index = voxblox::getLocalFromGlobalVoxelIndex(
+      voxel_index, config_.cache_voxels_per_side);
+  const int size = config_.cache_voxels_per_side;
+  return local_index.x() + size * (local_index.y() + size * local_index.z());
+}
+
 }  // namespace panoptic_mapping
@@ -0,0 +1,400 @@
+#include "panoptic_mapping/tools/semantic_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace panoptic_mapping {
+
+void SemanticIndex::Config::checkParams() const {
+  checkParamGT(grid_cell_size, 0.f, "grid_cell_size");
+}
+
+void SemanticIndex::Config::setupParamsAndPrinting() {
+  setupParam("verbosity", &verbosity);
+  setupParam("grid_cell_size", &grid_cell_size, "m");
+}
+
+SemanticIndex::SemanticIndex(const Config& config)
+    : config_(config.checkValid()) {
+  LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
+}
+
+void SemanticIndex::update(const SubmapCollection& submaps) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+
+  // Changes made while updating receive newer versions and are picked up by
+  // the next update.
+  const uint64_t version = MapVersion::current();
+  if (version == indexed_version_) {
+    return;
+  }
+  Timer timer("semantic_index/update");
+  int num_updated = 0;
+  int num_removed = 0;
+
+  // Update all submaps whose indexed data changed.
+  for (const Submap& submap : submaps) {
+    if (submap.getLatestVersion() <= indexed_version_) {
+      continue;
+    }
+    Entry entry;
+    entry.submap_id = submap.getID();
+    entry.instance_id = submap.getInstanceID();
+    entry.class_id = submap.getClassID();
+    entry.label = submap.getLabel();
+    entry.change_state = submap.getChangeState();
+    entry.is_active = submap.isActive();
+    entry.center_M = submap.getT_M_S() * submap.getBoundingVolume().getCenter();
+    entry.radius = submap.getBoundingVolume().getRadius();
+
+    auto it = entries_.find(entry.submap_id);
+    if (it != entries_.end()) {
+      if (!needsUpdate(it->second, entry)) {
+        continue;
+      }
+      remove(it->second);
+    }
+    insert(entry);
+    num_updated++;
+  }
+
+  // Remove all submaps that no longer exist.
+  if (submaps.getVersion() > indexed_version_) {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      if (submaps.submapIdExists(it->first)) {
+        ++it;
+        continue;
+      }
+      const Entry entry = it->second;
+      ++it;
+      remove(entry);
+      num_removed++;
+    }
+  }
+  indexed_version_ = version;
+  LOG_IF(INFO, config_.verbosity >= 3 && num_updated + num_removed > 0)
+      << "Semantic index: updated " << num_updated << " and removed "
+      << num_removed << " entries (" << entries_.size() << " total).";
+}
+
+void SemanticIndex::clear() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  entries_.clear();
+  class_index_.clear();
+  instance_index_.clear();
+  label_index_.clear();
+  change_state_index_.clear();
+  grid_levels_.clear();
+  indexed_version_ = 0;
+}
+
+bool SemanticIndex::needsUpdate(const Entry& old_entry,
+                                const Entry& new_entry) {
+  return old_entry.instance_id != new_entry.instance_id ||
+         old_entry.class_id != new_entry.class_id ||
+         old_entry.label != new_entry.label ||
+         old_entry.change_state != new_entry.change_state ||
+         old_entry.is_active != new_entry.is_active ||
+         old_entry.radius != new_entry.radius ||
+         old_entry.center_M != new_entry.center_M;
+}
+
+int SemanticIndex::gridLevel(float radius) const {
+  int level = 0;
+  float cell_size = config_.grid_cell_size;
+  while (cell_size < 2.f * radius && level < kMaxGridLevel) {
+    cell_size *= 2.f;
+    ++level;
+  }
+  return level;
+}
+
+float SemanticIndex::gridCellSize(int level) const {
+  return std::ldexp(config_.grid_cell_size, level);
+}
+
+SemanticIndex::GridIndex SemanticIndex::gridIndexFromPoint(const Point& point,
+                                                           int level) const {
+  const float cell_size = gridCellSize(level);
+  return GridIndex(std::floor(point.x() / cell_size),
+                   std::floor(point.y() / cell_size),
+                   std::floor(point.z() / cell_size));
+}
+
+void SemanticIndex::insert(const Entry& entry) {
+  const int id = entry.submap_id;
+  entries_[id] = entry;
+  class_index_[entry.class_id].insert(id);
+  instance_index_[entry.instance_id].insert(id);
+  label_index_[static_cast<int>(entry.label)].insert(id);
+  change_state_index_[static_cast<int>(entry.change_state)].insert(id);
+
+  const int level = gridLevel(entry.radius);
+  if (grid_levels_.size() <= static_cast<size_t>(level)) {
+    grid_levels_.resize(level + 1);
+  }
+  grid_levels_[level][gridIndexFromPoint(entry.center_M, level)].insert(id);
+}
+
+void SemanticIndex::remove(const Entry& entry) {
+  const int id = entry.submap_id;
+  const auto erase_from = [id](std::unordered_map<int, IDSet>* index,
+                               int key) {
+    auto it = index->find(key);
+    if (it != index->end()) {
+      it->second.erase(id);
+      if (it->second.empty()) {
+        index->erase(it);
+      }
+    }
+  };
+  erase_from(&class_index_, entry.class_id);
+  erase_from(&instance_index_, entry.instance_id);
+  erase_from(&label_index_, static_cast<int>(entry.label));
+  erase_from(&change_state_index_, static_cast<int>(entry.change_state));
+
+  const int level = gridLevel(entry.radius);
+  if (static_cast<size_t>(level) < grid_levels_.size()) {
+    Grid& grid = grid_levels_[level];
+    auto it = grid.find(gridIndexFromPoint(entry.center_M, level));
+    if (it != grid.end()) {
+      it->second.erase(id);
+      if (it->second.empty()) {
+        grid.erase(it);
+      }
+    }
+  }
+  entries_.erase(id);
+}
+
+bool SemanticIndex::visitNeighborhood(
+    const Point& position_M, float radius, size_t max_cells,
+    const std::function<void(const Entry&)>& visitor, bool* visited_all) const {
+  // Entries of a level have a radius of at most half its cell size, so their
+  // centers lie within radius + cell_size / 2 of the point. Levels where this
+  // range covers more cells than are occupied are scanned completely.
+  std::vector<bool> scan_level(grid_levels_.size(), false);
+  size_t num_cells = 0;
+  bool scans_all = true;
+  for (size_t level = 0; level < grid_levels_.size(); ++level) {
+    const Grid& grid = grid_levels_[level];
+    if (grid.empty()) {
+      continue;
+    }
+    const float cell_size = gridCellSize(level);
+    const double cells_per_side = 2.0 * radius / cell_size + 2.0;
+    const double range_cells = std::pow(cells_per_side, 3);
+    if (range_cells >= static_cast<double>(grid.size())) {
+      scan_level[level] = true;
+      num_cells += grid.size();
+    } else {
+      num_cells += static_cast<size_t>(range_cells);
+      scans_all = false;
+    }
+  }
+  if (num_cells > max_cells) {
+    return false;
+  }
+
+  for (size_t level = 0; level < grid_levels_.size(); ++level) {
+    const Grid& grid = grid_levels_[level];
+    if (grid.empty()) {
+      continue;
+    }
+    if (scan_level[level]) {
+      for (const auto& index_ids_pair : grid) {
+        for (const int id : index_ids_pair.second) {
+          visitor(entries_.at(id));
+        }
+      }
+      continue;
+    }
+    const Point reach = Point::Ones() * (radius + gridCellSize(level) / 2.f);
+    const GridIndex min_index = gridIndexFromPoint(position_M - reach, level);
+    const GridIndex max_index = gridIndexFromPoint(position_M + reach, level);
+    for (int x = min_index.x(); x <= max_index.x(); ++x) {
+      for (int y = min_index.y(); y <= max_index.y(); ++y) {
+        for (int z = min_index.z(); z <= max_index.z(); ++z) {
+          auto it = grid.find(GridIndex(x, y, z));
+          if (it == grid.end()) {
+            continue;
+          }
+          for (const int id : it->second) {
+            visitor(entries_.at(id));
+          }
+        }
+      }
+    }
+  }
+  if (visited_all) {
+    *visited_all = scans_all;
+  }
+  return true;
+}
+
+bool SemanticIndex::matches(const Entry& entry, const Query& query) const {
+  if (query.class_id && entry.class_id != *query.class_id) {
+    return false;
+  }
+  if (query.instance_id && entry.instance_id != *query.instance_id) {
+    return false;
+  }
+  if (query.label && entry.label != *query.label) {
+    return false;
+  }
+  if (query.change_state && entry.change_state != *query.change_state) {
+    return false;
+  }
+  if (query.only_active && !entry.is_active) {
+    return false;
+  }
+  return true;
+}
+
+const SemanticIndex::IDSet* SemanticIndex::semanticCandidates(
+    const Query& query) const {
+  const IDSet* result = nullptr;
+  const auto narrow = [&result, this](
+                            const std::unordered_map<int, IDSet>& index,
+                            int key) {
+    auto it = index.find(key);
+    const IDSet* candidates = it == index.end() ? &empty_set_ : &it->second;
+    if (!result || candidates->size() < result->size()) {
+      result = candidates;
+    }
+  };
+  if (query.class_id) {
+    narrow(class_index_, *query.class_id);
+  }
+  if (query.instance_id) {
+    narrow(instance_index_, *query.instance_id);
+  }
+  if (query.label) {
+    narrow(label_index_, static_cast<int>(*query.label));
+  }
+  if (query.change_state) {
+    narrow(change_state_index_, static_cast<int>(*query.change_state));
+  }
+  return result;
+}
+
+std::vector<int> SemanticIndex::find(const Query& query) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::vector<int> result;
+  const IDSet* candidates = semanticCandidates(query);
+  if (candidates) {
+    for (const int id : *candidates) {
+      if (matches(entries_.at(id), query)) {
+        result.push_back(id);
+      }
+    }
+  } else {
+    for (const auto& id_entry_pair : entries_) {
+      if (matches(id_entry_pair.second, query)) {
+        result.push_back(id_entry_pair.first);
+      }
+    }
+  }
+  return result;
+}
+
+std::vector<int> SemanticIndex::findWithinRadius(const Query& query,
+                                                 const Point& position_M,
+                                                 float radius) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::vector<int> result;
+  const auto check = [&](const Entry& entry) {
+    if (!matches(entry, query)) {
+      return;
+    }
+    if ((entry.center_M - position_M).norm() - entry.radius <= radius) {
+      result.push_back(entry.submap_id);
+    }
+  };
+
+  // Use the semantic index if it is more selective than the spatial one.
+  const IDSet* candidates = semanticCandidates(query);
+  const size_t max_cells =
+      candidates ? candidates->size() : std::numeric_limits<size_t>::max();
+  if (!visitNeighborhood(position_M, radius, max_cells, check)) {
+    for (const int id : *candidates) {
+      check(entries_.at(id));
+    }
+  }
+  return result;
+}
+
+bool SemanticIndex::findNearest(const Query& query, const Point& position_M,
+                                int* submap_id, float* distance) const {
+  CHECK_NOTNULL(submap_id);
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  const IDSet* candidates = semanticCandidates(query);
+  if (entries_.empty() || (candidates && candidates->empty())) {
+    return false;
+  }
+  float min_distance = std::numeric_limits<float>::max();
+  bool found = false;
+  const auto check = [&](const Entry& entry) {
+    if (!matches(entry, query)) {
+      return;
+    }
+    const float dist = std::max(
+        (entry.center_M - position_M).norm() - entry.radius, 0.f);
+    if (dist < min_distance) {
+      min_distance = dist;
+      *submap_id = entry.submap_id;
+      found = true;
+    }
+  };
+
+  // Search in growing radii. All submaps closer than the searched radius are
+  // visited, so a match within it is the nearest one. Once the search would
+  // touch more cells than there are candidates, check these directly.
+  const size_t max_cells = candidates ? candidates->size() : entries_.size();
+  float radius = config_.grid_cell_size;
+  while (true) {
+    bool visited_all = false;
+    if (!visitNeighborhood(position_M, radius, max_cells, check,
+                           &visited_all)) {
+      if (candidates) {
+        for (const int id : *candidates) {
+          check(entries_.at(id));
+        }
+      } else {
+        for (const auto& id_entry_pair : entries_) {
+          check(id_entry_pair.second);
+        }
+      }
+      break;
+    }
+    if ((found && min_distance <= radius) || visited_all) {
+      break;
+    }
+    radius *= 2.f;
+  }
+  if (found && distance) {
+    *distance = min_distance;
+  }
+  return found;
+}
+
+size_t SemanticIndex::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return entries_.size();
+}
+
+bool SemanticIndex::getEntry(int submap_id, Entry* entry) const {
+  CHECK_NOTNULL(entry);
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto it = entries_.find(submap_id);
+  if (it == entries_.end()) {
+    return false;
+  }
+  *entry = it->second;
+  return true;
+}
+
+}  // namespace panoptic_mapping
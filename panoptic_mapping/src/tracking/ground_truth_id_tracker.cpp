@@ -1,18 +1,30 @@
 #include "panoptic_mapping/tracking/ground_truth_id_tracker.h"
 
+#include <algorithm>
+#include <future>
+#include <limits>
 #include <memory>
+#include <numeric>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "panoptic_mapping/common/index_getter.h"
+#include "panoptic_mapping/common/thread_affinity.h"
+
 namespace panoptic_mapping {
 
 config_utilities::Factory::RegistrationRos<IDTrackerBase, GroundTruthIDTracker,
                                            std::shared_ptr<Globals>>
     GroundTruthIDTracker::registration_("ground_truth");
 
+void GroundTruthIDTracker::Config::checkParams() const {
+  checkParamGT(num_threads, 0, "num_threads");
+}
+
 void GroundTruthIDTracker::Config::setupParamsAndPrinting() {
   setupParam("verbosity", &verbosity);
+  setupParam("num_threads", &num_threads);
 }
 
 GroundTruthIDTracker::GroundTruthIDTracker(const Config& config,
@@ -31,14 +43,12 @@ void GroundTruthIDTracker::processInput(SubmapCollection* submaps,
   CHECK_NOTNULL(input);
   CHECK(inputIsValid(*input));
   // Look for new instances that are within integration range.
-  std::unordered_set<int> instances;
-  for (int u = 0; u < input->idImage().cols; ++u) {
-    for (int v = 0; v < input->idImage().rows; ++v) {
-      if (input->validityImage().at<uchar>(v, u)) {
-        instances.insert(input->idImage().at<int>(v, u));
-      }
-    }
-  }
+  Timer scan_timer("tracking/scan_instances");
+  int min_id;
+  int max_id;
+  const std::unordered_set<int> instances =
+      collectInstances(*input, &min_id, &max_id);
+  scan_timer.Stop();
 
   // Allocate new submaps if necessary.
   for (const int instance : instances) {
@@ -47,20 +57,125 @@ void GroundTruthIDTracker::processInput(SubmapCollection* submaps,
   printAndResetWarnings();
 
   // Set segmentation image to submap ids.
-  for (auto it = input->idImagePtr()->begin<int>();
-       it != input->idImagePtr()->end<int>(); ++it) {
-    auto it2 = instance_to_id_.find(*it);
-    if (it2 == instance_to_id_.end()) {
-      *it = -1;
-    } else {
-      *it = it2->second;
-    }
-  }
+  Timer remap_timer("tracking/remap_ids");
+  remapIDImage(min_id, max_id, input);
+  remap_timer.Stop();
 
   // Allocate free space map if required.
   freespace_allocator_->allocateSubmap(submaps, input);
 }
 
+std::unordered_set<int> GroundTruthIDTracker::collectInstances(
+    const InputData& input, int* min_id, int* max_id) const {
+  // Scan rows in parallel. Each thread collects its own set, consecutive
+  // pixels mostly share the same ID so only ID changes are inserted.
+  struct ScanResult {
+    std::unordered_set<int> instances;
+    int min_id = std::numeric_limits<int>::max();
+    int max_id = std::numeric_limits<int>::lowest();
+  };
+  const cv::Mat& id_image = input.idImage();
+  const cv::Mat& validity_image = input.validityImage();
+  std::vector<int> rows(id_image.rows);
+  std::iota(rows.begin(), rows.end(), 0);
+  IndexGetter<int> index_getter(rows);
+  std::vector<std::future<ScanResult>> threads;
+  for (int i = 0; i < config_.num_threads; ++i) {
+    threads.emplace_back(std::async(
+        std::launch::async,
+        [&index_getter, &id_image, &validity_image, i]() -> ScanResult {
+          ThreadAffinity::pinWorkerThread(i);
+          ScanResult result;
+          int v;
+          while (index_getter.getNextIndex(&v)) {
+            const int* ids = id_image.ptr<int>(v);
+            const uchar* valid = validity_image.ptr<uchar>(v);
+            bool has_previous = false;
+            int previous_id = 0;
+            for (int u = 0; u < id_image.cols; ++u) {
+              const int id = ids[u];
+              result.min_id = std::min(result.min_id, id);
+              result.max_id = std::max(result.max_id, id);
+              if (!valid[u] || (has_previous && id == previous_id)) {
+                continue;
+              }
+              result.instances.insert(id);
+              previous_id = id;
+              has_previous = true;
+            }
+          }
+          return result;
+        }));
+  }
+
+  // Join all threads and merge the results.
+  std::unordered_set<int> instances;
+  *min_id = std::numeric_limits<int>::max();
+  *max_id = std::numeric_limits<int>::lowest();
+  for (auto& thread : threads) {
+    const ScanResult result = thread.get();
+    instances.insert(result.instances.begin(), result.instances.end());
+    *min_id = std::min(*min_id, result.min_id);
+    *max_id = std::max(*max_id, result.max_id);
+  }
+  return instances;
+}
+
+void GroundTruthIDTracker::remapIDImage(int min_id, int max_id,
+                                        InputData* input) const {
+  cv::Mat* id_image = input->idImagePtr();
+  if (id_image->empty()) {
+    return;
+  }
+
+  // Use a flat lookup table over the range of IDs in the image if it is
+  // small enough.
+  const int64_t range = static_cast<int64_t>(max_id) - min_id + 1;
+  std::vector<int> lookup_table;
+  if (range <= kMaxLookupTableSize) {
+    lookup_table.assign(range, -1);
+    for (const auto& instance_id_pair : instance_to_id_) {
+      if (instance_id_pair.first >= min_id &&
+          instance_id_pair.first <= max_id) {
+        lookup_table[instance_id_pair.first - min_id] =
+            instance_id_pair.second;
+      }
+    }
+  }
+
+  // Remap all rows in parallel.
+  std::vector<int> rows(id_image->rows);
+  std::iota(rows.begin(), rows.end(), 0);
+  IndexGetter<int> index_getter(rows);
+  std::vector<std::future<void>> threads;
+  for (int i = 0; i < config_.num_threads; ++i) {
+    threads.emplace_back(std::async(
+        std::launch::async,
+        [this, &index_getter, &lookup_table, id_image, min_id, i]() {
+          ThreadAffinity::pinWorkerThread(i);
+          int v;
+          while (index_getter.getNextIndex(&v)) {
+            int* ids = id_image->ptr<int>(v);
+            if (!lookup_table.empty()) {
+              for (int u = 0; u < id_image->cols; ++u) {
+                ids[u] = lookup_table[ids[u] - min_id];
+              }
+            } else {
+              for (int u = 0; u < id_image->cols; ++u) {
+                auto it = instance_to_id_.find(ids[u]);
+                ids[u] = it == instance_to_id_.end() ? -1 : it->second;
+              }
+            }
+          }
+        }));
+  }
+
+  // Join all threads.
+  for (auto& thread : threads) {
+    thread.get();
+  }
+}
+
 bool GroundTruthIDTracker::parseInputInstance(int instance,
                                               SubmapCollection* submaps,
                                               InputData* input) {
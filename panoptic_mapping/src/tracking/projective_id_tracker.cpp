@@ -1,5 +1,6 @@
 #include "panoptic_mapping/tracking/projective_id_tracker.h"
 
+#include <algorithm>
 #include <future>
 #include <memory>
 #include <unordered_map>
@@ -8,6 +9,7 @@
 #include <vector>
 
 #include "panoptic_mapping/common/index_getter.h"
+#include "panoptic_mapping/common/thread_affinity.h"
 
 namespace panoptic_mapping {
 
@@ -32,6 +34,7 @@ void ProjectiveIDTracker::Config::setupParamsAndPrinting() {
   setupParam("rendering_subsampling", &rendering_subsampling);
   setupParam("min_allocation_size", &min_allocation_size);
   setupParam("rendering_threads", &rendering_threads);
+  setupParam("use_occlusion_culling", &use_occlusion_culling);
   setupParam("renderer", &renderer);
 }
 
@@ -40,13 +43,31 @@ ProjectiveIDTracker::ProjectiveIDTracker(const Config& config,
                                          bool print_config)
     : IDTrackerBase(std::move(globals)),
       config_(config.checkValid()),
-      renderer_(config.renderer, globals_->camera()->getConfig(), false) {
+      renderer_(config.renderer, globals_->camera()->getConfig(), false),
+      rendering_threads_(config_.rendering_threads),
+      rendering_subsampling_(config_.rendering_subsampling) {
   LOG_IF(INFO, config_.verbosity >= 1 && print_config) << "\n"
                                                        << config_.toString();
   addRequiredInputs({InputData::InputType::kColorImage,
                      InputData::InputType::kDepthImage,
                      InputData::InputType::kSegmentationImage,
                      InputData::InputType::kValidityImage});
+  if (config_.use_occlusion_culling) {
+    addRequiredInput(InputData::InputType::kMaxDepthPyramid);
+  }
+}
+
+void ProjectiveIDTracker::reconfigure(const PerformanceParameters& parameters) {
+  if (parameters.rendering_threads > 0) {
+    rendering_threads_ = parameters.rendering_threads;
+  }
+  if (parameters.rendering_subsampling > 0) {
+    rendering_subsampling_ = parameters.rendering_subsampling;
+  }
+  LOG_IF(INFO, config_.verbosity >= 2)
+      << "Reconfigured tracking to use " << rendering_threads_
+      << " threads and a rendering subsampling of " << rendering_subsampling_
+      << ".";
 }
 
 void ProjectiveIDTracker::processInput(SubmapCollection* submaps,
@@ -54,10 +75,16 @@ void ProjectiveIDTracker::processInput(SubmapCollection* submaps,
   CHECK_NOTNULL(submaps);
   CHECK_NOTNULL(input);
   CHECK(inputIsValid(*input));
-  // Visualization.
+  // Visualization. Images are only computed if they are requested.
+  const bool visualize_input = visualizationIsRequested("input");
+  const bool visualize_color = visualizationIsRequested("color");
+  const bool visualize_tracked = visualizationIsRequested("tracked");
+  visualize_rendered_ = visualizationIsRequested("rendered");
+  const bool visualize = visualize_input || visualize_color ||
+                         visualize_tracked || visualize_rendered_;
   cv::Mat input_vis;
   std::unique_ptr<Timer> vis_timer;
-  if (visualizationIsOn()) {
+  if (visualize_input) {
     vis_timer = std::make_unique<Timer>("visualization/tracking");
     Timer timer("visualization/tracking/input_image");
     input_vis = renderer_.colorIdImage(input->idImage());
@@ -199,20 +226,33 @@ void ProjectiveIDTracker::processInput(SubmapCollection* submaps,
   }
 
   // Publish Visualization if requested.
-  if (visualizationIsOn()) {
-    vis_timer->Unpause();
-    Timer timer("visualization/tracking/rendered");
-    if (config_.use_approximate_rendering) {
-      rendered_vis_ = renderer_.colorIdImage(
-          renderer_.renderActiveSubmapIDs(*submaps, input->T_M_C()));
+  if (visualize) {
+    if (vis_timer) {
+      vis_timer->Unpause();
+    } else {
+      vis_timer = std::make_unique<Timer>("visualization/tracking");
+    }
+    if (visualize_input) {
+      visualize(input_vis, "input");
+    }
+    if (visualize_rendered_) {
+      Timer timer("visualization/tracking/rendered");
+      if (config_.use_approximate_rendering) {
+        rendered_vis_ = renderer_.colorIdImage(
+            renderer_.renderActiveSubmapIDs(*submaps, input->T_M_C()));
+      }
+      timer.Stop();
+      visualize(rendered_vis_, "rendered");
+    }
+    if (visualize_color) {
+      visualize(input->colorImage(), "color");
+    }
+    if (visualize_tracked) {
+      Timer timer("visualization/tracking/tracked");
+      cv::Mat tracked_vis = renderer_.colorIdImage(input->idImage());
+      timer.Stop();
+      visualize(tracked_vis, "tracked");
     }
-    timer = Timer("visualization/tracking/tracked");
-    cv::Mat tracked_vis = renderer_.colorIdImage(input->idImage());
-    timer.Stop();
-    visualize(input_vis, "input");
-    visualize(rendered_vis_, "rendered");
-    visualize(input->colorImage(), "color");
-    visualize(tracked_vis, "tracked");
     vis_timer->Stop();
   }
 }
@@ -238,8 +278,11 @@ bool ProjectiveIDTracker::classesMatch(int input_id, int submap_class_id) {
 TrackingInfoAggregator ProjectiveIDTracker::computeTrackingData(
     SubmapCollection* submaps, InputData* input) {
   // Render each active submap in parallel to collect overlap statistics.
-  const std::vector<int> visible_submaps =
+  std::vector<int> visible_submaps =
       globals_->camera()->findVisibleSubmapIDs(*submaps, input->T_M_C());
+  if (config_.use_occlusion_culling) {
+    cullOccludedSubmaps(*submaps, *input, &visible_submaps);
+  }
 
   // Make sure the meshes of all submaps are update for tracking.
   for (int submap_id : visible_submaps) {
@@ -250,16 +293,18 @@ TrackingInfoAggregator ProjectiveIDTracker::computeTrackingData(
   SubmapIndexGetter index_getter(visible_submaps);
   std::vector<std::future<std::vector<TrackingInfo>>> threads;
   TrackingInfoAggregator tracking_data;
-  for (int i = 0; i < config_.rendering_threads; ++i) {
+  for (int i = 0; i < rendering_threads_; ++i) {
     threads.emplace_back(std::async(
         std::launch::async,
         [this, i, &tracking_data, &index_getter, submaps,
          input]() -> std::vector<TrackingInfo> {
+          ThreadAffinity::pinWorkerThread(i);
           // Also process the input image.
           if (i == 0) {
             tracking_data.insertInputImage(
                 input->idImage(), input->depthImage(),
-                globals_->camera()->getConfig(), config_.rendering_subsampling);
+                globals_->camera()->getConfig(), rendering_subsampling_,
+                input->depthScale());
           }
           std::vector<TrackingInfo> result;
           int index;
@@ -286,7 +331,7 @@ TrackingInfoAggregator ProjectiveIDTracker::computeTrackingData(
   tracking_data.insertTrackingInfos(infos);
 
   // Render the data if required.
-  if (visualizationIsOn() && !config_.use_approximate_rendering) {
+  if (visualize_rendered_ && !config_.use_approximate_rendering) {
     Timer timer("visualization/tracking/rendered");
     cv::Mat vis =
         cv::Mat::ones(globals_->camera()->getConfig().height,
@@ -302,6 +347,31 @@ TrackingInfoAggregator ProjectiveIDTracker::computeTrackingData(
   return tracking_data;
 }
 
+void ProjectiveIDTracker::cullOccludedSubmaps(
+    const SubmapCollection& submaps, const InputData& input,
+    std::vector<int>* submap_ids) const {
+  Timer timer("tracking/occlusion_culling");
+  const size_t num_visible = submap_ids->size();
+  submap_ids->erase(
+      std::remove_if(submap_ids->begin(), submap_ids->end(),
+                     [&](int submap_id) {
+                       // Submaps farther than the tolerance can not match.
+                       const Submap& submap = submaps.getSubmap(submap_id);
+                       const float depth_tolerance =
+                           config_.depth_tolerance > 0
+                               ? config_.depth_tolerance
+                               : -config_.depth_tolerance *
+                                     submap.getTsdfLayer().voxel_size();
+                       return globals_->camera()->submapIsOccluded(
+                           submap, input.T_M_C(), input.maxDepthPyramid(),
+                           depth_tolerance);
+                     }),
+      submap_ids->end());
+  LOG_IF(INFO, config_.verbosity >= 3)
+      << "Culled " << num_visible - submap_ids->size() << " of "
+      << num_visible << " visible submaps as occluded.";
+}
+
 TrackingInfo ProjectiveIDTracker::renderTrackingInfoApproximate(
     const Submap& submap, const InputData& input) const {
   // Approximate rendering by projecting the surface points of the submap into
@@ -340,7 +410,7 @@ TrackingInfo ProjectiveIDTracker::renderTrackingInfoApproximate(
       if (!camera.projectPointToImagePlane(p_C, &u, &v)) {
         continue;
       }
-      if (std::abs(depth_image.at<float>(v, u) - p_C.z()) >= depth_tolerance) {
+      if (std::abs(input.depth(v, u) - p_C.z()) >= depth_tolerance) {
         continue;
       }
 
@@ -350,7 +420,7 @@ TrackingInfo ProjectiveIDTracker::renderTrackingInfoApproximate(
       result.insertRenderedPoint(u, v, size_x, size_y);
     }
   }
-  result.evaluate(input.idImage(), depth_image);
+  result.evaluate(input.idImage(), depth_image, input.depthScale());
   return result;
 }
 
@@ -375,11 +445,9 @@ TrackingInfo ProjectiveIDTracker::renderTrackingInfoVertices(
       config_.depth_tolerance > 0
           ? config_.depth_tolerance
           : -config_.depth_tolerance * submap.getTsdfLayer().voxel_size();
-  for (size_t u = limits[0]; u < limits[1];
-       u += config_.rendering_subsampling) {
-    for (size_t v = limits[2]; v < limits[3];
-         v += config_.rendering_subsampling) {
-      const float depth = input.depthImage().at<float>(v, u);
+  for (size_t u = limits[0]; u < limits[1]; u += rendering_subsampling_) {
+    for (size_t v = limits[2]; v < limits[3]; v += rendering_subsampling_) {
+      const float depth = input.depth(v, u);
       if (depth < cam_config.min_range || depth > cam_config.max_range) {
         continue;
       }
@@ -401,7 +469,7 @@ TrackingInfo ProjectiveIDTracker::renderTrackingInfoVertices(
         }
         if (voxel.weight > 1e-6 && std::abs(voxel.distance) < depth_tolerance) {
           result.insertVertexPoint(input.idImage().at<int>(v, u));
-          if (visualizationIsOn()) {
+          if (visualize_rendered_) {
             result.insertVertexVisualizationPoint(u, v);
           }
         }
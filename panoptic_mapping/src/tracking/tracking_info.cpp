@@ -48,7 +48,7 @@ void TrackingInfo::insertRenderedPoint(int u, int v, int size_x, int size_y) {
 }
 
 void TrackingInfo::evaluate(const cv::Mat& id_image,
-                            const cv::Mat& depth_image) {
+                            const cv::Mat& depth_image, float depth_scale) {
   // Pass through the image and lookup which pixels should be covered by the
   // submap. Must be called after all input is inserted.
   for (int v = v_min_; v <= v_max_; ++v) {
@@ -57,7 +57,7 @@ void TrackingInfo::evaluate(const cv::Mat& id_image,
     for (int u = u_min_; u <= std::min(u_max_, camera_.width - 1); ++u) {
       range = std::max(range, image_.at<int>(v, u)) - 1;
       if (range > 0) {
-        const float depth = depth_image.at<float>(v, u);
+        const float depth = depthAt(depth_image, depth_scale, v, u);
         if (depth >= camera_.min_range && depth <= camera_.max_range) {
           incrementMap(&counts_, id_image.at<int>(v, u));
         }
@@ -96,10 +96,11 @@ void TrackingInfoAggregator::insertTrackingInfo(const TrackingInfo& info) {
 void TrackingInfoAggregator::insertInputImage(const cv::Mat& id_image,
                                               const cv::Mat& depth_image,
                                               const Camera::Config& camera,
-                                              int rendering_subsampling) {
+                                              int rendering_subsampling,
+                                              float depth_scale) {
   for (int u = 0; u < id_image.cols; u += rendering_subsampling) {
     for (int v = 0; v < id_image.rows; v += rendering_subsampling) {
-      const float depth = depth_image.at<float>(v, u);
+      const float depth = depthAt(depth_image, depth_scale, v, u);
       if (depth >= camera.min_range && depth <= camera.max_range) {
         incrementMap(&total_input_count_, id_image.at<int>(v, u));
       }
@@ -0,0 +1,148 @@
+#include "panoptic_mapping/common/camera.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <opencv2/core.hpp>
+
+#include "panoptic_mapping/common/common.h"
+
+namespace panoptic_mapping {
+namespace test {
+
+struct CameraConfig {
+  // Image size.
+  const int width = 64;
+  const int height = 48;
+
+  // 16-bit depth in millimeters.
+  const float depth_scale = 0.001f;
+  const uint16_t max_depth = 8000;  // Beyond the max range of the camera.
+
+  // Max pixel error of projecting back-projected pixels.
+  const float round_trip_tolerance = 0.01f;
+
+  // Strong radial distortion, k1, for which the models fold back into the
+  // image at about 1.05 (radius or incidence angle).
+  const float folding_k1 = -0.3f;
+} config;
+
+inline Camera::Config cameraConfig(const std::string& distortion_model) {
+  Camera::Config result;
+  result.width = config.width;
+  result.height = config.height;
+  result.vx = config.width / 2.f;
+  result.vy = config.height / 2.f;
+  result.fx = config.width / 2.f;
+  result.fy = config.width / 2.f;
+  result.distortion_model = distortion_model;
+  if (distortion_model == "radtan") {
+    result.distortion_coefficients = {-0.1f, 0.01f, 0.001f, -0.001f};
+  } else if (distortion_model == "equidistant") {
+    result.distortion_coefficients = {0.1f, -0.05f, 0.01f, -0.002f};
+  }
+  return result;
+}
+
+inline bool imagesAreEqual(const cv::Mat& image_a, const cv::Mat& image_b) {
+  return image_a.type() == image_b.type() &&
+         image_a.size() == image_b.size() &&
+         cv::norm(image_a, image_b, cv::NORM_INF) == 0.0;
+}
+
+// 16-bit depth and the same depth converted to float meters need to result in
+// identical vertex maps and validity images.
+inline void testDepthFormats(const std::string& distortion_model) {
+  const Camera camera(cameraConfig(distortion_model));
+  std::mt19937 random_engine(42);
+  std::uniform_int_distribution<int> depth(0, config.max_depth);
+  cv::Mat depth_16(config.height, config.width, CV_16UC1);
+  cv::Mat depth_32(config.height, config.width, CV_32FC1);
+  for (int v = 0; v < config.height; ++v) {
+    for (int u = 0; u < config.width; ++u) {
+      // Include invalid (zero) depth.
+      const uint16_t value = (u + v) % 7 == 0 ? 0 : depth(random_engine);
+      depth_16.at<uint16_t>(v, u) = value;
+      depth_32.at<float>(v, u) = value * config.depth_scale;
+    }
+  }
+
+  EXPECT_TRUE(imagesAreEqual(
+      camera.computeVertexMap(depth_16, config.depth_scale),
+      camera.computeVertexMap(depth_32)));
+  const cv::Mat validity = camera.computeValidityImage(depth_32);
+  EXPECT_TRUE(imagesAreEqual(
+      camera.computeValidityImage(depth_16, config.depth_scale), validity));
+
+  // Both valid and invalid pixels are covered.
+  EXPECT_GT(cv::countNonZero(validity), 0);
+  EXPECT_LT(cv::countNonZero(validity), config.width * config.height);
+}
+
+// Projecting the back-projected ray of every pixel needs to hit the pixel.
+inline void testRoundTrip(const std::string& distortion_model) {
+  const Camera camera(cameraConfig(distortion_model));
+  const cv::Mat vertices = camera.computeVertexMap(
+      cv::Mat(config.height, config.width, CV_32FC1, cv::Scalar(1.f)));
+
+  // The projection rejects points whose rounded coordinates could leave the
+  // image, so the outermost pixels are skipped.
+  for (int v = 1; v < config.height - 1; ++v) {
+    for (int u = 1; u < config.width - 1; ++u) {
+      const cv::Vec3f& vertex = vertices.at<cv::Vec3f>(v, u);
+      float u_projected, v_projected;
+      ASSERT_TRUE(camera.projectPointToImagePlane(
+          Point(vertex[0], vertex[1], vertex[2]), &u_projected, &v_projected))
+          << "Pixel (" << u << ", " << v << ") was not projected.";
+      EXPECT_NEAR(u_projected, u, config.round_trip_tolerance);
+      EXPECT_NEAR(v_projected, v, config.round_trip_tolerance);
+    }
+  }
+}
+
+// Points beyond the range where the distortion is invertible would fold back
+// into the image and need to be rejected.
+inline void testFoldingRejected(const std::string& distortion_model,
+                                const Point& valid_point,
+                                const Point& folding_point) {
+  Camera::Config camera_config = cameraConfig(distortion_model);
+  camera_config.distortion_coefficients = {config.folding_k1, 0.f, 0.f, 0.f};
+  const Camera camera(camera_config);
+  float u, v;
+  EXPECT_TRUE(camera.projectPointToImagePlane(valid_point, &u, &v));
+  EXPECT_FALSE(camera.projectPointToImagePlane(folding_point, &u, &v));
+  int u_int, v_int;
+  EXPECT_TRUE(camera.projectPointToImagePlane(valid_point, &u_int, &v_int));
+  EXPECT_FALSE(camera.projectPointToImagePlane(folding_point, &u_int, &v_int));
+}
+
+TEST(Camera, DepthFormatsArePinholeEquivalent) { testDepthFormats("pinhole"); }
+
+TEST(Camera, DepthFormatsAreRadtanEquivalent) { testDepthFormats("radtan"); }
+
+TEST(Camera, RadtanRoundTrip) { testRoundTrip("radtan"); }
+
+TEST(Camera, EquidistantRoundTrip) { testRoundTrip("equidistant"); }
+
+TEST(Camera, RadtanRejectsFoldingPoints) {
+  // Undistorted radius 1.5, distorted to 0.49 which lies inside the image.
+  testFoldingRejected("radtan", Point(0.5f, 0.f, 1.f), Point(1.5f, 0.f, 1.f));
+}
+
+TEST(Camera, EquidistantRejectsFoldingPoints) {
+  // Incidence angle 1.3 rad, distorted to 0.64 which lies inside the image.
+  testFoldingRejected("equidistant", Point(0.5f, 0.f, 1.f),
+                      Point(std::tan(1.3f), 0.f, 1.f));
+}
+
+}  // namespace test
+}  // namespace panoptic_mapping
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
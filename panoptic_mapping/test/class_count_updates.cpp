@@ -0,0 +1,106 @@
+#include "panoptic_mapping/map/classification/class_layer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/map/classification/binary_count.h"
+#include "panoptic_mapping/map/classification/moving_binary_count.h"
+#include "panoptic_mapping/map/classification/variable_count.h"
+#include "panoptic_mapping/test/comparison_utils.h"
+
+namespace panoptic_mapping {
+namespace test {
+
+struct ClassCountUpdatesConfig {
+  // Layer structure.
+  const size_t voxels_per_side = 8;
+  const FloatingPoint voxel_size = 0.1;
+
+  // Fractions of the voxels of a block observed per frame, covering the
+  // sparse and the dense kernels.
+  const std::vector<float> observed_fractions = {0.01f, 0.1f, 0.5f, 1.f};
+
+  // Number of frames integrated into each block, enough to saturate 8-bit
+  // counts.
+  const size_t num_frames = 600;
+
+  // Probability of an observation to belong to the submap (ID 0).
+  const float belonging_probability = 0.7f;
+
+  // Cached downstream quantities.
+  const size_t voxels_per_block =
+      voxels_per_side * voxels_per_side * voxels_per_side;
+} config;
+
+// Class updates of a single frame for one block, as recorded by the
+// integrators: a random subset of the voxels, each observed once.
+inline ClassCountUpdates randomFrameUpdates(float observed_fraction,
+                                            std::mt19937* random_engine) {
+  std::vector<size_t> voxels(config.voxels_per_block);
+  std::iota(voxels.begin(), voxels.end(), 0u);
+  std::shuffle(voxels.begin(), voxels.end(), *random_engine);
+  voxels.resize(std::max<size_t>(
+      static_cast<size_t>(observed_fraction * config.voxels_per_block), 1u));
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::uniform_int_distribution<int> foreign_id(1, 5);
+  ClassCountUpdates updates;
+  for (const size_t voxel : voxels) {
+    updates.add(voxel, unit(*random_engine) < config.belonging_probability
+                           ? 0
+                           : foreign_id(*random_engine));
+  }
+  return updates;
+}
+
+// Integrate the same frames batched and voxel by voxel and compare the blocks.
+template <typename LayerT>
+inline void testBatchedUpdates() {
+  std::mt19937 random_engine(42);
+  for (const float fraction : config.observed_fractions) {
+    LayerT batched(typename LayerT::Config(), config.voxel_size,
+                   config.voxels_per_side);
+    LayerT per_voxel(typename LayerT::Config(), config.voxel_size,
+                     config.voxels_per_side);
+    ClassBlock::Ptr batched_block =
+        batched.allocateBlockPtrByIndex(BlockIndex(0, 0, 0));
+    ClassBlock::Ptr per_voxel_block =
+        per_voxel.allocateBlockPtrByIndex(BlockIndex(0, 0, 0));
+    for (size_t i = 0; i < config.num_frames; ++i) {
+      const ClassCountUpdates updates =
+          randomFrameUpdates(fraction, &random_engine);
+      batched.incrementCounts(batched_block.get(), updates);
+      for (size_t j = 0; j < updates.size(); ++j) {
+        per_voxel_block->getVoxelByLinearIndex(updates.voxel_indices[j])
+            .incrementCount(updates.ids[j]);
+      }
+    }
+    SCOPED_TRACE("Observed fraction " + std::to_string(fraction));
+    EXPECT_TRUE(checkLayerEqual(batched.getLayer(), per_voxel.getLayer()));
+  }
+}
+
+TEST(ClassCountUpdates, BinaryCount) {
+  testBatchedUpdates<BinaryCountLayer>();
+}
+
+TEST(ClassCountUpdates, MovingBinaryCount) {
+  testBatchedUpdates<MovingBinaryCountLayer>();
+}
+
+TEST(ClassCountUpdates, VariableCount) {
+  testBatchedUpdates<VariableCountLayer>();
+}
+
+}  // namespace test
+}  // namespace panoptic_mapping
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
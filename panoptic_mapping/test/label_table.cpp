@@ -0,0 +1,155 @@
+#include "panoptic_mapping/labels/label_table.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <gtest/gtest.h>
+#include <opencv2/core.hpp>
+
+#include "panoptic_mapping/common/globals.h"
+#include "panoptic_mapping/labels/csv_label_handler.h"
+#include "panoptic_mapping/test/temporary_file.h"
+
+namespace panoptic_mapping {
+namespace test {
+
+// Write a small label file and return the config to read it.
+inline CsvLabelHandler::Config writeLabelFile(TempFile* file) {
+  file->stream() << "InstanceID,ClassID,PanopticID,R,G,B,Name,Size\n"
+                 << "0,0,0,10,20,30,Wall,L\n"
+                 << "1,1,1,40,50,60,Chair,M\n"
+                 << "2,2,1,70,80,90,Cup,S\n"
+                 << "100000,3,1,1,2,3,Outlier,M\n";
+  file->stream().flush();
+  CsvLabelHandler::Config config;
+  config.verbosity = 0;
+  config.file_name = file->fileName();
+  return config;
+}
+
+TEST(LabelTable, Lookup) {
+  LabelTable::Labels labels;
+  for (int id : {-3, 0, 5, 1000000}) {
+    LabelEntry label;
+    label.segmentation_id = id;
+    label.class_id = id + 1;
+    label.label = PanopticLabel::kInstance;
+    labels[id] = std::make_unique<LabelEntry>(label);
+  }
+  const LabelTable table(std::move(labels));
+  EXPECT_EQ(table.numberOfLabels(), 4u);
+  for (int id : {-3, 0, 5, 1000000}) {
+    const LabelTable::CompactLabel* label = table.findLabel(id);
+    ASSERT_NE(label, nullptr);
+    EXPECT_EQ(label->class_id, id + 1);
+    EXPECT_EQ(label->label, PanopticLabel::kInstance);
+    EXPECT_EQ(label->entry->segmentation_id, id);
+  }
+  for (int id : {-4, 1, 999999, 1000001}) {
+    EXPECT_EQ(table.findLabel(id), nullptr);
+  }
+}
+
+TEST(LabelTable, MappersShareLabels) {
+  TempFile file("label_table_test");
+  ASSERT_TRUE(file);
+  const CsvLabelHandler::Config config = writeLabelFile(&file);
+
+  // Several mappers in one process reference the same label table.
+  Globals globals_a(nullptr, std::make_shared<CsvLabelHandler>(config, false));
+  Globals globals_b(nullptr, std::make_shared<CsvLabelHandler>(config, false));
+  Globals globals_c(nullptr, std::make_shared<CsvLabelHandler>(config, false));
+  const std::shared_ptr<const LabelTable>& table =
+      globals_a.labelHandler()->getLabelTable();
+  EXPECT_EQ(table, globals_b.labelHandler()->getLabelTable());
+  EXPECT_EQ(table, globals_c.labelHandler()->getLabelTable());
+  EXPECT_EQ(table.use_count(), 3);
+
+  // All handlers see the same labels.
+  for (const Globals* globals : {&globals_a, &globals_b, &globals_c}) {
+    const LabelHandlerBase& handler = *globals->labelHandler();
+    EXPECT_EQ(handler.numberOfLabels(), 4u);
+    EXPECT_EQ(handler.getName(1), "Chair");
+    EXPECT_EQ(handler.getClassID(100000), 3);
+    EXPECT_TRUE(handler.isBackgroundClass(0));
+    EXPECT_TRUE(handler.isInstanceClass(2));
+    EXPECT_FALSE(handler.segmentationIdExists(3));
+  }
+}
+
+TEST(LabelTable, SharingCanBeDisabled) {
+  TempFile file("label_table_test");
+  ASSERT_TRUE(file);
+  CsvLabelHandler::Config config = writeLabelFile(&file);
+  config.share_labels = false;
+  const CsvLabelHandler handler_a(config, false);
+  const CsvLabelHandler handler_b(config, false);
+  EXPECT_NE(handler_a.getLabelTable(), handler_b.getLabelTable());
+  EXPECT_EQ(handler_a.numberOfLabels(), handler_b.numberOfLabels());
+}
+
+TEST(LabelTable, SharedTablesAreReleased) {
+  TempFile file("label_table_test");
+  ASSERT_TRUE(file);
+  const CsvLabelHandler::Config config = writeLabelFile(&file);
+  std::weak_ptr<const LabelTable> table;
+  {
+    const CsvLabelHandler handler(config, false);
+    table = handler.getLabelTable();
+    EXPECT_FALSE(table.expired());
+  }
+  EXPECT_TRUE(table.expired());
+}
+
+TEST(LabelTable, ClassifyIDImage) {
+  TempFile file("label_table_test");
+  ASSERT_TRUE(file);
+  const CsvLabelHandler handler(writeLabelFile(&file), false);
+
+  // Known, unknown and sparse IDs, including repeated IDs in a row.
+  const cv::Mat id_image =
+      (cv::Mat_<int>(2, 6) << 0, 0, 1, 3, 3, 100000, 2, -1, 100000, 100000, 0,
+       5);
+  cv::Mat class_image, label_image, color_image;
+  handler.classifyIDImage(id_image, &class_image, &label_image, &color_image);
+  ASSERT_EQ(class_image.type(), CV_32SC1);
+  ASSERT_EQ(label_image.type(), CV_8UC1);
+  ASSERT_EQ(color_image.type(), CV_8UC3);
+  for (int v = 0; v < id_image.rows; ++v) {
+    for (int u = 0; u < id_image.cols; ++u) {
+      const int id = id_image.at<int>(v, u);
+      const int class_id = class_image.at<int>(v, u);
+      const auto label =
+          static_cast<PanopticLabel>(label_image.at<uchar>(v, u));
+      const cv::Vec3b& color = color_image.at<cv::Vec3b>(v, u);
+      SCOPED_TRACE("Segmentation ID " + std::to_string(id));
+      if (!handler.segmentationIdExists(id)) {
+        EXPECT_EQ(class_id, -1);
+        EXPECT_EQ(label, PanopticLabel::kUnknown);
+        EXPECT_EQ(color, cv::Vec3b(0, 0, 0));
+        continue;
+      }
+      EXPECT_EQ(class_id, handler.getClassID(id));
+      EXPECT_EQ(label, handler.getPanopticLabel(id));
+      const voxblox::Color& expected_color = handler.getColor(id);
+      EXPECT_EQ(color, cv::Vec3b(expected_color.b, expected_color.g,
+                                 expected_color.r));
+    }
+  }
+  EXPECT_EQ(class_image.at<int>(0, 5), 3);
+  EXPECT_EQ(color_image.at<cv::Vec3b>(1, 0), cv::Vec3b(90, 80, 70));
+
+  // Outputs are optional.
+  cv::Mat labels_only;
+  handler.classifyIDImage(id_image, nullptr, &labels_only);
+  EXPECT_EQ(cv::norm(labels_only, label_image, cv::NORM_INF), 0.0);
+}
+
+}  // namespace test
+}  // namespace panoptic_mapping
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
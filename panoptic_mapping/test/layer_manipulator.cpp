@@ -0,0 +1,121 @@
+#include "panoptic_mapping/map_management/layer_manipulator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "panoptic_mapping/common/common.h"
+
+namespace panoptic_mapping {
+namespace test {
+
+struct LayerManipulatorConfig {
+  // Layer structure.
+  const FloatingPoint voxel_size = 0.05;
+  const int voxels_per_side = 8;
+  const int blocks_per_side = 6;
+  const FloatingPoint truncation_distance = 0.2;
+
+  // Tilted plane n * p = offset, observed along the z-axis. The projective
+  // distances along z overestimate the distance to the plane by 1 / n_z.
+  const Point plane_normal = Point(1, 1, 2).normalized();
+  const FloatingPoint plane_offset = 0.6;
+
+  // Maximum error of the re-distanced voxels within the truncation band.
+  const FloatingPoint max_error = 0.5 * voxel_size;
+} config;
+
+inline LayerManipulator::Config manipulatorConfig() {
+  LayerManipulator::Config result;
+  result.verbosity = 0;
+  result.num_threads = 2;
+  return result;
+}
+
+inline FloatingPoint planeDistance(const Point& position) {
+  return config.plane_normal.dot(position) - config.plane_offset;
+}
+
+// Fill a layer with the truncated projective distances to the plane.
+inline void createProjectivePlaneLayer(TsdfLayer* layer) {
+  for (int x = 0; x < config.blocks_per_side; ++x) {
+    for (int y = 0; y < config.blocks_per_side; ++y) {
+      for (int z = 0; z < config.blocks_per_side; ++z) {
+        TsdfBlock::Ptr block =
+            layer->allocateBlockPtrByIndex(BlockIndex(x, y, z));
+        for (size_t i = 0; i < block->num_voxels(); ++i) {
+          TsdfVoxel& voxel = block->getVoxelByLinearIndex(i);
+          const FloatingPoint projective_distance =
+              planeDistance(block->computeCoordinatesFromLinearIndex(i)) /
+              config.plane_normal.z();
+          voxel.distance = std::max(
+              std::min(projective_distance, config.truncation_distance),
+              -config.truncation_distance);
+          voxel.weight = 1.f;
+        }
+        block->set_has_data(true);
+      }
+    }
+  }
+}
+
+// Whether the voxel is within the band and the surface is observed around it.
+inline bool isEvaluated(const Point& position) {
+  const FloatingPoint extent =
+      config.blocks_per_side * config.voxels_per_side * config.voxel_size;
+  return std::abs(planeDistance(position)) <
+             config.truncation_distance - config.voxel_size &&
+         (position.array() > config.truncation_distance).all() &&
+         (position.array() < extent - config.truncation_distance).all();
+}
+
+TEST(LayerManipulator, UnprojectPlane) {
+  TsdfLayer layer(config.voxel_size, config.voxels_per_side);
+  createProjectivePlaneLayer(&layer);
+  const TsdfLayer projective_layer(layer);
+  const LayerManipulator manipulator(manipulatorConfig());
+  manipulator.unprojectTsdfLayer(&layer, config.truncation_distance);
+
+  voxblox::BlockIndexList block_indices;
+  layer.getAllAllocatedBlocks(&block_indices);
+  size_t num_evaluated = 0;
+  FloatingPoint max_projective_error = 0.f;
+  for (const BlockIndex& block_index : block_indices) {
+    const TsdfBlock& block = layer.getBlockByIndex(block_index);
+    const TsdfBlock& projective_block =
+        projective_layer.getBlockByIndex(block_index);
+    for (size_t i = 0; i < block.num_voxels(); ++i) {
+      const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const Point position = block.computeCoordinatesFromLinearIndex(i);
+      const FloatingPoint distance = planeDistance(position);
+
+      // All voxels keep their sign and stay within the truncation distance.
+      EXPECT_EQ(voxel.distance >= 0.f,
+                projective_block.getVoxelByLinearIndex(i).distance >= 0.f);
+      EXPECT_LE(std::abs(voxel.distance), config.truncation_distance);
+      if (!isEvaluated(position)) {
+        continue;
+      }
+      EXPECT_NEAR(voxel.distance, distance, config.max_error)
+          << "Voxel at " << position.transpose() << ".";
+      max_projective_error = std::max(
+          max_projective_error,
+          std::abs(projective_block.getVoxelByLinearIndex(i).distance -
+                   distance));
+      num_evaluated++;
+    }
+  }
+
+  // The band is covered and the projective distances were off.
+  EXPECT_GT(num_evaluated, 100u);
+  EXPECT_GT(max_projective_error, config.max_error);
+}
+
+}  // namespace test
+}  // namespace panoptic_mapping
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,250 @@
+#include "panoptic_mapping/tools/semantic_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/map/submap_collection.h"
+
+namespace panoptic_mapping {
+namespace test {
+
+struct SemanticIndexConfig {
+  // Submap structure.
+  const FloatingPoint voxel_size = 0.1;
+  const int voxels_per_side = 16;
+
+  // Random spatial tests.
+  const size_t num_submaps = 200;
+  const size_t num_queries = 500;
+  const FloatingPoint map_extent = 100.f;
+} config;
+
+inline SemanticIndex::Config indexConfig() {
+  SemanticIndex::Config result;
+  result.verbosity = 0;
+  result.grid_cell_size = 2.f;
+  return result;
+}
+
+// Create a submap whose blocks cover a cube of the given half extent.
+inline Submap* createSubmap(SubmapCollection* submaps, const Point& center,
+                            FloatingPoint half_extent, int class_id = 0,
+                            PanopticLabel label = PanopticLabel::kInstance) {
+  Submap::Config submap_config;
+  submap_config.verbosity = 0;
+  submap_config.voxel_size = config.voxel_size;
+  submap_config.voxels_per_side = config.voxels_per_side;
+  Submap* submap = submaps->createSubmap(submap_config);
+  submap->setClassID(class_id);
+  submap->setLabel(label);
+  const FloatingPoint block_size = config.voxel_size * config.voxels_per_side;
+  for (FloatingPoint x = -half_extent; x <= half_extent; x += block_size) {
+    for (FloatingPoint y = -half_extent; y <= half_extent; y += block_size) {
+      for (FloatingPoint z = -half_extent; z <= half_extent; z += block_size) {
+        const Point point = center + Point(x, y, z);
+        submap->getTsdfLayerPtr()->allocateBlockPtrByCoordinates(point);
+        submap->markBlockUpdated(
+            submap->getTsdfLayer().computeBlockIndexFromCoordinates(point));
+      }
+    }
+  }
+  submap->updateBoundingVolume();
+  return submap;
+}
+
+inline FloatingPoint distanceToSubmap(const Submap& submap,
+                                      const Point& point_M) {
+  const Point center_M =
+      submap.getT_M_S() * submap.getBoundingVolume().getCenter();
+  return std::max((center_M - point_M).norm() -
+                      submap.getBoundingVolume().getRadius(),
+                  0.f);
+}
+
+TEST(SemanticIndex, SemanticQueries) {
+  SubmapCollection submaps;
+  const int chair = createSubmap(&submaps, Point(0, 0, 0), 0.5f, 1)->getID();
+  const int table = createSubmap(&submaps, Point(5, 0, 0), 0.5f, 2)->getID();
+  const int wall = createSubmap(&submaps, Point(0, 5, 0), 0.5f, 3,
+                                PanopticLabel::kBackground)
+                       ->getID();
+  SemanticIndex index(indexConfig());
+  index.update(submaps);
+  ASSERT_EQ(index.size(), 3u);
+
+  SemanticIndex::Query query;
+  query.class_id = 2;
+  EXPECT_EQ(index.find(query), std::vector<int>({table}));
+  query = SemanticIndex::Query();
+  query.label = PanopticLabel::kBackground;
+  EXPECT_EQ(index.find(query), std::vector<int>({wall}));
+  query.class_id = 1;
+  EXPECT_TRUE(index.find(query).empty());
+
+  query = SemanticIndex::Query();
+  query.label = PanopticLabel::kInstance;
+  std::vector<int> instances = index.find(query);
+  std::sort(instances.begin(), instances.end());
+  EXPECT_EQ(instances, std::vector<int>({chair, table}));
+
+  SemanticIndex::Entry entry;
+  ASSERT_TRUE(index.getEntry(wall, &entry));
+  EXPECT_EQ(entry.class_id, 3);
+  EXPECT_FALSE(index.getEntry(-1, &entry));
+}
+
+TEST(SemanticIndex, IncrementalUpdates) {
+  SubmapCollection submaps;
+  Submap* chair = createSubmap(&submaps, Point(0, 0, 0), 0.5f, 1);
+  const int table = createSubmap(&submaps, Point(5, 0, 0), 0.5f, 2)->getID();
+  SemanticIndex index(indexConfig());
+  index.update(submaps);
+
+  // Changed submap state.
+  chair->setChangeState(ChangeState::kPersistent);
+  chair->setIsActive(false);
+  index.update(submaps);
+  SemanticIndex::Query query;
+  query.change_state = ChangeState::kPersistent;
+  EXPECT_EQ(index.find(query), std::vector<int>({chair->getID()}));
+  query = SemanticIndex::Query();
+  query.only_active = true;
+  EXPECT_EQ(index.find(query), std::vector<int>({table}));
+
+  // Changed submap data.
+  const Point far_point(20, 0, 0);
+  EXPECT_TRUE(index.findWithinRadius(query, far_point, 1.f).empty());
+  Submap* table_submap = submaps.getSubmapPtr(table);
+  table_submap->getTsdfLayerPtr()->allocateBlockPtrByCoordinates(far_point);
+  table_submap->markBlockUpdated(
+      table_submap->getTsdfLayer().computeBlockIndexFromCoordinates(
+          far_point));
+  table_submap->updateBoundingVolume();
+  index.update(submaps);
+  EXPECT_EQ(index.findWithinRadius(query, far_point, 1.f),
+            std::vector<int>({table}));
+
+  // Removed submaps.
+  submaps.removeSubmap(table);
+  index.update(submaps);
+  EXPECT_EQ(index.size(), 1u);
+  EXPECT_TRUE(index.find(query).empty());
+
+  index.clear();
+  EXPECT_EQ(index.size(), 0u);
+  index.update(submaps);
+  EXPECT_EQ(index.size(), 1u);
+}
+
+TEST(SemanticIndex, SpatialQueriesMatchBruteForce) {
+  std::mt19937 random_engine(42);
+  std::uniform_real_distribution<FloatingPoint> coordinate(
+      -config.map_extent / 2.f, config.map_extent / 2.f);
+  std::uniform_real_distribution<FloatingPoint> unit(0.f, 1.f);
+  std::uniform_int_distribution<int> class_id(0, 4);
+
+  // Mostly small objects, some large background submaps.
+  SubmapCollection submaps;
+  for (size_t i = 0; i < config.num_submaps; ++i) {
+    const Point center(coordinate(random_engine), coordinate(random_engine),
+                       coordinate(random_engine));
+    const FloatingPoint half_extent =
+        unit(random_engine) < 0.9f ? 2.f * unit(random_engine)
+                                   : 20.f * unit(random_engine);
+    createSubmap(&submaps, center, half_extent, class_id(random_engine));
+  }
+  SemanticIndex index(indexConfig());
+  index.update(submaps);
+
+  for (size_t i = 0; i < config.num_queries; ++i) {
+    const Point point(coordinate(random_engine), coordinate(random_engine),
+                      coordinate(random_engine));
+    const FloatingPoint radius = 10.f * unit(random_engine);
+    SemanticIndex::Query query;
+    if (i % 2) {
+      query.class_id = class_id(random_engine);
+    }
+
+    // Brute force reference.
+    std::vector<int> expected;
+    int expected_nearest = -1;
+    FloatingPoint expected_distance = std::numeric_limits<float>::max();
+    for (const Submap& submap : submaps) {
+      if (query.class_id && submap.getClassID() != *query.class_id) {
+        continue;
+      }
+      const FloatingPoint distance = distanceToSubmap(submap, point);
+      if (distance <= radius) {
+        expected.push_back(submap.getID());
+      }
+      if (distance < expected_distance) {
+        expected_distance = distance;
+        expected_nearest = submap.getID();
+      }
+    }
+
+    std::vector<int> result = index.findWithinRadius(query, point, radius);
+    std::sort(result.begin(), result.end());
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(result, expected);
+
+    int nearest = -1;
+    FloatingPoint distance = 0.f;
+    ASSERT_EQ(index.findNearest(query, point, &nearest, &distance),
+              expected_nearest >= 0);
+    if (expected_nearest >= 0) {
+      EXPECT_FLOAT_EQ(distance, expected_distance);
+      EXPECT_FLOAT_EQ(distanceToSubmap(submaps.getSubmap(nearest), point),
+                      expected_distance);
+    }
+  }
+}
+
+TEST(SemanticIndex, ConcurrentQueries) {
+  SubmapCollection submaps;
+  for (int i = 0; i < 20; ++i) {
+    createSubmap(&submaps, Point(i, 0, 0), 0.5f, i % 3);
+  }
+  SemanticIndex index(indexConfig());
+  index.update(submaps);
+
+  // Readers query while the index is rebuilt.
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&index, &stop]() {
+      SemanticIndex::Query query;
+      query.class_id = 1;
+      while (!stop) {
+        int id;
+        index.findWithinRadius(query, Point(10, 0, 0), 3.f);
+        index.findNearest(query, Point(30, 0, 0), &id);
+        EXPECT_LE(index.find(query).size(), 7u);
+      }
+    });
+  }
+  for (int i = 0; i < 100; ++i) {
+    index.clear();
+    index.update(submaps);
+  }
+  stop = true;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(index.size(), 20u);
+}
+
+}  // namespace test
+}  // namespace panoptic_mapping
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,92 @@
+#include "panoptic_mapping/map/submap.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/map/submap_collection.h"
+
+namespace panoptic_mapping {
+namespace test {
+
+struct SubmapBlocksConfig {
+  // Submap structure.
+  const FloatingPoint voxel_size = 0.1;
+  const int voxels_per_side = 8;
+
+  // Blocks allocated in every submap.
+  const std::vector<BlockIndex> block_indices = {
+      BlockIndex(0, 0, 0), BlockIndex(-1, 2, 0), BlockIndex(3, -1, -2)};
+} config;
+
+inline Submap* createSubmap(SubmapCollection* submaps, bool fused) {
+  Submap::Config submap_config;
+  submap_config.verbosity = 0;
+  submap_config.voxel_size = config.voxel_size;
+  submap_config.voxels_per_side = config.voxels_per_side;
+  submap_config.fused_block_storage = fused;
+  return submaps->createSubmap(submap_config);
+}
+
+// The blocks returned by the submap need to be the blocks of its layers.
+inline void expectBlocksMatchLayers(const Submap& submap) {
+  voxblox::BlockIndexList block_indices;
+  submap.getTsdfLayer().getAllAllocatedBlocks(&block_indices);
+  for (const BlockIndex& block_index : block_indices) {
+    const Submap::BlockRecord blocks = submap.getBlocks(block_index);
+    ASSERT_TRUE(blocks);
+    EXPECT_EQ(blocks.tsdf,
+              submap.getTsdfLayer().getBlockPtrByIndex(block_index));
+  }
+}
+
+inline void testBlockAccess(bool fused) {
+  SubmapCollection submaps;
+  Submap* submap = createSubmap(&submaps, fused);
+  for (const BlockIndex& block_index : config.block_indices) {
+    EXPECT_FALSE(submap->getBlocks(block_index));
+    const Submap::BlockRecord blocks = submap->allocateBlocks(block_index);
+    ASSERT_TRUE(blocks);
+    blocks.tsdf->getVoxelByLinearIndex(0).weight = 1.f;
+  }
+  EXPECT_EQ(submap->getTsdfLayer().getNumberOfAllocatedBlocks(),
+            config.block_indices.size());
+  expectBlocksMatchLayers(*submap);
+  EXPECT_EQ(submap->getTsdfLayer()
+                .getBlockByIndex(config.block_indices[0])
+                .getVoxelByLinearIndex(0)
+                .weight,
+            1.f);
+
+  // Removed blocks are neither in the layers nor returned.
+  submap->removeBlocks(config.block_indices[0]);
+  EXPECT_FALSE(submap->getBlocks(config.block_indices[0]));
+  EXPECT_FALSE(submap->getTsdfLayer().hasBlock(config.block_indices[0]));
+  expectBlocksMatchLayers(*submap);
+
+  // Blocks allocated via the layers are found after updating the records.
+  submap->getTsdfLayerPtr()->allocateBlockPtrByIndex(config.block_indices[0]);
+  submap->updateBlockRecords();
+  expectBlocksMatchLayers(*submap);
+
+  // Copies refer to their own blocks.
+  const std::unique_ptr<SubmapCollection> copy = submaps.clone();
+  const Submap& submap_copy = copy->getSubmap(submap->getID());
+  expectBlocksMatchLayers(submap_copy);
+  EXPECT_NE(submap_copy.getBlocks(config.block_indices[1]).tsdf,
+            submap->getBlocks(config.block_indices[1]).tsdf);
+}
+
+TEST(SubmapBlocks, SeparateStorage) { testBlockAccess(false); }
+
+TEST(SubmapBlocks, FusedStorage) { testBlockAccess(true); }
+
+}  // namespace test
+}  // namespace panoptic_mapping
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
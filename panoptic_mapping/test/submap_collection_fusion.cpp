@@ -0,0 +1,228 @@
+#include "panoptic_mapping/map_management/submap_collection_fusion.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "panoptic_mapping/common/common.h"
+#include "panoptic_mapping/map/submap_collection.h"
+#include "panoptic_mapping/test/temporary_file.h"
+
+namespace panoptic_mapping {
+namespace test {
+
+struct FusionConfig {
+  // Submap structure.
+  const FloatingPoint voxel_size = 0.1;
+  const int voxels_per_side = 16;
+  const FloatingPoint truncation_distance = 0.2;
+
+  // All submaps contain a horizontal plane at this height.
+  const FloatingPoint plane_height = 0.8;
+
+  // A voxel on the plane.
+  const Point probe = Point(0.75, 0.75, 0.75);
+} config;
+
+inline SubmapCollectionFusion::Config fusionConfig() {
+  SubmapCollectionFusion::Config result;
+  result.verbosity = 0;
+  result.integration_threads = 2;
+  result.tsdf_registrator_config.verbosity = 0;
+  result.tsdf_registrator_config.normalize_by_voxel_weight = false;
+  result.tsdf_registrator_config.integration_threads = 2;
+  result.layer_manipulator_config.verbosity = 0;
+  result.layer_manipulator_config.num_threads = 2;
+  return result;
+}
+
+// Create a submap containing a horizontal plane with its iso-surface points.
+inline Submap* createPlaneSubmap(SubmapCollection* submaps, int class_id,
+                                 bool is_active) {
+  Submap::Config submap_config;
+  submap_config.verbosity = 0;
+  submap_config.voxel_size = config.voxel_size;
+  submap_config.voxels_per_side = config.voxels_per_side;
+  submap_config.truncation_distance = config.truncation_distance;
+  Submap* submap = submaps->createSubmap(submap_config);
+  submap->setClassID(class_id);
+  submap->setLabel(PanopticLabel::kInstance);
+  for (const BlockIndex& block_index :
+       {BlockIndex(0, 0, -1), BlockIndex(0, 0, 0)}) {
+    TsdfBlock::Ptr block =
+        submap->getTsdfLayerPtr()->allocateBlockPtrByIndex(block_index);
+    for (size_t i = 0; i < block->num_voxels(); ++i) {
+      TsdfVoxel& voxel = block->getVoxelByLinearIndex(i);
+      const Point position = block->computeCoordinatesFromLinearIndex(i);
+      voxel.distance = std::max(
+          std::min(position.z() - config.plane_height,
+                   config.truncation_distance),
+          -config.truncation_distance);
+      voxel.weight = 1.f;
+    }
+    block->set_has_data(true);
+    submap->markBlockUpdated(block_index);
+  }
+  for (FloatingPoint x = 0.2f; x < 1.45f; x += config.voxel_size) {
+    for (FloatingPoint y = 0.2f; y < 1.45f; y += config.voxel_size) {
+      submap->getIsoSurfacePointsPtr()->emplace_back(
+          Point(x, y, config.plane_height), 1.f);
+    }
+  }
+  submap->updateBoundingVolume();
+  submap->setIsActive(is_active);
+  return submap;
+}
+
+inline TsdfVoxel& probeVoxel(Submap* submap) {
+  return *submap->getTsdfLayerPtr()->getVoxelPtrByCoordinates(config.probe);
+}
+
+TEST(SubmapCollectionFusion, MergedDataIsKeptByOtherPeers) {
+  SubmapCollectionFusion fusion(fusionConfig());
+  SubmapCollection peer_a;
+  SubmapCollection peer_b;
+  SubmapCollection target;
+  const int peer_a_id = 0;
+  const int peer_b_id = 1;
+  const int submap_a = createPlaneSubmap(&peer_a, 1, false)->getID();
+  Submap* submap_b = createPlaneSubmap(&peer_b, 1, false);
+
+  // A is merged into the copy of B.
+  fusion.fuseCollection(peer_b_id, peer_b, Transformation(), &target);
+  ASSERT_EQ(target.size(), 1u);
+  const int merged_id = fusion.getTargetSubmapID(peer_b_id, submap_b->getID());
+  fusion.fuseCollection(peer_a_id, peer_a, Transformation(), &target);
+  ASSERT_EQ(target.size(), 1u);
+  EXPECT_EQ(fusion.getTargetSubmapID(peer_a_id, submap_a), merged_id);
+  EXPECT_FLOAT_EQ(probeVoxel(target.getSubmapPtr(merged_id)).weight, 2.f);
+
+  // Updates of B do not overwrite the merged data.
+  probeVoxel(submap_b).weight = 5.f;
+  submap_b->markBlockUpdated(
+      submap_b->getTsdfLayer().computeBlockIndexFromCoordinates(config.probe));
+  fusion.fuseCollection(peer_b_id, peer_b, Transformation(), &target);
+  ASSERT_EQ(target.size(), 1u);
+  ASSERT_TRUE(target.submapIdExists(merged_id));
+  EXPECT_FLOAT_EQ(probeVoxel(target.getSubmapPtr(merged_id)).weight, 2.f);
+
+  // Neither does removing it.
+  const int submap_b_id = submap_b->getID();
+  peer_b.removeSubmap(submap_b_id);
+  fusion.fuseCollection(peer_b_id, peer_b, Transformation(), &target);
+  EXPECT_EQ(target.size(), 1u);
+  EXPECT_TRUE(target.submapIdExists(merged_id));
+  EXPECT_EQ(fusion.getTargetSubmapID(peer_b_id, submap_b_id), -1);
+}
+
+TEST(SubmapCollectionFusion, ActiveCopiesAreNotMergedInto) {
+  SubmapCollectionFusion fusion(fusionConfig());
+  SubmapCollection peer_a;
+  SubmapCollection peer_b;
+  SubmapCollection target;
+  createPlaneSubmap(&peer_a, 1, false);
+  createPlaneSubmap(&peer_b, 1, true);
+  fusion.fuseCollection(1, peer_b, Transformation(), &target);
+  fusion.fuseCollection(0, peer_a, Transformation(), &target);
+  EXPECT_EQ(target.size(), 2u);
+}
+
+TEST(SubmapCollectionFusion, CopiesAreUpdatedInPlace) {
+  SubmapCollectionFusion fusion(fusionConfig());
+  SubmapCollection peer;
+  SubmapCollection target;
+  Submap* peer_submap = createPlaneSubmap(&peer, 1, true);
+  peer_submap->setChangeState(ChangeState::kPersistent);
+
+  // The copy keeps the change state of the peer.
+  fusion.fuseCollection(0, peer, Transformation(), &target);
+  ASSERT_EQ(target.size(), 1u);
+  const int copy_id = fusion.getTargetSubmapID(0, peer_submap->getID());
+  Submap* copy = target.getSubmapPtr(copy_id);
+  EXPECT_FALSE(copy->isActive());
+  EXPECT_EQ(copy->getChangeState(), ChangeState::kPersistent);
+
+  // Nothing changed.
+  const uint64_t version = copy->getLatestVersion();
+  fusion.fuseCollection(0, peer, Transformation(), &target);
+  ASSERT_TRUE(target.submapIdExists(copy_id));
+  EXPECT_EQ(copy->getLatestVersion(), version);
+
+  // Only the updated block is copied.
+  const BlockIndex updated_block =
+      peer_submap->getTsdfLayer().computeBlockIndexFromCoordinates(
+          config.probe);
+  const BlockIndex other_block = updated_block - BlockIndex(0, 0, 1);
+  probeVoxel(peer_submap).distance = 0.05f;
+  peer_submap->markBlockUpdated(updated_block);
+  fusion.fuseCollection(0, peer, Transformation(), &target);
+  ASSERT_TRUE(target.submapIdExists(copy_id));
+  EXPECT_FLOAT_EQ(probeVoxel(copy).distance, 0.05f);
+  EXPECT_GT(copy->getBlockVersion(updated_block), version);
+  EXPECT_LE(copy->getBlockVersion(other_block), version);
+
+  // State changes are copied.
+  peer_submap->setChangeState(ChangeState::kAbsent);
+  fusion.fuseCollection(0, peer, Transformation(), &target);
+  EXPECT_EQ(copy->getChangeState(), ChangeState::kAbsent);
+  EXPECT_EQ(target.size(), 1u);
+}
+
+TEST(SubmapCollectionFusion, ReloadedPeersAreCopiedCompletely) {
+  SubmapCollectionFusion fusion(fusionConfig());
+  SubmapCollection peer;
+  SubmapCollection target;
+  Submap* peer_submap = createPlaneSubmap(&peer, 1, true);
+  fusion.fuseCollection(0, peer, Transformation(), &target);
+  ASSERT_EQ(target.size(), 1u);
+  const int copy_id = fusion.getTargetSubmapID(0, peer_submap->getID());
+
+  // Save the changed peer map and fuse it after reloading it, which drops all
+  // block versions.
+  probeVoxel(peer_submap).distance = 0.05f;
+  peer_submap->markBlockUpdated(
+      peer_submap->getTsdfLayer().computeBlockIndexFromCoordinates(
+          config.probe));
+  TempFile file("submap_collection_fusion_test", ".panmap");
+  ASSERT_TRUE(peer.saveToFile(file.fileName()));
+  SubmapCollection reloaded_peer;
+  ASSERT_TRUE(reloaded_peer.loadFromFile(file.fileName()));
+  ASSERT_TRUE(reloaded_peer.submapIdExists(peer_submap->getID()));
+  fusion.fuseCollection(0, reloaded_peer, Transformation(), &target);
+  ASSERT_EQ(target.size(), 1u);
+  EXPECT_EQ(fusion.getTargetSubmapID(0, peer_submap->getID()), copy_id);
+  Submap* copy = target.getSubmapPtr(copy_id);
+  EXPECT_FLOAT_EQ(probeVoxel(copy).distance, 0.05f);
+  EXPECT_FALSE(copy->isActive());
+}
+
+TEST(SubmapCollectionFusion, CopiesShareInstances) {
+  SubmapCollectionFusion fusion(fusionConfig());
+  SubmapCollection peer;
+  SubmapCollection target;
+  Submap* first = createPlaneSubmap(&peer, 1, true);
+  Submap* second = createPlaneSubmap(&peer, 1, true);
+  second->setInstanceID(first->getInstanceID());
+  fusion.fuseCollection(0, peer, Transformation(), &target);
+  ASSERT_EQ(target.size(), 2u);
+  const Submap& first_copy =
+      target.getSubmap(fusion.getTargetSubmapID(0, first->getID()));
+  const Submap& second_copy =
+      target.getSubmap(fusion.getTargetSubmapID(0, second->getID()));
+  EXPECT_EQ(first_copy.getInstanceID(), second_copy.getInstanceID());
+
+  // Joining an instance does not consume a new instance ID.
+  Submap::Config submap_config;
+  submap_config.verbosity = 0;
+  EXPECT_EQ(target.createSubmap(submap_config)->getInstanceID(),
+            first_copy.getInstanceID() + 1);
+}
+
+}  // namespace test
+}  // namespace panoptic_mapping
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -9,6 +9,7 @@
 #include <utility>
 #include <vector>
 
+#include <panoptic_mapping/common/common.h>
 #include <panoptic_mapping/common/input_data.h>
 #include <ros/ros.h>
 #include <sensor_msgs/Image.h>
@@ -27,6 +28,7 @@ struct InputSynchronizerData {
   ros::Time timestamp;
   std::mutex write_mutex_;  // Lock this mutex when writing to common data
                             // structures such as the input list
+  std::unique_ptr<Timer> dispatch_timer;  // Runs from ready until retrieved.
 };
 
 /**
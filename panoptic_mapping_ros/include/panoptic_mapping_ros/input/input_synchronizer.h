@@ -2,6 +2,8 @@
 #define PANOPTIC_MAPPING_ROS_INPUT_INPUT_SYNCHRONIZER_H_
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <limits>
 #include <memory>
@@ -37,6 +39,8 @@ class InputSynchronizer : public InputSynchronizerBase {
     float transform_lookup_time =
         0.1f;  // s, Maximum time to wait for transforms.
     double max_delay = 0.0; // s, Maximum delay between Image messages that should be synced
+    float depth_scale = 0.001f;  // m, Size of a unit of 16-bit depth images,
+    // which are kept in their native format.
 
     Config() { setConfigName("InputSynchronizer"); }
 
@@ -63,6 +67,21 @@ class InputSynchronizer : public InputSynchronizerBase {
    */
   bool hasInputData() const { return data_is_ready_; }
 
+  /**
+   * @brief Block until input data is ready to be retrieved, the timeout
+   * expires, or the wait is interrupted.
+   *
+   * @param timeout Maximum time to wait in seconds.
+   * @return True if input data is ready.
+   */
+  bool waitForInputData(double timeout);
+
+  /**
+   * @brief Wake up all threads waiting for input data, e.g. when shutting
+   * down. Subsequent waits return immediately.
+   */
+  void interruptWait();
+
   /**
    * @brief Extract the most recent input data from the queue. The data will be
    * deleted from the queue. This call is blocking.
@@ -87,6 +106,15 @@ class InputSynchronizer : public InputSynchronizerBase {
    */
   void advertiseInputTopics();
 
+  /**
+   * @brief Change the number of data points stored before old data is
+   * discarded. Excess data is dropped immediately. The queue sizes of the ROS
+   * subscribers are not changed.
+   *
+   * @param max_input_queue_length The new maximum queue length.
+   */
+  void setMaxInputQueueLength(int max_input_queue_length);
+
  private:
   /**
    * @brief Utility function for more readable queue allocation.
@@ -126,6 +154,12 @@ class InputSynchronizer : public InputSynchronizerBase {
 
   void checkDataIsReady(InputSynchronizerData* data) override;
 
+  /**
+   * @brief Recompute whether any data in the queue is ready. The data_mutex_
+   * needs to be locked by the caller.
+   */
+  void updateDataIsReady();
+
  private:
   template <typename T>
   friend class InputSubscriber;
@@ -146,12 +180,21 @@ class InputSynchronizer : public InputSynchronizerBase {
   // Settings.
   static const std::unordered_map<InputData::InputType, std::string>
       kDefaultTopicNames_;
+  static constexpr double kLookupRetryInterval = 0.01;  // s
 
   // Variables.
   std::atomic<bool> data_is_ready_;
   ros::Time oldest_time_ = ros::Time(0);
   std::string used_sensor_frame_name_;
   std::mutex data_mutex_;
+  size_t max_input_queue_length_;
+
+  // Signaling of ready data.
+  std::mutex ready_mutex_;
+  std::condition_variable ready_condition_;
+  bool wait_is_interrupted_ = false;
+  // Ready data whose transform lookup failed is not retried before this time.
+  std::chrono::steady_clock::time_point retry_time_;
 };
 
 }  // namespace panoptic_mapping
@@ -1,25 +1,33 @@
 #ifndef PANOPTIC_MAPPING_ROS_PANOPTIC_MAPPER_H_
 #define PANOPTIC_MAPPING_ROS_PANOPTIC_MAPPER_H_
 
+#include <atomic>
 #include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include <panoptic_mapping/3rd_party/config_utilities.hpp>
 #include <panoptic_mapping/common/common.h>
 #include <panoptic_mapping/common/globals.h>
+#include <panoptic_mapping/common/performance_parameters.h>
+#include <panoptic_mapping/common/thread_affinity.h>
 #include <panoptic_mapping/integration/tsdf_integrator_base.h>
 #include <panoptic_mapping/map/submap.h>
 #include <panoptic_mapping/map/submap_collection.h>
 #include <panoptic_mapping/map_management/map_manager_base.h>
 #include <panoptic_mapping/tools/data_writer_base.h>
 #include <panoptic_mapping/tools/planning_interface.h>
+#include <panoptic_mapping/tools/frame_deduplicator.h>
+#include <panoptic_mapping/tools/semantic_index.h>
 #include <panoptic_mapping/tools/thread_safe_submap_collection.h>
 #include <panoptic_mapping/tracking/id_tracker_base.h>
 #include <panoptic_mapping_msgs/SaveLoadMap.h>
+#include <panoptic_mapping_msgs/SetPerformanceParameters.h>
 #include <panoptic_mapping_msgs/SetVisualizationMode.h>
 #include <ros/ros.h>
 #include <std_srvs/Empty.h>
@@ -49,9 +57,20 @@ class PanopticMapper {
     // If true maintain and update the threadsafe submap collection for access.
     bool use_threadsafe_submap_collection = false;
 
+    // If true maintain and update the semantic index for object queries.
+    bool use_semantic_index = false;
+
+    // If true skip frames that are nearly identical to the last integrated
+    // frame, e.g. while the sensor is stationary.
+    bool skip_redundant_frames = false;
+
     // Number of threads used for ROS spinning.
     int ros_spinner_threads = std::thread::hardware_concurrency();
 
+    // If true process frames in a dedicated thread as soon as they are
+    // complete. Otherwise poll the input queue every check_input_interval.
+    bool wait_for_input = true;
+
     // Frequency in seconds in which the input queue is queried.
     float check_input_interval = 0.01f;
 
@@ -85,7 +104,7 @@ class PanopticMapper {
 
   // Construction.
   PanopticMapper(const ros::NodeHandle& nh, const ros::NodeHandle& nh_private);
-  virtual ~PanopticMapper() = default;
+  virtual ~PanopticMapper();
 
   // ROS callbacks.
   // Timers.
@@ -105,6 +124,11 @@ class PanopticMapper {
       panoptic_mapping_msgs::SetVisualizationMode::Request& request,  // NOLINT
       panoptic_mapping_msgs::SetVisualizationMode::Response&          // NOLINT
           response);
+  bool setPerformanceParametersCallback(
+      panoptic_mapping_msgs::SetPerformanceParameters::Request&  // NOLINT
+          request,
+      panoptic_mapping_msgs::SetPerformanceParameters::Response&  // NOLINT
+          response);
   bool printTimingsCallback(std_srvs::Empty::Request& request,      // NOLINT
                             std_srvs::Empty::Response& response);   // NOLINT
   bool finishMappingCallback(std_srvs::Empty::Request& request,     // NOLINT
@@ -119,6 +143,17 @@ class PanopticMapper {
   // NOTE(schmluk): This is currently a preliminary tool to play around with.
   void finishMapping();
 
+  /**
+   * @brief Request a change of performance parameters. Valid requests are
+   * applied before the next frame is processed.
+   *
+   * @param parameters The parameters to change.
+   * @param error Optional: reason why the request is invalid.
+   * @return True if the request is valid.
+   */
+  bool requestReconfiguration(const PerformanceParameters& parameters,
+                              std::string* error = nullptr);
+
   // IO.
   bool saveMap(const std::string& file_path);
   bool loadMap(const std::string& file_path);
@@ -138,6 +173,7 @@ class PanopticMapper {
   const PlanningInterface& getPlanningInterface() const {
     return *planning_interface_;
   }
+  const SemanticIndex& getSemanticIndex() const { return *semantic_index_; }
   MapManagerBase* getMapManagerPtr() { return map_manager_.get(); }
   const Config& getConfig() const { return config_; }
 
@@ -147,6 +183,16 @@ class PanopticMapper {
   void setupCollectionDependentMembers();
   void setupRos();
 
+  // Apply all pending reconfiguration requests, between two frames.
+  void applyPendingReconfigurations();
+
+  // Write the log data if requested, between two frames.
+  void writePendingData();
+
+  // Input handling. Process the next ready frame if there is one.
+  void checkInput();
+  void inputLoop();
+
  private:
   // Node handles.
   ros::NodeHandle nh_;
@@ -159,6 +205,7 @@ class PanopticMapper {
   ros::ServiceServer set_color_mode_srv_;
   ros::ServiceServer print_timings_srv_;
   ros::ServiceServer finish_mapping_srv_;
+  ros::ServiceServer set_performance_parameters_srv_;
   ros::Timer visualization_timer_;
   ros::Timer data_logging_timer_;
   ros::Timer print_timing_timer_;
@@ -181,6 +228,8 @@ class PanopticMapper {
   std::unique_ptr<InputSynchronizer> input_synchronizer_;
   std::unique_ptr<DataWriterBase> data_logger_;
   std::shared_ptr<PlanningInterface> planning_interface_;
+  std::unique_ptr<SemanticIndex> semantic_index_;
+  std::unique_ptr<FrameDeduplicator> frame_deduplicator_;
 
   // Visualization.
   std::unique_ptr<SubmapVisualizer> submap_visualizer_;
@@ -190,6 +239,11 @@ class PanopticMapper {
   // Which processing to perform.
   bool compute_vertex_map_ = false;
   bool compute_validity_image_ = false;
+  bool compute_max_depth_pyramid_ = false;
+
+  // Input thread, used if 'wait_for_input' is true.
+  std::thread input_thread_;
+  std::atomic<bool> stop_input_thread_{false};
 
   // Tracking variables.
   ros::WallTime previous_frame_time_ = ros::WallTime::now();
@@ -197,6 +251,14 @@ class PanopticMapper {
   ros::Time last_input_;
   bool got_a_frame_ = false;
 
+  // Reconfiguration requests that are applied before the next frame.
+  std::vector<PerformanceParameters> pending_reconfigurations_;
+  std::mutex reconfiguration_mutex_;
+
+  // Data logging requested by the timer, written before the next frame since
+  // the evaluations read the map.
+  std::atomic<bool> data_logging_requested_{false};
+
   // Default namespaces and types for modules are defined here.
   static const std::map<std::string, std::pair<std::string, std::string>>
       default_names_and_types_;
@@ -0,0 +1,61 @@
+#ifndef PANOPTIC_MAPPING_ROS_TOOLS_ONLINE_EVALUATION_DATA_WRITER_H_
+#define PANOPTIC_MAPPING_ROS_TOOLS_ONLINE_EVALUATION_DATA_WRITER_H_
+
+#include <memory>
+#include <string>
+
+#include <panoptic_mapping/3rd_party/config_utilities.hpp>
+#include <panoptic_mapping/common/common.h>
+#include <panoptic_mapping/map/submap_collection.h>
+#include <panoptic_mapping/tools/log_data_writer.h>
+#include <panoptic_mapping/tools/online_evaluator.h>
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Log data writer that additionally evaluates the reconstruction error
+ * and coverage of the map against a ground truth point cloud on every entry.
+ * The evaluation is incremental, only regions of the map that changed since
+ * the last entry are re-evaluated.
+ */
+class OnlineEvaluationDataWriter : public LogDataWriter {
+ public:
+  struct Config : public config_utilities::Config<Config> {
+    int verbosity = 2;
+
+    // Log data writer config.
+    LogDataWriter::Config log_data_writer_config;
+
+    // Evaluation.
+    std::string ground_truth_pointcloud_file;  // .ply file in mission frame.
+    OnlineEvaluator::Config online_evaluator_config;
+
+    Config() { setConfigName("OnlineEvaluationDataWriter"); }
+
+   protected:
+    void setupParamsAndPrinting() override;
+    void checkParams() const override;
+  };
+
+  explicit OnlineEvaluationDataWriter(const Config& config);
+  ~OnlineEvaluationDataWriter() override = default;
+
+ private:
+  static config_utilities::Factory::RegistrationRos<DataWriterBase,
+                                                    OnlineEvaluationDataWriter>
+      registration_;
+  const Config config_;
+
+  // Members.
+  std::unique_ptr<OnlineEvaluator> evaluator_;
+
+  // Methods.
+  void setupEvaluations() override;
+
+  // Evaluations. The data are always preceded by a separating comma.
+  void evaluateReconstruction(const SubmapCollection& submaps);
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_ROS_TOOLS_ONLINE_EVALUATION_DATA_WRITER_H_
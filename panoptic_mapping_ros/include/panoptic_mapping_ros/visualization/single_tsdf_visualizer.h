@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -31,6 +32,13 @@ class SingleTsdfVisualizer : public SubmapVisualizer {
     float min_score = 0.0f;
     float max_score = 1.0f;
 
+    // Number of threads used to color the mesh blocks.
+    int coloring_threads = std::thread::hardware_concurrency();
+
+    // If true cache the voxel colors of every block and only recompute them
+    // when the block or the color mode changed.
+    bool cache_colors = true;
+
     // Standard visualizer config.
     SubmapVisualizer::Config submap_visualizer;
 
@@ -57,10 +65,26 @@ class SingleTsdfVisualizer : public SubmapVisualizer {
   void setColorMode(ColorMode color_mode) override;
 
  protected:
-  void colorMeshBlockFromClass(const Submap& submap,
-                               voxblox_msgs::MeshBlock* mesh_block);
-  void colorMeshBlockFromScore(const Submap& submap,
-                               voxblox_msgs::MeshBlock* mesh_block);
+  // Colors of all voxels of a block, precomputed from the class or score
+  // layer.
+  struct BlockColors {
+    uint64_t block_version = 0u;
+    bool is_valid = false;
+    std::vector<Color> colors;
+    std::vector<bool> is_colored;  // False for voxels that keep their color.
+  };
+
+  void colorMeshBlocks(const Submap& submap, bool use_score_layer,
+                       voxblox_msgs::Mesh* mesh);
+  void computeBlockColorsFromClass(const Submap& submap,
+                                   const voxblox::BlockIndex& block_index,
+                                   BlockColors* block_colors) const;
+  void computeBlockColorsFromScore(const Submap& submap,
+                                   const voxblox::BlockIndex& block_index,
+                                   BlockColors* block_colors) const;
+  static void colorMeshBlock(const BlockColors& block_colors,
+                             int voxels_per_side,
+                             voxblox_msgs::MeshBlock* mesh_block);
   std::function<Color(const ClassVoxel&)> getColoring() const;
   void updateVisInfos(const SubmapCollection& submaps) override;
 
@@ -76,6 +100,8 @@ class SingleTsdfVisualizer : public SubmapVisualizer {
 
   // Cached / tracked data.
   SubmapVisInfo info_;
+  voxblox::AnyIndexHashMapType<BlockColors>::type block_colors_;
+  uint64_t block_colors_submap_version_ = 0u;
 };
 
 }  // namespace panoptic_mapping
@@ -32,6 +32,16 @@ class SubmapVisualizer {
     bool visualize_free_space = true;
     bool visualize_bounding_volumes = true;
     bool include_free_space = false;
+
+    // Minimum time in seconds between publishing the respective visuals, 0 to
+    // publish them on every request. Visuals are only computed if their topic
+    // has subscribers.
+    float tsdf_blocks_interval = 0.f;
+    float free_space_interval = 0.f;
+    float bounding_volumes_interval = 0.f;
+
+    // Only publish every n-th free space point, 1 to publish all.
+    int free_space_downsampling = 1;
     std::string ros_namespace;
 
     Config() { setConfigName("SubmapVisualizer"); }
@@ -131,6 +141,10 @@ class SubmapVisualizer {
   virtual void generateClassificationMesh(Submap* submap,
                                           voxblox_msgs::Mesh* mesh);
 
+  // Check whether a visual with the given minimum publishing interval is due
+  // and if so reset its last publishing time.
+  static bool publishingIsDue(float interval, ros::Time* last_published);
+
  protected:
   // Settings.
   VisualizationMode visualization_mode_;
@@ -154,6 +168,9 @@ class SubmapVisualizer {
   ros::Publisher mesh_pub_;
   ros::Publisher tsdf_blocks_pub_;
   ros::Publisher bounding_volume_pub_;
+  ros::Time tsdf_blocks_last_published_;
+  ros::Time free_space_last_published_;
+  ros::Time bounding_volumes_last_published_;
 
  private:
   const Config config_;
@@ -8,6 +8,7 @@
 #include <panoptic_mapping/common/common.h>
 #include <panoptic_mapping/tracking/id_tracker_base.h>
 #include <ros/node_handle.h>
+#include <ros/time.h>
 
 namespace panoptic_mapping {
 
@@ -17,6 +18,13 @@ class TrackingVisualizer {
   struct Config : public config_utilities::Config<Config> {
     int verbosity = 1;
     bool visualize_tracking = true;
+
+    // Maximum rate in Hz at which each image is published, 0 for no limit.
+    float max_publish_rate = 0.f;
+
+    // Factor by which images are downsampled before publishing, 1 to publish
+    // them at full resolution.
+    int image_downsampling = 1;
     std::string ros_namespace;
 
     Config() { setConfigName("TrackingVisualizer"); }
@@ -24,6 +32,7 @@ class TrackingVisualizer {
    protected:
     void setupParamsAndPrinting() override;
     void fromRosParam() override;
+    void checkParams() const override;
   };
 
   // Constructors.
@@ -36,12 +45,26 @@ class TrackingVisualizer {
   // Publish visualization requests.
   void publishImage(const cv::Mat& image, const std::string& name);
 
+  /**
+   * @brief Check whether an image should be computed and published now, i.e.
+   * whether its topic has subscribers and it is not rate limited. Topics are
+   * advertised on the first request.
+   */
+  bool imageIsRequested(const std::string& name);
+
+ private:
+  struct ImagePublisher {
+    ros::Publisher publisher;
+    ros::Time last_published;
+  };
+  ImagePublisher& getPublisher(const std::string& name);
+
  private:
   const Config config_;
 
   // Publishers.
   ros::NodeHandle nh_;
-  std::unordered_map<std::string, ros::Publisher> publishers_;
+  std::unordered_map<std::string, ImagePublisher> publishers_;
 };
 
 }  // namespace panoptic_mapping
@@ -1,6 +1,7 @@
 #include "panoptic_mapping_ros/input/input_synchronizer.h"
 
 #include <algorithm>
+#include <chrono>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -11,6 +12,7 @@
 #include <minkindr_conversions/kindr_tf.h>
 #include <panoptic_mapping_msgs/DetectronLabels.h>
 #include <sensor_msgs/Image.h>
+#include <sensor_msgs/image_encodings.h>
 
 #include "panoptic_mapping_ros/conversions/conversions.h"
 
@@ -29,6 +31,7 @@ void InputSynchronizer::Config::checkParams() const {
   checkParamCond(!global_frame_name.empty(),
                  "'global_frame_name' may not be empty.");
   checkParamGE(transform_lookup_time, 0.f, "transform_lookup_time");
+  checkParamGT(depth_scale, 0.f, "depth_scale");
 }
 
 void InputSynchronizer::Config::setupParamsAndPrinting() {
@@ -38,17 +41,40 @@ void InputSynchronizer::Config::setupParamsAndPrinting() {
   setupParam("sensor_frame_name", &sensor_frame_name);
   setupParam("transform_lookup_time", &transform_lookup_time);
   setupParam("max_delay", &max_delay);
+  setupParam("depth_scale", &depth_scale);
 }
 
 InputSynchronizer::InputSynchronizer(const Config& config,
                                      const ros::NodeHandle& nh)
-    : config_(config.checkValid()), nh_(nh), data_is_ready_(false) {
+    : config_(config.checkValid()),
+      nh_(nh),
+      data_is_ready_(false),
+      max_input_queue_length_(config_.max_input_queue_length) {
   LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
   if (!config_.sensor_frame_name.empty()) {
     used_sensor_frame_name_ = config_.sensor_frame_name;
   }
 }
 
+void InputSynchronizer::setMaxInputQueueLength(int max_input_queue_length) {
+  CHECK_GT(max_input_queue_length, 0);
+  std::lock_guard<std::mutex> lock(data_mutex_);
+  max_input_queue_length_ = max_input_queue_length;
+  if (data_queue_.size() <= max_input_queue_length_) {
+    return;
+  }
+
+  // Drop the oldest data.
+  std::sort(data_queue_.begin(), data_queue_.end(),
+            [](const auto& lhs, const auto& rhs) -> bool {
+              return lhs->timestamp < rhs->timestamp;
+            });
+  data_queue_.erase(data_queue_.begin(),
+                    data_queue_.end() - max_input_queue_length_);
+  updateDataIsReady();
+  oldest_time_ = data_queue_.front()->timestamp;
+}
+
 void InputSynchronizer::requestInputs(const InputData::InputTypes& types) {
   for (const auto& type : types) {
     requested_inputs_.insert(type);
@@ -69,9 +95,16 @@ void InputSynchronizer::advertiseInputTopics() {
         using MsgT = sensor_msgs::ImageConstPtr;
         addQueue<MsgT>(
             type, [this](const MsgT& msg, InputSynchronizerData* data) {
-              const cv_bridge::CvImageConstPtr depth =
-                  cv_bridge::toCvCopy(msg, "32FC1");
-              data->data->depth_image_ = depth->image;
+              // 16-bit depth is converted when it is first read.
+              if (msg->encoding == sensor_msgs::image_encodings::TYPE_16UC1 ||
+                  msg->encoding == sensor_msgs::image_encodings::MONO16) {
+                data->data->depth_image_ = cv_bridge::toCvCopy(msg)->image;
+                data->data->depth_scale_ = this->config_.depth_scale;
+              } else {
+                data->data->depth_image_ =
+                    cv_bridge::toCvCopy(msg, "32FC1")->image;
+                data->data->depth_scale_ = 1.f;
+              }
 
               // NOTE(schmluk): If the sensor frame name is not set
               // recover it from the depth image.
@@ -102,6 +135,8 @@ void InputSynchronizer::advertiseInputTopics() {
       case InputData::InputType::kSegmentationImage: {
         using MsgT = sensor_msgs::ImageConstPtr;
         addQueue<MsgT>(type, [](const MsgT& msg, InputSynchronizerData* data) {
+          // IDs are overwritten in place during tracking and need 32 bits,
+          // 16-bit messages are widened by the copy.
           const cv_bridge::CvImageConstPtr seg =
               cv_bridge::toCvCopy(msg, "32SC1");
           data->data->id_image_ = seg->image;
@@ -178,7 +213,7 @@ bool InputSynchronizer::allocateDataInQueue(const ros::Time& timestamp) {
   // NOTE(schmluk): This obviously modifies the queue but the data_mutex_ should
   // already be locked from the calling getDataInQueue().
   // Check max queue size.
-  if (data_queue_.size() > config_.max_input_queue_length) {
+  if (data_queue_.size() > max_input_queue_length_) {
     std::sort(data_queue_.begin(), data_queue_.end(),
               [](const auto& lhs, const auto& rhs) -> bool {
                 return lhs->timestamp < rhs->timestamp;
@@ -205,13 +240,7 @@ bool InputSynchronizer::allocateDataInQueue(const ros::Time& timestamp) {
 
     // Erase first element and update queue.
     data_queue_.erase(data_queue_.begin());
-    data_is_ready_ = false;
-    for (size_t i = 0; i < data_queue_.size(); ++i) {
-      if (data_queue_[i]->ready) {
-        data_is_ready_ = true;
-        break;
-      }
-    }
+    updateDataIsReady();
     LOG_IF(WARNING, config_.verbosity >= 2)
         << "Input queue is getting too long, dropping oldest data" << info.str()
         << ".";
@@ -248,8 +277,47 @@ void InputSynchronizer::checkDataIsReady(InputSynchronizerData* data) {
     }
   }
   // Has all required inputs.
+  if (data->ready) {
+    return;
+  }
   data->ready = true;
-  data_is_ready_ = true;
+  data->dispatch_timer = std::make_unique<Timer>("input/dispatch_latency");
+  {
+    // Lock so the signal can not get lost between a check and the wait.
+    std::lock_guard<std::mutex> ready_lock(ready_mutex_);
+    data_is_ready_ = true;
+  }
+  ready_condition_.notify_one();
+}
+
+bool InputSynchronizer::waitForInputData(double timeout) {
+  const auto now = std::chrono::steady_clock::now();
+  const auto deadline =
+      now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(timeout));
+  std::unique_lock<std::mutex> lock(ready_mutex_);
+
+  // Data whose transform could not be looked up is only retried after a short
+  // delay, so the caller does not spin on it.
+  if (retry_time_ > now) {
+    ready_condition_.wait_until(lock, std::min(retry_time_, deadline),
+                                [this]() { return wait_is_interrupted_; });
+    if (retry_time_ > deadline) {
+      return false;
+    }
+  }
+  ready_condition_.wait_until(lock, deadline, [this]() {
+    return data_is_ready_ || wait_is_interrupted_;
+  });
+  return data_is_ready_;
+}
+
+void InputSynchronizer::interruptWait() {
+  {
+    std::lock_guard<std::mutex> lock(ready_mutex_);
+    wait_is_interrupted_ = true;
+  }
+  ready_condition_.notify_all();
 }
 
 std::shared_ptr<InputData> InputSynchronizer::getInputData() {
@@ -269,6 +337,12 @@ std::shared_ptr<InputData> InputSynchronizer::getInputData() {
         if (!lookupTransform(data_queue_[i]->timestamp,
                              config_.global_frame_name, used_sensor_frame_name_,
                              &T_M_C)) {
+          // The data stays ready, delay the next attempt.
+          std::lock_guard<std::mutex> ready_lock(ready_mutex_);
+          retry_time_ =
+              std::chrono::steady_clock::now() +
+              std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  std::chrono::duration<double>(kLookupRetryInterval));
           return result;
         }
         data_queue_[i]->data->setT_M_C(T_M_C);
@@ -276,21 +350,34 @@ std::shared_ptr<InputData> InputSynchronizer::getInputData() {
       }
 
       // Get the result and erase from the queue.
+      if (data_queue_[i]->dispatch_timer) {
+        data_queue_[i]->dispatch_timer->Stop();
+      }
       result = data_queue_[i]->data;
       data_queue_.erase(data_queue_.begin() + i);
-      oldest_time_ = data_queue_.front()->timestamp;
+      if (!data_queue_.empty()) {
+        oldest_time_ = data_queue_.front()->timestamp;
+      }
       break;
     }
   }
 
   // Check whether there are other ready data points.
-  for (size_t i = 0; i < data_queue_.size(); ++i) {
-    if (data_queue_[i]->ready) {
-      return result;
+  updateDataIsReady();
+  return result;
+}
+
+void InputSynchronizer::updateDataIsReady() {
+  bool is_ready = false;
+  for (const auto& data : data_queue_) {
+    if (data->ready) {
+      is_ready = true;
+      break;
     }
   }
-  data_is_ready_ = false;
-  return result;
+  // Lock so a concurrent wait can not miss the change.
+  std::lock_guard<std::mutex> ready_lock(ready_mutex_);
+  data_is_ready_ = is_ready;
 }
 
 bool InputSynchronizer::lookupTransform(const ros::Time& timestamp,
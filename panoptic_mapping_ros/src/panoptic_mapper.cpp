@@ -29,13 +29,19 @@ const std::map<std::string, std::pair<std::string, std::string>>
         {"vis_submaps", {"visualization/submaps", "submaps"}},
         {"vis_tracking", {"visualization/tracking", ""}},
         {"vis_planning", {"visualization/planning", ""}},
-        {"data_writer", {"data_writer", "null"}}};
+        {"data_writer", {"data_writer", "null"}},
+        {"semantic_index", {"semantic_index", ""}},
+        {"planning_interface", {"planning_interface", ""}},
+        {"frame_deduplicator", {"frame_deduplicator", ""}},
+        {"thread_affinity", {"thread_affinity", ""}}};
 
 void PanopticMapper::Config::checkParams() const {
   checkParamCond(!global_frame_name.empty(),
                  "'global_frame_name' may not be empty.");
   checkParamGT(ros_spinner_threads, 1, "ros_spinner_threads");
-  checkParamGT(check_input_interval, 0.f, "check_input_interval");
+  if (!wait_for_input) {
+    checkParamGT(check_input_interval, 0.f, "check_input_interval");
+  }
 }
 
 void PanopticMapper::Config::setupParamsAndPrinting() {
@@ -46,7 +52,10 @@ void PanopticMapper::Config::setupParamsAndPrinting() {
   setupParam("print_timing_interval", &print_timing_interval, "s");
   setupParam("use_threadsafe_submap_collection",
              &use_threadsafe_submap_collection);
+  setupParam("use_semantic_index", &use_semantic_index);
+  setupParam("skip_redundant_frames", &skip_redundant_frames);
   setupParam("ros_spinner_threads", &ros_spinner_threads);
+  setupParam("wait_for_input", &wait_for_input);
   setupParam("check_input_interval", &check_input_interval, "s");
   setupParam("load_submaps_conservative", &load_submaps_conservative);
   setupParam("loaded_freespace_stays_active", &loaded_freespace_stays_active);
@@ -72,9 +81,26 @@ PanopticMapper::PanopticMapper(const ros::NodeHandle& nh,
       config_.display_config_units;
   LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
 
+  // Setup the placement of the worker threads before any are spawned.
+  ThreadAffinity::configure(
+      config_utilities::getConfigFromRos<ThreadAffinity::Config>(
+          defaultNh("thread_affinity")));
+
   // Setup all components of the panoptic mapper.
   setupMembers();
   setupRos();
+
+  // The ROS callback threads are spawned from the constructing thread.
+  ThreadAffinity::pinToReservedCores();
+}
+
+PanopticMapper::~PanopticMapper() {
+  // Stop the input thread before the members it uses are destroyed.
+  if (input_thread_.joinable()) {
+    stop_input_thread_ = true;
+    input_synchronizer_->interruptWait();
+    input_thread_.join();
+  }
 }
 
 void PanopticMapper::setupMembers() {
@@ -138,6 +164,18 @@ void PanopticMapper::setupMembers() {
   // Planning.
   setupCollectionDependentMembers();
 
+  // Semantic Index.
+  semantic_index_ = std::make_unique<SemanticIndex>(
+      config_utilities::getConfigFromRos<SemanticIndex::Config>(
+          defaultNh("semantic_index")));
+
+  // Frame Deduplication.
+  if (config_.skip_redundant_frames) {
+    frame_deduplicator_ = std::make_unique<FrameDeduplicator>(
+        config_utilities::getConfigFromRos<FrameDeduplicator::Config>(
+            defaultNh("frame_deduplicator")));
+  }
+
   // Data Logging.
   data_logger_ = config_utilities::FactoryRos::create<DataWriterBase>(
       defaultNh("data_writer"));
@@ -157,6 +195,9 @@ void PanopticMapper::setupMembers() {
   compute_validity_image_ =
       requested_inputs.find(InputData::InputType::kValidityImage) !=
       requested_inputs.end();
+  compute_max_depth_pyramid_ =
+      requested_inputs.find(InputData::InputType::kMaxDepthPyramid) !=
+      requested_inputs.end();
 
   // Setup the input synchronizer.
   input_synchronizer_ = std::make_unique<InputSynchronizer>(
@@ -168,7 +209,10 @@ void PanopticMapper::setupMembers() {
 
 void PanopticMapper::setupCollectionDependentMembers() {
   // Planning Interface.
-  planning_interface_ = std::make_shared<PlanningInterface>(submaps_);
+  planning_interface_ = std::make_shared<PlanningInterface>(
+      submaps_,
+      config_utilities::getConfigFromRos<PlanningInterface::Config>(
+          defaultNh("planning_interface")));
 
   // Planning Visualizer.
   planning_visualizer_ = std::make_unique<PlanningVisualizer>(
@@ -194,6 +238,9 @@ void PanopticMapper::setupRos() {
       "print_timings", &PanopticMapper::printTimingsCallback, this);
   finish_mapping_srv_ = nh_private_.advertiseService(
       "finish_mapping", &PanopticMapper::finishMappingCallback, this);
+  set_performance_parameters_srv_ = nh_private_.advertiseService(
+      "set_performance_parameters",
+      &PanopticMapper::setPerformanceParametersCallback, this);
 
   // Timers.
   if (config_.visualization_interval > 0.0) {
@@ -211,12 +258,34 @@ void PanopticMapper::setupRos() {
         nh_private_.createTimer(ros::Duration(config_.print_timing_interval),
                                 &PanopticMapper::dataLoggingCallback, this);
   }
-  input_timer_ =
-      nh_private_.createTimer(ros::Duration(config_.check_input_interval),
-                              &PanopticMapper::inputCallback, this);
+  if (config_.wait_for_input) {
+    input_thread_ = std::thread(&PanopticMapper::inputLoop, this);
+  } else {
+    input_timer_ =
+        nh_private_.createTimer(ros::Duration(config_.check_input_interval),
+                                &PanopticMapper::inputCallback, this);
+  }
 }
 
-void PanopticMapper::inputCallback(const ros::TimerEvent&) {
+void PanopticMapper::inputCallback(const ros::TimerEvent&) { checkInput(); }
+
+void PanopticMapper::inputLoop() {
+  // Wake up as soon as a frame is complete. The timeout only bounds the delay
+  // of reconfigurations and of shutting down when no more frames arrive.
+  constexpr double kMaxWaitTime = 0.5;  // s
+  while (ros::ok() && !stop_input_thread_) {
+    input_synchronizer_->waitForInputData(kMaxWaitTime);
+    if (stop_input_thread_) {
+      break;
+    }
+    checkInput();
+  }
+}
+
+void PanopticMapper::checkInput() {
+  // Frame boundary: no other input is being processed.
+  applyPendingReconfigurations();
+  writePendingData();
   if (input_synchronizer_->hasInputData()) {
     std::shared_ptr<InputData> data = input_synchronizer_->getInputData();
     if (data) {
@@ -244,6 +313,13 @@ void PanopticMapper::inputCallback(const ros::TimerEvent&) {
 
 void PanopticMapper::processInput(InputData* input) {
   CHECK_NOTNULL(input);
+  // Frames that add no new information are not integrated.
+  if (frame_deduplicator_) {
+    Timer dedup_timer("input/frame_deduplication");
+    if (frame_deduplicator_->isRedundant(*input)) {
+      return;
+    }
+  }
   Timer timer("input");
   frame_timer_ = std::make_unique<Timer>("frame");
 
@@ -251,14 +327,25 @@ void PanopticMapper::processInput(InputData* input) {
   if (compute_validity_image_) {
     Timer validity_timer("input/compute_validity_image");
     input->setValidityImage(
-        globals_->camera()->computeValidityImage(input->depthImage()));
+        globals_->camera()->computeValidityImage(input->depthImage(),
+                                                 input->depthScale()));
   }
 
   // Compute and store the vertex map.
   if (compute_vertex_map_) {
     Timer vertex_timer("input/compute_vertex_map");
     input->setVertexMap(
-        globals_->camera()->computeVertexMap(input->depthImage()));
+        globals_->camera()->computeVertexMap(input->depthImage(),
+                                             input->depthScale()));
+  }
+
+  // Compute and store the max depth pyramid, shared by the occlusion culling
+  // of the tracker and the integrator.
+  if (compute_max_depth_pyramid_) {
+    Timer pyramid_timer("input/compute_max_depth_pyramid");
+    MaxDepthPyramid max_depths;
+    max_depths.compute(input->depthImage(), input->depthScale());
+    input->setMaxDepthPyramid(max_depths);
   }
   ros::WallTime t0 = ros::WallTime::now();
 
@@ -286,7 +373,7 @@ void PanopticMapper::processInput(InputData* input) {
     publishVisualizationCallback(ros::TimerEvent());
   }
   if (config_.data_logging_interval < 0.f) {
-    dataLoggingCallback(ros::TimerEvent());
+    data_logger_->writeData(ros::Time::now().toSec(), *submaps_);
   }
   ros::WallTime t4 = ros::WallTime::now();
 
@@ -295,6 +382,11 @@ void PanopticMapper::processInput(InputData* input) {
     thread_safe_submaps_->update();
   }
 
+  // If requested update the semantic index.
+  if (config_.use_semantic_index) {
+    semantic_index_->update(*submaps_);
+  }
+
   // Logging.
   timer.Stop();
   std::stringstream info;
@@ -368,6 +460,13 @@ bool PanopticMapper::loadMap(const std::string& file_path) {
 
   // Set the map.
   submaps_ = loaded_map;
+  if (frame_deduplicator_) {
+    frame_deduplicator_->reset();
+  }
+  semantic_index_->clear();
+  if (config_.use_semantic_index) {
+    semantic_index_->update(*submaps_);
+  }
 
   // Setup the interfaces that use the new collection.
   setupCollectionDependentMembers();
@@ -383,7 +482,14 @@ bool PanopticMapper::loadMap(const std::string& file_path) {
 }
 
 void PanopticMapper::dataLoggingCallback(const ros::TimerEvent&) {
-  data_logger_->writeData(ros::Time::now().toSec(), *submaps_);
+  // The map is only read by the input processing between two frames.
+  data_logging_requested_ = true;
+}
+
+void PanopticMapper::writePendingData() {
+  if (data_logging_requested_.exchange(false)) {
+    data_logger_->writeData(ros::Time::now().toSec(), *submaps_);
+  }
 }
 
 void PanopticMapper::publishVisualizationCallback(const ros::TimerEvent&) {
@@ -433,6 +539,27 @@ bool PanopticMapper::setVisualizationModeCallback(
   return success;
 }
 
+bool PanopticMapper::setPerformanceParametersCallback(
+    panoptic_mapping_msgs::SetPerformanceParameters::Request& request,
+    panoptic_mapping_msgs::SetPerformanceParameters::Response& response) {
+  PerformanceParameters parameters;
+  parameters.integration_threads = request.integration_threads;
+  parameters.interpolation_method = request.interpolation_method;
+  parameters.rendering_threads = request.rendering_threads;
+  parameters.rendering_subsampling = request.rendering_subsampling;
+  parameters.prune_active_blocks_frequency =
+      request.prune_active_blocks_frequency;
+  parameters.change_detection_frequency = request.change_detection_frequency;
+  parameters.activity_management_frequency =
+      request.activity_management_frequency;
+  parameters.max_input_queue_length = request.max_input_queue_length;
+  response.success = requestReconfiguration(parameters, &response.message);
+  if (response.success) {
+    response.message = "Parameters will be applied before the next frame.";
+  }
+  return true;
+}
+
 bool PanopticMapper::saveMapCallback(
     panoptic_mapping_msgs::SaveLoadMap::Request& request,
     panoptic_mapping_msgs::SaveLoadMap::Response& response) {
@@ -465,6 +592,45 @@ bool PanopticMapper::finishMappingCallback(
   return true;
 }
 
+bool PanopticMapper::requestReconfiguration(
+    const PerformanceParameters& parameters, std::string* error) {
+  std::string reason;
+  if (!parameters.isValid(&reason)) {
+    LOG_IF(WARNING, config_.verbosity >= 1)
+        << "Invalid reconfiguration request: " << reason;
+    if (error) {
+      *error = reason;
+    }
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(reconfiguration_mutex_);
+  pending_reconfigurations_.push_back(parameters);
+  return true;
+}
+
+void PanopticMapper::applyPendingReconfigurations() {
+  std::vector<PerformanceParameters> requests;
+  {
+    std::lock_guard<std::mutex> lock(reconfiguration_mutex_);
+    if (pending_reconfigurations_.empty()) {
+      return;
+    }
+    requests.swap(pending_reconfigurations_);
+  }
+
+  // Requests are applied in the order they were received.
+  Timer timer("reconfiguration");
+  for (const PerformanceParameters& parameters : requests) {
+    tsdf_integrator_->reconfigure(parameters);
+    id_tracker_->reconfigure(parameters);
+    map_manager_->reconfigure(parameters);
+    if (parameters.max_input_queue_length > 0) {
+      input_synchronizer_->setMaxInputQueueLength(
+          parameters.max_input_queue_length);
+    }
+  }
+}
+
 ros::NodeHandle PanopticMapper::defaultNh(const std::string& key) const {
   // Essentially just read the default namespaces list and type params.
   // NOTE(schmluk): Since these lookups are quasi-static we don't check for
@@ -0,0 +1,83 @@
+#include "panoptic_mapping_ros/tools/online_evaluation_data_writer.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pcl/io/ply_io.h>
+
+namespace panoptic_mapping {
+
+config_utilities::Factory::RegistrationRos<DataWriterBase,
+                                           OnlineEvaluationDataWriter>
+    OnlineEvaluationDataWriter::registration_("online_evaluation");
+
+void OnlineEvaluationDataWriter::Config::checkParams() const {
+  checkParamNE(ground_truth_pointcloud_file, std::string(),
+               "ground_truth_pointcloud_file");
+  checkParamConfig(online_evaluator_config);
+}
+
+void OnlineEvaluationDataWriter::Config::setupParamsAndPrinting() {
+  setupParam("verbosity", &verbosity);
+  setupParam("log_data_writer_config", &log_data_writer_config);
+  setupParam("ground_truth_pointcloud_file", &ground_truth_pointcloud_file);
+  setupParam("online_evaluator_config", &online_evaluator_config,
+             "online_evaluator");
+}
+
+OnlineEvaluationDataWriter::OnlineEvaluationDataWriter(const Config& config)
+    : config_(config.checkValid()),
+      LogDataWriter(config.log_data_writer_config, false) {
+  LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
+
+  // Load the ground truth once, all entries are evaluated against it.
+  pcl::PointCloud<pcl::PointXYZ> ground_truth;
+  if (pcl::io::loadPLYFile<pcl::PointXYZ>(config_.ground_truth_pointcloud_file,
+                                          ground_truth) != 0) {
+    LOG(ERROR) << "Could not load ground truth point cloud from '"
+               << config_.ground_truth_pointcloud_file << "'.";
+  }
+  std::vector<Point> points;
+  points.reserve(ground_truth.size());
+  for (const pcl::PointXYZ& point : ground_truth) {
+    points.emplace_back(point.x, point.y, point.z);
+  }
+  evaluator_ =
+      std::make_unique<OnlineEvaluator>(config_.online_evaluator_config);
+  evaluator_->setGroundTruth(points);
+}
+
+void OnlineEvaluationDataWriter::setupEvaluations() {
+  LogDataWriter::setupEvaluations();
+  // Additional evaluations of the online evaluation writer.
+  writeEntry("MeanError [m]");
+  writeEntry("StdError [m]");
+  writeEntry("RMSE [m]");
+  writeEntry("Coverage [1]");
+  writeEntry("Inliers [1]");
+  writeEntry("TruncatedPoints [1]");
+  writeEntry("UpdatedCells [1]");
+  evaluations_.emplace_back([this](const SubmapCollection& submaps) {
+    this->evaluateReconstruction(submaps);
+  });
+}
+
+void OnlineEvaluationDataWriter::evaluateReconstruction(
+    const SubmapCollection& submaps) {
+  const OnlineEvaluator::Metrics& metrics = evaluator_->update(submaps);
+  writeEntry(std::to_string(metrics.mean_error));
+  writeEntry(std::to_string(metrics.stddev_error));
+  writeEntry(std::to_string(metrics.rmse));
+  writeEntry(std::to_string(metrics.coverage));
+  writeEntry(std::to_string(metrics.inliers));
+  writeEntry(std::to_string(metrics.truncated_points));
+  writeEntry(std::to_string(metrics.updated_cells));
+  LOG_IF(INFO, config_.verbosity >= 2)
+      << "Reconstruction error: mean " << metrics.mean_error << "m, stddev "
+      << metrics.stddev_error << "m, RMSE " << metrics.rmse << "m, coverage "
+      << metrics.coverage * 100.f << "% (" << metrics.updated_cells
+      << " cells updated).";
+}
+
+}  // namespace panoptic_mapping
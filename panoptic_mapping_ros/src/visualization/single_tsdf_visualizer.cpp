@@ -1,11 +1,15 @@
 #include "panoptic_mapping_ros/visualization/single_tsdf_visualizer.h"
 
 #include <algorithm>
+#include <cmath>
+#include <future>
 #include <limits>
 #include <memory>
+#include <numeric>
 #include <utility>
 #include <vector>
 
+#include "panoptic_mapping/common/index_getter.h"
 #include "panoptic_mapping/map/classification/fixed_count.h"
 #include "panoptic_mapping/map/classification/uncertainty.h"
 #include "panoptic_mapping/tools/coloring.h"
@@ -17,6 +21,7 @@ config_utilities::Factory::RegistrationRos<
     SingleTsdfVisualizer::registration_("single_tsdf");
 
 void SingleTsdfVisualizer::Config::checkParams() const {
+  checkParamGT(coloring_threads, 0, "coloring_threads");
   checkParamConfig(submap_visualizer);
 }
 
@@ -26,6 +31,8 @@ void SingleTsdfVisualizer::Config::setupParamsAndPrinting() {
   setupParam("entropy_factor", &entropy_factor);
   setupParam("min_score", &min_score);
   setupParam("max_score", &max_score);
+  setupParam("coloring_threads", &coloring_threads);
+  setupParam("cache_colors", &cache_colors);
 }
 
 SingleTsdfVisualizer::SingleTsdfVisualizer(const Config& config,
@@ -46,6 +53,7 @@ void SingleTsdfVisualizer::reset() {
   info_ = SubmapVisInfo();
   info_.republish_everything = true;
   previous_submaps_ = nullptr;
+  block_colors_.clear();
 }
 
 void SingleTsdfVisualizer::clearMesh() {
@@ -117,6 +125,7 @@ std::vector<voxblox_msgs::MultiMesh> SingleTsdfVisualizer::generateMeshMsgs(
       mesh_block.index[1] = block_index.y();
       mesh_block.index[2] = block_index.z();
       msg.mesh.mesh_blocks.push_back(mesh_block);
+      block_colors_.erase(block_index);
     }
   }
   info_.previous_blocks = block_indices;
@@ -135,9 +144,7 @@ std::vector<voxblox_msgs::MultiMesh> SingleTsdfVisualizer::generateMeshMsgs(
             << colorModeToString(color_mode_)
             << "' without existing score layer.";
       } else {
-        for (auto& mesh_block : msg.mesh.mesh_blocks) {
-          colorMeshBlockFromScore(submap, &mesh_block);
-        }
+        colorMeshBlocks(submap, true, &msg.mesh);
       }
     } else {
       if (!submap.hasClassLayer()) {
@@ -146,9 +153,7 @@ std::vector<voxblox_msgs::MultiMesh> SingleTsdfVisualizer::generateMeshMsgs(
             << colorModeToString(color_mode_)
             << "' without existing class layer.";
       } else {
-        for (auto& mesh_block : msg.mesh.mesh_blocks) {
-          colorMeshBlockFromClass(submap, &mesh_block);
-        }
+        colorMeshBlocks(submap, false, &msg.mesh);
       }
     }
   }
@@ -157,44 +162,141 @@ std::vector<voxblox_msgs::MultiMesh> SingleTsdfVisualizer::generateMeshMsgs(
   return result;
 }
 
-void SingleTsdfVisualizer::colorMeshBlockFromClass(
-    const Submap& submap, voxblox_msgs::MeshBlock* mesh_block) {
-  const voxblox::BlockIndex block_index(
-      mesh_block->index[0], mesh_block->index[1], mesh_block->index[2]);
-  if (!submap.getClassLayer().hasBlock(block_index)) {
+void SingleTsdfVisualizer::colorMeshBlocks(const Submap& submap,
+                                           bool use_score_layer,
+                                           voxblox_msgs::Mesh* mesh) {
+  // Changes of the submap state, e.g. applying a class layer, can affect all
+  // blocks.
+  if (!config_.cache_colors ||
+      block_colors_submap_version_ != submap.getVersion()) {
+    block_colors_.clear();
+    block_colors_submap_version_ = submap.getVersion();
+  }
+
+  // Look up the cache entries serially so the threads only work on distinct
+  // blocks.
+  std::vector<std::pair<voxblox_msgs::MeshBlock*, BlockColors*>> jobs;
+  jobs.reserve(mesh->mesh_blocks.size());
+  for (auto& mesh_block : mesh->mesh_blocks) {
+    const voxblox::BlockIndex block_index(
+        mesh_block.index[0], mesh_block.index[1], mesh_block.index[2]);
+    const bool has_block =
+        use_score_layer ? submap.getScoreLayer().hasBlock(block_index)
+                        : submap.getClassLayer().hasBlock(block_index);
+    if (has_block && !mesh_block.x.empty()) {
+      jobs.emplace_back(&mesh_block, &block_colors_[block_index]);
+    }
+  }
+  if (jobs.empty()) {
     return;
   }
+  std::vector<int> indices(jobs.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  IndexGetter<int> index_getter(indices);
+
+  // Recompute outdated blocks and color the vertices in parallel.
+  const int voxels_per_side = submap.getTsdfLayer().voxels_per_side();
+  std::vector<std::future<void>> threads;
+  for (int i = 0; i < config_.coloring_threads; ++i) {
+    threads.emplace_back(std::async(
+        std::launch::async,
+        [this, &index_getter, &jobs, &submap, use_score_layer,
+         voxels_per_side]() {
+          int index;
+          while (index_getter.getNextIndex(&index)) {
+            voxblox_msgs::MeshBlock* mesh_block = jobs[index].first;
+            BlockColors* block_colors = jobs[index].second;
+            const voxblox::BlockIndex block_index(mesh_block->index[0],
+                                                  mesh_block->index[1],
+                                                  mesh_block->index[2]);
+            const uint64_t version = submap.getBlockVersion(block_index);
+            if (!block_colors->is_valid ||
+                block_colors->block_version != version) {
+              if (use_score_layer) {
+                computeBlockColorsFromScore(submap, block_index, block_colors);
+              } else {
+                computeBlockColorsFromClass(submap, block_index, block_colors);
+              }
+              block_colors->block_version = version;
+              block_colors->is_valid = true;
+            }
+            colorMeshBlock(*block_colors, voxels_per_side, mesh_block);
+          }
+        }));
+  }
+
+  // Join all threads.
+  for (auto& thread : threads) {
+    thread.get();
+  }
+}
+
+void SingleTsdfVisualizer::computeBlockColorsFromClass(
+    const Submap& submap, const voxblox::BlockIndex& block_index,
+    BlockColors* block_colors) const {
+  const ClassBlock& class_block =
+      submap.getClassLayer().getBlockByIndex(block_index);
+  const size_t num_voxels = class_block.num_voxels();
+  block_colors->colors.resize(num_voxels);
+  block_colors->is_colored.assign(num_voxels, true);
+
+  // Coloring schemes.
+  std::function<Color(const ClassVoxel&)> get_color = getColoring();
+  for (size_t i = 0; i < num_voxels; ++i) {
+    block_colors->colors[i] = get_color(class_block.getVoxelByLinearIndex(i));
+  }
+}
+
+void SingleTsdfVisualizer::computeBlockColorsFromScore(
+    const Submap& submap, const voxblox::BlockIndex& block_index,
+    BlockColors* block_colors) const {
+  const ScoreBlock& score_block =
+      submap.getScoreLayer().getBlockByIndex(block_index);
+  const size_t num_voxels = score_block.num_voxels();
+  block_colors->colors.resize(num_voxels);
+  block_colors->is_colored.assign(num_voxels, false);
+
+  for (size_t i = 0; i < num_voxels; ++i) {
+    const ScoreVoxel& voxel = score_block.getVoxelByLinearIndex(i);
+    if (!voxel.isObserverd()) continue;
+    float normalised_value = (voxel.getScore() - config_.min_score) /
+                             (config_.max_score - config_.min_score);
+    normalised_value = std::min(normalised_value, 1.f);
+    normalised_value = std::max(normalised_value, 0.f);
+    block_colors->colors[i] = redToGreenGradient(normalised_value);
+    block_colors->is_colored[i] = true;
+  }
+}
 
-  // Setup.
-  const ClassBlock::ConstPtr class_block =
-      submap.getClassLayer().getBlockConstPtrByIndex(block_index);
+void SingleTsdfVisualizer::colorMeshBlock(const BlockColors& block_colors,
+                                          int voxels_per_side,
+                                          voxblox_msgs::MeshBlock* mesh_block) {
+  // Vertices are stored relative to the block origin in units of half a
+  // block size.
   const float point_conv_factor = 2.f / std::numeric_limits<uint16_t>::max();
-  const float block_edge_length = submap.getClassLayer().block_size();
+  const float voxel_conv_factor = point_conv_factor * voxels_per_side;
   const size_t num_vertices = mesh_block->x.size();
   mesh_block->r.resize(num_vertices);
   mesh_block->g.resize(num_vertices);
   mesh_block->b.resize(num_vertices);
 
-  // Coloring schemes.
-  std::function<Color(const ClassVoxel&)> get_color = getColoring();
-
-  for (int i = 0; i < num_vertices; ++i) {
-    // Get the vertex position in map frame.
-    const float mesh_x =
-        (static_cast<float>(mesh_block->x[i]) * point_conv_factor +
-         static_cast<float>(block_index[0])) *
-        block_edge_length;
-    const float mesh_y =
-        (static_cast<float>(mesh_block->y[i]) * point_conv_factor +
-         static_cast<float>(block_index[1])) *
-        block_edge_length;
-    const float mesh_z =
-        (static_cast<float>(mesh_block->z[i]) * point_conv_factor +
-         static_cast<float>(block_index[2])) *
-        block_edge_length;
-    const ClassVoxel& voxel =
-        class_block->getVoxelByCoordinates({mesh_x, mesh_y, mesh_z});
-    const Color color = get_color(voxel);
+  auto to_voxel_coordinate = [voxel_conv_factor,
+                              voxels_per_side](uint16_t value) {
+    const int index = static_cast<int>(
+        std::floor(static_cast<float>(value) * voxel_conv_factor));
+    return std::max(0, std::min(index, voxels_per_side - 1));
+  };
+
+  for (size_t i = 0; i < num_vertices; ++i) {
+    const size_t linear_index =
+        to_voxel_coordinate(mesh_block->x[i]) +
+        voxels_per_side * (to_voxel_coordinate(mesh_block->y[i]) +
+                           voxels_per_side *
+                               to_voxel_coordinate(mesh_block->z[i]));
+    if (!block_colors.is_colored[linear_index]) {
+      continue;
+    }
+    const Color& color = block_colors.colors[linear_index];
     mesh_block->r[i] = color.r;
     mesh_block->g[i] = color.g;
     mesh_block->b[i] = color.b;
@@ -276,51 +378,6 @@ std::function<Color(const ClassVoxel&)> SingleTsdfVisualizer::getColoring()
       };
   }
 }
-void SingleTsdfVisualizer::colorMeshBlockFromScore(
-    const Submap& submap, voxblox_msgs::MeshBlock* mesh_block) {
-  const voxblox::BlockIndex block_index(
-      mesh_block->index[0], mesh_block->index[1], mesh_block->index[2]);
-  if (!submap.getScoreLayer().hasBlock(block_index)) {
-    return;
-  }
-
-  // Setup.
-  const ScoreBlock::ConstPtr score_block =
-      submap.getScoreLayer().getBlockConstPtrByIndex(block_index);
-  const float point_conv_factor = 2.f / std::numeric_limits<uint16_t>::max();
-  const float block_edge_length = submap.getScoreLayer().block_size();
-  const size_t num_vertices = mesh_block->x.size();
-  mesh_block->r.resize(num_vertices);
-  mesh_block->g.resize(num_vertices);
-  mesh_block->b.resize(num_vertices);
-
-  for (int i = 0; i < num_vertices; ++i) {
-    // Get the vertex position in map frame.
-    const float mesh_x =
-        (static_cast<float>(mesh_block->x[i]) * point_conv_factor +
-         static_cast<float>(block_index[0])) *
-        block_edge_length;
-    const float mesh_y =
-        (static_cast<float>(mesh_block->y[i]) * point_conv_factor +
-         static_cast<float>(block_index[1])) *
-        block_edge_length;
-    const float mesh_z =
-        (static_cast<float>(mesh_block->z[i]) * point_conv_factor +
-         static_cast<float>(block_index[2])) *
-        block_edge_length;
-    const ScoreVoxel& voxel =
-        score_block->getVoxelByCoordinates({mesh_x, mesh_y, mesh_z});
-    if (!voxel.isObserverd()) continue;
-    float normalised_value = (voxel.getScore() - config_.min_score) /
-                             (config_.max_score - config_.min_score);
-    normalised_value = std::min(normalised_value, 1.f);
-    normalised_value = std::max(normalised_value, 0.f);
-    const Color color = redToGreenGradient(normalised_value);
-    mesh_block->r[i] = color.r;
-    mesh_block->g[i] = color.g;
-    mesh_block->b[i] = color.b;
-  }
-}
 
 void SingleTsdfVisualizer::updateVisInfos(const SubmapCollection& submaps) {
   // Check whether the same submap collection is being visualized (cached
@@ -19,6 +19,10 @@ config_utilities::Factory::RegistrationRos<SubmapVisualizer, SubmapVisualizer,
 
 void SubmapVisualizer::Config::checkParams() const {
   checkParamGT(submap_color_discretization, 0, "submap_color_discretization");
+  checkParamGE(tsdf_blocks_interval, 0.f, "tsdf_blocks_interval");
+  checkParamGE(free_space_interval, 0.f, "free_space_interval");
+  checkParamGE(bounding_volumes_interval, 0.f, "bounding_volumes_interval");
+  checkParamGE(free_space_downsampling, 1, "free_space_downsampling");
   // NOTE(schmluk): if the visualization or color mode is not valid it will be
   // defaulted to 'all' or 'color' and a warning will be raised.
 }
@@ -33,6 +37,10 @@ void SubmapVisualizer::Config::setupParamsAndPrinting() {
   setupParam("visualize_free_space", &visualize_free_space);
   setupParam("visualize_bounding_volumes", &visualize_bounding_volumes);
   setupParam("include_free_space", &include_free_space);
+  setupParam("tsdf_blocks_interval", &tsdf_blocks_interval, "s");
+  setupParam("free_space_interval", &free_space_interval, "s");
+  setupParam("bounding_volumes_interval", &bounding_volumes_interval, "s");
+  setupParam("free_space_downsampling", &free_space_downsampling);
 }
 
 void SubmapVisualizer::Config::printFields() const {
@@ -117,14 +125,18 @@ void SubmapVisualizer::visualizeMeshes(SubmapCollection* submaps) {
 
 void SubmapVisualizer::visualizeTsdfBlocks(const SubmapCollection& submaps) {
   if (config_.visualize_tsdf_blocks &&
-      tsdf_blocks_pub_.getNumSubscribers() > 0) {
+      tsdf_blocks_pub_.getNumSubscribers() > 0 &&
+      publishingIsDue(config_.tsdf_blocks_interval,
+                      &tsdf_blocks_last_published_)) {
     visualization_msgs::MarkerArray markers = generateBlockMsgs(submaps);
     tsdf_blocks_pub_.publish(markers);
   }
 }
 
 void SubmapVisualizer::visualizeFreeSpace(const SubmapCollection& submaps) {
-  if (config_.visualize_free_space && freespace_pub_.getNumSubscribers() > 0) {
+  if (config_.visualize_free_space && freespace_pub_.getNumSubscribers() > 0 &&
+      publishingIsDue(config_.free_space_interval,
+                      &free_space_last_published_)) {
     pcl::PointCloud<pcl::PointXYZI> msg = generateFreeSpaceMsg(submaps);
     msg.header.frame_id = global_frame_name_;
     freespace_pub_.publish(msg);
@@ -134,7 +146,9 @@ void SubmapVisualizer::visualizeFreeSpace(const SubmapCollection& submaps) {
 void SubmapVisualizer::visualizeBoundingVolume(
     const SubmapCollection& submaps) {
   if (config_.visualize_bounding_volumes &&
-      bounding_volume_pub_.getNumSubscribers() > 0) {
+      bounding_volume_pub_.getNumSubscribers() > 0 &&
+      publishingIsDue(config_.bounding_volumes_interval,
+                      &bounding_volumes_last_published_)) {
     visualization_msgs::MarkerArray markers =
         generateBoundingVolumeMsgs(submaps);
     bounding_volume_pub_.publish(markers);
@@ -390,9 +404,29 @@ pcl::PointCloud<pcl::PointXYZI> SubmapVisualizer::generateFreeSpaceMsg(
     createDistancePointcloudFromTsdfLayer(
         submaps.getSubmap(free_space_id).getTsdfLayer(), &result);
   }
+  if (config_.free_space_downsampling > 1) {
+    pcl::PointCloud<pcl::PointXYZI> downsampled;
+    downsampled.reserve(result.size() / config_.free_space_downsampling + 1);
+    for (size_t i = 0; i < result.size();
+         i += config_.free_space_downsampling) {
+      downsampled.push_back(result[i]);
+    }
+    return downsampled;
+  }
   return result;
 }
 
+bool SubmapVisualizer::publishingIsDue(float interval,
+                                       ros::Time* last_published) {
+  const ros::Time now = ros::Time::now();
+  if (interval > 0.f && !last_published->isZero() &&
+      (now - *last_published).toSec() < interval) {
+    return false;
+  }
+  *last_published = now;
+  return true;
+}
+
 visualization_msgs::MarkerArray SubmapVisualizer::generateBoundingVolumeMsgs(
     const SubmapCollection& submaps) {
   visualization_msgs::MarkerArray result;
@@ -3,13 +3,21 @@
 #include <string>
 
 #include <cv_bridge/cv_bridge.h>
+#include <opencv2/imgproc.hpp>
 #include <sensor_msgs/Image.h>
 
 namespace panoptic_mapping {
 
+void TrackingVisualizer::Config::checkParams() const {
+  checkParamGE(max_publish_rate, 0.f, "max_publish_rate");
+  checkParamGE(image_downsampling, 1, "image_downsampling");
+}
+
 void TrackingVisualizer::Config::setupParamsAndPrinting() {
   setupParam("verbosity", &verbosity);
   setupParam("visualize_tracking", &visualize_tracking);
+  setupParam("max_publish_rate", &max_publish_rate, "Hz");
+  setupParam("image_downsampling", &image_downsampling);
 }
 
 void TrackingVisualizer::Config::fromRosParam() {
@@ -32,23 +40,49 @@ void TrackingVisualizer::registerIDTracker(IDTrackerBase* tracker) {
         [this](const cv::Mat& image, const std::string& name) {
           publishImage(image, name);
         });
+    tracker->setVisualizationRequestCallback(
+        [this](const std::string& name) { return imageIsRequested(name); });
   }
 }
 
-void TrackingVisualizer::publishImage(const cv::Mat& image,
-                                      const std::string& name) {
+TrackingVisualizer::ImagePublisher& TrackingVisualizer::getPublisher(
+    const std::string& name) {
   auto it = publishers_.find(name);
   if (it == publishers_.end()) {
     // Advertise a new topic if there is no publisher for the given name.
-    it = publishers_.emplace(name, nh_.advertise<sensor_msgs::Image>(name, 100))
-             .first;
+    it = publishers_.emplace(name, ImagePublisher()).first;
+    it->second.publisher = nh_.advertise<sensor_msgs::Image>(name, 100);
   }
+  return it->second;
+}
 
-  // Publish the image, expected as BGR8.
+bool TrackingVisualizer::imageIsRequested(const std::string& name) {
+  const ImagePublisher& publisher = getPublisher(name);
+  if (publisher.publisher.getNumSubscribers() == 0) {
+    return false;
+  }
+  if (config_.max_publish_rate > 0.f && !publisher.last_published.isZero()) {
+    return (ros::Time::now() - publisher.last_published).toSec() >=
+           1.0 / config_.max_publish_rate;
+  }
+  return true;
+}
+
+void TrackingVisualizer::publishImage(const cv::Mat& image,
+                                      const std::string& name) {
+  ImagePublisher& publisher = getPublisher(name);
   std_msgs::Header header;
   header.stamp = ros::Time::now();
-  it->second.publish(
-      cv_bridge::CvImage(header, sensor_msgs::image_encodings::BGR8, image)
+  publisher.last_published = header.stamp;
+
+  // Publish the image, expected as BGR8.
+  cv::Mat msg_image = image;
+  if (config_.image_downsampling > 1) {
+    const double scale = 1.0 / config_.image_downsampling;
+    cv::resize(image, msg_image, cv::Size(), scale, scale, cv::INTER_NEAREST);
+  }
+  publisher.publisher.publish(
+      cv_bridge::CvImage(header, sensor_msgs::image_encodings::BGR8, msg_image)
           .toImageMsg());
 }
 
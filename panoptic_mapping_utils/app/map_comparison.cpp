@@ -0,0 +1,29 @@
+#include <panoptic_mapping/3rd_party/config_utilities.hpp>
+#include <ros/ros.h>
+
+#include "panoptic_mapping_utils/evaluation/map_comparator.h"
+
+int main(int argc, char** argv) {
+  config_utilities::RequiredArguments ra(
+      &argc, &argv, {"--logtostderr", "--colorlogtostderr"});
+
+  // Setup logging.
+  google::InitGoogleLogging(argv[0]);
+  google::InstallFailureSignalHandler();
+  google::ParseCommandLineFlags(&argc, &argv, false);
+
+  // Run ros.
+  ros::init(argc, argv, "map_comparison_node");
+  ros::NodeHandle nh_private("~");
+
+  // Compare the maps.
+  panoptic_mapping::MapComparator comparator(
+      config_utilities::getConfigFromRos<
+          panoptic_mapping::MapComparator::Config>(nh_private));
+  if (!comparator.compare()) {
+    return 1;
+  }
+
+  // Return 0 if the maps are equal within the tolerances.
+  return comparator.getSummary().mapsAreEqual() ? 0 : 2;
+}
@@ -0,0 +1,166 @@
+#ifndef PANOPTIC_MAPPING_UTILS_EVALUATION_MAP_COMPARATOR_H_
+#define PANOPTIC_MAPPING_UTILS_EVALUATION_MAP_COMPARATOR_H_
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <panoptic_mapping/3rd_party/config_utilities.hpp>
+#include <panoptic_mapping/common/common.h>
+#include <panoptic_mapping/map/submap_collection.h>
+
+namespace panoptic_mapping {
+
+/**
+ * @brief Structural comparison of two maps, e.g. of two sessions or of the
+ * output before and after a change of the mapper. Submaps are matched by ID or
+ * by class and spatial overlap, and all blocks of matched submaps are compared
+ * voxel by voxel in parallel. Identical blocks are detected with an early
+ * exit and skip the detailed comparison.
+ */
+class MapComparator {
+ public:
+  struct Config : public config_utilities::Config<Config> {
+    int verbosity = 2;
+
+    // Maps to compare (.panmap files).
+    std::string map_file_a;
+    std::string map_file_b;
+
+    // If set, write all blocks that differ to this CSV file.
+    std::string changed_blocks_file;
+
+    // How to match submaps of the two maps. Supported are {id, overlap}.
+    // 'overlap' matches submaps with the same class by the fraction of shared
+    // blocks.
+    std::string submap_matching = "id";
+
+    // Minimum fraction of the blocks of the smaller submap that need to be
+    // shared for an overlap match.
+    float min_overlap = 0.5f;
+
+    // Differences up to these values are considered equal.
+    float distance_tolerance = 1e-4f;  // m
+    float weight_tolerance = 1e-4f;
+    float score_tolerance = 1e-4f;
+
+    // Number of threads used to match and compare the maps.
+    int num_threads = std::thread::hardware_concurrency();
+
+    Config() { setConfigName("MapComparator"); }
+
+   protected:
+    void setupParamsAndPrinting() override;
+    void checkParams() const override;
+  };
+
+  // Results of a comparison.
+  struct Summary {
+    // Submaps.
+    size_t submaps_a = 0;
+    size_t submaps_b = 0;
+    size_t matched_submaps = 0;
+    size_t removed_submaps = 0;  // Only in map A.
+    size_t added_submaps = 0;    // Only in map B.
+
+    // Blocks of matched submaps.
+    size_t compared_blocks = 0;
+    size_t identical_blocks = 0;  // Exactly equal.
+    size_t changed_blocks = 0;    // Differences beyond the tolerances.
+    size_t removed_blocks = 0;
+    size_t added_blocks = 0;
+
+    // Voxels of compared blocks that differ beyond the tolerances.
+    size_t distance_differences = 0;
+    size_t weight_differences = 0;
+    size_t color_differences = 0;
+    size_t class_differences = 0;
+    size_t score_differences = 0;
+    float max_distance_difference = 0.f;
+    float max_weight_difference = 0.f;
+    float max_score_difference = 0.f;
+
+    bool mapsAreEqual() const;
+    std::string toString() const;
+  };
+
+  explicit MapComparator(const Config& config);
+  virtual ~MapComparator() = default;
+
+  /**
+   * @brief Load and compare the maps specified in the config.
+   *
+   * @return True if both maps were loaded.
+   */
+  bool compare();
+
+  /**
+   * @brief Compare two maps.
+   */
+  const Summary& compare(const SubmapCollection& map_a,
+                         const SubmapCollection& map_b);
+
+  // Access.
+  const Summary& getSummary() const { return summary_; }
+
+ private:
+  // Matched submap IDs, -1 if the submap only exists in one map.
+  struct SubmapMatch {
+    int id_a = -1;
+    int id_b = -1;
+  };
+
+  // Block to be compared.
+  struct BlockTask {
+    size_t match_index;
+    BlockIndex block_index;
+  };
+
+  // Comparison result of a single block.
+  struct BlockDifference {
+    size_t match_index = 0;
+    BlockIndex block_index;
+    enum class Status { kIdentical, kEqual, kChanged, kRemoved, kAdded };
+    Status status = Status::kIdentical;
+    size_t distance_differences = 0;
+    size_t weight_differences = 0;
+    size_t color_differences = 0;
+    size_t class_differences = 0;
+    size_t score_differences = 0;
+    float max_distance_difference = 0.f;
+    float max_weight_difference = 0.f;
+    float max_score_difference = 0.f;
+  };
+
+  // Matching.
+  std::vector<SubmapMatch> matchSubmapsByID(
+      const SubmapCollection& map_a, const SubmapCollection& map_b) const;
+  std::vector<SubmapMatch> matchSubmapsByOverlap(
+      const SubmapCollection& map_a, const SubmapCollection& map_b) const;
+  static float computeOverlap(const Submap& submap_a, const Submap& submap_b);
+
+  // Comparison.
+  BlockDifference compareBlock(const Submap* submap_a, const Submap* submap_b,
+                               const BlockIndex& block_index) const;
+  void compareVoxels(const Submap& submap_a, const Submap& submap_b,
+                     const BlockIndex& block_index,
+                     BlockDifference* result) const;
+  // Exact comparison of the compared quantities, stops at the first
+  // difference.
+  static bool blocksAreIdentical(const Submap& submap_a,
+                                 const Submap& submap_b,
+                                 const BlockIndex& block_index);
+  void addToSummary(const BlockDifference& difference);
+
+  // Output.
+  void writeChangedBlocks(const std::vector<SubmapMatch>& matches,
+                          const std::vector<BlockDifference>& differences);
+
+ private:
+  const Config config_;
+  Summary summary_;
+};
+
+}  // namespace panoptic_mapping
+
+#endif  // PANOPTIC_MAPPING_UTILS_EVALUATION_MAP_COMPARATOR_H_
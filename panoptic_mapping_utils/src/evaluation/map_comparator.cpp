@@ -0,0 +1,540 @@
+#include "panoptic_mapping_utils/evaluation/map_comparator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <panoptic_mapping/common/index_getter.h>
+#include <voxblox/core/block_hash.h>
+
+namespace panoptic_mapping {
+
+void MapComparator::Config::checkParams() const {
+  checkParamCond(submap_matching == "id" || submap_matching == "overlap",
+                 "'submap_matching' must be one of {id, overlap}.");
+  checkParamGT(min_overlap, 0.f, "min_overlap");
+  checkParamLE(min_overlap, 1.f, "min_overlap");
+  checkParamGE(distance_tolerance, 0.f, "distance_tolerance");
+  checkParamGE(weight_tolerance, 0.f, "weight_tolerance");
+  checkParamGE(score_tolerance, 0.f, "score_tolerance");
+  checkParamGT(num_threads, 0, "num_threads");
+}
+
+void MapComparator::Config::setupParamsAndPrinting() {
+  setupParam("verbosity", &verbosity);
+  setupParam("map_file_a", &map_file_a);
+  setupParam("map_file_b", &map_file_b);
+  setupParam("changed_blocks_file", &changed_blocks_file);
+  setupParam("submap_matching", &submap_matching);
+  setupParam("min_overlap", &min_overlap);
+  setupParam("distance_tolerance", &distance_tolerance, "m");
+  setupParam("weight_tolerance", &weight_tolerance);
+  setupParam("score_tolerance", &score_tolerance);
+  setupParam("num_threads", &num_threads);
+}
+
+bool MapComparator::Summary::mapsAreEqual() const {
+  return matched_submaps == submaps_a && matched_submaps == submaps_b &&
+         changed_blocks == 0 && removed_blocks == 0 && added_blocks == 0;
+}
+
+std::string MapComparator::Summary::toString() const {
+  std::stringstream ss;
+  ss << "Submaps: " << submaps_a << " (A), " << submaps_b << " (B), "
+     << matched_submaps << " matched, " << removed_submaps << " removed, "
+     << added_submaps << " added.\n"
+     << "Blocks: " << compared_blocks << " compared, " << identical_blocks
+     << " identical, " << changed_blocks << " changed, " << removed_blocks
+     << " removed, " << added_blocks << " added.\n"
+     << "Voxel differences: " << distance_differences << " distance (max "
+     << max_distance_difference << "m), " << weight_differences
+     << " weight (max " << max_weight_difference << "), " << color_differences
+     << " color, " << class_differences << " class, " << score_differences
+     << " score (max " << max_score_difference << ").\n"
+     << "The maps are " << (mapsAreEqual() ? "equal." : "different.");
+  return ss.str();
+}
+
+MapComparator::MapComparator(const Config& config)
+    : config_(config.checkValid()) {
+  LOG_IF(INFO, config_.verbosity >= 1) << "\n" << config_.toString();
+}
+
+bool MapComparator::compare() {
+  SubmapCollection map_a;
+  SubmapCollection map_b;
+  std::future<bool> load_a =
+      std::async(std::launch::async, [this, &map_a]() {
+        return map_a.loadFromFile(config_.map_file_a, false);
+      });
+  const bool loaded_b = map_b.loadFromFile(config_.map_file_b, false);
+  const bool loaded_a = load_a.get();
+  if (!loaded_a || !loaded_b) {
+    LOG(ERROR) << "Could not load map '"
+               << (loaded_a ? config_.map_file_b : config_.map_file_a) << "'.";
+    return false;
+  }
+  compare(map_a, map_b);
+  return true;
+}
+
+const MapComparator::Summary& MapComparator::compare(
+    const SubmapCollection& map_a, const SubmapCollection& map_b) {
+  summary_ = Summary();
+  summary_.submaps_a = map_a.size();
+  summary_.submaps_b = map_b.size();
+
+  // Match the submaps.
+  const std::vector<SubmapMatch> matches =
+      config_.submap_matching == "id" ? matchSubmapsByID(map_a, map_b)
+                                      : matchSubmapsByOverlap(map_a, map_b);
+
+  // Collect all blocks to compare.
+  std::vector<BlockTask> tasks;
+  for (size_t i = 0; i < matches.size(); ++i) {
+    const SubmapMatch& match = matches[i];
+    if (match.id_a >= 0 && match.id_b >= 0) {
+      summary_.matched_submaps++;
+    } else if (match.id_a >= 0) {
+      summary_.removed_submaps++;
+    } else {
+      summary_.added_submaps++;
+    }
+    voxblox::IndexSet blocks;
+    for (const int id : {match.id_a, match.id_b}) {
+      if (id >= 0) {
+        voxblox::BlockIndexList block_list;
+        (id == match.id_a ? map_a : map_b)
+            .getSubmap(id)
+            .getTsdfLayer()
+            .getAllAllocatedBlocks(&block_list);
+        blocks.insert(block_list.begin(), block_list.end());
+      }
+    }
+    for (const BlockIndex& block_index : blocks) {
+      tasks.push_back({i, block_index});
+    }
+  }
+
+  // Compare all blocks in parallel.
+  std::vector<int> indices(tasks.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  IndexGetter<int> index_getter(indices);
+  std::vector<std::future<std::vector<BlockDifference>>> threads;
+  for (int i = 0; i < config_.num_threads; ++i) {
+    threads.emplace_back(std::async(
+        std::launch::async,
+        [this, &index_getter, &tasks, &matches, &map_a,
+         &map_b]() -> std::vector<BlockDifference> {
+          std::vector<BlockDifference> result;
+          int index;
+          while (index_getter.getNextIndex(&index)) {
+            const BlockTask& task = tasks[index];
+            const SubmapMatch& match = matches[task.match_index];
+            const Submap* submap_a =
+                match.id_a >= 0 ? &map_a.getSubmap(match.id_a) : nullptr;
+            const Submap* submap_b =
+                match.id_b >= 0 ? &map_b.getSubmap(match.id_b) : nullptr;
+            result.push_back(
+                compareBlock(submap_a, submap_b, task.block_index));
+            result.back().match_index = task.match_index;
+          }
+          return result;
+        }));
+  }
+
+  // Aggregate the results.
+  std::vector<BlockDifference> differences;
+  for (auto& thread : threads) {
+    for (const BlockDifference& difference : thread.get()) {
+      addToSummary(difference);
+      if (difference.status != BlockDifference::Status::kIdentical &&
+          difference.status != BlockDifference::Status::kEqual) {
+        differences.push_back(difference);
+      }
+    }
+  }
+  if (!config_.changed_blocks_file.empty()) {
+    writeChangedBlocks(matches, differences);
+  }
+  LOG_IF(INFO, config_.verbosity >= 1) << "\n" << summary_.toString();
+  return summary_;
+}
+
+std::vector<MapComparator::SubmapMatch> MapComparator::matchSubmapsByID(
+    const SubmapCollection& map_a, const SubmapCollection& map_b) const {
+  std::vector<SubmapMatch> result;
+  for (const Submap& submap : map_a) {
+    SubmapMatch match;
+    match.id_a = submap.getID();
+    if (map_b.submapIdExists(submap.getID())) {
+      match.id_b = submap.getID();
+    }
+    result.push_back(match);
+  }
+  for (const Submap& submap : map_b) {
+    if (!map_a.submapIdExists(submap.getID())) {
+      SubmapMatch match;
+      match.id_b = submap.getID();
+      result.push_back(match);
+    }
+  }
+  return result;
+}
+
+std::vector<MapComparator::SubmapMatch> MapComparator::matchSubmapsByOverlap(
+    const SubmapCollection& map_a, const SubmapCollection& map_b) const {
+  // Compute the overlap of all submaps with the same class in parallel.
+  struct Candidate {
+    int id_a;
+    int id_b;
+    float overlap;
+  };
+  std::vector<int> ids_a;
+  for (const Submap& submap : map_a) {
+    ids_a.push_back(submap.getID());
+  }
+  SubmapIndexGetter index_getter(ids_a);
+  std::vector<std::future<std::vector<Candidate>>> threads;
+  for (int i = 0; i < config_.num_threads; ++i) {
+    threads.emplace_back(std::async(
+        std::launch::async,
+        [this, &index_getter, &map_a, &map_b]() -> std::vector<Candidate> {
+          std::vector<Candidate> result;
+          int id_a;
+          while (index_getter.getNextIndex(&id_a)) {
+            const Submap& submap_a = map_a.getSubmap(id_a);
+            for (const Submap& submap_b : map_b) {
+              if (submap_a.getClassID() != submap_b.getClassID() ||
+                  submap_a.getLabel() != submap_b.getLabel()) {
+                continue;
+              }
+              const float overlap = computeOverlap(submap_a, submap_b);
+              if (overlap >= config_.min_overlap) {
+                result.push_back({id_a, submap_b.getID(), overlap});
+              }
+            }
+          }
+          return result;
+        }));
+  }
+  std::vector<Candidate> candidates;
+  for (auto& thread : threads) {
+    for (const Candidate& candidate : thread.get()) {
+      candidates.push_back(candidate);
+    }
+  }
+
+  // Greedily assign the best overlaps.
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& lhs, const Candidate& rhs) {
+              return lhs.overlap > rhs.overlap;
+            });
+  std::unordered_map<int, int> a_to_b;
+  std::unordered_set<int> matched_b;
+  for (const Candidate& candidate : candidates) {
+    if (a_to_b.find(candidate.id_a) != a_to_b.end() ||
+        matched_b.find(candidate.id_b) != matched_b.end()) {
+      continue;
+    }
+    a_to_b[candidate.id_a] = candidate.id_b;
+    matched_b.insert(candidate.id_b);
+  }
+  std::vector<SubmapMatch> result;
+  for (const int id_a : ids_a) {
+    SubmapMatch match;
+    match.id_a = id_a;
+    auto it = a_to_b.find(id_a);
+    if (it != a_to_b.end()) {
+      match.id_b = it->second;
+    }
+    result.push_back(match);
+  }
+  for (const Submap& submap : map_b) {
+    if (matched_b.find(submap.getID()) == matched_b.end()) {
+      SubmapMatch match;
+      match.id_b = submap.getID();
+      result.push_back(match);
+    }
+  }
+  return result;
+}
+
+float MapComparator::computeOverlap(const Submap& submap_a,
+                                    const Submap& submap_b) {
+  // Fraction of the blocks of the smaller submap whose centers fall into
+  // blocks of the other submap.
+  const Submap& smaller = submap_a.getTsdfLayer().getNumberOfAllocatedBlocks() <
+                                  submap_b.getTsdfLayer()
+                                      .getNumberOfAllocatedBlocks()
+                              ? submap_a
+                              : submap_b;
+  const Submap& larger = &smaller == &submap_a ? submap_b : submap_a;
+  voxblox::BlockIndexList blocks;
+  smaller.getTsdfLayer().getAllAllocatedBlocks(&blocks);
+  if (blocks.empty()) {
+    return 0.f;
+  }
+  const Transformation T_larger_smaller =
+      larger.getT_S_M() * smaller.getT_M_S();
+  const float block_size = smaller.getTsdfLayer().block_size();
+  size_t shared = 0;
+  for (const BlockIndex& block_index : blocks) {
+    const Point center =
+        T_larger_smaller *
+        voxblox::getCenterPointFromGridIndex(block_index, block_size);
+    if (larger.getTsdfLayer().getBlockPtrByCoordinates(center)) {
+      shared++;
+    }
+  }
+  return static_cast<float>(shared) / blocks.size();
+}
+
+MapComparator::BlockDifference MapComparator::compareBlock(
+    const Submap* submap_a, const Submap* submap_b,
+    const BlockIndex& block_index) const {
+  BlockDifference result;
+  result.block_index = block_index;
+  const bool in_a =
+      submap_a && submap_a->getTsdfLayer().hasBlock(block_index);
+  const bool in_b =
+      submap_b && submap_b->getTsdfLayer().hasBlock(block_index);
+  if (!in_b) {
+    result.status = BlockDifference::Status::kRemoved;
+    return result;
+  }
+  if (!in_a) {
+    result.status = BlockDifference::Status::kAdded;
+    return result;
+  }
+
+  // Skip blocks with identical data.
+  if (blocksAreIdentical(*submap_a, *submap_b, block_index)) {
+    result.status = BlockDifference::Status::kIdentical;
+    return result;
+  }
+  compareVoxels(*submap_a, *submap_b, block_index, &result);
+  const bool changed = result.distance_differences > 0 ||
+                       result.weight_differences > 0 ||
+                       result.color_differences > 0 ||
+                       result.class_differences > 0 ||
+                       result.score_differences > 0;
+  result.status = changed ? BlockDifference::Status::kChanged
+                          : BlockDifference::Status::kEqual;
+  return result;
+}
+
+void MapComparator::compareVoxels(const Submap& submap_a,
+                                  const Submap& submap_b,
+                                  const BlockIndex& block_index,
+                                  BlockDifference* result) const {
+  const TsdfBlock& tsdf_a =
+      submap_a.getTsdfLayer().getBlockByIndex(block_index);
+  const TsdfBlock& tsdf_b =
+      submap_b.getTsdfLayer().getBlockByIndex(block_index);
+  if (tsdf_a.num_voxels() != tsdf_b.num_voxels() ||
+      tsdf_a.voxel_size() != tsdf_b.voxel_size()) {
+    // Different resolutions can not be compared voxel by voxel.
+    result->distance_differences = tsdf_b.num_voxels();
+    return;
+  }
+
+  // Optional layers are only compared if both submaps have them.
+  ClassBlock::ConstPtr class_a;
+  ClassBlock::ConstPtr class_b;
+  if (submap_a.hasClassLayer() && submap_b.hasClassLayer()) {
+    class_a = submap_a.getClassLayer().getBlockConstPtrByIndex(block_index);
+    class_b = submap_b.getClassLayer().getBlockConstPtrByIndex(block_index);
+  }
+  const bool compare_classes = class_a && class_b;
+  ScoreBlock::ConstPtr score_a;
+  ScoreBlock::ConstPtr score_b;
+  if (submap_a.hasScoreLayer() && submap_b.hasScoreLayer()) {
+    score_a = submap_a.getScoreLayer().getBlockConstPtrByIndex(block_index);
+    score_b = submap_b.getScoreLayer().getBlockConstPtrByIndex(block_index);
+  }
+  const bool compare_scores = score_a && score_b;
+
+  for (size_t i = 0; i < tsdf_a.num_voxels(); ++i) {
+    const TsdfVoxel& voxel_a = tsdf_a.getVoxelByLinearIndex(i);
+    const TsdfVoxel& voxel_b = tsdf_b.getVoxelByLinearIndex(i);
+    const float distance_difference =
+        std::abs(voxel_a.distance - voxel_b.distance);
+    if (distance_difference > config_.distance_tolerance) {
+      result->distance_differences++;
+      result->max_distance_difference =
+          std::max(result->max_distance_difference, distance_difference);
+    }
+    const float weight_difference = std::abs(voxel_a.weight - voxel_b.weight);
+    if (weight_difference > config_.weight_tolerance) {
+      result->weight_differences++;
+      result->max_weight_difference =
+          std::max(result->max_weight_difference, weight_difference);
+    }
+    if (voxel_a.color.r != voxel_b.color.r ||
+        voxel_a.color.g != voxel_b.color.g ||
+        voxel_a.color.b != voxel_b.color.b) {
+      result->color_differences++;
+    }
+    if (compare_classes) {
+      const ClassVoxel& class_voxel_a = class_a->getVoxelByLinearIndex(i);
+      const ClassVoxel& class_voxel_b = class_b->getVoxelByLinearIndex(i);
+      if (class_voxel_a.getBelongingID() != class_voxel_b.getBelongingID() ||
+          class_voxel_a.belongsToSubmap() != class_voxel_b.belongsToSubmap()) {
+        result->class_differences++;
+      }
+    }
+    if (compare_scores) {
+      const float score_difference =
+          std::abs(score_a->getVoxelByLinearIndex(i).getScore() -
+                   score_b->getVoxelByLinearIndex(i).getScore());
+      if (score_difference > config_.score_tolerance) {
+        result->score_differences++;
+        result->max_score_difference =
+            std::max(result->max_score_difference, score_difference);
+      }
+    }
+  }
+}
+
+bool MapComparator::blocksAreIdentical(const Submap& submap_a,
+                                       const Submap& submap_b,
+                                       const BlockIndex& block_index) {
+  const TsdfBlock& tsdf_a =
+      submap_a.getTsdfLayer().getBlockByIndex(block_index);
+  const TsdfBlock& tsdf_b =
+      submap_b.getTsdfLayer().getBlockByIndex(block_index);
+  if (tsdf_a.num_voxels() != tsdf_b.num_voxels() ||
+      tsdf_a.voxel_size() != tsdf_b.voxel_size()) {
+    return false;
+  }
+  for (size_t i = 0; i < tsdf_a.num_voxels(); ++i) {
+    const TsdfVoxel& voxel_a = tsdf_a.getVoxelByLinearIndex(i);
+    const TsdfVoxel& voxel_b = tsdf_b.getVoxelByLinearIndex(i);
+    if (voxel_a.distance != voxel_b.distance ||
+        voxel_a.weight != voxel_b.weight ||
+        voxel_a.color.r != voxel_b.color.r ||
+        voxel_a.color.g != voxel_b.color.g ||
+        voxel_a.color.b != voxel_b.color.b) {
+      return false;
+    }
+  }
+
+  // Optional layers are identical if they only exist in one submap or are
+  // equal in the compared quantities.
+  if (submap_a.hasClassLayer() && submap_b.hasClassLayer()) {
+    const ClassBlock::ConstPtr class_a =
+        submap_a.getClassLayer().getBlockConstPtrByIndex(block_index);
+    const ClassBlock::ConstPtr class_b =
+        submap_b.getClassLayer().getBlockConstPtrByIndex(block_index);
+    if (class_a && class_b) {
+      for (size_t i = 0; i < tsdf_a.num_voxels(); ++i) {
+        const ClassVoxel& voxel_a = class_a->getVoxelByLinearIndex(i);
+        const ClassVoxel& voxel_b = class_b->getVoxelByLinearIndex(i);
+        if (voxel_a.getBelongingID() != voxel_b.getBelongingID() ||
+            voxel_a.belongsToSubmap() != voxel_b.belongsToSubmap()) {
+          return false;
+        }
+      }
+    }
+  }
+  if (submap_a.hasScoreLayer() && submap_b.hasScoreLayer()) {
+    const ScoreBlock::ConstPtr score_a =
+        submap_a.getScoreLayer().getBlockConstPtrByIndex(block_index);
+    const ScoreBlock::ConstPtr score_b =
+        submap_b.getScoreLayer().getBlockConstPtrByIndex(block_index);
+    if (score_a && score_b) {
+      for (size_t i = 0; i < tsdf_a.num_voxels(); ++i) {
+        if (score_a->getVoxelByLinearIndex(i).getScore() !=
+            score_b->getVoxelByLinearIndex(i).getScore()) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void MapComparator::addToSummary(const BlockDifference& difference) {
+  switch (difference.status) {
+    case BlockDifference::Status::kRemoved:
+      summary_.removed_blocks++;
+      return;
+    case BlockDifference::Status::kAdded:
+      summary_.added_blocks++;
+      return;
+    case BlockDifference::Status::kIdentical:
+      summary_.identical_blocks++;
+      break;
+    case BlockDifference::Status::kChanged:
+      summary_.changed_blocks++;
+      break;
+    case BlockDifference::Status::kEqual:
+      break;
+  }
+  summary_.compared_blocks++;
+  summary_.distance_differences += difference.distance_differences;
+  summary_.weight_differences += difference.weight_differences;
+  summary_.color_differences += difference.color_differences;
+  summary_.class_differences += difference.class_differences;
+  summary_.score_differences += difference.score_differences;
+  summary_.max_distance_difference = std::max(
+      summary_.max_distance_difference, difference.max_distance_difference);
+  summary_.max_weight_difference = std::max(summary_.max_weight_difference,
+                                            difference.max_weight_difference);
+  summary_.max_score_difference = std::max(summary_.max_score_difference,
+                                           difference.max_score_difference);
+}
+
+void MapComparator::writeChangedBlocks(
+    const std::vector<SubmapMatch>& matches,
+    const std::vector<BlockDifference>& differences) {
+  std::ofstream file(config_.changed_blocks_file);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open output file '" << config_.changed_blocks_file
+               << "'.";
+    return;
+  }
+  file << "SubmapA,SubmapB,BlockX,BlockY,BlockZ,Status,DistanceDifferences,"
+          "MaxDistanceDifference,WeightDifferences,MaxWeightDifference,"
+          "ColorDifferences,ClassDifferences,ScoreDifferences,"
+          "MaxScoreDifference\n";
+  for (const BlockDifference& difference : differences) {
+    const SubmapMatch& match = matches[difference.match_index];
+    std::string status;
+    switch (difference.status) {
+      case BlockDifference::Status::kRemoved:
+        status = "removed";
+        break;
+      case BlockDifference::Status::kAdded:
+        status = "added";
+        break;
+      default:
+        status = "changed";
+    }
+    file << match.id_a << "," << match.id_b << ","
+         << difference.block_index.x() << "," << difference.block_index.y()
+         << "," << difference.block_index.z() << "," << status << ","
+         << difference.distance_differences << ","
+         << difference.max_distance_difference << ","
+         << difference.weight_differences << ","
+         << difference.max_weight_difference << ","
+         << difference.color_differences << ","
+         << difference.class_differences << ","
+         << difference.score_differences << ","
+         << difference.max_score_difference << "\n";
+  }
+  LOG_IF(INFO, config_.verbosity >= 2)
+      << "Wrote " << differences.size() << " changed blocks to '"
+      << config_.changed_blocks_file << "'.";
+}
+
+}  // namespace panoptic_mapping